@@ -112,6 +112,16 @@
                             "DEBUG_INFORMATION_FORMAT": "dwarf-with-dsym"
                         },
                     }
+                ],
+                [
+                    'OS=="linux"',
+                    {
+                        'libraries': [
+                            '<(module_root_dir)/window-monitor/install/lib/libmonitor.a',
+                            # xcb only when cmake found it for the monitor
+                            '<!@(cat ./window-monitor/install/lib/monitor.libs)',
+                        ],
+                    }
                 ]
             ]
         },
@@ -10,6 +10,10 @@ const enum WindowMonitorEventType {
   Minimized = 8,
   Maxmized = 9,
   Restore = 10,
+  /** a drag started, the updates until GestureEnded are Moving */
+  GestureStarted = 11,
+  /** a drag ended, after its final Moved, with a WindowMonitorGesture */
+  GestureEnded = 12,
 }
 
 const enum WindowMonitorErrorCode {
@@ -28,6 +32,99 @@ declare type WindowMonitorBounds = {
   bottom: number;
 };
 
+/**
+ * Records of registerWindowMonitorBatch are packed in a Float64Array, each
+ * record has WindowMonitorBatchStride numbers:
+ * winId, event, left, top, right, bottom, timestamp(microseconds).
+ */
+const WindowMonitorBatchStride = 7;
+
+/**
+ * Summary of a drag passed with GestureEnded to callbacks of
+ * registerWindowMonitor. Moves outside of a drag are Moved, consumers which
+ * only lay out once a window settled leave Moving out of the events they
+ * register for and get no updates in the middle of drags.
+ */
+declare type WindowMonitorGesture = {
+  startRect: WindowMonitorBounds;
+  endRect: WindowMonitorBounds;
+  /** milliseconds */
+  duration: number;
+  /** updates of the rect reported during the drag */
+  samples: number;
+};
+
+/**
+ * Events delivered for a window, the others are dropped natively before they
+ * are queued. events is a mask of 1 << WindowMonitorEventType, all types by
+ * default. Moving, Moved and Resized are dropped unless an edge moved by
+ * minDelta pixels since the last rect delivered, 1 drops unchanged rects.
+ * predictMs extrapolates the rects of Moving that many milliseconds past
+ * when they are delivered from the velocity of the drag, to hide the latency
+ * of drawing over a dragged window. Each environment registering a window
+ * gets its own minDelta and predictMs.
+ */
+declare type WindowMonitorOptions = {
+  events?: number;
+  minDelta?: number;
+  predictMs?: number;
+};
+
+declare type WindowMonitorLaneStats = {
+  queued: number;
+  /** deepest the lane was when the main loop started delivering */
+  highWater: number;
+  dropped: number;
+  /** kept beyond the storage of the lane */
+  spilled: number;
+  capacity: number;
+};
+
+/**
+ * Latencies in microseconds, percentiles are within 1/16 of the real value.
+ */
+declare type LatencyStats = {
+  count: number;
+  mean: number;
+  p50: number;
+  p99: number;
+  p999: number;
+  max: number;
+};
+
+declare type EventStats = {
+  queued: number;
+  coalesced: number;
+  /** events this environment did not register for or below its minDelta */
+  filtered: number;
+  /** events of types no environment registered for */
+  filteredTypes: number;
+  /** geometry updates below the minDelta of every environment */
+  filteredUnchanged: number;
+  dropped: number;
+  yields: number;
+  budgetEvents: number;
+  budgetMicroseconds: number;
+  /**
+   * Priority lanes, state changes are in lanes[0] and never dropped, lanes[1]
+   * has Moved and Resized, lanes[2] has Moving. A lane delivers a few events
+   * in a row at most while the lanes after it wait. The events of one window
+   * are delivered in the order they happened, those queued while a state
+   * change of the window waits follow it in lanes[0].
+   */
+  lanes: WindowMonitorLaneStats[];
+  latency: {
+    /** from capture by the window system to being queued */
+    capture: LatencyStats;
+    /** from being queued to being taken by the main loop */
+    queue: LatencyStats;
+    /** from being taken to the js callback returning */
+    callback: LatencyStats;
+    /** from capture to the js callback returning */
+    total: LatencyStats;
+  };
+};
+
 declare interface IAgoraPlugin {
   checkAccessPrivilege: () => boolean;
   registerWindowMonitor: (
@@ -35,14 +132,76 @@ declare interface IAgoraPlugin {
     callback: (
       winId: number,
       event: WindowMonitorEventType,
-      bounds: WindowMonitorBounds
-    ) => void
+      bounds: WindowMonitorBounds,
+      gesture?: WindowMonitorGesture
+    ) => void,
+    options?: WindowMonitorOptions
+  ) => WindowMonitorErrorCode;
+  registerWindowMonitorBatch: (
+    winId: number,
+    callback: (records: Float64Array) => void,
+    options?: WindowMonitorOptions
   ) => WindowMonitorErrorCode;
   unregisterWindowMonitor: (winId: number) => void;
   getWindowRect: (winId: number) => WindowMonitorBounds;
+  /**
+   * Limit the events delivered per main loop wakeup, zero means no limit.
+   */
+  setWindowMonitorDrainBudget: (
+    maxEvents: number,
+    maxMicroseconds: number
+  ) => void;
+  /**
+   * Deliver at most one geometry update per window and frame, the latest
+   * one, at rate frames per second or the refresh rate of the display. The
+   * end of a drag and state changes are delivered right away, 0 delivers
+   * every event again. Returns the rate paced at.
+   */
+  setWindowMonitorFrameRate: (rate: number | 'display') => number;
+  /**
+   * Counters and latencies of the events delivered since load or resetStats,
+   * coalesced updates report the times of the oldest update they replaced.
+   */
+  getStats: () => EventStats;
+  resetStats: () => void;
+  /**
+   * Trace the native pipeline, hooks, classification, queueing, drains and
+   * js callbacks, until stopTracing writes a Chrome JSON trace to path which
+   * chrome://tracing and Perfetto load. False when tracing already.
+   */
+  startTracing: (path: string) => boolean;
+  /**
+   * Count of trace events written, -1 when not tracing or path failed.
+   */
+  stopTracing: () => number;
+  /**
+   * Write the raw events of the monitor to a binary event trace at path,
+   * false when recording already.
+   */
+  startWindowMonitorRecording: (path: string) => boolean;
+  /**
+   * Count of events recorded, -1 when not recording or path failed.
+   */
+  stopWindowMonitorRecording: () => number;
+  /**
+   * Report the events of a trace to the registered windows again, at speed
+   * times the recorded pace, 1 by default, or as fast as possible for 0.
+   * Resolves with the count of events replayed, their callbacks may still be
+   * pending.
+   */
+  replayWindowMonitorTrace: (path: string, speed?: number) => Promise<number>;
 }
 
 const AgoraPlugin: IAgoraPlugin = require('../build/Release/agora_plugin.node');
 
-export { WindowMonitorEventType, WindowMonitorErrorCode, WindowMonitorBounds };
+export {
+  WindowMonitorEventType,
+  WindowMonitorErrorCode,
+  WindowMonitorBounds,
+  WindowMonitorBatchStride,
+  WindowMonitorOptions,
+  WindowMonitorLaneStats,
+  LatencyStats,
+  EventStats,
+};
 export default AgoraPlugin;
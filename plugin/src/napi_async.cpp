@@ -3,12 +3,12 @@
 namespace agora {
 namespace plugin {
 
-node_async_call node_async_call::s_instance_;
-
-node_async_call::node_async_call() {
+node_async_call::node_async_call(uv_loop_t* loop) {
   node_queue_.reset(new async_queue<task_type>(
-      uv_default_loop(),
+      loop,
       std::bind(&node_async_call::run_task, this, std::placeholders::_1)));
+  // tasks settle promises and call back into js, a burst must not lose any
+  node_queue_->set_lane(0, 0, async_drop_policy::never_drop);
 }
 
 node_async_call::~node_async_call() {}
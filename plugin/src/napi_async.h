@@ -10,114 +10,565 @@
 #include <cstdint>
 #include <functional>
 #include <future>
+#include <memory>
 #include <mutex>
+#include <new>
 #include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "epoch_snapshot.h"
+#include "napi_trace.h"
 
 namespace agora {
 namespace plugin {
 
 using task_type = std::function<void(void)>;
 
-template <typename Elem, typename T2 = int, typename Lck = std::mutex>
+static const size_t kCacheLineSize = 64;
+
+// Storage policy which guards a std::queue with a lock, every push and pop
+// takes the lock and the queue grows without bound.
+template <typename Elem, typename Lck = std::mutex>
+class locked_queue {
+  locked_queue(const locked_queue&) = delete;
+  locked_queue& operator=(const locked_queue&) = delete;
+
+ public:
+  locked_queue() {}
+
+  bool try_push(Elem& e) {
+    std::lock_guard<Lck> guard(lock_);
+    q_.push(std::move(e));
+    return true;
+  }
+
+  bool pop(Elem& e) {
+    std::lock_guard<Lck> guard(lock_);
+    if (q_.empty()) return false;
+    e = std::move(q_.front());
+    q_.pop();
+    return true;
+  }
+
+  size_t size() const {
+    std::lock_guard<Lck> guard(lock_);
+    return q_.size();
+  }
+
+  void clear() {
+    std::lock_guard<Lck> guard(lock_);
+    std::queue<Elem> empty;
+    std::swap(q_, empty);
+  }
+
+ private:
+  mutable Lck lock_;
+  std::queue<Elem> q_;
+};
+
+// Storage policy with a preallocated bounded ring, producers and consumer
+// never block each other. Each cell carries a sequence number which tells
+// whether it is ready to be written or read (D. Vyukov's bounded queue).
+// Though async_queue has only one consumer, the ring accepts pops from any
+// thread, producers rely on it to drop the oldest element of a lane over
+// capacity. A full ring rejects pushes, async_queue spills them.
+template <typename Elem, size_t N = 1024>
+class mpsc_ring {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "N must be a power of two");
+
+  mpsc_ring(const mpsc_ring&) = delete;
+  mpsc_ring& operator=(const mpsc_ring&) = delete;
+
+  struct cell {
+    std::atomic<size_t> seq;
+    typename std::aligned_storage<sizeof(Elem), alignof(Elem)>::type data;
+  };
+
+  // pad every cell to whole cache lines so neighbours never share one
+  struct padded_cell : cell {
+    char pad[kCacheLineSize - sizeof(cell) % kCacheLineSize];
+  };
+
+ public:
+  mpsc_ring() {
+    // over-aligned new is not available before c++17, align by hand
+    raw_ = ::operator new(sizeof(padded_cell) * N + kCacheLineSize);
+    cells_ = reinterpret_cast<padded_cell*>(
+        (reinterpret_cast<uintptr_t>(raw_) + kCacheLineSize - 1) &
+        ~(uintptr_t)(kCacheLineSize - 1));
+    for (size_t i = 0; i < N; i++) {
+      new (&cells_[i]) padded_cell();
+      cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+    enqueue_pos_.store(0, std::memory_order_relaxed);
+    dequeue_pos_.store(0, std::memory_order_relaxed);
+  }
+
+  ~mpsc_ring() {
+    clear();
+    for (size_t i = 0; i < N; i++) cells_[i].~padded_cell();
+    ::operator delete(raw_);
+  }
+
+  bool pop(Elem& e) {
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+      padded_cell& c = cells_[pos & (N - 1)];
+      size_t seq = c.seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+
+    padded_cell& c = cells_[pos & (N - 1)];
+    Elem* ptr = reinterpret_cast<Elem*>(&c.data);
+    e = std::move(*ptr);
+    ptr->~Elem();
+    c.seq.store(pos + N, std::memory_order_release);
+    return true;
+  }
+
+  size_t size() const {
+    size_t tail = enqueue_pos_.load(std::memory_order_relaxed);
+    size_t head = dequeue_pos_.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+  }
+
+  void clear() {
+    Elem e;
+    while (pop(e)) {
+    }
+  }
+
+  static constexpr size_t max_size() { return N; }
+
+  // only move from e when the push succeeded
+  bool try_push(Elem& e) {
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+      padded_cell& c = cells_[pos & (N - 1)];
+      size_t seq = c.seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+
+    padded_cell& c = cells_[pos & (N - 1)];
+    new (&c.data) Elem(std::move(e));
+    c.seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  void* raw_;
+  padded_cell* cells_;
+  // keep producer and consumer cursors on their own cache lines
+  char pad0_[kCacheLineSize];
+  std::atomic<size_t> enqueue_pos_;
+  char pad1_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> dequeue_pos_;
+  char pad2_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+};
+
+// Single value slot guarded by a sequence lock, readers never block the
+// writer and retry when they raced with it. Writers must be serialized by the
+// caller and T must be trivially copyable.
+//
+// The value is copied word by word through atomics, stored with release and
+// loaded with acquire, so a reader which saw a word of a newer value also
+// sees the sequence bumped ahead of it. Unlike fences, which thread sanitizer
+// does not model, it sees every ordering this relies on.
+template <typename T>
+class seqlock_slot {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "T must be trivially copyable");
+
+  static const size_t kWords =
+      (sizeof(T) + sizeof(uintptr_t) - 1) / sizeof(uintptr_t);
+
+ public:
+  seqlock_slot() : seq_(0) {
+    for (auto& word : words_) word.store(0, std::memory_order_relaxed);
+  }
+
+  void store(const T& value) {
+    uintptr_t words[kWords] = {};
+    memcpy(words, &value, sizeof(T));
+    uint32_t seq = seq_.load(std::memory_order_relaxed);
+    seq_.store(seq + 1, std::memory_order_relaxed);
+    for (size_t i = 0; i < kWords; i++)
+      words_[i].store(words[i], std::memory_order_release);
+    seq_.store(seq + 2, std::memory_order_release);
+  }
+
+  T load() const {
+    uintptr_t words[kWords];
+    for (;;) {
+      uint32_t before = seq_.load(std::memory_order_acquire);
+      if (before & 1) continue;
+      for (size_t i = 0; i < kWords; i++)
+        words[i] = words_[i].load(std::memory_order_acquire);
+      if (seq_.load(std::memory_order_relaxed) == before) break;
+    }
+    T value;
+    memcpy(&value, words, sizeof(T));
+    return value;
+  }
+
+ private:
+  std::atomic<uint32_t> seq_;
+  std::atomic<uintptr_t> words_[kWords];
+};
+
+enum class async_drop_policy {
+  // drop the oldest queued element to make room for the new one
+  drop_oldest,
+  // reject the new element
+  drop_newest,
+  // ignore capacity
+  never_drop,
+};
+
+// Storage decides how elements are kept between producers and the uv thread,
+// use locked_queue<Elem> for the former mutex + std::queue behavior.
+//
+// Elements are queued in lanes, the drain takes from the lane with the lowest
+// index first. Each lane has its own capacity and drop policy so that
+// overload only sheds the elements of less important lanes. What the storage
+// can not hold spills to an unbounded overflow list of the lane, a lane only
+// drops by its policy once it holds its capacity. Each lane has a quota of
+// elements it may take in a row while later lanes wait so that a flooded lane
+// can not starve them, see set_lane_quota.
+template <typename Elem, typename T2 = int, typename Lck = mpsc_ring<Elem>>
 class async_queue {
   async_queue(const async_queue&) = delete;
   async_queue& operator=(const async_queue&) = delete;
 
+  struct lane {
+    lane()
+        : capacity(0),
+          policy(async_drop_policy::drop_oldest),
+          quota(0),
+          dropped(0),
+          spilled(0),
+          overflow_size(0),
+          high_water(0),
+          served(0) {}
+
+    Lck q;
+    // may be changed while producers push
+    std::atomic<size_t> capacity;
+    std::atomic<async_drop_policy> policy;
+    std::atomic<size_t> quota;
+    std::atomic<uint64_t> dropped;
+    // elements which went to the overflow
+    std::atomic<uint64_t> spilled;
+    // once an element spilled all the later ones follow it until the
+    // overflow is drained to keep them in order
+    std::mutex overflow_lock;
+    std::queue<Elem> overflow;
+    std::atomic<size_t> overflow_size;
+    // deepest the lane was when a drain started
+    std::atomic<size_t> high_water;
+    // taken in a row since a later lane was, only touched on the uv thread
+    size_t served;
+  };
+
  public:
-  using callback_type = std::function<void(task_type&)>;
-  async_queue(uv_loop_t* loop, callback_type&& cb)
+  using callback_type = std::function<void(Elem&)>;
+  using flush_type = std::function<void(void)>;
+  async_queue(uv_loop_t* loop, callback_type&& cb, size_t lanes = 1)
       : h_((uv_async_t*)malloc(sizeof(uv_async_t))),
         closed_(false),
+        callers_(0),
         cb_(std::move(cb)),
-        capacity_(0) {
+        lanes_(new lane[lanes ? lanes : 1]),
+        lane_count_(lanes ? lanes : 1),
+        max_elements_(0),
+        max_us_(0),
+        yields_(0) {
     ::uv_async_init(loop, h_, async_callback);
     h_->data = this;
   }
 
+  // Producers must not start new calls once the queue is being destroyed,
+  // the calls still running are waited for before the handle is closed.
   ~async_queue() {
+    close(true);
     uv_close((uv_handle_t*)h_, [](uv_handle_t* handle) { free(handle); });
   }
 
-  int async_call(Elem&& e, uint64_t ts = 0) {
+  int async_call(Elem&& e, uint64_t ts = 0, size_t prio = 0) {
+    NAPI_TRACE_SCOPE(trace, "queue", "async_call");
+    NAPI_TRACE_ARG(trace, "lane", prio);
+    caller_guard caller(callers_);
     if (closed_) {
       return -1;
     }
 
-    {
-      std::lock_guard<Lck> guard(lock_);
-      if (capacity_ && q_.size() > capacity_) {
-        q_.pop();
+    lane& l = lanes_[prio < lane_count_ ? prio : lane_count_ - 1];
+    const size_t capacity = l.capacity.load(std::memory_order_relaxed);
+    // no policy drops without a capacity
+    const async_drop_policy policy =
+        capacity ? l.policy.load(std::memory_order_relaxed)
+                 : async_drop_policy::never_drop;
+    switch (policy) {
+      case async_drop_policy::drop_oldest: {
+        // keeps the latest capacity + 1 elements like set_capacity did
+        size_t dropped = 0;
+        Elem oldest;
+        while (lane_size(l) > capacity && pop(l, oldest)) dropped++;
+        if (dropped) l.dropped.fetch_add(dropped, std::memory_order_relaxed);
+        break;
       }
-      q_.push(std::move(e));
+      case async_drop_policy::drop_newest:
+        if (lane_size(l) >= capacity) {
+          // e is left untouched so the caller can tell it was rejected
+          l.dropped.fetch_add(1, std::memory_order_relaxed);
+          return -1;
+        }
+        break;
+      case async_drop_policy::never_drop:
+        break;
+    }
+
+    if (l.overflow_size.load(std::memory_order_acquire) || !l.q.try_push(e)) {
+      std::lock_guard<std::mutex> guard(l.overflow_lock);
+      l.overflow.push(std::move(e));
+      l.overflow_size.fetch_add(1, std::memory_order_release);
+      l.spilled.fetch_add(1, std::memory_order_relaxed);
     }
 
     return !uv_async_send(h_) ? 0 : -1;
   }
   size_t size() const {
-    std::lock_guard<Lck> guard(lock_);
-    return q_.size();
+    size_t size = 0;
+    for (size_t i = 0; i < lane_count_; i++) size += lane_size(i);
+    return size;
   }
   bool empty() const { return size() == 0; }
+  // Closing rejects new calls and waits for the running ones, so nothing is
+  // pushed after the queue was cleared.
   void close(bool closed) {
-    if (!empty()) {
-      // LOG_WARNING(" You should close this queue after taking all the
-      // elements!");
+    closed_ = closed;
+    if (closed) {
+      while (callers_.load()) std::this_thread::yield();
     }
     clear();
-    closed_ = closed;
   }
   bool closed() const { return closed_; }
-  void set_priority(int prio) {}
-  void set_capacity(size_t capacity) { capacity_ = capacity; }
+  size_t lanes() const { return lane_count_; }
+  // Set capacity and drop policy of a lane, capacity zero means no limit and
+  // nothing is dropped whatever the policy.
+  void set_lane(size_t prio, size_t capacity, async_drop_policy policy) {
+    if (prio >= lane_count_) return;
+    lanes_[prio].capacity.store(capacity, std::memory_order_relaxed);
+    lanes_[prio].policy.store(policy, std::memory_order_relaxed);
+  }
+  // Limit the elements the drain takes from a lane in a row while later lanes
+  // have some, zero means no limit. The quota of a lane is given back once a
+  // later lane had its turn, with no quota at all the lanes are drained in
+  // strict priority order.
+  void set_lane_quota(size_t prio, size_t quota) {
+    if (prio >= lane_count_) return;
+    lanes_[prio].quota.store(quota, std::memory_order_relaxed);
+  }
+  // set capacity of all the lanes
+  void set_capacity(size_t capacity) {
+    for (size_t i = 0; i < lane_count_; i++)
+      lanes_[i].capacity.store(capacity, std::memory_order_relaxed);
+  }
   void clear() {
-    std::lock_guard<Lck> guard(lock_);
-    std::queue<Elem> empty;
-    std::swap(q_, empty);
+    for (size_t i = 0; i < lane_count_; i++) {
+      lane& l = lanes_[i];
+      l.q.clear();
+      std::lock_guard<std::mutex> guard(l.overflow_lock);
+      std::queue<Elem> empty;
+      std::swap(l.overflow, empty);
+      l.overflow_size.store(0, std::memory_order_release);
+    }
   }
   uint64_t last_pop_ts() const { return 0; }
+  size_t lane_size(size_t prio) const {
+    if (prio >= lane_count_) return 0;
+    return lane_size(lanes_[prio]);
+  }
+  uint64_t lane_dropped(size_t prio) const {
+    if (prio >= lane_count_) return 0;
+    return lanes_[prio].dropped.load(std::memory_order_relaxed);
+  }
+  uint64_t dropped() const {
+    uint64_t dropped = 0;
+    for (size_t i = 0; i < lane_count_; i++) dropped += lane_dropped(i);
+    return dropped;
+  }
+  // Count of elements a lane kept beyond what its storage holds.
+  uint64_t lane_spilled(size_t prio) const {
+    if (prio >= lane_count_) return 0;
+    return lanes_[prio].spilled.load(std::memory_order_relaxed);
+  }
+  // Deepest a lane was when a drain started, sampled by the uv thread so
+  // producers pay nothing for it.
+  size_t lane_high_water(size_t prio) const {
+    if (prio >= lane_count_) return 0;
+    return lanes_[prio].high_water.load(std::memory_order_relaxed);
+  }
+  // zero the drop, spill and yield counters and the high water marks
+  void reset_stats() {
+    for (size_t i = 0; i < lane_count_; i++) {
+      lanes_[i].dropped.store(0, std::memory_order_relaxed);
+      lanes_[i].spilled.store(0, std::memory_order_relaxed);
+      lanes_[i].high_water.store(0, std::memory_order_relaxed);
+    }
+    yields_.store(0, std::memory_order_relaxed);
+  }
+  // called on uv thread once all the queued elements have been handled
+  void set_flush_callback(flush_type&& flush) { flush_ = std::move(flush); }
+  // Limit the work done by one drain, zero means no limit. When the budget is
+  // used up the drain yields to the other handles of the loop and re-arms
+  // itself, so a busy producer can not hold the uv thread.
+  void set_budget(size_t max_elements, uint64_t max_us) {
+    max_elements_.store(max_elements, std::memory_order_relaxed);
+    max_us_.store(max_us, std::memory_order_relaxed);
+  }
+  size_t budget_elements() const {
+    return max_elements_.load(std::memory_order_relaxed);
+  }
+  uint64_t budget_us() const { return max_us_.load(std::memory_order_relaxed); }
+  uint64_t yields() const { return yields_.load(std::memory_order_relaxed); }
 
  private:
+  // Counts the running async_call, checked by close after closed_ is set.
+  // Both sides are sequentially consistent so either close sees the call or
+  // the call sees closed_.
+  struct caller_guard {
+    explicit caller_guard(std::atomic<uint32_t>& callers) : callers(callers) {
+      callers.fetch_add(1);
+    }
+    ~caller_guard() { callers.fetch_sub(1, std::memory_order_release); }
+    std::atomic<uint32_t>& callers;
+  };
+
   static void async_callback(uv_async_t* handle) {
     reinterpret_cast<async_queue*>(handle->data)->on_event();
   }
+  // Takes from the first lane with elements which has quota left, lanes
+  // which used theirs up only when no other has elements.
+  bool pop(Elem& e) {
+    for (size_t i = 0; i < lane_count_; i++) {
+      lane& l = lanes_[i];
+      const size_t quota = l.quota.load(std::memory_order_relaxed);
+      if (quota && l.served >= quota) continue;
+      if (pop(l, e)) return served(i);
+    }
+    for (size_t i = 0; i < lane_count_; i++) {
+      if (pop(lanes_[i], e)) return served(i);
+    }
+    return false;
+  }
+  static size_t lane_size(const lane& l) {
+    return l.q.size() + l.overflow_size.load(std::memory_order_relaxed);
+  }
+  bool pop(lane& l, Elem& e) {
+    if (l.q.pop(e)) return true;
+    if (!l.overflow_size.load(std::memory_order_acquire)) return false;
+
+    std::lock_guard<std::mutex> guard(l.overflow_lock);
+    if (l.overflow.empty()) return false;
+    e = std::move(l.overflow.front());
+    l.overflow.pop();
+    l.overflow_size.fetch_sub(1, std::memory_order_release);
+    return true;
+  }
+  // the earlier lanes get their quota back
+  bool served(size_t prio) {
+    lanes_[prio].served++;
+    for (size_t i = 0; i < prio; i++) lanes_[i].served = 0;
+    return true;
+  }
   void on_event() {
-    std::unique_lock<Lck> lock(lock_);
-    while (!q_.empty()) {
-      Elem e(std::move(q_.front()));
-      q_.pop();
-      lock.unlock();
+    NAPI_TRACE_SCOPE(trace, "queue", "drain");
+    const size_t max_elements = max_elements_.load(std::memory_order_relaxed);
+    const uint64_t max_us = max_us_.load(std::memory_order_relaxed);
+    const auto begin = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < lane_count_; i++) {
+      lane& l = lanes_[i];
+      size_t depth = lane_size(i);
+      if (depth > l.high_water.load(std::memory_order_relaxed))
+        l.high_water.store(depth, std::memory_order_relaxed);
+    }
+
+    size_t count = 0;
+    for (;; count++) {
+      if ((max_elements && count >= max_elements) ||
+          (max_us && count &&
+           std::chrono::steady_clock::now() - begin >=
+               std::chrono::microseconds(max_us))) {
+        if (!empty()) {
+          yields_.fetch_add(1, std::memory_order_relaxed);
+          uv_async_send(h_);
+        }
+        break;
+      }
+
+      Elem e;
+      if (!pop(e)) break;
       cb_(e);
-      lock.lock();
     }
+
+    if (flush_) flush_();
+    NAPI_TRACE_ARG(trace, "events", count);
   }
 
  private:
   uv_async_t* h_;
   std::atomic<bool> closed_;
-  mutable Lck lock_;
-  std::queue<Elem> q_;
+  std::atomic<uint32_t> callers_;
   callback_type cb_;
-  size_t capacity_;
+  flush_type flush_;
+  std::unique_ptr<lane[]> lanes_;
+  size_t lane_count_;
+  std::atomic<size_t> max_elements_;
+  std::atomic<uint64_t> max_us_;
+  std::atomic<uint64_t> yields_;
 };
 
+// Runs tasks on the loop it is bound to, every node environment owns one for
+// its own loop, see napi_get_instance. No task is dropped, those the ring
+// can not hold spill to the overflow of the lane.
 class node_async_call {
+  node_async_call(const node_async_call&) = delete;
+  node_async_call& operator=(const node_async_call&) = delete;
+
  public:
-  static void async_call(task_type&& cb) {
-    node_async_call::instance().node_queue_->async_call(std::move(cb));
-  }
+  explicit node_async_call(uv_loop_t* loop);
+  ~node_async_call();
 
-  static void close(bool closed) {
-    node_async_call::instance().node_queue_->close(closed);
-  }
+  void async_call(task_type&& cb) { node_queue_->async_call(std::move(cb)); }
+
+  void close(bool closed) { node_queue_->close(closed); }
 
  private:
   using node_queue_type = async_queue<task_type>;
-  node_async_call();
-  ~node_async_call();
-  static node_async_call& instance() { return s_instance_; }
   void run_task(task_type& task) { task(); }
   std::unique_ptr<node_queue_type> node_queue_;
-  static node_async_call s_instance_;
 };
 
 }  // namespace plugin
@@ -3,26 +3,117 @@
 
 #include <node_api.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <type_traits>
 #include <unordered_map>
+#include <vector>
 
 #include "napi_async.h"
+#include "napi_stats.h"
 #include "napi_utils.h"
 
 namespace agora {
 namespace plugin {
 
-// const int argc = 2;
-// Fire(NODE_VALORAN_EVENTS::kMediaUserMajorChange, argc,
-//      [=](napi_env& env, napi_value argv[]) {
-//        PackageNodeUser(env, argv[0], user);
+// Every event is queued as a fixed size record and marshalled on js thread by
+// the packer specialized for KEY and PAYLOAD, no closure is allocated:
+//
+// template <>
+// struct NodeValoranEventPacker<UserId, UserEvent> {
+//   static const int argc = 2;
+//   static void Pack(napi_env& env,
+//                    const NodeValoranEventRecord<UserId, UserEvent>& record,
+//                    napi_value argv[]) {
+//     PackageNodeUser(env, argv[0], record.payload.user);
+//
+//     NAPI_CALL_NORETURN(
+//         env, napi_create_int32(env, record.payload.reason, &argv[1]));
+//   }
+// };
+//
+// Fire(uid, UserEvent{user, reason});
+//
+// Updates of which only the latest one matters can be coalesced per key by
+// FireLatest, ordered events fired by Fire stay in order around them: the
+// pending update of a key is queued ahead of its ordered event in the lane
+// of the event.
+//
+// Events are queued in priority lanes, the drain delivers the queued events
+// of a higher priority first, up to the quota of their lane in a row while
+// lower lanes wait, see SetLaneQuota. Priorities order the events of
+// different keys, those of one key are delivered in the order they were
+// fired: while an ordered event of a key is queued, the later events of the
+// key follow it in its lane whatever their priority. Overload of one lane
+// only drops the events of that lane, by default no lane has a capacity and
+// none drops, see SetLane.
+//
+// Sources which are shared by the whole process, like the hooks of the window
+// monitor, fire through a NodeValoranEventHub which forwards the event to the
+// NodeValoranEventBase of every environment subscribed to the key, each of
+// them delivers on the loop of its own environment. Firing takes no lock,
+// the subscribers and the coalescing slots are epoch_snapshots which only
+// (un)subscribing and adding or removing keys copy.
+//
+// Keys added by AddBatchEvent are delivered in batches instead, the packer
+// writes batch_fields numbers per record by PackBatch and every callback is
+// called once per drain with a Float64Array of all the records of its keys.
+//
+// Every event carries the time it was captured by its source and the time it
+// was queued, the drain records how long each stage took in a
+// latency_histogram per stage on the uv thread, see latency.
 
-//        NAPI_CALL_NORETURN(env, napi_create_int32(env, reason, &argv[1]));
-//      });
+enum NodeValoranEventPriority {
+  kEventPriorityHigh = 0,
+  kEventPriorityNormal = 1,
+  kEventPriorityLow = 2,
+  kEventPriorityCount = 3,
+};
+
+enum NodeValoranEventStage {
+  // from capture by the source to Fire
+  kEventStageCapture = 0,
+  // from Fire to the drain taking it from the queue
+  kEventStageQueue = 1,
+  // from the drain taking it to the js callback returning
+  kEventStageCallback = 2,
+  // from capture to the js callback returning
+  kEventStageTotal = 3,
+  kEventStageCount = 4,
+};
+
+template <typename KEY, typename PAYLOAD>
+struct NodeValoranEventRecord {
+  KEY key;
+  PAYLOAD payload;
+  // steady clock in microseconds when the event was fired
+  uint64_t ts;
+  // steady clock in microseconds when the source captured the event
+  uint64_t captured;
+  // version of the payload in the coalescing slot, only for the pending
+  // update an ordered event queued ahead of itself
+  uint64_t version;
+  // epoch of the coalescing slot for latest records, number of the ordered
+  // event in the slot of its key for ordered ones
+  uint32_t epoch;
+  bool latest;
+};
+
+template <typename KEY, typename PAYLOAD>
+struct NodeValoranEventPacker;
 
-template <typename KEY>
+template <typename KEY, typename PAYLOAD>
 class NodeValoranEventBase {
+  using Record = NodeValoranEventRecord<KEY, PAYLOAD>;
+  using Packer = NodeValoranEventPacker<KEY, PAYLOAD>;
+
+  static_assert(std::is_trivially_copyable<Record>::value,
+                "KEY and PAYLOAD must be trivially copyable");
+
  public:
   class NodeValoranEventRef {
    public:
@@ -43,62 +134,701 @@ class NodeValoranEventBase {
     napi_ref ref_;
   };
 
-  virtual ~NodeValoranEventBase() { callbacks_.clear(); }
+  class NodeValoranEventBatch {
+   public:
+    NodeValoranEventBatch(const napi_env& env, const napi_value& cb,
+                          const napi_value& global)
+        : callback_(env, cb, global) {
+      data_.reserve(Packer::batch_fields * 64);
+      captured_.reserve(64);
+    }
+
+    NodeValoranEventRef callback_;
+    std::vector<double> data_;
+    // capture time of every record in data_
+    std::vector<uint64_t> captured_;
+  };
+
+  NodeValoranEventBase(uv_loop_t* loop = uv_default_loop())
+      : queue_(new async_queue<Record>(
+            loop, std::bind(&NodeValoranEventBase::Deliver, this,
+                            std::placeholders::_1),
+            kEventPriorityCount)) {
+    queue_->set_flush_callback(std::bind(&NodeValoranEventBase::Flush, this));
+    SetLane(kEventPriorityHigh, 0, async_drop_policy::never_drop);
+    // given a capacity they reject new events, a rejected marker is re-queued
+    // by the next update of its key, dropping an older one would leave its
+    // key pending forever
+    SetLane(kEventPriorityNormal, 0, async_drop_policy::drop_newest);
+    SetLane(kEventPriorityLow, 0, async_drop_policy::drop_newest);
+    // a flood of high events still lets one of the lanes below through every
+    // few of them
+    SetLaneQuota(kEventPriorityHigh, 4);
+    SetLaneQuota(kEventPriorityNormal, 2);
+  }
+
+  virtual ~NodeValoranEventBase() {
+    callbacks_.clear();
+    batch_callbacks_.clear();
+  }
 
   virtual void AddEvent(const KEY& key, const napi_env& env,
                         const napi_value& cb, const napi_value& global) {
+    batch_callbacks_.erase(key);
     callbacks_[key] = std::make_unique<NodeValoranEventRef>(env, cb, global);
+    PrepareLatest(key);
+  }
+
+  // Keys added with the same callback share one batch.
+  virtual void AddBatchEvent(const KEY& key, const napi_env& env,
+                             const napi_value& cb, const napi_value& global) {
+    // the slot of key stays, it may be subscribed already
+    callbacks_.erase(key);
+
+    std::shared_ptr<NodeValoranEventBatch> batch;
+    for (auto& item : batches_) {
+      auto exist = item.lock();
+      if (!exist || exist->callback_.env_ != env) continue;
+
+      napi_value exist_cb;
+      bool equals = false;
+      NAPI_CALL_NORETURN(env, napi_get_reference_value(
+                                  env, exist->callback_.ref_, &exist_cb));
+      NAPI_CALL_NORETURN(env, napi_strict_equals(env, exist_cb, cb, &equals));
+      if (equals) {
+        batch = exist;
+        break;
+      }
+    }
+
+    if (!batch) {
+      batch = std::make_shared<NodeValoranEventBatch>(env, cb, global);
+      batches_.emplace_back(batch);
+    }
+
+    batch_callbacks_[key] = batch;
+    PrepareLatest(key);
   }
 
   virtual void RemoveEvent(const KEY& key) {
     auto itr = callbacks_.find(key);
     if (itr != callbacks_.end()) callbacks_.erase(itr);
+    batch_callbacks_.erase(key);
+
+    slots_.update([&key](Slots& slots) { slots.erase(key); });
+  }
+
+  // Fire an ordered event, it will never be coalesced. It is delivered after
+  // every event of its key fired before it, the pending update of its key is
+  // queued right ahead of it in its lane. captured is the steady clock time
+  // in microseconds when the source saw the event, zero for now.
+  virtual void Fire(const KEY& key, const PAYLOAD& payload,
+                    NodeValoranEventPriority priority = kEventPriorityNormal,
+                    uint64_t captured = 0) {
+    uint64_t ts = now();
+    Record record = {key, payload, ts, captured ? captured : ts, 0, 0, false};
+    {
+      epoch_read_scope scope;
+      LatestSlot* slot = FindSlot(key);
+      Record pending = {key, payload, ts, ts, 0, 0, false};
+      if (slot && slot->Seal(pending, record, priority)) {
+        queue_->async_call(std::move(pending), 0, priority);
+      }
+    }
+
+    queue_->async_call(std::move(record), 0, priority);
   }
 
-  using NodeValoranEventPackCallback =
-      std::function<void(napi_env& env, napi_value argv[])>;
+  // Fire an update which overwrites the pending one of the same key, only the
+  // latest payload is delivered when the queue is drained. It is delivered
+  // after the ordered events of its key fired before it and ahead of those
+  // fired after it.
+  // The marker keeps the priority and the times of the update which queued
+  // it, the latencies of a coalesced key are those of its oldest pending
+  // update. Updates of keys which were neither added nor prepared are
+  // dropped, like the events delivered to no callback.
+  virtual void FireLatest(
+      const KEY& key, const PAYLOAD& payload,
+      NodeValoranEventPriority priority = kEventPriorityNormal,
+      uint64_t captured = 0) {
+    uint64_t ts = now();
+    Record record = {key, payload, ts, captured ? captured : ts, 0, 0, true};
+    epoch_read_scope scope;
+    LatestSlot* slot = FindSlot(key);
+    if (slot) QueueLatest(*slot, record, priority);
+  }
 
-  virtual void Fire(const KEY& key, const int argc,
-                    NodeValoranEventPackCallback callback) {
-    node_async_call::async_call([this, key, argc, callback] {
-      auto itr = callbacks_.find(key);
-      if (itr == callbacks_.end()) return;
+  // Publishes the coalescing slot of key, adding a key prepares it. A hub
+  // prepares the keys it subscribes, so that firing never copies the slots.
+  void PrepareLatest(const KEY& key) {
+    {
+      epoch_read_scope scope;
+      if (FindSlot(key)) return;
+    }
+    slots_.update([&key](Slots& slots) {
+      auto& slot = slots[key];
+      if (!slot) slot = std::make_shared<LatestSlot>();
+    });
+  }
 
-      napi_handle_scope scope;
-      NAPI_CALL_NORETURN(itr->second->env_,
-                         napi_open_handle_scope(itr->second->env_, &scope));
+  // Count of updates which were overwritten before being delivered.
+  uint64_t coalesced() const {
+    return coalesced_.load(std::memory_order_relaxed);
+  }
+
+  // Count an event which a filter dropped before it was fired.
+  void CountFiltered() { filtered_.fetch_add(1, std::memory_order_relaxed); }
+
+  uint64_t filtered() const {
+    return filtered_.load(std::memory_order_relaxed);
+  }
+
+  size_t queued() const { return queue_->size(); }
+
+  uint64_t dropped() const { return queue_->dropped(); }
+
+  // Capacity and drop policy of a priority lane, a lane of capacity zero
+  // drops nothing.
+  void SetLane(NodeValoranEventPriority priority, size_t capacity,
+               async_drop_policy policy) {
+    queue_->set_lane(priority, capacity, policy);
+    lane_capacities_[priority] = capacity;
+  }
+
+  // Events of a lane delivered in a row while lower lanes have some, zero
+  // for no limit, see async_queue::set_lane_quota.
+  void SetLaneQuota(NodeValoranEventPriority priority, size_t quota) {
+    queue_->set_lane_quota(priority, quota);
+  }
+
+  size_t lane_capacity(NodeValoranEventPriority priority) const {
+    return lane_capacities_[priority];
+  }
 
-      napi_value* argv = nullptr;
-      if (argc) {
-        argv = new napi_value[argc];
-        callback(itr->second->env_, argv);
+  size_t lane_queued(NodeValoranEventPriority priority) const {
+    return queue_->lane_size(priority);
+  }
+
+  uint64_t lane_dropped(NodeValoranEventPriority priority) const {
+    return queue_->lane_dropped(priority);
+  }
+
+  // Count of events a lane kept beyond its storage.
+  uint64_t lane_spilled(NodeValoranEventPriority priority) const {
+    return queue_->lane_spilled(priority);
+  }
+
+  // Limit the events delivered by one drain, see async_queue::set_budget.
+  void SetDrainBudget(size_t max_events, uint64_t max_us) {
+    queue_->set_budget(max_events, max_us);
+  }
+
+  size_t drain_budget_events() const { return queue_->budget_elements(); }
+
+  uint64_t drain_budget_us() const { return queue_->budget_us(); }
+
+  // Count of drains which yielded with events left in the queue.
+  uint64_t yields() const { return queue_->yields(); }
+
+  // Deepest the lane was when a drain started.
+  size_t lane_high_water(NodeValoranEventPriority priority) const {
+    return queue_->lane_high_water(priority);
+  }
+
+  // Latencies of the delivered events, only read it on the uv thread.
+  const latency_histogram& latency(NodeValoranEventStage stage) const {
+    return latencies_[stage];
+  }
+
+  // Zero the latencies, high water marks and drop, spill, coalesce, filter and
+  // yield counters, call it on the uv thread.
+  void ResetStats() {
+    for (auto& latency : latencies_) latency.reset();
+    coalesced_.store(0, std::memory_order_relaxed);
+    filtered_.store(0, std::memory_order_relaxed);
+    queue_->reset_stats();
+  }
+
+ protected:
+  // Called on the js thread with every event about to be delivered, after
+  // coalescing, to tailor it to this environment. Returning false drops it
+  // as filtered.
+  virtual bool Accept(Record& record) { return true; }
+
+ private:
+  // Latest payload of a key. Producers of the same key are serialized by a
+  // spin lock, the js thread reads without locking. An ordered event takes
+  // the pending payload out to queue it ahead of itself, which turns the
+  // marker queued before it stale, and later updates queue a new marker
+  // after the event.
+  //
+  // Ordered events are numbered per key, until the js thread delivered the
+  // last one the later events of the key are queued in its lane.
+  class LatestSlot {
+   public:
+    LatestSlot()
+        : pending_(false),
+          shadow_(),
+          version_(0),
+          pending_ts_(0),
+          pending_captured_(0),
+          ordered_(0),
+          ordered_lane_(kEventPriorityHigh),
+          ordered_delivered_(0),
+          delivered_(0) {
+      writing_.clear();
+    }
+
+    // Sets the epoch of record and the lane of its marker, returns true when
+    // a new marker should be queued.
+    bool Update(Record& record, NodeValoranEventPriority& priority) {
+      Lock();
+      shadow_.latest = record.payload;
+      shadow_.latest_version = ++version_;
+      value_.store(shadow_);
+      record.epoch = shadow_.epoch;
+      bool queued = pending_.exchange(true);
+      if (!queued) {
+        pending_ts_ = record.ts;
+        pending_captured_ = record.captured;
+        Follow(priority);
+      }
+      Unlock();
+      return !queued;
+    }
+
+    // Numbers the ordered event record and sets the lane it goes to, moves
+    // the pending payload with its version and the times of its marker to
+    // pending. Returns false when there is none.
+    bool Seal(Record& pending, Record& record,
+              NodeValoranEventPriority& priority) {
+      Lock();
+      Follow(priority);
+      if (++ordered_ == 0) ++ordered_;
+      record.epoch = ordered_;
+      ordered_lane_ = priority;
+      bool queued = pending_.exchange(false);
+      if (queued) {
+        pending.payload = shadow_.latest;
+        pending.version = shadow_.latest_version;
+        pending.ts = pending_ts_;
+        pending.captured = pending_captured_;
+        shadow_.epoch++;
+        value_.store(shadow_);
       }
+      Unlock();
+      return queued;
+    }
 
-      napi_value unrefed_cb;
-      NAPI_CALL_NORETURN(
-          itr->second->env_,
-          napi_get_reference_value(itr->second->env_, itr->second->ref_,
-                                   &unrefed_cb));
-      napi_value cb_returned_value;
-      NAPI_CALL_NORETURN(
-          itr->second->env_,
-          napi_get_undefined(itr->second->env_, &cb_returned_value));
-
-      napi_value result;
-      NAPI_CALL_NORETURN(
-          itr->second->env_,
-          napi_call_function(itr->second->env_, cb_returned_value, unrefed_cb,
-                             argc, argv, &result));
-
-      if (argv) delete[] argv;
-
-      NAPI_CALL_NORETURN(itr->second->env_,
-                         napi_close_handle_scope(itr->second->env_, scope));
-    });
+    // Called on js thread with the number of an ordered event taken from the
+    // queue.
+    void Delivered(uint32_t ordered) {
+      ordered_delivered_.store(ordered, std::memory_order_release);
+    }
+
+    // The marker queued with epoch was rejected, let the next update queue a
+    // new one.
+    void Cancel(uint32_t epoch) {
+      Lock();
+      if (shadow_.epoch == epoch) pending_.store(false);
+      Unlock();
+    }
+
+    // Called on js thread with the epoch of a marker, returns false when the
+    // marker is stale or its payload has already been delivered.
+    bool Take(uint32_t epoch, PAYLOAD& payload) {
+      if (value_.load().epoch == epoch) pending_.store(false);
+
+      Snapshot snapshot = value_.load();
+      if (snapshot.epoch != epoch) return false;
+
+      payload = snapshot.latest;
+      return Claim(snapshot.latest_version);
+    }
+
+    // Called on js thread with the version of a payload about to be
+    // delivered, returns false when a marker delivered it already.
+    bool Claim(uint64_t version) {
+      if (version <= delivered_) return false;
+      delivered_ = version;
+      return true;
+    }
+
+   private:
+    struct Snapshot {
+      PAYLOAD latest;
+      uint64_t latest_version;
+      uint32_t epoch;
+    };
+
+    // under the spin lock
+    void Follow(NodeValoranEventPriority& priority) {
+      if (ordered_delivered_.load(std::memory_order_acquire) != ordered_)
+        priority = ordered_lane_;
+    }
+
+    void Lock() {
+      while (writing_.test_and_set(std::memory_order_acquire)) {
+      }
+    }
+    void Unlock() { writing_.clear(std::memory_order_release); }
+
+    std::atomic_flag writing_;
+    std::atomic<bool> pending_;
+    seqlock_slot<Snapshot> value_;
+    // only touched by producers under the spin lock
+    Snapshot shadow_;
+    uint64_t version_;
+    // times of the update which queued the pending marker
+    uint64_t pending_ts_;
+    uint64_t pending_captured_;
+    // number and lane of the last ordered event
+    uint32_t ordered_;
+    NodeValoranEventPriority ordered_lane_;
+    // number of the last ordered event taken by the js thread
+    std::atomic<uint32_t> ordered_delivered_;
+    // only touched on js thread
+    uint64_t delivered_;
+  };
+
+  using Slots = std::unordered_map<KEY, std::shared_ptr<LatestSlot>>;
+
+  // Only inside an epoch_read_scope, the slot stays alive until it ends.
+  LatestSlot* FindSlot(const KEY& key) const {
+    const Slots& slots = slots_.read();
+    auto itr = slots.find(key);
+    return itr != slots.end() ? itr->second.get() : nullptr;
+  }
+
+  void QueueLatest(LatestSlot& slot, Record& record,
+                   NodeValoranEventPriority priority) {
+    if (!slot.Update(record, priority)) {
+      coalesced_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    if (queue_->async_call(std::move(record), 0, priority) != 0) {
+      slot.Cancel(record.epoch);
+    }
+  }
+
+  static uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // Records the stages up to the drain, returns the dequeue time.
+  uint64_t Dequeued(const Record& record) {
+    // right after the previous callback returned, one clock read per event
+    uint64_t dequeued = drain_clock_ ? drain_clock_ : now();
+    latencies_[kEventStageCapture].record(Elapsed(record.captured, record.ts));
+    latencies_[kEventStageQueue].record(Elapsed(record.ts, dequeued));
+    return dequeued;
+  }
+
+  void Returned(uint64_t dequeued, uint64_t captured) {
+    drain_clock_ = now();
+    latencies_[kEventStageCallback].record(Elapsed(dequeued, drain_clock_));
+    latencies_[kEventStageTotal].record(Elapsed(captured, drain_clock_));
+  }
+
+  static uint64_t Elapsed(uint64_t from, uint64_t to) {
+    return to > from ? to - from : 0;
+  }
+
+  void Deliver(Record& record) {
+    if (!record.latest && !record.version && record.epoch) {
+      // the later events of the key may leave the lane of this one
+      epoch_read_scope scope;
+      LatestSlot* slot = FindSlot(record.key);
+      if (slot) slot->Delivered(record.epoch);
+    }
+
+    auto itr = callbacks_.find(record.key);
+    auto batch_itr = batch_callbacks_.end();
+    if (itr == callbacks_.end()) {
+      batch_itr = batch_callbacks_.find(record.key);
+      if (batch_itr == batch_callbacks_.end()) return;
+    }
+
+    if (record.latest || record.version) {
+      // a stale marker or a payload delivered already, not an overwritten
+      // update, those are counted when they are fired
+      epoch_read_scope scope;
+      LatestSlot* slot = FindSlot(record.key);
+      if (!slot) return;
+      if (record.latest ? !slot->Take(record.epoch, record.payload)
+                        : !slot->Claim(record.version))
+        return;
+    }
+
+    if (!Accept(record)) {
+      CountFiltered();
+      return;
+    }
+
+    uint64_t dequeued = Dequeued(record);
+
+    if (batch_itr != batch_callbacks_.end()) {
+      std::vector<double>& data = batch_itr->second->data_;
+      size_t offset = data.size();
+      data.resize(offset + Packer::batch_fields);
+      Packer::PackBatch(record, &data[offset]);
+      batch_itr->second->captured_.push_back(record.captured);
+      // the drain clock stays put until the batch is called
+      if (!drain_clock_) drain_clock_ = dequeued;
+      return;
+    }
+
+    napi_env env = itr->second->env_;
+
+    napi_handle_scope scope;
+    NAPI_CALL_NORETURN(env, napi_open_handle_scope(env, &scope));
+
+    napi_value argv[Packer::argc];
+    Packer::Pack(env, record, argv);
+
+    napi_value unrefed_cb;
+    NAPI_CALL_NORETURN(
+        env, napi_get_reference_value(env, itr->second->ref_, &unrefed_cb));
+    napi_value cb_returned_value;
+    NAPI_CALL_NORETURN(env, napi_get_undefined(env, &cb_returned_value));
+
+    napi_value result;
+    {
+      NAPI_TRACE_SCOPE(trace, "js", "js_callback");
+      NAPI_CALL_NORETURN(env,
+                         napi_call_function(env, cb_returned_value, unrefed_cb,
+                                            Packer::argc, argv, &result));
+    }
+
+    NAPI_CALL_NORETURN(env, napi_close_handle_scope(env, scope));
+
+    Returned(dequeued, record.captured);
+  }
+
+  void Flush() {
+    const uint64_t dequeued = drain_clock_;
+
+    for (auto itr = batches_.begin(); itr != batches_.end();) {
+      auto batch = itr->lock();
+      if (!batch) {
+        itr = batches_.erase(itr);
+        continue;
+      }
+      itr++;
+
+      if (batch->data_.empty()) continue;
+      DeliverBatch(*batch);
+
+      // every record of the batch waited for the one callback
+      drain_clock_ = now();
+      for (uint64_t captured : batch->captured_) {
+        latencies_[kEventStageCallback].record(Elapsed(dequeued, drain_clock_));
+        latencies_[kEventStageTotal].record(Elapsed(captured, drain_clock_));
+      }
+      batch->data_.clear();
+      batch->captured_.clear();
+    }
+
+    drain_clock_ = 0;
+  }
+
+  void DeliverBatch(NodeValoranEventBatch& batch) {
+    napi_env env = batch.callback_.env_;
+    const std::vector<double>& data = batch.data_;
+
+    napi_handle_scope scope;
+    NAPI_CALL_NORETURN(env, napi_open_handle_scope(env, &scope));
+
+    void* buffer = nullptr;
+    napi_value array_buffer;
+    NAPI_CALL_NORETURN(
+        env, napi_create_arraybuffer(env, data.size() * sizeof(double),
+                                     &buffer, &array_buffer));
+    memcpy(buffer, data.data(), data.size() * sizeof(double));
+
+    napi_value argv[1];
+    NAPI_CALL_NORETURN(
+        env, napi_create_typedarray(env, napi_float64_array, data.size(),
+                                    array_buffer, 0, &argv[0]));
+
+    napi_value unrefed_cb;
+    NAPI_CALL_NORETURN(env, napi_get_reference_value(
+                                env, batch.callback_.ref_, &unrefed_cb));
+    napi_value cb_returned_value;
+    NAPI_CALL_NORETURN(env, napi_get_undefined(env, &cb_returned_value));
+
+    napi_value result;
+    NAPI_TRACE_SCOPE(trace, "js", "js_batch_callback");
+    NAPI_TRACE_ARG(trace, "records", data.size() / Packer::batch_fields);
+    NAPI_CALL_NORETURN(env, napi_call_function(env, cb_returned_value,
+                                               unrefed_cb, 1, argv, &result));
+
+    NAPI_CALL_NORETURN(env, napi_close_handle_scope(env, scope));
   }
 
  private:
   std::unordered_map<KEY, std::unique_ptr<NodeValoranEventRef>> callbacks_;
+  std::unordered_map<KEY, std::shared_ptr<NodeValoranEventBatch>>
+      batch_callbacks_;
+  std::vector<std::weak_ptr<NodeValoranEventBatch>> batches_;
+
+  epoch_snapshot<Slots> slots_;
+  std::atomic<uint64_t> coalesced_{0};
+  std::atomic<uint64_t> filtered_{0};
+
+  size_t lane_capacities_[kEventPriorityCount] = {};
+  std::unique_ptr<async_queue<Record>> queue_;
+
+  // only touched on the uv thread
+  latency_histogram latencies_[kEventStageCount];
+  // last clock read of the current drain, zero between drains
+  uint64_t drain_clock_ = 0;
+};
+
+template <typename KEY, typename PAYLOAD>
+class NodeValoranEventHub {
+ public:
+  using Events = NodeValoranEventBase<KEY, PAYLOAD>;
+
+  // Subscribers may only want some kinds of the events of a key, events are
+  // fired with the bit of their kind and skipped for the subscribers whose
+  // mask lacks it.
+  static const uint32_t kAllKinds = 0xffffffff;
+
+  // Returns true when events is the first subscriber of key, subscribing
+  // again changes the kinds of events.
+  bool Subscribe(const KEY& key, Events* events, uint32_t kinds = kAllKinds) {
+    events->PrepareLatest(key);
+    bool first = false;
+    subscribers_.update([&](Subscribers& all) {
+      auto& subscribers = all[key];
+      auto itr = Find(subscribers, events);
+      if (itr == subscribers.end()) {
+        subscribers.push_back(Subscriber{events, kinds});
+      } else {
+        itr->kinds = kinds;
+      }
+      first = subscribers.size() == 1;
+    });
+    return first;
+  }
+
+  bool Subscribed(const KEY& key, Events* events) const {
+    epoch_read_scope scope;
+    const Subscribers& all = subscribers_.read();
+    auto itr = all.find(key);
+    if (itr == all.end()) return false;
+    return Find(itr->second, events) != itr->second.end();
+  }
+
+  // Returns true when the last subscriber of key is gone.
+  bool Unsubscribe(const KEY& key, Events* events) {
+    bool last = false;
+    subscribers_.update([&](Subscribers& all) {
+      auto itr = all.find(key);
+      if (itr == all.end()) return;
+
+      auto& subscribers = itr->second;
+      Remove(subscribers, events);
+      if (!subscribers.empty()) return;
+
+      all.erase(itr);
+      last = true;
+    });
+    return last;
+  }
+
+  // Unsubscribe all the keys of events, returns the keys which have no
+  // subscriber left. Once it returns no event is fired to events anymore.
+  std::vector<KEY> UnsubscribeAll(Events* events) {
+    std::vector<KEY> keys;
+    subscribers_.update([&](Subscribers& all) {
+      for (auto itr = all.begin(); itr != all.end();) {
+        auto& subscribers = itr->second;
+        Remove(subscribers, events);
+        if (subscribers.empty()) {
+          keys.push_back(itr->first);
+          itr = all.erase(itr);
+        } else {
+          ++itr;
+        }
+      }
+    });
+    return keys;
+  }
+
+  void Fire(const KEY& key, const PAYLOAD& payload,
+            NodeValoranEventPriority priority = kEventPriorityNormal,
+            uint64_t captured = 0, uint32_t kind = kAllKinds) {
+    epoch_read_scope scope;
+    const Subscribers& all = subscribers_.read();
+    auto itr = all.find(key);
+    if (itr == all.end()) return;
+    for (auto& subscriber : itr->second) {
+      if (subscriber.kinds & kind) {
+        subscriber.events->Fire(key, payload, priority, captured);
+      } else {
+        subscriber.events->CountFiltered();
+      }
+    }
+  }
+
+  void FireLatest(const KEY& key, const PAYLOAD& payload,
+                  NodeValoranEventPriority priority = kEventPriorityNormal,
+                  uint64_t captured = 0, uint32_t kind = kAllKinds) {
+    epoch_read_scope scope;
+    const Subscribers& all = subscribers_.read();
+    auto itr = all.find(key);
+    if (itr == all.end()) return;
+    for (auto& subscriber : itr->second) {
+      if (subscriber.kinds & kind) {
+        subscriber.events->FireLatest(key, payload, priority, captured);
+      } else {
+        subscriber.events->CountFiltered();
+      }
+    }
+  }
+
+  // count of subscribed keys
+  size_t size() const {
+    epoch_read_scope scope;
+    return subscribers_.read().size();
+  }
+
+ private:
+  struct Subscriber {
+    Events* events;
+    uint32_t kinds;
+  };
+
+  static typename std::vector<Subscriber>::iterator Find(
+      std::vector<Subscriber>& subscribers, Events* events) {
+    return std::find_if(
+        subscribers.begin(), subscribers.end(),
+        [events](const Subscriber& item) { return item.events == events; });
+  }
+
+  static typename std::vector<Subscriber>::const_iterator Find(
+      const std::vector<Subscriber>& subscribers, Events* events) {
+    return std::find_if(
+        subscribers.begin(), subscribers.end(),
+        [events](const Subscriber& item) { return item.events == events; });
+  }
+
+  static void Remove(std::vector<Subscriber>& subscribers, Events* events) {
+    subscribers.erase(
+        std::remove_if(
+            subscribers.begin(), subscribers.end(),
+            [events](const Subscriber& item) { return item.events == events; }),
+        subscribers.end());
+  }
+
+  using Subscribers = std::unordered_map<KEY, std::vector<Subscriber>>;
+
+  epoch_snapshot<Subscribers> subscribers_;
 };
 
 }  // namespace plugin
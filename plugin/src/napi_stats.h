@@ -0,0 +1,107 @@
+#ifndef AGORA_PLUGIN_NAPI_STATS_H_
+#define AGORA_PLUGIN_NAPI_STATS_H_
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace agora {
+namespace plugin {
+
+// Log-linear histogram of latencies in microseconds like HdrHistogram, every
+// power of two is split into kSubBuckets linear buckets so a percentile is
+// within 1/kSubBuckets of the recorded value, from 0us up to about 19 hours.
+//
+// Recording is a few plain additions and never allocates, it is not thread
+// safe: record, read and reset it on one thread, like the uv thread which
+// drains an event queue.
+class latency_histogram {
+ public:
+  static const int kSubBucketBits = 4;
+  static const uint64_t kSubBuckets = 1 << kSubBucketBits;
+  static const int kMaxBits = 36;
+  static const size_t kBucketCount =
+      (kMaxBits - kSubBucketBits + 1) * kSubBuckets;
+
+  latency_histogram() { reset(); }
+
+  void record(uint64_t us) {
+    counts_[bucket_of(us)]++;
+    count_++;
+    sum_ += us;
+    if (us > max_) max_ = us;
+  }
+
+  void reset() {
+    memset(counts_, 0, sizeof(counts_));
+    count_ = 0;
+    sum_ = 0;
+    max_ = 0;
+  }
+
+  uint64_t count() const { return count_; }
+
+  uint64_t max() const { return max_; }
+
+  double mean() const { return count_ ? (double)sum_ / count_ : 0; }
+
+  // Highest value of the bucket holding the pth percentile, 0 < p <= 100,
+  // never above the recorded max.
+  uint64_t percentile(double p) const {
+    if (!count_) return 0;
+    uint64_t rank = (uint64_t)(p / 100.0 * count_ + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > count_) rank = count_;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; i++) {
+      seen += counts_[i];
+      if (seen < rank) continue;
+      uint64_t highest = upper_bound(i);
+      return highest < max_ ? highest : max_;
+    }
+    return max_;
+  }
+
+ private:
+  static int highest_bit(uint64_t value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanReverse(&index, (unsigned long)(value >> 32)))
+      return (int)index + 32;
+    _BitScanReverse(&index, (unsigned long)value);
+    return (int)index;
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+  }
+
+  static size_t bucket_of(uint64_t value) {
+    if (value < kSubBuckets) return (size_t)value;
+    int bit = highest_bit(value);
+    if (bit >= kMaxBits) return kBucketCount - 1;
+    int shift = bit - kSubBucketBits;
+    return (size_t)((shift + 1) * kSubBuckets +
+                    ((value >> shift) - kSubBuckets));
+  }
+
+  static uint64_t upper_bound(size_t bucket) {
+    if (bucket < kSubBuckets) return bucket;
+    uint64_t shift = bucket / kSubBuckets - 1;
+    uint64_t sub = bucket % kSubBuckets + kSubBuckets;
+    return ((sub + 1) << shift) - 1;
+  }
+
+  uint64_t counts_[kBucketCount];
+  uint64_t count_;
+  uint64_t sum_;
+  uint64_t max_;
+};
+
+}  // namespace plugin
+}  // namespace agora
+
+#endif  // AGORA_PLUGIN_NAPI_STATS_H_
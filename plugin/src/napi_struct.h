@@ -0,0 +1,284 @@
+#ifndef AGORA_PLUGIN_NAPI_STRUCT_H_
+#define AGORA_PLUGIN_NAPI_STRUCT_H_
+
+#include <node_api.h>
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "napi_utils.h"
+
+namespace agora {
+namespace plugin {
+
+// Field list of a struct, declared once inside namespace agora::plugin:
+//
+// NAPI_STRUCT(windowmonitor::CRect, left, top, right, bottom);
+//
+// napi_to_value and napi_from_value then convert the struct, vectors of it
+// and structs which have it as a field, objects are built by the cached
+// napi_object_shape of the env and no field allocates.
+
+template <typename T>
+struct napi_struct_traits {
+  static const bool is_struct = false;
+};
+
+#define NAPI_STRUCT_EXPAND(x) x
+#define NAPI_STRUCT_CONCAT_(a, b) a##b
+#define NAPI_STRUCT_CONCAT(a, b) NAPI_STRUCT_CONCAT_(a, b)
+#define NAPI_STRUCT_COUNT_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, \
+                           _13, _14, _15, _16, N, ...)                        \
+  N
+#define NAPI_STRUCT_COUNT(...)                                                \
+  NAPI_STRUCT_EXPAND(NAPI_STRUCT_COUNT_(__VA_ARGS__, 16, 15, 14, 13, 12, 11, \
+                                        10, 9, 8, 7, 6, 5, 4, 3, 2, 1))
+
+#define NAPI_STRUCT_EACH_1(M, x) M(x)
+#define NAPI_STRUCT_EACH_2(M, x, ...) \
+  M(x) NAPI_STRUCT_EXPAND(NAPI_STRUCT_EACH_1(M, __VA_ARGS__))
+#define NAPI_STRUCT_EACH_3(M, x, ...) \
+  M(x) NAPI_STRUCT_EXPAND(NAPI_STRUCT_EACH_2(M, __VA_ARGS__))
+#define NAPI_STRUCT_EACH_4(M, x, ...) \
+  M(x) NAPI_STRUCT_EXPAND(NAPI_STRUCT_EACH_3(M, __VA_ARGS__))
+#define NAPI_STRUCT_EACH_5(M, x, ...) \
+  M(x) NAPI_STRUCT_EXPAND(NAPI_STRUCT_EACH_4(M, __VA_ARGS__))
+#define NAPI_STRUCT_EACH_6(M, x, ...) \
+  M(x) NAPI_STRUCT_EXPAND(NAPI_STRUCT_EACH_5(M, __VA_ARGS__))
+#define NAPI_STRUCT_EACH_7(M, x, ...) \
+  M(x) NAPI_STRUCT_EXPAND(NAPI_STRUCT_EACH_6(M, __VA_ARGS__))
+#define NAPI_STRUCT_EACH_8(M, x, ...) \
+  M(x) NAPI_STRUCT_EXPAND(NAPI_STRUCT_EACH_7(M, __VA_ARGS__))
+#define NAPI_STRUCT_EACH_9(M, x, ...) \
+  M(x) NAPI_STRUCT_EXPAND(NAPI_STRUCT_EACH_8(M, __VA_ARGS__))
+#define NAPI_STRUCT_EACH_10(M, x, ...) \
+  M(x) NAPI_STRUCT_EXPAND(NAPI_STRUCT_EACH_9(M, __VA_ARGS__))
+#define NAPI_STRUCT_EACH_11(M, x, ...) \
+  M(x) NAPI_STRUCT_EXPAND(NAPI_STRUCT_EACH_10(M, __VA_ARGS__))
+#define NAPI_STRUCT_EACH_12(M, x, ...) \
+  M(x) NAPI_STRUCT_EXPAND(NAPI_STRUCT_EACH_11(M, __VA_ARGS__))
+#define NAPI_STRUCT_EACH_13(M, x, ...) \
+  M(x) NAPI_STRUCT_EXPAND(NAPI_STRUCT_EACH_12(M, __VA_ARGS__))
+#define NAPI_STRUCT_EACH_14(M, x, ...) \
+  M(x) NAPI_STRUCT_EXPAND(NAPI_STRUCT_EACH_13(M, __VA_ARGS__))
+#define NAPI_STRUCT_EACH_15(M, x, ...) \
+  M(x) NAPI_STRUCT_EXPAND(NAPI_STRUCT_EACH_14(M, __VA_ARGS__))
+#define NAPI_STRUCT_EACH_16(M, x, ...) \
+  M(x) NAPI_STRUCT_EXPAND(NAPI_STRUCT_EACH_15(M, __VA_ARGS__))
+#define NAPI_STRUCT_EACH(M, ...)                                     \
+  NAPI_STRUCT_EXPAND(NAPI_STRUCT_CONCAT(NAPI_STRUCT_EACH_,            \
+                                        NAPI_STRUCT_COUNT(__VA_ARGS__))( \
+      M, __VA_ARGS__))
+
+#define NAPI_STRUCT_NAME(field) #field,
+#define NAPI_STRUCT_VISIT(field) visit(index++, value.field);
+
+#define NAPI_STRUCT(TYPE, ...)                                               \
+  template <>                                                                \
+  struct napi_struct_traits<TYPE> {                                          \
+    static const bool is_struct = true;                                      \
+    static const size_t size = NAPI_STRUCT_COUNT(__VA_ARGS__);               \
+    static const char* const* names() {                                      \
+      static const char* const names[] = {                                   \
+          NAPI_STRUCT_EACH(NAPI_STRUCT_NAME, __VA_ARGS__)};                  \
+      return names;                                                          \
+    }                                                                        \
+    template <typename S, typename F>                                        \
+    static void for_each(S& value, F&& visit) {                              \
+      size_t index = 0;                                                      \
+      NAPI_STRUCT_EACH(NAPI_STRUCT_VISIT, __VA_ARGS__)                       \
+    }                                                                        \
+  }
+
+template <typename T>
+using napi_enable_if_struct =
+    typename std::enable_if<napi_struct_traits<T>::is_struct,
+                            napi_status>::type;
+
+// to js
+
+inline napi_status napi_to_value(napi_env env, bool value,
+                                 napi_value* result) {
+  return napi_get_boolean(env, value, result);
+}
+
+inline napi_status napi_to_value(napi_env env, int32_t value,
+                                 napi_value* result) {
+  return napi_create_int32(env, value, result);
+}
+
+inline napi_status napi_to_value(napi_env env, uint32_t value,
+                                 napi_value* result) {
+  return napi_create_uint32(env, value, result);
+}
+
+inline napi_status napi_to_value(napi_env env, int64_t value,
+                                 napi_value* result) {
+  return napi_create_int64(env, value, result);
+}
+
+inline napi_status napi_to_value(napi_env env, uint64_t value,
+                                 napi_value* result) {
+  return napi_create_bigint_uint64(env, value, result);
+}
+
+inline napi_status napi_to_value(napi_env env, double value,
+                                 napi_value* result) {
+  return napi_create_double(env, value, result);
+}
+
+inline napi_status napi_to_value(napi_env env, float value,
+                                 napi_value* result) {
+  return napi_create_double(env, value, result);
+}
+
+inline napi_status napi_to_value(napi_env env, const std::string& value,
+                                 napi_value* result) {
+  return napi_create_string_utf8(env, value.data(), value.size(), result);
+}
+
+template <typename T>
+napi_status napi_to_value(napi_env env, const std::vector<T>& value,
+                          napi_value* result);
+
+template <typename T>
+napi_enable_if_struct<T> napi_to_value(napi_env env, const T& value,
+                                       napi_value* result);
+
+template <typename T>
+napi_status napi_to_value(napi_env env, const std::vector<T>& value,
+                          napi_value* result) {
+  napi_status status =
+      napi_create_array_with_length(env, value.size(), result);
+  for (size_t i = 0; status == napi_ok && i < value.size(); i++) {
+    napi_value element;
+    status = napi_to_value(env, value[i], &element);
+    if (status == napi_ok)
+      status = napi_set_element(env, *result, (uint32_t)i, element);
+  }
+  return status;
+}
+
+template <typename T>
+napi_enable_if_struct<T> napi_to_value(napi_env env, const T& value,
+                                       napi_value* result) {
+  using traits = napi_struct_traits<T>;
+  static_assert(traits::size <= napi_object_shape::kMaxKeys,
+                "too many fields");
+
+  napi_env_cache* cache = napi_env_cache::get(env);
+  if (!cache) return napi_generic_failure;
+  const napi_object_shape& shape =
+      cache->shape(traits::names(), traits::names(), traits::size);
+
+  napi_value values[traits::size];
+  napi_status status = napi_ok;
+  traits::for_each(value, [&](size_t index, const auto& field) {
+    if (status == napi_ok) status = napi_to_value(env, field, &values[index]);
+  });
+  if (status != napi_ok) return status;
+
+  return shape.create_object(values, result);
+}
+
+// from js
+
+inline napi_status napi_from_value(napi_env env, napi_value value,
+                                   bool& result) {
+  return napi_get_value_bool(env, value, &result);
+}
+
+inline napi_status napi_from_value(napi_env env, napi_value value,
+                                   int32_t& result) {
+  return napi_get_value_int32(env, value, &result);
+}
+
+inline napi_status napi_from_value(napi_env env, napi_value value,
+                                   uint32_t& result) {
+  return napi_get_value_uint32(env, value, &result);
+}
+
+inline napi_status napi_from_value(napi_env env, napi_value value,
+                                   int64_t& result) {
+  return napi_get_value_int64(env, value, &result);
+}
+
+inline napi_status napi_from_value(napi_env env, napi_value value,
+                                   uint64_t& result) {
+  bool lossless;
+  return napi_get_value_bigint_uint64(env, value, &result, &lossless);
+}
+
+inline napi_status napi_from_value(napi_env env, napi_value value,
+                                   double& result) {
+  return napi_get_value_double(env, value, &result);
+}
+
+inline napi_status napi_from_value(napi_env env, napi_value value,
+                                   float& result) {
+  double number;
+  napi_status status = napi_get_value_double(env, value, &number);
+  if (status == napi_ok) result = (float)number;
+  return status;
+}
+
+inline napi_status napi_from_value(napi_env env, napi_value value,
+                                   std::string& result) {
+  return napi_get_value_utf8string(env, value, result);
+}
+
+template <typename T>
+napi_status napi_from_value(napi_env env, napi_value value,
+                            std::vector<T>& result);
+
+template <typename T>
+napi_enable_if_struct<T> napi_from_value(napi_env env, napi_value value,
+                                         T& result);
+
+template <typename T>
+napi_status napi_from_value(napi_env env, napi_value value,
+                            std::vector<T>& result) {
+  bool is_array = false;
+  napi_status status = napi_is_array(env, value, &is_array);
+  if (status != napi_ok) return status;
+  if (!is_array) return napi_array_expected;
+
+  uint32_t length = 0;
+  status = napi_get_array_length(env, value, &length);
+  if (status != napi_ok) return status;
+
+  result.resize(length);
+  for (uint32_t i = 0; status == napi_ok && i < length; i++) {
+    napi_value element;
+    status = napi_get_element(env, value, i, &element);
+    if (status == napi_ok) status = napi_from_value(env, element, result[i]);
+  }
+  return status;
+}
+
+template <typename T>
+napi_enable_if_struct<T> napi_from_value(napi_env env, napi_value value,
+                                         T& result) {
+  using traits = napi_struct_traits<T>;
+
+  napi_valuetype type;
+  napi_status status = napi_typeof(env, value, &type);
+  if (status != napi_ok) return status;
+  if (type != napi_object) return napi_object_expected;
+
+  const char* const* names = traits::names();
+  traits::for_each(result, [&](size_t index, auto& field) {
+    if (status != napi_ok) return;
+    napi_value field_value;
+    status = napi_get_named_property(env, value, names[index], &field_value);
+    if (status == napi_ok) status = napi_from_value(env, field_value, field);
+  });
+  return status;
+}
+
+}  // namespace plugin
+}  // namespace agora
+
+#endif  // AGORA_PLUGIN_NAPI_STRUCT_H_
@@ -0,0 +1,227 @@
+#include "napi_trace.h"
+
+#include <stdio.h>
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace agora {
+namespace plugin {
+
+namespace {
+
+struct trace_event {
+  const char* category;
+  const char* name;
+  const char* arg_name;
+  int64_t arg;
+  uint64_t begin;
+  uint64_t end;
+};
+
+// Written by its own thread only, count publishes the events before it so
+// stop can read them while the thread keeps appending.
+struct trace_buffer {
+  explicit trace_buffer(uint32_t tid)
+      : events(new trace_event[napi_tracer::kEventsPerThread]),
+        count(0),
+        session(0),
+        dropped(0),
+        alive(true),
+        tid(tid) {}
+
+  std::unique_ptr<trace_event[]> events;
+  std::atomic<size_t> count;
+  std::atomic<uint32_t> session;
+  std::atomic<uint64_t> dropped;
+  std::atomic<bool> alive;
+  const uint32_t tid;
+  // guarded by the registry lock
+  std::string name;
+};
+
+struct trace_registry {
+  std::mutex lock;
+  std::vector<std::unique_ptr<trace_buffer>> buffers;
+  uint32_t next_tid = 1;
+  std::atomic<uint32_t> session{0};
+  // serializes start and stop
+  std::mutex session_lock;
+};
+
+trace_registry& registry() {
+  // never deleted, threads may record while the process exits
+  static trace_registry* registry = new trace_registry();
+  return *registry;
+}
+
+// Lets the registry free the buffer once its thread is gone.
+struct thread_trace {
+  trace_buffer* buffer = nullptr;
+  ~thread_trace() {
+    if (buffer) buffer->alive.store(false, std::memory_order_release);
+  }
+};
+
+thread_local thread_trace _thread_trace;
+
+trace_buffer* threadBuffer() {
+  if (!_thread_trace.buffer) {
+    trace_registry& reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    reg.buffers.emplace_back(new trace_buffer(reg.next_tid++));
+    _thread_trace.buffer = reg.buffers.back().get();
+  }
+  return _thread_trace.buffer;
+}
+
+// called under the registry lock
+void freeDeadBuffers(trace_registry& reg) {
+  auto& buffers = reg.buffers;
+  for (auto itr = buffers.begin(); itr != buffers.end();) {
+    if ((*itr)->alive.load(std::memory_order_acquire)) {
+      ++itr;
+    } else {
+      itr = buffers.erase(itr);
+    }
+  }
+}
+
+int processId() {
+#if defined(_WIN32)
+  return _getpid();
+#else
+  return (int)getpid();
+#endif
+}
+
+}  // namespace
+
+std::atomic<bool> napi_tracer::enabled_(false);
+
+uint64_t napi_tracer::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+bool napi_tracer::start() {
+  trace_registry& reg = registry();
+  std::lock_guard<std::mutex> session_guard(reg.session_lock);
+  if (enabled_.load()) return false;
+
+  {
+    std::lock_guard<std::mutex> guard(reg.lock);
+    freeDeadBuffers(reg);
+  }
+  // buffers of the previous session are emptied by their own threads
+  reg.session.fetch_add(1, std::memory_order_release);
+  enabled_.store(true);
+  return true;
+}
+
+int64_t napi_tracer::stop(const char* path) {
+  trace_registry& reg = registry();
+  std::lock_guard<std::mutex> session_guard(reg.session_lock);
+  if (!enabled_.exchange(false)) return -1;
+
+  FILE* file = fopen(path, "w");
+  if (!file) return -1;
+
+  const int pid = processId();
+  const uint32_t session = reg.session.load(std::memory_order_acquire);
+  int64_t written = 0;
+
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  std::lock_guard<std::mutex> guard(reg.lock);
+  for (auto& buffer : reg.buffers) {
+    if (buffer->session.load(std::memory_order_acquire) != session) continue;
+
+    fprintf(file,
+            "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+            "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+            written ? "," : "", pid, buffer->tid,
+            buffer->name.empty() ? "native" : buffer->name.c_str());
+    written++;
+
+    const size_t count = buffer->count.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; i++) {
+      const trace_event& event = buffer->events[i];
+      // microseconds with the nanoseconds as fraction
+      fprintf(file,
+              ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+              "\"ts\":%llu.%03u,\"dur\":%llu.%03u,\"pid\":%d,\"tid\":%u",
+              event.name, event.category,
+              (unsigned long long)(event.begin / 1000),
+              (unsigned)(event.begin % 1000),
+              (unsigned long long)((event.end - event.begin) / 1000),
+              (unsigned)((event.end - event.begin) % 1000), pid,
+              buffer->tid);
+      if (event.arg_name) {
+        fprintf(file, ",\"args\":{\"%s\":%lld}", event.arg_name,
+                (long long)event.arg);
+      }
+      fprintf(file, "}");
+      written++;
+    }
+  }
+  fprintf(file, "\n]}\n");
+
+  bool failed = ferror(file) != 0;
+  failed = fclose(file) != 0 || failed;
+  return failed ? -1 : written;
+}
+
+void napi_tracer::record(const char* category, const char* name,
+                         uint64_t begin, uint64_t end, const char* arg_name,
+                         int64_t arg) {
+  if (!enabled()) return;
+
+  trace_buffer* buffer = threadBuffer();
+  const uint32_t session =
+      registry().session.load(std::memory_order_acquire);
+  if (buffer->session.load(std::memory_order_relaxed) != session) {
+    buffer->count.store(0, std::memory_order_relaxed);
+    buffer->dropped.store(0, std::memory_order_relaxed);
+    buffer->session.store(session, std::memory_order_release);
+  }
+
+  const size_t index = buffer->count.load(std::memory_order_relaxed);
+  if (index >= kEventsPerThread) {
+    buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  const uint64_t finished = end > begin ? end : begin;
+  buffer->events[index] =
+      trace_event{category, name, arg_name, arg, begin, finished};
+  buffer->count.store(index + 1, std::memory_order_release);
+}
+
+void napi_tracer::set_thread_name(const char* name) {
+  trace_buffer* buffer = threadBuffer();
+  std::lock_guard<std::mutex> guard(registry().lock);
+  buffer->name = name;
+}
+
+uint64_t napi_tracer::dropped() {
+  trace_registry& reg = registry();
+  const uint32_t session = reg.session.load(std::memory_order_acquire);
+  uint64_t dropped = 0;
+  std::lock_guard<std::mutex> guard(reg.lock);
+  for (auto& buffer : reg.buffers) {
+    if (buffer->session.load(std::memory_order_acquire) == session)
+      dropped += buffer->dropped.load(std::memory_order_relaxed);
+  }
+  return dropped;
+}
+
+}  // namespace plugin
+}  // namespace agora
@@ -0,0 +1,106 @@
+#ifndef AGORA_PLUGIN_NAPI_TRACE_H_
+#define AGORA_PLUGIN_NAPI_TRACE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Call sites are compiled in unless AGORA_PLUGIN_TRACING is 0, while tracing
+// is stopped one costs a relaxed load.
+#ifndef AGORA_PLUGIN_TRACING
+#define AGORA_PLUGIN_TRACING 1
+#endif
+
+namespace agora {
+namespace plugin {
+
+// Process wide tracer writing the Chrome trace event format, which
+// chrome://tracing and Perfetto load next to a trace of Electron itself.
+// Every thread records complete events into a buffer of its own without
+// locking, the buffers are only read by stop. Timestamps are steady clock,
+// the clock of Chrome's trace on the desktop platforms.
+//
+// NAPI_TRACE_SCOPE(scope, "queue", "drain");
+// ...
+// NAPI_TRACE_ARG(scope, "events", count);
+//
+// category, name and arg_name must be string literals.
+class napi_tracer {
+ public:
+  // events a thread keeps per session, later ones are dropped
+  static const size_t kEventsPerThread = 1 << 16;
+
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  // steady clock in nanoseconds
+  static uint64_t now();
+
+  // Starts a session and forgets the events of the previous one, returns
+  // false when a session is running already.
+  static bool start();
+
+  // Stops the session and writes its events to path as a Chrome JSON trace.
+  // Returns the count of events written or -1 when nothing was started or
+  // path can not be written.
+  static int64_t stop(const char* path);
+
+  static void record(const char* category, const char* name, uint64_t begin,
+                     uint64_t end, const char* arg_name = nullptr,
+                     int64_t arg = 0);
+
+  // name of the calling thread in the trace
+  static void set_thread_name(const char* name);
+
+  // events dropped by full buffers in the current or last session
+  static uint64_t dropped();
+
+ private:
+  static std::atomic<bool> enabled_;
+};
+
+// Records a complete event from its construction to its destruction.
+class napi_trace_scope {
+ public:
+  napi_trace_scope(const char* category, const char* name)
+      : category_(category),
+        name_(name),
+        arg_name_(nullptr),
+        arg_(0),
+        begin_(napi_tracer::enabled() ? napi_tracer::now() : 0) {}
+
+  ~napi_trace_scope() {
+    if (begin_)
+      napi_tracer::record(category_, name_, begin_, napi_tracer::now(),
+                          arg_name_, arg_);
+  }
+
+  void set_arg(const char* name, int64_t value) {
+    arg_name_ = name;
+    arg_ = value;
+  }
+
+ private:
+  napi_trace_scope(const napi_trace_scope&) = delete;
+  napi_trace_scope& operator=(const napi_trace_scope&) = delete;
+
+  const char* category_;
+  const char* name_;
+  const char* arg_name_;
+  int64_t arg_;
+  uint64_t begin_;
+};
+
+#if AGORA_PLUGIN_TRACING
+#define NAPI_TRACE_SCOPE(scope, category, name) \
+  ::agora::plugin::napi_trace_scope scope(category, name)
+#define NAPI_TRACE_ARG(scope, arg_name, value) \
+  scope.set_arg(arg_name, (int64_t)(value))
+#else
+#define NAPI_TRACE_SCOPE(scope, category, name)
+#define NAPI_TRACE_ARG(scope, arg_name, value)
+#endif
+
+}  // namespace plugin
+}  // namespace agora
+
+#endif  // AGORA_PLUGIN_NAPI_TRACE_H_
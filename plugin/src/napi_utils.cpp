@@ -1,24 +1,389 @@
 #include "napi_utils.h"
 
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
 namespace agora {
 namespace plugin {
 
+namespace {
+// napi_get_value_string_utf8 never splits a character, a copy which leaves
+// more than a character of room in the buffer is complete
+const size_t kMaxUtf8CharSize = 4;
+const size_t kStackStringSize = 256;
+const size_t kArenaBlockSize = 16 * 1024;
+}  // namespace
+
 napi_status napi_get_value_utf8string(napi_env& env, napi_value& value,
                                       std::string& str) {
-  napi_status status;
+  // most strings fit on the stack and are read by one call
+  char buffer[kStackStringSize];
   size_t length = 0;
+  napi_status status =
+      napi_get_value_string_utf8(env, value, buffer, sizeof(buffer), &length);
+  if (status != napi_ok) return status;
+  if (length + kMaxUtf8CharSize < sizeof(buffer)) {
+    str.assign(buffer, length);
+    return napi_ok;
+  }
+
   status = napi_get_value_string_utf8(env, value, nullptr, 0, &length);
+  if (status != napi_ok) return status;
+  // the terminating null is written over the one std::string keeps
+  str.resize(length);
+  return napi_get_value_string_utf8(env, value, &str[0], length + 1, &length);
+}
 
-  std::vector<char> strData;
-  // https://github.com/nodejs/node-addon-examples/issues/83
-  length += 1;
-  strData.resize(length, '\0');
+std::string napi_string_view::str() const {
+  return std::string(data, size);
+}
 
-  size_t result = 0;
-  status =
-      napi_get_value_string_utf8(env, value, strData.data(), length, &result);
-  str = strData.data();
-  return status;
+void napi_string_arena::clear() {
+  if (blocks_.size() > 1) blocks_.erase(blocks_.begin() + 1, blocks_.end());
+  used_ = 0;
+}
+
+napi_status napi_string_arena::append(napi_env env, napi_value value,
+                                      napi_string_view& view) {
+  if (blocks_.empty()) {
+    blocks_.emplace_back(kArenaBlockSize);
+    used_ = 0;
+  }
+
+  // write into the rest of the current block first
+  std::vector<char>& block = blocks_.back();
+  char* cursor = block.data() + used_;
+  size_t length = 0;
+  napi_status status = napi_get_value_string_utf8(
+      env, value, cursor, block.size() - used_, &length);
+  if (status != napi_ok) return status;
+  if (length + kMaxUtf8CharSize < block.size() - used_) {
+    view = napi_string_view{cursor, length};
+    used_ += length + 1;
+    return napi_ok;
+  }
+
+  status = napi_get_value_string_utf8(env, value, nullptr, 0, &length);
+  if (status != napi_ok) return status;
+  blocks_.emplace_back(std::max(kArenaBlockSize, length + 1));
+  cursor = blocks_.back().data();
+  status = napi_get_value_string_utf8(env, value, cursor, length + 1, &length);
+  if (status != napi_ok) return status;
+  view = napi_string_view{cursor, length};
+  used_ = length + 1;
+  return napi_ok;
+}
+
+napi_status napi_get_value_string_array(napi_env env, napi_value value,
+                                        napi_string_arena& arena,
+                                        std::vector<napi_string_view>& result) {
+  bool isArray = false;
+  napi_status status = napi_is_array(env, value, &isArray);
+  if (status != napi_ok) return status;
+  if (!isArray) return napi_array_expected;
+
+  uint32_t length = 0;
+  status = napi_get_array_length(env, value, &length);
+  if (status != napi_ok) return status;
+
+  result.reserve(result.size() + length);
+  for (uint32_t index = 0; index < length; index++) {
+    napi_value elementValue;
+    status = napi_get_element(env, value, index, &elementValue);
+    if (status != napi_ok) return status;
+
+    napi_string_view view;
+    status = arena.append(env, elementValue, view);
+    if (status != napi_ok) return status;
+    result.push_back(view);
+  }
+
+  return napi_ok;
+}
+
+napi_object_shape::napi_object_shape(napi_env env, const char* const names[],
+                                     size_t count)
+    : env_(env), names_(names, names + count) {
+  keys_.reserve(names_.size());
+  for (const char* name : names_) {
+    napi_value key;
+    napi_ref ref = nullptr;
+    if (napi_create_string_utf8(env, name, NAPI_AUTO_LENGTH, &key) ==
+        napi_ok)
+      napi_create_reference(env, key, 1, &ref);
+    keys_.push_back(ref);
+  }
+}
+
+napi_object_shape::~napi_object_shape() {
+  for (napi_ref ref : keys_) {
+    if (ref) napi_delete_reference(env_, ref);
+  }
+}
+
+napi_status napi_object_shape::create_object(napi_value values[],
+                                             napi_value* result) const {
+  if (names_.size() > kMaxKeys) return napi_invalid_arg;
+  napi_property_descriptor descriptors[kMaxKeys];
+  const napi_property_attributes attributes =
+      static_cast<napi_property_attributes>(napi_writable | napi_enumerable |
+                                            napi_configurable);
+  for (size_t i = 0; i < names_.size(); i++) {
+    napi_property_descriptor& descriptor = descriptors[i];
+    descriptor = {nullptr, nullptr, nullptr, nullptr,
+                  nullptr, values[i], attributes, nullptr};
+    // keys which could not be kept are interned by name
+    if (!keys_[i] ||
+        napi_get_reference_value(env_, keys_[i], &descriptor.name) !=
+            napi_ok) {
+      descriptor.name = nullptr;
+      descriptor.utf8name = names_[i];
+    }
+  }
+
+  napi_status status = napi_create_object(env_, result);
+  if (status != napi_ok) return status;
+  return napi_define_properties(env_, *result, names_.size(), descriptors);
+}
+
+namespace {
+std::mutex g_env_caches_lock;
+std::unordered_map<napi_env, std::unique_ptr<napi_env_cache>> g_env_caches;
+thread_local napi_env t_last_env = nullptr;
+thread_local napi_env_cache* t_last_cache = nullptr;
+}  // namespace
+
+napi_env_cache* napi_env_cache::get(napi_env env) {
+  if (env == t_last_env) return t_last_cache;
+
+  std::lock_guard<std::mutex> guard(g_env_caches_lock);
+  std::unique_ptr<napi_env_cache>& cache = g_env_caches[env];
+  if (!cache) {
+    cache.reset(new napi_env_cache(env));
+    napi_add_env_cleanup_hook(env, cleanup, env);
+  }
+  t_last_env = env;
+  t_last_cache = cache.get();
+  return t_last_cache;
+}
+
+void napi_env_cache::cleanup(void* arg) {
+  // runs on the thread of the env
+  napi_env env = static_cast<napi_env>(arg);
+  if (t_last_env == env) {
+    t_last_env = nullptr;
+    t_last_cache = nullptr;
+  }
+
+  std::unique_ptr<napi_env_cache> cache;
+  {
+    std::lock_guard<std::mutex> guard(g_env_caches_lock);
+    auto itr = g_env_caches.find(env);
+    if (itr == g_env_caches.end()) return;
+    cache = std::move(itr->second);
+    g_env_caches.erase(itr);
+  }
+}
+
+const napi_object_shape& napi_env_cache::shape(const void* key,
+                                               const char* const names[],
+                                               size_t count) {
+  for (auto& item : shapes_) {
+    if (item.first == key) return *item.second;
+  }
+
+  shapes_.emplace_back(key, std::unique_ptr<napi_object_shape>(
+                                new napi_object_shape(env_, names, count)));
+  return *shapes_.back().second;
+}
+
+// Free blocks are kept per power of two size class, so that payloads of
+// slightly different sizes reuse the same blocks.
+struct napi_buffer_pool_state {
+  explicit napi_buffer_pool_state(size_t max_cached_bytes)
+      : max_cached_bytes(max_cached_bytes),
+        cached_bytes(0),
+        copied_bytes(0),
+        shared_bytes(0),
+        outstanding(0),
+        external_allowed(true) {}
+
+  ~napi_buffer_pool_state() {
+    for (auto& item : free_blocks) free(item.second);
+  }
+
+  void release(unsigned char* data, size_t capacity) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (cached_bytes + capacity > max_cached_bytes) {
+      free(data);
+      return;
+    }
+    free_blocks.emplace(capacity, data);
+    cached_bytes += capacity;
+  }
+
+  std::mutex lock;
+  std::multimap<size_t, unsigned char*> free_blocks;
+  const size_t max_cached_bytes;
+  size_t cached_bytes;
+  std::atomic<uint64_t> copied_bytes;
+  std::atomic<uint64_t> shared_bytes;
+  std::atomic<uint64_t> outstanding;
+  std::atomic<bool> external_allowed;
+};
+
+namespace {
+const size_t kMinPooledBlockSize = 64 * 1024;
+
+size_t pooledBlockSize(size_t size) {
+  size_t capacity = kMinPooledBlockSize;
+  while (capacity < size) capacity <<= 1;
+  return capacity;
+}
+
+// js owns the block of an external ArrayBuffer until it is finalized
+struct ExternalBlock {
+  std::shared_ptr<napi_buffer_pool_state> pool;
+  unsigned char* data;
+  size_t capacity;
+};
+
+void finalizeExternalBlock(napi_env env, void* data, void* hint) {
+  ExternalBlock* block = static_cast<ExternalBlock*>(hint);
+  block->pool->outstanding--;
+  block->pool->release(block->data, block->capacity);
+  delete block;
+}
+}  // namespace
+
+napi_pooled_buffer::napi_pooled_buffer(napi_pooled_buffer&& other)
+    : pool_(std::move(other.pool_)),
+      data_(other.data_),
+      size_(other.size_),
+      capacity_(other.capacity_) {
+  other.data_ = nullptr;
+  other.size_ = other.capacity_ = 0;
+}
+
+napi_pooled_buffer& napi_pooled_buffer::operator=(napi_pooled_buffer&& other) {
+  if (this != &other) {
+    reset();
+    pool_ = std::move(other.pool_);
+    data_ = other.data_;
+    size_ = other.size_;
+    capacity_ = other.capacity_;
+    other.data_ = nullptr;
+    other.size_ = other.capacity_ = 0;
+  }
+  return *this;
+}
+
+void napi_pooled_buffer::reset() {
+  if (data_ && pool_) pool_->release(data_, capacity_);
+  pool_.reset();
+  data_ = nullptr;
+  size_ = capacity_ = 0;
+}
+
+napi_buffer_pool::napi_buffer_pool(size_t max_cached_bytes)
+    : state_(std::make_shared<napi_buffer_pool_state>(max_cached_bytes)) {}
+
+napi_buffer_pool::~napi_buffer_pool() {}
+
+napi_pooled_buffer napi_buffer_pool::acquire(size_t size) {
+  napi_pooled_buffer buffer;
+  const size_t capacity = pooledBlockSize(size);
+
+  unsigned char* data = nullptr;
+  {
+    std::lock_guard<std::mutex> guard(state_->lock);
+    auto itr = state_->free_blocks.find(capacity);
+    if (itr != state_->free_blocks.end()) {
+      data = itr->second;
+      state_->free_blocks.erase(itr);
+      state_->cached_bytes -= capacity;
+    }
+  }
+  if (!data) data = static_cast<unsigned char*>(malloc(capacity));
+  if (!data) return buffer;
+
+  buffer.pool_ = state_;
+  buffer.data_ = data;
+  buffer.size_ = size;
+  buffer.capacity_ = capacity;
+  return buffer;
+}
+
+napi_status napi_buffer_pool::create_uint8array(napi_env env,
+                                                napi_pooled_buffer&& buffer,
+                                                napi_value* result) {
+  if (!buffer) return napi_invalid_arg;
+
+  const size_t length = buffer.size_;
+  napi_status status = napi_generic_failure;
+  napi_value array_buffer;
+#ifndef NODE_API_NO_EXTERNAL_BUFFERS_ALLOWED
+  if (state_->external_allowed) {
+    ExternalBlock* block =
+        new ExternalBlock{buffer.pool_, buffer.data_, buffer.capacity_};
+    status = napi_create_external_arraybuffer(env, buffer.data_, length,
+                                              finalizeExternalBlock, block,
+                                              &array_buffer);
+    if (status == napi_ok) {
+      state_->outstanding++;
+      state_->shared_bytes += length;
+      // js owns the block now
+      buffer.pool_.reset();
+      buffer.data_ = nullptr;
+      buffer.size_ = buffer.capacity_ = 0;
+    } else {
+      delete block;
+      bool is_pending = false;
+      napi_is_exception_pending(env, &is_pending);
+      if (is_pending) {
+        napi_value error;
+        napi_get_and_clear_last_exception(env, &error);
+      }
+      // the runtime forbids external buffers, do not try again
+      state_->external_allowed = false;
+    }
+  }
+#endif
+
+  if (status != napi_ok) {
+    void* data = nullptr;
+    status = napi_create_arraybuffer(env, length, &data, &array_buffer);
+    if (status != napi_ok) return status;
+    memcpy(data, buffer.data_, length);
+    state_->copied_bytes += length;
+    buffer.reset();
+  }
+
+  return napi_create_typedarray(env, napi_uint8_array, length, array_buffer, 0,
+                                result);
+}
+
+void napi_buffer_pool::set_external_allowed(bool allowed) {
+  state_->external_allowed = allowed;
+}
+
+napi_buffer_pool::stats napi_buffer_pool::get_stats() const {
+  stats result;
+  result.copied_bytes = state_->copied_bytes;
+  result.shared_bytes = state_->shared_bytes;
+  result.outstanding = state_->outstanding;
+  {
+    std::lock_guard<std::mutex> guard(state_->lock);
+    result.cached_bytes = state_->cached_bytes;
+  }
+  result.external_allowed = state_->external_allowed;
+  return result;
 }
 
 napi_status napi_obj_set_property(napi_env& env, napi_value& object,
@@ -120,6 +485,16 @@ napi_status napi_obj_set_property(napi_env& env, napi_value& object,
   return status;
 }
 
+napi_status napi_obj_set_property(napi_env& env, napi_value& object,
+                                  const char* utf8name, napi_buffer_pool& pool,
+                                  napi_pooled_buffer&& value) {
+  napi_value typed_array_value;
+  napi_status status =
+      pool.create_uint8array(env, std::move(value), &typed_array_value);
+  if (status != napi_ok) return status;
+  return napi_set_named_property(env, object, utf8name, typed_array_value);
+}
+
 napi_status napi_obj_set_property(napi_env& env, napi_value& object,
                                   const char* utf8name, const napi_value& value,
                                   int length) {
@@ -198,16 +573,15 @@ napi_status napi_obj_get_property(napi_env& env, napi_value& object,
   status = napi_get_array_length(env, retValue, &length);
   if (status != napi_ok || !length) return status;
 
+  result.reserve(result.size() + length);
   for (uint32_t index = 0; index < length; index++) {
     napi_value elementValue;
     status = napi_get_element(env, retValue, index, &elementValue);
     if (status != napi_ok) return status;
 
-    std::string stringValue;
-    status = napi_get_value_utf8string(env, elementValue, stringValue);
+    result.emplace_back();
+    status = napi_get_value_utf8string(env, elementValue, result.back());
     if (status != napi_ok) return status;
-
-    result.emplace_back(stringValue);
   }
 
   return status;
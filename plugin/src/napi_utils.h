@@ -2,10 +2,11 @@
 #define AGORA_PLUGIN_NAPI_UTILS_H_
 
 #include <node_api.h>
-#include <node_buffer.h>
 
+#include <initializer_list>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace agora {
@@ -65,9 +66,44 @@ namespace plugin {
   napi_obj_set_property(env, retObj, _ret_result_str, resultStr); \
   return retObj
 
+// Reads the whole string, embedded nulls included, short strings by a single
+// n-api call.
 napi_status napi_get_value_utf8string(napi_env& env, napi_value& value,
                                       std::string& str);
 
+// Null terminated string owned by a napi_string_arena, std::string_view is
+// not available to the c++14 builds of the addon.
+struct napi_string_view {
+  const char* data;
+  size_t size;
+
+  std::string str() const;
+};
+
+// Storage for strings read in bulk, they are packed in large blocks instead
+// of one allocation per string. Views stay valid until clear, which keeps
+// the first block for the next read.
+class napi_string_arena {
+  napi_string_arena(const napi_string_arena&) = delete;
+  napi_string_arena& operator=(const napi_string_arena&) = delete;
+
+ public:
+  napi_string_arena() : used_(0) {}
+
+  void clear();
+
+  napi_status append(napi_env env, napi_value value, napi_string_view& view);
+
+ private:
+  std::vector<std::vector<char>> blocks_;
+  size_t used_;
+};
+
+// Appends the views of all the strings of the array value to result.
+napi_status napi_get_value_string_array(napi_env env, napi_value value,
+                                        napi_string_arena& arena,
+                                        std::vector<napi_string_view>& result);
+
 napi_status napi_obj_set_property(napi_env& env, napi_value& object,
                                   const char* utf8name, const int& value,
                                   int length = 0);
@@ -100,6 +136,8 @@ napi_status napi_obj_set_property(napi_env& env, napi_value& object,
                                   const char* utf8name, const uint64_t& value,
                                   int length = 0);
 
+// Copies length bytes into a new Uint8Array, see napi_buffer_pool to hand
+// large native buffers to js without copying.
 napi_status napi_obj_set_property(napi_env& env, napi_value& object,
                                   const char* utf8name,
                                   const unsigned char* value, int length = 0);
@@ -131,6 +169,164 @@ napi_status napi_obj_get_property(napi_env& env, napi_value& object,
                                   const char* utf8name,
                                   std::vector<std::string>& result);
 
+// Builds objects which have the same property names. The names are interned
+// once per environment and kept as js strings, an object is then created
+// with all of its properties by a single napi_define_properties instead of
+// one napi_set_named_property per field, which interns the name every time.
+class napi_object_shape {
+  napi_object_shape(const napi_object_shape&) = delete;
+  napi_object_shape& operator=(const napi_object_shape&) = delete;
+
+ public:
+  static const size_t kMaxKeys = 16;
+
+  // names must outlive the shape, a shape of more than kMaxKeys of them
+  // creates no object
+  napi_object_shape(napi_env env, const char* const names[], size_t count);
+  napi_object_shape(napi_env env, std::initializer_list<const char*> names)
+      : napi_object_shape(env, names.begin(), names.size()) {}
+  ~napi_object_shape();
+
+  size_t size() const { return names_.size(); }
+  const char* name(size_t index) const { return names_[index]; }
+
+  // values holds size() values in the order of the names, napi_invalid_arg
+  // when there are more than kMaxKeys of them
+  napi_status create_object(napi_value values[], napi_value* result) const;
+
+ private:
+  napi_env env_;
+  std::vector<const char*> names_;
+  // interned names, null when one could not be created
+  std::vector<napi_ref> keys_;
+};
+
+class napi_buffer_pool;
+struct napi_buffer_pool_state;
+
+// Block of a napi_buffer_pool owned by native code, filled in place and then
+// handed to js by napi_buffer_pool::create_uint8array. A block which is not
+// handed over returns to its pool when destroyed.
+class napi_pooled_buffer {
+  napi_pooled_buffer(const napi_pooled_buffer&) = delete;
+  napi_pooled_buffer& operator=(const napi_pooled_buffer&) = delete;
+
+ public:
+  napi_pooled_buffer() : data_(nullptr), size_(0), capacity_(0) {}
+  napi_pooled_buffer(napi_pooled_buffer&& other);
+  napi_pooled_buffer& operator=(napi_pooled_buffer&& other);
+  ~napi_pooled_buffer() { reset(); }
+
+  unsigned char* data() const { return data_; }
+  size_t size() const { return size_; }
+  explicit operator bool() const { return data_ != nullptr; }
+
+  void reset();
+
+ private:
+  friend class napi_buffer_pool;
+
+  std::shared_ptr<napi_buffer_pool_state> pool_;
+  unsigned char* data_;
+  size_t size_;
+  size_t capacity_;
+};
+
+// Recycles large blocks handed to js as external ArrayBuffers, js owns a
+// block from create_uint8array until its ArrayBuffer is collected and the
+// finalizer gives it back, native code must not touch it in between. The
+// pool state outlives the pool object while js still holds blocks.
+//
+// Runtimes which forbid external buffers, like electron with the V8 memory
+// cage, fail napi_create_external_arraybuffer, the pool then copies into a
+// regular ArrayBuffer and returns the block right away.
+class napi_buffer_pool {
+  napi_buffer_pool(const napi_buffer_pool&) = delete;
+  napi_buffer_pool& operator=(const napi_buffer_pool&) = delete;
+
+ public:
+  struct stats {
+    // bytes copied into js by the fallback
+    uint64_t copied_bytes;
+    // bytes handed to js without copying
+    uint64_t shared_bytes;
+    // blocks owned by js
+    uint64_t outstanding;
+    // bytes of the free blocks kept for reuse
+    uint64_t cached_bytes;
+    bool external_allowed;
+  };
+
+  // keeps at most max_cached_bytes of free blocks
+  explicit napi_buffer_pool(size_t max_cached_bytes = 64 * 1024 * 1024);
+  ~napi_buffer_pool();
+
+  // A block of at least size bytes, empty when out of memory.
+  napi_pooled_buffer acquire(size_t size);
+
+  // Hand buffer to js as a Uint8Array of buffer.size() bytes.
+  napi_status create_uint8array(napi_env env, napi_pooled_buffer&& buffer,
+                                napi_value* result);
+
+  // always copy, for runtimes known to forbid external buffers
+  void set_external_allowed(bool allowed);
+
+  stats get_stats() const;
+
+ private:
+  std::shared_ptr<napi_buffer_pool_state> state_;
+};
+
+// Sets a Uint8Array property which takes over value, see napi_buffer_pool.
+napi_status napi_obj_set_property(napi_env& env, napi_value& object,
+                                  const char* utf8name, napi_buffer_pool& pool,
+                                  napi_pooled_buffer&& value);
+
+// Caches of one environment which are shared by all the addon code instead
+// of belonging to its instance data, like the shapes of NAPI_STRUCT types.
+// Created on first use and deleted by a cleanup hook of the env, the cache of
+// the env last used on a thread is found without locking.
+class napi_env_cache {
+  napi_env_cache(const napi_env_cache&) = delete;
+  napi_env_cache& operator=(const napi_env_cache&) = delete;
+
+ public:
+  static napi_env_cache* get(napi_env env);
+
+  // Shape identified by the static address key, built from names on first
+  // use.
+  const napi_object_shape& shape(const void* key, const char* const names[],
+                                 size_t count);
+
+ private:
+  explicit napi_env_cache(napi_env env) : env_(env) {}
+  static void cleanup(void* arg);
+
+  napi_env env_;
+  std::vector<std::pair<const void*, std::unique_ptr<napi_object_shape>>>
+      shapes_;
+};
+
+// Instance of T owned by the calling environment, it is constructed with the
+// env on first use and deleted when the env is torn down, so main thread,
+// renderers and workers never share one. An addon has one instance type.
+template <typename T>
+T* napi_get_instance(napi_env env) {
+  T* instance = nullptr;
+  if (napi_get_instance_data(env, (void**)&instance) == napi_ok && instance)
+    return instance;
+
+  instance = new T(env);
+  napi_status status = napi_set_instance_data(
+      env, instance,
+      [](napi_env env, void* data, void* hint) { delete (T*)data; }, nullptr);
+  if (status != napi_ok) {
+    delete instance;
+    return nullptr;
+  }
+  return instance;
+}
+
 }  // namespace plugin
 }  // namespace agora
 
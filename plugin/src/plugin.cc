@@ -1,48 +1,443 @@
 #include "plugin.h"
 
+#include <math.h>
 #include <node_api.h>
 
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include "monitor.h"
 
 namespace {
 using namespace agora::plugin;
-static agora::plugin::NodeValoranEventBase<windowmonitor::WNDID>
-    _window_monitor_events;
 
-static void packageRect(napi_env env, napi_value &value,
-                        const windowmonitor::CRect &rect) {
-  NAPI_CALL_NORETURN(env, napi_create_object(env, &value));
-  NAPI_CALL_NORETURN(env, napi_create_object(env, &value));
-  NAPI_CALL_NORETURN(env, napi_obj_set_property(env, value, "left", rect.left));
-  NAPI_CALL_NORETURN(env, napi_obj_set_property(env, value, "top", rect.top));
-  NAPI_CALL_NORETURN(env,
-                     napi_obj_set_property(env, value, "right", rect.right));
-  NAPI_CALL_NORETURN(env,
-                     napi_obj_set_property(env, value, "bottom", rect.bottom));
-}
+// summary of a drag passed with GestureEnded, field names are the keys seen
+// by js
+struct WindowMonitorGesture {
+  windowmonitor::CRect startRect;
+  windowmonitor::CRect endRect;
+  // milliseconds
+  double duration;
+  uint32_t samples;
+};
+
+struct WindowMonitorPayload {
+  windowmonitor::EventType event;
+  windowmonitor::CRect rect;
+  // GestureEnded only
+  WindowMonitorGesture gesture;
+  // Moving of predicted windows only, rect is then the one of the platform
+  // and each environment extrapolates it by its own lead
+  bool has_motion;
+  windowmonitor::WindowMotion motion;
+};
+
+using WindowMonitorRecord =
+    NodeValoranEventRecord<windowmonitor::WNDID, WindowMonitorPayload>;
+
+// what an environment asked for when registering a window
+struct WindowMonitorOptions {
+  windowmonitor::EventFilter filter;
+  // microseconds the rects of Moving are extrapolated ahead, zero for none
+  uint32_t lead_us;
+};
+
+// results of getStats, field names are the keys seen by js
+struct LatencyStats {
+  int64_t count;
+  double mean;
+  int64_t p50;
+  int64_t p99;
+  int64_t p999;
+  int64_t max;
+};
+
+struct StageLatencies {
+  LatencyStats capture;
+  LatencyStats queue;
+  LatencyStats callback;
+  LatencyStats total;
+};
+
+struct LaneStats {
+  int64_t queued;
+  int64_t highWater;
+  int64_t dropped;
+  // kept beyond the storage of the lane
+  int64_t spilled;
+  int64_t capacity;
+};
+
+struct EventStats {
+  int64_t queued;
+  int64_t coalesced;
+  // events this environment did not register for or moved less than its
+  // min delta
+  int64_t filtered;
+  // dropped by the monitor for every environment
+  int64_t filteredTypes;
+  int64_t filteredUnchanged;
+  int64_t dropped;
+  int64_t yields;
+  int64_t budgetEvents;
+  int64_t budgetMicroseconds;
+  std::vector<LaneStats> lanes;
+  StageLatencies latency;
+};
+}  // namespace
+
+namespace agora {
+namespace plugin {
+
+NAPI_STRUCT(windowmonitor::CRect, left, top, right, bottom);
+NAPI_STRUCT(WindowMonitorGesture, startRect, endRect, duration, samples);
+NAPI_STRUCT(LatencyStats, count, mean, p50, p99, p999, max);
+NAPI_STRUCT(StageLatencies, capture, queue, callback, total);
+NAPI_STRUCT(LaneStats, queued, highWater, dropped, spilled, capacity);
+NAPI_STRUCT(EventStats, queued, coalesced, filtered, filteredTypes,
+            filteredUnchanged, dropped, yields, budgetEvents,
+            budgetMicroseconds, lanes, latency);
+
+template <>
+struct NodeValoranEventPacker<windowmonitor::WNDID, WindowMonitorPayload> {
+  static const int argc = 4;
+  static void Pack(napi_env &env, const WindowMonitorRecord &record,
+                   napi_value argv[]) {
+    NAPI_CALL_NORETURN(
+        env, napi_create_int32(env, (int32_t)record.key, &argv[0]));
+    NAPI_CALL_NORETURN(
+        env, napi_create_int32(env, static_cast<int32_t>(record.payload.event),
+                               &argv[1]));
+    NAPI_CALL_NORETURN(env, napi_to_value(env, record.payload.rect, &argv[2]));
+    if (record.payload.event == windowmonitor::EventType::GestureEnded) {
+      NAPI_CALL_NORETURN(env,
+                         napi_to_value(env, record.payload.gesture, &argv[3]));
+    } else {
+      NAPI_CALL_NORETURN(env, napi_get_undefined(env, &argv[3]));
+    }
+  }
+
+  // winId, event, left, top, right, bottom, timestamp, the summary of a
+  // gesture is only passed to callbacks of single events
+  static const int batch_fields = 7;
+  static void PackBatch(const WindowMonitorRecord &record, double data[]) {
+    data[0] = (double)(int32_t)record.key;
+    data[1] = (double)record.payload.event;
+    data[2] = record.payload.rect.left;
+    data[3] = record.payload.rect.top;
+    data[4] = record.payload.rect.right;
+    data[5] = record.payload.rect.bottom;
+    data[6] = (double)record.ts;
+  }
+};
+
+}  // namespace plugin
+}  // namespace agora
+
+namespace {
+// default time a drain may hold the main loop before yielding to it
+static const uint64_t kDefaultDrainBudgetUs = 2000;
+// markers of windows being dragged which may wait in the low lane
+static const size_t kDefaultMovingCapacity = 256;
+
+// Events of one environment. The monitor reports what the union of the
+// environments of a window asked for, each applies its own lead and min
+// delta when delivering.
+class WindowMonitorEvents
+    : public agora::plugin::NodeValoranEventBase<windowmonitor::WNDID,
+                                                 WindowMonitorPayload> {
+ public:
+  explicit WindowMonitorEvents(uv_loop_t *loop) : NodeValoranEventBase(loop) {}
+
+  void SetOptions(windowmonitor::WNDID winId,
+                  const WindowMonitorOptions &options) {
+    windows_[winId] = Window{options, false, windowmonitor::CRect(), false};
+  }
+
+  void RemoveOptions(windowmonitor::WNDID winId) { windows_.erase(winId); }
+
+ protected:
+  bool Accept(WindowMonitorRecord &record) override {
+    auto itr = windows_.find(record.key);
+    if (itr == windows_.end()) return true;
+
+    Window &window = itr->second;
+    WindowMonitorPayload &payload = record.payload;
+    if (!AcceptRect(window, payload)) return false;
+    // extrapolated as late as possible, to when it is delivered
+    if (payload.has_motion && window.options.lead_us)
+      windowmonitor::predictWindowRect(payload.motion, window.options.lead_us,
+                                       payload.rect);
+    return true;
+  }
+
+ private:
+  struct Window {
+    WindowMonitorOptions options;
+    // rect of the platform last delivered
+    bool reported;
+    windowmonitor::CRect rect;
+    // a Moved after Moving ends a drag
+    bool dragging;
+  };
+
+  // Like the filters of the monitor, geometry updates which moved no edge by
+  // the min delta since the rect last delivered are dropped, the end of a
+  // drag only when unchanged.
+  static bool AcceptRect(Window &window, const WindowMonitorPayload &payload) {
+    using windowmonitor::EventType;
+    const EventType event = payload.event;
+    if (event != EventType::Moving && event != EventType::Moved &&
+        event != EventType::Resized)
+      return true;
+
+    const bool settled = event == EventType::Moved && window.dragging;
+    window.dragging = event == EventType::Moving;
+    const float min_delta = window.options.filter.min_delta;
+    if (!(min_delta > 0)) return true;
+
+    if (window.reported) {
+      const windowmonitor::CRect &last = window.rect;
+      const windowmonitor::CRect &rect = payload.rect;
+      float delta = fabsf(last.left - rect.left);
+      delta = fmaxf(delta, fabsf(last.top - rect.top));
+      delta = fmaxf(delta, fabsf(last.right - rect.right));
+      delta = fmaxf(delta, fabsf(last.bottom - rect.bottom));
+      if (settled ? delta == 0 : delta < min_delta) return false;
+    }
+    window.reported = true;
+    window.rect = payload.rect;
+    return true;
+  }
+
+  // only touched on the js thread
+  std::unordered_map<windowmonitor::WNDID, Window> windows_;
+};
+
+// hooks of the window monitor are process wide, events are forwarded to every
+// environment which registered the window
+static agora::plugin::NodeValoranEventHub<windowmonitor::WNDID,
+                                          WindowMonitorPayload>
+    _window_monitor_hub;
+// serializes hooking and unhooking windows between environments
+static std::mutex _window_monitor_lock;
+// options of the environments subscribed to a window, the monitor reports
+// what any of them wants, guarded by _window_monitor_lock
+using WindowMonitorOptionsMap =
+    std::unordered_map<WindowMonitorEvents *, WindowMonitorOptions>;
+static std::unordered_map<windowmonitor::WNDID, WindowMonitorOptionsMap>
+    _window_monitor_options;
+// trace file of the running session, guarded by _trace_lock
+static std::mutex _trace_lock;
+static std::string _trace_path;
 
 static void onWindowMonitorCallback(windowmonitor::WNDID winId,
                                     windowmonitor::EventType event,
                                     windowmonitor::CRect rect) {
-  const int argc = 3;
-  _window_monitor_events.Fire(
-      winId, argc, [=](napi_env &env, napi_value argv[]) {
-        NAPI_CALL_NORETURN(env,
-                           napi_create_int32(env, (int32_t)winId, &argv[0]));
-        NAPI_CALL_NORETURN(
-            env, napi_create_int32(env, static_cast<int32_t>(event), &argv[1]));
-        // pack crect
-        NAPI_CALL_NORETURN(env, napi_create_object(env, &argv[2]));
-        NAPI_CALL_NORETURN(
-            env, napi_obj_set_property(env, argv[2], "left", rect.left));
-        NAPI_CALL_NORETURN(
-            env, napi_obj_set_property(env, argv[2], "top", rect.top));
-        NAPI_CALL_NORETURN(
-            env, napi_obj_set_property(env, argv[2], "right", rect.right));
-        NAPI_CALL_NORETURN(
-            env, napi_obj_set_property(env, argv[2], "bottom", rect.bottom));
-      });
+  using agora::plugin::kEventPriorityHigh;
+  using agora::plugin::kEventPriorityLow;
+  using agora::plugin::kEventPriorityNormal;
+
+  const uint64_t captured = windowmonitor::getEventTimestamp();
+  const uint32_t kind = 1u << event;
+  switch (event) {
+    // geometry changes only matter with the latest rect, coalesce them, the
+    // intermediate ones while dragging are the first to be shed
+    case windowmonitor::EventType::Moving: {
+      WindowMonitorPayload payload{event, rect};
+      payload.has_motion = windowmonitor::getEventMotion(payload.motion);
+      if (payload.has_motion) payload.rect = payload.motion.rect;
+      _window_monitor_hub.FireLatest(winId, payload, kEventPriorityLow,
+                                     captured, kind);
+      break;
+    }
+    case windowmonitor::EventType::Moved:
+    case windowmonitor::EventType::Resized:
+      _window_monitor_hub.FireLatest(winId, WindowMonitorPayload{event, rect},
+                                     kEventPriorityNormal, captured, kind);
+      break;
+    // the end of a drag carries its summary and is never dropped
+    case windowmonitor::EventType::GestureEnded: {
+      windowmonitor::GestureSummary summary;
+      WindowMonitorPayload payload{event, rect};
+      if (windowmonitor::getEventGesture(summary)) {
+        payload.gesture.startRect = summary.start;
+        payload.gesture.endRect = summary.end;
+        payload.gesture.duration = summary.duration / 1000.0;
+        payload.gesture.samples = summary.samples;
+      }
+      _window_monitor_hub.Fire(winId, payload, kEventPriorityHigh, captured,
+                               kind);
+      break;
+    }
+    // state changes are never dropped
+    default:
+      _window_monitor_hub.Fire(winId, WindowMonitorPayload{event, rect},
+                               kEventPriorityHigh, captured, kind);
+      break;
+  }
+}
+
+// spans of the monitor, recorded on the threads it reports on
+static void onWindowMonitorTrace(const char *name, windowmonitor::WNDID winId,
+                                 uint64_t begin, uint64_t end) {
+  agora::plugin::napi_tracer::record("monitor", name, begin, end, "winId",
+                                     (int64_t)(uintptr_t)winId);
+}
+
+// Hands the union of the options of a window to the monitor: the types any
+// environment wants with the smallest min delta, and the longest lead which
+// only turns the tracking of its drags on. Each environment applies its own
+// min delta and lead to what it receives.
+static void applyOptions(windowmonitor::WNDID winId,
+                         const WindowMonitorOptionsMap &options) {
+  WindowMonitorOptions result = {windowmonitor::EventFilter(0, 0), 0};
+  bool first = true;
+  for (auto &item : options) {
+    const WindowMonitorOptions &option = item.second;
+    result.filter.types |= option.filter.types;
+    if (first || option.filter.min_delta < result.filter.min_delta)
+      result.filter.min_delta = option.filter.min_delta;
+    if (option.lead_us > result.lead_us) result.lead_us = option.lead_us;
+    first = false;
+  }
+  windowmonitor::setWindowMonitorFilter(winId, result.filter);
+  windowmonitor::setWindowMonitorPrediction(winId, result.lead_us);
+}
+
+static LatencyStats toLatencyStats(
+    const agora::plugin::latency_histogram &histogram) {
+  return LatencyStats{(int64_t)histogram.count(),
+                      histogram.mean(),
+                      (int64_t)histogram.percentile(50),
+                      (int64_t)histogram.percentile(99),
+                      (int64_t)histogram.percentile(99.9),
+                      (int64_t)histogram.max()};
 }
+
+// State of the plugin owned by one node environment, created by init and
+// deleted with the environment.
+class PluginInstance {
+ public:
+  explicit PluginInstance(napi_env env)
+      : env_(env), detached_(false), filter_base_() {
+    uv_loop_t *loop = nullptr;
+    NAPI_CALL_NORETURN(env, napi_get_uv_event_loop(env, &loop));
+    events_.reset(new WindowMonitorEvents(loop));
+
+    events_->SetDrainBudget(0, kDefaultDrainBudgetUs);
+    events_->SetLane(agora::plugin::kEventPriorityLow, kDefaultMovingCapacity,
+                     agora::plugin::async_drop_policy::drop_newest);
+
+    // unhook before the env is gone, instance data is deleted after the
+    // cleanup hooks of the addon have run
+    NAPI_CALL_NORETURN(env, napi_add_env_cleanup_hook(env, Cleanup, this));
+  }
+
+  ~PluginInstance() {
+    if (!detached_) {
+      napi_remove_env_cleanup_hook(env_, Cleanup, this);
+      Detach();
+    }
+  }
+
+  // The monitor drops what no environment wants, the hub what this one
+  // does not want of the rest.
+  int Register(windowmonitor::WNDID winId,
+               const WindowMonitorOptions &options) {
+    std::lock_guard<std::mutex> guard(_window_monitor_lock);
+    if (_window_monitor_hub.Subscribed(winId, events_.get()))
+      return windowmonitor::ErrorCode::AlreadyExist;
+
+    auto &subscribed = _window_monitor_options[winId];
+    subscribed[events_.get()] = options;
+    if (!_window_monitor_hub.Subscribe(winId, events_.get(),
+                                       options.filter.types)) {
+      applyOptions(winId, subscribed);
+      events_->SetOptions(winId, options);
+      return windowmonitor::ErrorCode::Success;
+    }
+
+    int code = windowmonitor::registerWindowMonitorFilteredCallback(
+        winId, onWindowMonitorCallback, options.filter);
+    if (code != windowmonitor::ErrorCode::Success) {
+      _window_monitor_hub.Unsubscribe(winId, events_.get());
+      _window_monitor_options.erase(winId);
+      return code;
+    }
+    if (options.lead_us)
+      windowmonitor::setWindowMonitorPrediction(winId, options.lead_us);
+    events_->SetOptions(winId, options);
+    return code;
+  }
+
+  void Unregister(windowmonitor::WNDID winId) {
+    std::lock_guard<std::mutex> guard(_window_monitor_lock);
+    if (_window_monitor_hub.Unsubscribe(winId, events_.get()))
+      windowmonitor::unregisterWindowMonitorCallback(winId);
+    RemoveOptions(winId);
+    events_->RemoveEvent(winId);
+    events_->RemoveOptions(winId);
+  }
+
+  WindowMonitorEvents &events() { return *events_; }
+
+  // Counters of the monitor filters since this environment last reset its
+  // stats, the monitor counts for the whole process.
+  windowmonitor::EventFilterStats filter_stats() const {
+    windowmonitor::EventFilterStats stats;
+    windowmonitor::getEventFilterStats(stats);
+    stats.types -= filter_base_.types;
+    stats.unchanged -= filter_base_.unchanged;
+    return stats;
+  }
+
+  void ResetStats() {
+    events_->ResetStats();
+    windowmonitor::getEventFilterStats(filter_base_);
+  }
+
+ private:
+  static void Cleanup(void *arg) {
+    reinterpret_cast<PluginInstance *>(arg)->Detach();
+  }
+
+  void Detach() {
+    detached_ = true;
+
+    std::lock_guard<std::mutex> guard(_window_monitor_lock);
+    for (auto winId : _window_monitor_hub.UnsubscribeAll(events_.get()))
+      windowmonitor::unregisterWindowMonitorCallback(winId);
+
+    std::vector<windowmonitor::WNDID> windows;
+    for (auto &item : _window_monitor_options) windows.push_back(item.first);
+    for (auto winId : windows) RemoveOptions(winId);
+  }
+
+  // with _window_monitor_lock, narrows the options of the monitor to what
+  // the environments left want
+  void RemoveOptions(windowmonitor::WNDID winId) {
+    auto itr = _window_monitor_options.find(winId);
+    if (itr == _window_monitor_options.end() ||
+        itr->second.erase(events_.get()) == 0)
+      return;
+
+    if (itr->second.empty()) {
+      _window_monitor_options.erase(itr);
+      return;
+    }
+    applyOptions(winId, itr->second);
+  }
+
+  napi_env env_;
+  bool detached_;
+  std::unique_ptr<WindowMonitorEvents> events_;
+  windowmonitor::EventFilterStats filter_base_;
+};
+
 }  // namespace
 
 namespace agora {
@@ -61,16 +456,49 @@ napi_value checkAccessPrivilege(napi_env env, napi_callback_info info) {
   return result;
 }
 
+// Options of registerWindowMonitor, { events: mask of 1 << event type,
+// minDelta: pixels, predictMs: milliseconds }, a missing option filters and
+// predicts nothing.
+static WindowMonitorOptions toWindowMonitorOptions(napi_env env,
+                                                   napi_value object) {
+  WindowMonitorOptions options = {windowmonitor::EventFilter(), 0};
+  napi_valuetype type = napi_undefined;
+  if (!object || napi_typeof(env, object, &type) != napi_ok ||
+      type != napi_object)
+    return options;
+
+  bool has = false;
+  napi_has_named_property(env, object, "events", &has);
+  if (has) napi_obj_get_property(env, object, "events", options.filter.types);
+
+  napi_value value;
+  double min_delta = 0;
+  if (napi_get_named_property(env, object, "minDelta", &value) == napi_ok &&
+      napi_get_value_double(env, value, &min_delta) == napi_ok &&
+      min_delta > 0)
+    options.filter.min_delta = (float)min_delta;
+
+  double predict_ms = 0;
+  if (napi_get_named_property(env, object, "predictMs", &value) == napi_ok &&
+      napi_get_value_double(env, value, &predict_ms) == napi_ok &&
+      predict_ms > 0)
+    options.lead_us = (uint32_t)(predict_ms * 1000);
+  return options;
+}
+
 napi_value registerWindowMonitor(napi_env env, napi_callback_info info) {
-  size_t argc = 2;
-  napi_value args[2];
+  size_t argc = 3;
+  napi_value args[3] = {nullptr, nullptr, nullptr};
   NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
 
   int winId;
   NAPI_CALL(env, napi_get_value_int32(env, args[0], &winId));
 
-  int code = windowmonitor::registerWindowMonitorCallback(
-      (windowmonitor::WNDID)winId, onWindowMonitorCallback);
+  PluginInstance *instance = napi_get_instance<PluginInstance>(env);
+  if (!instance) return nullptr;
+
+  int code = instance->Register((windowmonitor::WNDID)winId,
+                                toWindowMonitorOptions(env, args[2]));
 
   napi_value result;
   NAPI_CALL(env, napi_create_int32(env, code, &result));
@@ -80,13 +508,42 @@ napi_value registerWindowMonitor(napi_env env, napi_callback_info info) {
     napi_value global;
     NAPI_CALL(env, napi_get_global(env, &global));
 
-    _window_monitor_events.AddEvent((windowmonitor::WNDID)winId, env, cb,
+    instance->events().AddEvent((windowmonitor::WNDID)winId, env, cb,
                                     global);
   }
 
   return result;
 }
 
+napi_value registerWindowMonitorBatch(napi_env env, napi_callback_info info) {
+  size_t argc = 3;
+  napi_value args[3] = {nullptr, nullptr, nullptr};
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+  int winId;
+  NAPI_CALL(env, napi_get_value_int32(env, args[0], &winId));
+
+  PluginInstance *instance = napi_get_instance<PluginInstance>(env);
+  if (!instance) return nullptr;
+
+  int code = instance->Register((windowmonitor::WNDID)winId,
+                                toWindowMonitorOptions(env, args[2]));
+
+  napi_value result;
+  NAPI_CALL(env, napi_create_int32(env, code, &result));
+  if (code == windowmonitor::ErrorCode::Success) {
+    napi_value cb = args[1];
+
+    napi_value global;
+    NAPI_CALL(env, napi_get_global(env, &global));
+
+    instance->events().AddBatchEvent((windowmonitor::WNDID)winId, env, cb,
+                                         global);
+  }
+
+  return result;
+}
+
 napi_value unregisterWindowMonitor(napi_env env, napi_callback_info info) {
   size_t argc = 1;
   napi_value args[1];
@@ -95,9 +552,10 @@ napi_value unregisterWindowMonitor(napi_env env, napi_callback_info info) {
   int winId;
   NAPI_CALL(env, napi_get_value_int32(env, args[0], &winId));
 
-  windowmonitor::unregisterWindowMonitorCallback((windowmonitor::WNDID)winId);
+  PluginInstance *instance = napi_get_instance<PluginInstance>(env);
+  if (!instance) return nullptr;
 
-  _window_monitor_events.RemoveEvent((windowmonitor::WNDID)winId);
+  instance->Unregister((windowmonitor::WNDID)winId);
 
   return napi_value();
 }
@@ -114,17 +572,254 @@ napi_value getWindowRect(napi_env env, napi_callback_info info) {
   windowmonitor::getWindowRect((windowmonitor::WNDID)winId, rect);
 
   napi_value result;
-  packageRect(env, result, rect);
+  NAPI_CALL(env, napi_to_value(env, rect, &result));
+  return result;
+}
+
+// Counters and latencies in microseconds of the events delivered to this
+// environment since it loaded the plugin or since resetStats, reading them
+// takes no lock which producers of events take.
+napi_value getStats(napi_env env, napi_callback_info info) {
+  PluginInstance *instance = napi_get_instance<PluginInstance>(env);
+  if (!instance) return nullptr;
+  WindowMonitorEvents &events = instance->events();
+
+  EventStats stats;
+  stats.queued = (int64_t)events.queued();
+  stats.coalesced = (int64_t)events.coalesced();
+  stats.filtered = (int64_t)events.filtered();
+  windowmonitor::EventFilterStats filter_stats = instance->filter_stats();
+  stats.filteredTypes = (int64_t)filter_stats.types;
+  stats.filteredUnchanged = (int64_t)filter_stats.unchanged;
+  stats.dropped = (int64_t)events.dropped();
+  stats.yields = (int64_t)events.yields();
+  stats.budgetEvents = (int64_t)events.drain_budget_events();
+  stats.budgetMicroseconds = (int64_t)events.drain_budget_us();
+  for (uint32_t i = 0; i < kEventPriorityCount; i++) {
+    auto priority = (NodeValoranEventPriority)i;
+    stats.lanes.push_back(
+        LaneStats{(int64_t)events.lane_queued(priority),
+                  (int64_t)events.lane_high_water(priority),
+                  (int64_t)events.lane_dropped(priority),
+                  (int64_t)events.lane_spilled(priority),
+                  (int64_t)events.lane_capacity(priority)});
+  }
+  stats.latency.capture =
+      toLatencyStats(events.latency(kEventStageCapture));
+  stats.latency.queue = toLatencyStats(events.latency(kEventStageQueue));
+  stats.latency.callback =
+      toLatencyStats(events.latency(kEventStageCallback));
+  stats.latency.total = toLatencyStats(events.latency(kEventStageTotal));
+
+  napi_value result;
+  NAPI_CALL(env, napi_to_value(env, stats, &result));
+  return result;
+}
+
+napi_value resetStats(napi_env env, napi_callback_info info) {
+  PluginInstance *instance = napi_get_instance<PluginInstance>(env);
+  if (!instance) return nullptr;
+  instance->ResetStats();
+
+  return napi_value();
+}
+
+// startTracing(path), records the native pipeline of every environment until
+// stopTracing writes it to path, returns false when tracing already.
+napi_value startTracing(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+  std::string path;
+  NAPI_CALL(env, napi_get_value_utf8string(env, args[0], path));
+
+  bool started = false;
+  {
+    std::lock_guard<std::mutex> guard(_trace_lock);
+    started = !path.empty() && napi_tracer::start();
+    if (started) {
+      _trace_path = path;
+      napi_tracer::set_thread_name("js");
+      windowmonitor::setTraceCallback(onWindowMonitorTrace);
+    }
+  }
+
+  napi_value result;
+  NAPI_CALL(env, napi_get_boolean(env, started, &result));
+  return result;
+}
+
+// stopTracing(), returns the count of trace events written or -1.
+napi_value stopTracing(napi_env env, napi_callback_info info) {
+  int64_t written = -1;
+  {
+    std::lock_guard<std::mutex> guard(_trace_lock);
+    windowmonitor::setTraceCallback(nullptr);
+    if (!_trace_path.empty()) written = napi_tracer::stop(_trace_path.c_str());
+    _trace_path.clear();
+  }
+
+  napi_value result;
+  NAPI_CALL(env, napi_create_int64(env, written, &result));
+  return result;
+}
+
+// startWindowMonitorRecording(path), writes the raw events of the monitor to
+// an event trace at path, returns false when recording already.
+napi_value startWindowMonitorRecording(napi_env env,
+                                       napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+  std::string path;
+  NAPI_CALL(env, napi_get_value_utf8string(env, args[0], path));
+
+  napi_value result;
+  NAPI_CALL(env, napi_get_boolean(
+                     env, !path.empty() &&
+                              windowmonitor::startEventRecording(path.c_str()),
+                     &result));
+  return result;
+}
+
+// stopWindowMonitorRecording(), returns the count of events recorded or -1.
+napi_value stopWindowMonitorRecording(napi_env env,
+                                      napi_callback_info info) {
+  napi_value result;
+  NAPI_CALL(env, napi_create_int64(env, windowmonitor::stopEventRecording(),
+                                   &result));
+  return result;
+}
+
+struct ReplayWork {
+  napi_async_work work;
+  napi_deferred deferred;
+  std::string path;
+  double speed;
+  int64_t replayed;
+};
+
+// replayWindowMonitorTrace(path, speed = 1), reports the events of a trace
+// to the registered windows from a thread of the pool, resolves with the
+// count of events replayed once all of them were reported.
+napi_value replayWindowMonitorTrace(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[2];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+  std::unique_ptr<ReplayWork> replay(new ReplayWork());
+  NAPI_CALL(env, napi_get_value_utf8string(env, args[0], replay->path));
+  napi_valuetype type = napi_undefined;
+  if (argc > 1) NAPI_CALL(env, napi_typeof(env, args[1], &type));
+  replay->speed = 1;
+  if (type != napi_undefined)
+    NAPI_CALL(env, napi_get_value_double(env, args[1], &replay->speed));
+
+  napi_value promise;
+  NAPI_CALL(env, napi_create_promise(env, &replay->deferred, &promise));
+
+  napi_value name;
+  NAPI_CALL(env, napi_create_string_utf8(env, "replayWindowMonitorTrace",
+                                         NAPI_AUTO_LENGTH, &name));
+  NAPI_CALL(env,
+            napi_create_async_work(
+                env, nullptr, name,
+                [](napi_env env, void *data) {
+                  auto replay = reinterpret_cast<ReplayWork *>(data);
+                  replay->replayed = windowmonitor::replayEventTrace(
+                      replay->path.c_str(), replay->speed);
+                },
+                [](napi_env env, napi_status status, void *data) {
+                  std::unique_ptr<ReplayWork> replay(
+                      reinterpret_cast<ReplayWork *>(data));
+                  napi_delete_async_work(env, replay->work);
+
+                  napi_value value;
+                  if (status == napi_ok && replay->replayed >= 0) {
+                    napi_create_int64(env, replay->replayed, &value);
+                    napi_resolve_deferred(env, replay->deferred, value);
+                    return;
+                  }
+                  napi_value message;
+                  napi_create_string_utf8(
+                      env, ("not an event trace: " + replay->path).c_str(),
+                      NAPI_AUTO_LENGTH, &message);
+                  napi_create_error(env, nullptr, message, &value);
+                  napi_reject_deferred(env, replay->deferred, value);
+                },
+                replay.get(), &replay->work));
+  NAPI_CALL(env, napi_queue_async_work(env, replay->work));
+  replay.release();
+
+  return promise;
+}
+
+napi_value setWindowMonitorDrainBudget(napi_env env,
+                                       napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[2];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+  uint32_t maxEvents, maxMicroseconds;
+  NAPI_CALL(env, napi_get_value_uint32(env, args[0], &maxEvents));
+  NAPI_CALL(env, napi_get_value_uint32(env, args[1], &maxMicroseconds));
+
+  PluginInstance *instance = napi_get_instance<PluginInstance>(env);
+  if (!instance) return nullptr;
+  instance->events().SetDrainBudget(maxEvents, maxMicroseconds);
+
+  return napi_value();
+}
+
+// setWindowMonitorFrameRate(rate), paces the geometry updates of every window
+// to rate frames per second, 'display' paces at the refresh rate of the
+// display and 0 reports every event again. Returns the rate paced at.
+napi_value setWindowMonitorFrameRate(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+  napi_valuetype type;
+  NAPI_CALL(env, napi_typeof(env, args[0], &type));
+  double rate = -1;
+  if (type != napi_string) {
+    NAPI_CALL(env, napi_get_value_double(env, args[0], &rate));
+    if (!(rate > 0)) rate = 0;
+  }
+
+  napi_value result;
+  NAPI_CALL(env, napi_create_double(env, windowmonitor::setFrameRate(rate),
+                                    &result));
   return result;
 }
 
 napi_value init(napi_env env, napi_value exports) {
+  if (!napi_get_instance<PluginInstance>(env)) return nullptr;
+
   NAPI_DEFINE_FUNC(env, exports, checkAccessPrivilege, "checkAccessPrivilege");
   NAPI_DEFINE_FUNC(env, exports, registerWindowMonitor,
                    "registerWindowMonitor");
+  NAPI_DEFINE_FUNC(env, exports, registerWindowMonitorBatch,
+                   "registerWindowMonitorBatch");
   NAPI_DEFINE_FUNC(env, exports, unregisterWindowMonitor,
                    "unregisterWindowMonitor");
   NAPI_DEFINE_FUNC(env, exports, getWindowRect, "getWindowRect");
+  NAPI_DEFINE_FUNC(env, exports, setWindowMonitorDrainBudget,
+                   "setWindowMonitorDrainBudget");
+  NAPI_DEFINE_FUNC(env, exports, setWindowMonitorFrameRate,
+                   "setWindowMonitorFrameRate");
+  NAPI_DEFINE_FUNC(env, exports, getStats, "getStats");
+  NAPI_DEFINE_FUNC(env, exports, resetStats, "resetStats");
+  NAPI_DEFINE_FUNC(env, exports, startTracing, "startTracing");
+  NAPI_DEFINE_FUNC(env, exports, stopTracing, "stopTracing");
+  NAPI_DEFINE_FUNC(env, exports, startWindowMonitorRecording,
+                   "startWindowMonitorRecording");
+  NAPI_DEFINE_FUNC(env, exports, stopWindowMonitorRecording,
+                   "stopWindowMonitorRecording");
+  NAPI_DEFINE_FUNC(env, exports, replayWindowMonitorTrace,
+                   "replayWindowMonitorTrace");
 
   return exports;
 }
@@ -2,6 +2,8 @@
 #define AGORA_PLUGIN_H_
 
 #include "napi_event.h"
+#include "napi_struct.h"
+#include "napi_trace.h"
 #include "napi_utils.h"
 
 #endif // AGORA_PLUGIN_H_
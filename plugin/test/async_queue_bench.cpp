@@ -0,0 +1,131 @@
+// Compare async_queue storage policies: the lock-free mpsc_ring against the
+// former mutex + std::queue, with 1, 4 and 16 producer threads pushing bursts
+// of tasks into one uv loop, like hook threads do while a window is dragged.
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "napi_async.h"
+
+using namespace agora::plugin;
+
+namespace {
+
+const uint64_t kBurstSize = 256;
+const size_t kBacklogLimit = 512;
+
+struct BenchResult {
+  double seconds;
+  double producer_ns;  // average time spent in async_call
+  uint64_t executed;
+  uint64_t dropped;
+};
+
+template <typename Storage>
+BenchResult runBench(int producers, uint64_t per_producer, size_t capacity) {
+  using queue_type = async_queue<task_type, int, Storage>;
+
+  uv_loop_t loop;
+  uv_loop_init(&loop);
+
+  std::atomic<uint64_t> executed(0);
+  queue_type* queue =
+      new queue_type(&loop, [](task_type& task) { task(); });
+  queue->set_capacity(capacity);
+
+  const uint64_t total = per_producer * producers;
+
+  uv_async_t stop;
+  uv_async_init(&loop, &stop, [](uv_async_t* handle) { uv_stop(handle->loop); });
+
+  auto begin = std::chrono::steady_clock::now();
+
+  std::atomic<uint64_t> producer_ns(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < producers; i++) {
+    threads.emplace_back([queue, per_producer, &executed, &producer_ns] {
+      uint64_t elapsed = 0;
+      for (uint64_t n = 0; n < per_producer;) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t b = 0; b < kBurstSize && n < per_producer; b++, n++) {
+          queue->async_call([&executed] {
+            executed.fetch_add(1, std::memory_order_relaxed);
+          });
+        }
+        elapsed += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+        // give the consumer a chance between bursts
+        while (queue->size() > kBacklogLimit) std::this_thread::yield();
+      }
+      producer_ns.fetch_add(elapsed);
+    });
+  }
+
+  std::thread watcher([&] {
+    for (auto& t : threads) t.join();
+    while (executed.load() + queue->dropped() < total) {
+      std::this_thread::yield();
+    }
+    uv_async_send(&stop);
+  });
+
+  uv_run(&loop, UV_RUN_DEFAULT);
+  watcher.join();
+
+  auto end = std::chrono::steady_clock::now();
+
+  BenchResult result;
+  result.seconds = std::chrono::duration<double>(end - begin).count();
+  result.producer_ns = (double)producer_ns.load() / total;
+  result.executed = executed.load();
+  result.dropped = queue->dropped();
+
+  delete queue;
+  uv_close((uv_handle_t*)&stop, nullptr);
+  uv_run(&loop, UV_RUN_DEFAULT);
+  uv_loop_close(&loop);
+
+  return result;
+}
+
+void printResult(const char* name, int producers, const BenchResult& r) {
+  uint64_t total = r.executed + r.dropped;
+  printf(
+      "%-8s producers: %2d  events: %9llu  dropped: %7llu  %8.2f Mops/s  "
+      "%8.1f ns/call\r\n",
+      name, producers, (unsigned long long)total,
+      (unsigned long long)r.dropped, total / r.seconds / 1e6, r.producer_ns);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+  const uint64_t total = quick ? 200000 : 4000000;
+  // same capacity for both policies so they drop with the same rules
+  const size_t capacity = mpsc_ring<task_type>::max_size() - 1;
+
+  const int producers[] = {1, 4, 16};
+  for (int p : producers) {
+    BenchResult mutex_result =
+        runBench<locked_queue<task_type>>(p, total / p, capacity);
+    BenchResult ring_result =
+        runBench<mpsc_ring<task_type>>(p, total / p, capacity);
+
+    printResult("mutex", p, mutex_result);
+    printResult("ring", p, ring_result);
+
+    if (mutex_result.executed + mutex_result.dropped != total / p * p ||
+        ring_result.executed + ring_result.dropped != total / p * p) {
+      printf("lost events with %d producers\r\n", p);
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,307 @@
+// Check that the drain budget of async_queue keeps a producer which never
+// lets the queue run empty from delaying the other handles of the loop, and
+// that priority lanes drop by their own policies, or nothing without a
+// capacity, and drain high lanes first up to their quota, that
+// node_async_call runs every task posted to it and that readers of an
+// epoch_snapshot only see whole copies while writers replace them.
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "napi_async.h"
+
+using namespace agora::plugin;
+
+#define EXPECT(cond)                                                   \
+  do {                                                                 \
+    if (!(cond)) {                                                     \
+      printf("%s:%d expect failed: %s\r\n", __FILE__, __LINE__, #cond); \
+      return false;                                                    \
+    }                                                                  \
+  } while (0)
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+const uint64_t kTimerDelayMs = 20;
+
+struct TimerContext {
+  clock_type::time_point armed;
+  int64_t lateness_us;
+};
+
+// Returns how late a timer armed next to a flooded queue has fired.
+int64_t measureTimerLateness(size_t max_elements, uint64_t max_us,
+                             uint64_t& yields) {
+  uv_loop_t loop;
+  uv_loop_init(&loop);
+
+  async_queue<task_type>* queue = nullptr;
+  queue = new async_queue<task_type>(&loop, [&queue](task_type& task) {
+    auto until = clock_type::now() + std::chrono::microseconds(2);
+    while (clock_type::now() < until) {
+    }
+    // the producer refills the queue as fast as it is drained, without a
+    // budget the drain would never return
+    queue->async_call([] {});
+  });
+  queue->set_budget(max_elements, max_us);
+  for (int i = 0; i < 64; i++) queue->async_call([] {});
+
+  TimerContext context;
+  uv_timer_t timer;
+  uv_timer_init(&loop, &timer);
+  timer.data = &context;
+  context.armed = clock_type::now();
+  uv_timer_start(
+      &timer,
+      [](uv_timer_t* handle) {
+        auto context = reinterpret_cast<TimerContext*>(handle->data);
+        context->lateness_us =
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                clock_type::now() - context->armed)
+                .count() -
+            kTimerDelayMs * 1000;
+        uv_stop(handle->loop);
+      },
+      kTimerDelayMs, 0);
+
+  uv_run(&loop, UV_RUN_DEFAULT);
+
+  yields = queue->yields();
+
+  delete queue;
+  uv_close((uv_handle_t*)&timer, nullptr);
+  uv_run(&loop, UV_RUN_DEFAULT);
+  uv_loop_close(&loop);
+
+  return context.lateness_us;
+}
+
+bool testTimeBudget() {
+  const uint64_t budget_us = 1000;
+  uint64_t yields = 0;
+  int64_t lateness = measureTimerLateness(0, budget_us, yields);
+  printf("time budget %llu us: timer late %lld us, yields %llu\r\n",
+         (unsigned long long)budget_us, (long long)lateness,
+         (unsigned long long)yields);
+
+  EXPECT(yields > 0);
+  // leave room for a scheduler tick on loaded machines
+  EXPECT(lateness < (int64_t)budget_us + 15000);
+  return true;
+}
+
+bool testElementBudget() {
+  uv_loop_t loop;
+  uv_loop_init(&loop);
+
+  int executed = 0;
+  auto queue = new async_queue<task_type>(&loop, [](task_type& task) { task(); });
+  queue->set_budget(10, 0);
+  for (int i = 0; i < 95; i++) queue->async_call([&executed] { executed++; });
+
+  uv_run(&loop, UV_RUN_NOWAIT);
+  EXPECT(executed == 10);
+  EXPECT(queue->yields() == 1);
+
+  while (executed < 95) uv_run(&loop, UV_RUN_NOWAIT);
+  EXPECT(queue->yields() == 9);
+
+  delete queue;
+  uv_run(&loop, UV_RUN_DEFAULT);
+  uv_loop_close(&loop);
+  return true;
+}
+
+bool testLanes() {
+  uv_loop_t loop;
+  uv_loop_init(&loop);
+
+  std::vector<int> executed;
+  auto queue = new async_queue<task_type>(
+      &loop, [](task_type& task) { task(); }, 3);
+  // more than the ring holds, none of them may be dropped
+  const int kHigh = (int)mpsc_ring<task_type>::max_size() + 100;
+  queue->set_lane(0, 4, async_drop_policy::never_drop);
+  queue->set_lane(1, 4, async_drop_policy::drop_oldest);
+  queue->set_lane(2, 4, async_drop_policy::drop_newest);
+
+  for (int i = 0; i < 10; i++) {
+    queue->async_call([&executed, i] { executed.push_back(200 + i); }, 0, 2);
+    queue->async_call([&executed, i] { executed.push_back(100 + i); }, 0, 1);
+  }
+  for (int i = 0; i < kHigh; i++) {
+    queue->async_call([&executed, i] { executed.push_back(i); }, 0, 0);
+  }
+  EXPECT(queue->lane_size(0) == (size_t)kHigh);
+  EXPECT(queue->lane_dropped(0) == 0);
+  EXPECT(queue->lane_spilled(0) == 100);
+  // drop_oldest keeps the latest capacity + 1 elements like set_capacity did
+  EXPECT(queue->lane_dropped(1) == 5);
+  EXPECT(queue->lane_dropped(2) == 6);
+  EXPECT(queue->dropped() == 11);
+
+  uv_run(&loop, UV_RUN_NOWAIT);
+  EXPECT(executed.size() == (size_t)kHigh + 9);
+  for (int i = 0; i < kHigh; i++) EXPECT(executed[i] == i);
+  for (int i = 0; i < 5; i++) EXPECT(executed[kHigh + i] == 105 + i);
+  for (int i = 0; i < 4; i++) EXPECT(executed[kHigh + 5 + i] == 200 + i);
+  EXPECT(queue->empty());
+
+  delete queue;
+  uv_run(&loop, UV_RUN_DEFAULT);
+  uv_loop_close(&loop);
+  return true;
+}
+
+bool testNoCapacity() {
+  uv_loop_t loop;
+  uv_loop_init(&loop);
+
+  int executed = 0;
+  auto queue = new async_queue<task_type>(
+      &loop, [](task_type& task) { task(); }, 2);
+  // without a capacity the policy never applies, what the ring can not hold
+  // spills
+  queue->set_lane(0, 0, async_drop_policy::drop_oldest);
+  queue->set_lane(1, 0, async_drop_policy::drop_newest);
+  const int kCalls = (int)mpsc_ring<task_type>::max_size() + 10;
+  for (int i = 0; i < kCalls; i++) {
+    EXPECT(queue->async_call([&executed] { executed++; }, 0, 0) == 0);
+    EXPECT(queue->async_call([&executed] { executed++; }, 0, 1) == 0);
+  }
+  EXPECT(queue->dropped() == 0);
+  EXPECT(queue->lane_spilled(0) == 10 && queue->lane_spilled(1) == 10);
+
+  uv_run(&loop, UV_RUN_NOWAIT);
+  EXPECT(executed == kCalls * 2);
+
+  delete queue;
+  uv_run(&loop, UV_RUN_DEFAULT);
+  uv_loop_close(&loop);
+  return true;
+}
+
+bool testLaneQuotas() {
+  uv_loop_t loop;
+  uv_loop_init(&loop);
+
+  std::vector<int> executed;
+  auto queue = new async_queue<task_type>(
+      &loop, [](task_type& task) { task(); }, 3);
+  queue->set_lane(0, 0, async_drop_policy::never_drop);
+  queue->set_lane_quota(0, 2);
+  queue->set_lane_quota(1, 1);
+
+  for (int i = 0; i < 6; i++) {
+    queue->async_call([&executed, i] { executed.push_back(i); }, 0, 0);
+  }
+  for (int i = 0; i < 3; i++) {
+    queue->async_call([&executed, i] { executed.push_back(100 + i); }, 0, 1);
+    queue->async_call([&executed, i] { executed.push_back(200 + i); }, 0, 2);
+  }
+
+  // a lane takes its quota in a row, then the next lane with elements has
+  // its turn, a lane alone is drained whatever its quota
+  const std::vector<int> expected = {0, 1,   100, 2,   3,   200,
+                                     4, 5,   101, 201, 102, 202};
+  uv_run(&loop, UV_RUN_NOWAIT);
+  EXPECT(executed == expected);
+
+  // what a lane took in a row survives the drains which yield
+  executed.clear();
+  queue->set_budget(1, 0);
+  for (int i = 0; i < 6; i++) {
+    queue->async_call([&executed, i] { executed.push_back(i); }, 0, 0);
+  }
+  queue->async_call([&executed] { executed.push_back(200); }, 0, 2);
+  for (int i = 0; i < 3; i++) uv_run(&loop, UV_RUN_NOWAIT);
+  EXPECT(executed.size() == 3 && executed[2] == 200);
+  while (!queue->empty()) uv_run(&loop, UV_RUN_NOWAIT);
+  EXPECT(executed.size() == 7);
+
+  delete queue;
+  uv_run(&loop, UV_RUN_DEFAULT);
+  uv_loop_close(&loop);
+  return true;
+}
+
+bool testNodeAsyncCall() {
+  uv_loop_t loop;
+  uv_loop_init(&loop);
+
+  std::vector<int> executed;
+  auto tasks = new node_async_call(&loop);
+  // more than the ring holds, the oldest ones used to be dropped
+  const int kTasks = (int)mpsc_ring<task_type>::max_size() * 4;
+  for (int i = 0; i < kTasks; i++) {
+    tasks->async_call([&executed, i] { executed.push_back(i); });
+  }
+
+  uv_run(&loop, UV_RUN_NOWAIT);
+  EXPECT(executed.size() == (size_t)kTasks);
+  for (int i = 0; i < kTasks; i++) EXPECT(executed[i] == i);
+
+  delete tasks;
+  uv_run(&loop, UV_RUN_DEFAULT);
+  uv_loop_close(&loop);
+  return true;
+}
+
+bool testEpochSnapshot() {
+  // every element of a copy is the count of updates it went through
+  epoch_snapshot<std::vector<int>> values;
+  values.update([](std::vector<int>& items) { items.assign(64, 0); });
+  // written by the readers inside their reads, like the first update of a
+  // key fired through a hub
+  epoch_snapshot<std::vector<int>> nested;
+
+  const int kUpdates = 2000;
+  std::atomic<bool> done(false);
+  std::atomic<int> torn(0);
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; i++) {
+    readers.emplace_back([&, i] {
+      int reads = 0;
+      for (; reads < 16 || !done.load(); std::this_thread::yield()) {
+        epoch_read_scope scope;
+        const std::vector<int>& items = values.read();
+        for (int item : items) {
+          if (item != items[0]) torn.fetch_add(1);
+        }
+        if (++reads <= 16)
+          nested.update([i](std::vector<int>& items) { items.push_back(i); });
+      }
+    });
+  }
+
+  for (int i = 1; i <= kUpdates; i++) {
+    values.update([](std::vector<int>& items) {
+      for (int& item : items) item++;
+    });
+  }
+  done.store(true);
+  for (auto& reader : readers) reader.join();
+
+  EXPECT(torn.load() == 0);
+  epoch_read_scope scope;
+  EXPECT(values.read().size() == 64 && values.read()[63] == kUpdates);
+  EXPECT(nested.read().size() == 64);
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  bool ok = testElementBudget() && testTimeBudget() && testLanes() &&
+            testNoCapacity() && testLaneQuotas() && testNodeAsyncCall() &&
+            testEpochSnapshot();
+
+  printf("async queue test %s\r\n", ok ? "passed" : "failed");
+  return ok ? 0 : 1;
+}
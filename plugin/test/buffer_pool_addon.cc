@@ -0,0 +1,105 @@
+// Native side of buffer_pool_test.js, hands byte payloads to js by the
+// copying napi_obj_set_property, by a napi_buffer_pool and by a pool which
+// is forced to its copying fallback.
+#include <node_api.h>
+
+#include <string.h>
+
+#include "napi_utils.h"
+
+namespace {
+using namespace agora::plugin;
+
+enum PayloadMode { kCopy = 0, kPooled = 1, kFallback = 2 };
+
+class BufferPoolInstance {
+ public:
+  explicit BufferPoolInstance(napi_env env) : copied_bytes(0) {
+    fallback.set_external_allowed(false);
+  }
+
+  napi_buffer_pool pooled;
+  napi_buffer_pool fallback;
+  // bytes copied by napi_obj_set_property
+  uint64_t copied_bytes;
+  // producer side buffer of kCopy, like a captured frame
+  std::vector<unsigned char> frame;
+};
+
+// payload(mode, size, seed), an object with a Uint8Array data property of
+// size bytes filled with seed
+napi_value payload(napi_env env, napi_callback_info info) {
+  size_t argc = 3;
+  napi_value args[3];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+  int32_t mode, size, seed;
+  NAPI_CALL(env, napi_get_value_int32(env, args[0], &mode));
+  NAPI_CALL(env, napi_get_value_int32(env, args[1], &size));
+  NAPI_CALL(env, napi_get_value_int32(env, args[2], &seed));
+
+  BufferPoolInstance* instance = napi_get_instance<BufferPoolInstance>(env);
+  if (!instance) return nullptr;
+
+  napi_value object;
+  NAPI_CALL(env, napi_create_object(env, &object));
+  if (mode == kCopy) {
+    instance->frame.resize(size);
+    memset(instance->frame.data(), seed, size);
+    NAPI_CALL(env, napi_obj_set_property(env, object, "data",
+                                         instance->frame.data(), size));
+    instance->copied_bytes += size;
+  } else {
+    napi_buffer_pool& pool =
+        mode == kPooled ? instance->pooled : instance->fallback;
+    napi_pooled_buffer buffer = pool.acquire(size);
+    if (!buffer) return nullptr;
+    memset(buffer.data(), seed, size);
+    NAPI_CALL(env, napi_obj_set_property(env, object, "data", pool,
+                                         std::move(buffer)));
+  }
+  return object;
+}
+
+// stats(mode), copied and shared bytes and the blocks of the pool
+napi_value stats(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+  int32_t mode;
+  NAPI_CALL(env, napi_get_value_int32(env, args[0], &mode));
+
+  BufferPoolInstance* instance = napi_get_instance<BufferPoolInstance>(env);
+  if (!instance) return nullptr;
+
+  napi_buffer_pool::stats stats = {};
+  if (mode == kCopy) {
+    stats.copied_bytes = instance->copied_bytes;
+  } else {
+    stats = (mode == kPooled ? instance->pooled : instance->fallback)
+                .get_stats();
+  }
+
+  napi_value result;
+  NAPI_CALL(env, napi_create_object(env, &result));
+  napi_obj_set_property(env, result, "copiedBytes", (double)stats.copied_bytes);
+  napi_obj_set_property(env, result, "sharedBytes", (double)stats.shared_bytes);
+  napi_obj_set_property(env, result, "outstanding", (double)stats.outstanding);
+  napi_obj_set_property(env, result, "cachedBytes", (double)stats.cached_bytes);
+  napi_obj_set_property(env, result, "externalAllowed",
+                        stats.external_allowed);
+  return result;
+}
+
+napi_value init(napi_env env, napi_value exports) {
+  if (!napi_get_instance<BufferPoolInstance>(env)) return nullptr;
+
+  NAPI_DEFINE_FUNC(env, exports, payload, "payload");
+  NAPI_DEFINE_FUNC(env, exports, stats, "stats");
+
+  return exports;
+}
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, init);
+}  // namespace
@@ -0,0 +1,139 @@
+// Hand repeated 1-8MB payloads to js by copying, through a napi_buffer_pool
+// and through a pool forced to its copying fallback, report the payload and
+// copy throughput and the steady state RSS, pooled payloads must not be
+// copied and their blocks must return to the pool once collected.
+// Usage: node --expose-gc buffer_pool_test.js <buffer_pool_addon.node> [--quick]
+const assert = require('assert');
+const path = require('path');
+
+// eslint-disable-next-line import/no-dynamic-require
+const addon = require(path.resolve(process.argv[2]));
+const quick = process.argv.includes('--quick');
+
+const MB = 1024 * 1024;
+const MODES = [
+  ['copy', 0],
+  ['pooled', 1],
+  ['fallback', 2],
+];
+const ROUNDS = quick ? 160 : 2000;
+// payloads the consumer still holds, like frames waiting to be drawn
+const KEEP = 4;
+const GC_EVERY = 16;
+// above the pool cache and the payloads kept alive, well below one payload
+// per round leaking
+const RSS_GROWTH_LIMIT = 128 * MB;
+
+if (typeof global.gc !== 'function') {
+  console.error('buffer pool test needs node --expose-gc');
+  process.exit(1);
+}
+
+const nextTick = () => new Promise((resolve) => setImmediate(resolve));
+
+// let external buffer finalizers run
+const collect = async () => {
+  for (let i = 0; i < 4; i += 1) {
+    global.gc();
+    // eslint-disable-next-line no-await-in-loop
+    await nextTick();
+  }
+};
+
+const runMode = async (name, mode) => {
+  const kept = [];
+  let bytes = 0;
+  let rssBase = 0;
+  let rssMax = 0;
+  let begin = 0n;
+  let before = null;
+
+  for (let i = 0; i < ROUNDS * 2; i += 1) {
+    // first half warms up the pool and the heap
+    if (i === ROUNDS) {
+      // eslint-disable-next-line no-await-in-loop
+      await collect();
+      rssBase = process.memoryUsage().rss;
+      bytes = 0;
+      before = addon.stats(mode);
+      begin = process.hrtime.bigint();
+    }
+
+    const size = (1 + (i % 8)) * MB - (i % 3) * 4096;
+    const seed = i & 0xff;
+    const { data } = addon.payload(mode, size, seed);
+    assert(data instanceof Uint8Array, `${name} returns no Uint8Array`);
+    assert.strictEqual(data.length, size, `${name} returns another size`);
+    assert(
+      data[0] === seed && data[size >> 1] === seed && data[size - 1] === seed,
+      `${name} returns other bytes`
+    );
+    bytes += size;
+
+    kept.push(data);
+    if (kept.length > KEEP) kept.shift();
+    if (i % GC_EVERY === 0) global.gc();
+    // one payload per event, napi finalizers only run once the loop turns
+    // eslint-disable-next-line no-await-in-loop
+    await nextTick();
+    if (i >= ROUNDS) rssMax = Math.max(rssMax, process.memoryUsage().rss);
+  }
+  const seconds = Number(process.hrtime.bigint() - begin) / 1e9;
+
+  const copied = addon.stats(mode).copiedBytes - before.copiedBytes;
+  return {
+    payloadRate: bytes / seconds,
+    copyRate: copied / seconds,
+    rss: rssBase,
+    rssGrowth: rssMax - rssBase,
+  };
+};
+
+const megabytes = (bytes, digits = 0) => (bytes / MB).toFixed(digits);
+
+const report = (name, result) => {
+  console.log(
+    `${name.padEnd(8)} ` +
+      `payload ${megabytes(result.payloadRate).padStart(6)} MB/s  ` +
+      `copied ${megabytes(result.copyRate).padStart(6)} MB/s  ` +
+      `rss ${megabytes(result.rss)} MB +${megabytes(result.rssGrowth, 1)} MB  ` +
+      `cached ${megabytes(result.after.cachedBytes)} MB`
+  );
+};
+
+(async () => {
+  const results = {};
+  // eslint-disable-next-line no-restricted-syntax
+  for (const [name, mode] of MODES) {
+    // eslint-disable-next-line no-await-in-loop
+    results[name] = await runMode(name, mode);
+    // the suspended runMode would still hold its last payload
+    // eslint-disable-next-line no-await-in-loop
+    await collect();
+    results[name].after = addon.stats(mode);
+    report(name, results[name]);
+    assert(
+      results[name].rssGrowth < RSS_GROWTH_LIMIT,
+      `${name} grows rss by ${results[name].rssGrowth} bytes`
+    );
+  }
+
+  const { pooled, fallback } = results;
+  if (pooled.after.externalAllowed) {
+    assert.strictEqual(pooled.after.copiedBytes, 0, 'pooled payloads copied');
+    console.log(
+      `pooled ${(pooled.payloadRate / results.copy.payloadRate).toFixed(2)}x ` +
+        'the payload rate of copy'
+    );
+  } else {
+    console.log('runtime forbids external buffers, pooled mode copies');
+  }
+  assert.strictEqual(fallback.after.sharedBytes, 0, 'fallback shared blocks');
+  assert(fallback.after.copiedBytes > 0, 'fallback copied nothing');
+  [pooled, fallback].forEach(({ after }) => {
+    assert.strictEqual(after.outstanding, 0, 'blocks not returned to the pool');
+  });
+})().catch((error) => {
+  console.error(`buffer pool test failed: ${error.message}`);
+  process.exit(1);
+});
@@ -0,0 +1,114 @@
+// Register the windows of a drag storm on the simulated desktop in the main
+// thread without options and in a worker with a min delta and a lead, and
+// check that each environment only gets what it asked for: the main thread
+// every small step with the rects of the platform, which are whole pixels
+// there, the worker extrapolated rects and fewer of them.
+// Usage: node env_options_test.js <agora_plugin_sim.node>
+const assert = require('assert');
+const path = require('path');
+const { Worker, isMainThread, parentPort, workerData } = require(
+  'worker_threads'
+);
+
+const WINDOWS = 8;
+const MIN_DELTA = 50;
+const MOVED = 3;
+const MOVING = 4;
+const RESIZED = 5;
+
+// read by the monitor core when the first window is registered
+process.env.WINDOW_MONITOR_BACKEND = 'simulated';
+process.env.WINDOW_MONITOR_SIMULATED_WINDOWS = `${WINDOWS}`;
+process.env.WINDOW_MONITOR_SIMULATED_RATE = '20000';
+
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+const isGeometry = (event) =>
+  event === MOVED || event === MOVING || event === RESIZED;
+const isWhole = (rect) =>
+  Number.isInteger(rect.left) &&
+  Number.isInteger(rect.top) &&
+  Number.isInteger(rect.right) &&
+  Number.isInteger(rect.bottom);
+
+// registers every window with options, returns what it delivered
+const observe = (plugin, options) => {
+  const result = { geometry: 0, fractional: 0, smallSteps: 0 };
+  const last = {};
+  for (let winId = 1; winId <= WINDOWS; winId += 1) {
+    const code = plugin.registerWindowMonitor(
+      winId,
+      (id, event, rect) => {
+        if (!isGeometry(event)) return;
+        result.geometry += 1;
+        if (!isWhole(rect)) result.fractional += 1;
+        const previous = last[id];
+        if (
+          event === MOVING &&
+          previous &&
+          Math.abs(rect.left - previous.left) < MIN_DELTA &&
+          Math.abs(rect.top - previous.top) < MIN_DELTA
+        ) {
+          result.smallSteps += 1;
+        }
+        last[id] = rect;
+      },
+      options
+    );
+    assert.strictEqual(code, 0);
+  }
+  return result;
+};
+
+const unregister = (plugin) => {
+  for (let winId = 1; winId <= WINDOWS; winId += 1) {
+    plugin.unregisterWindowMonitor(winId);
+  }
+};
+
+if (!isMainThread) {
+  // eslint-disable-next-line import/no-dynamic-require
+  const plugin = require(workerData.addon);
+  const result = observe(plugin, { minDelta: MIN_DELTA, predictMs: 16 });
+  (async () => {
+    await sleep(500);
+    result.filtered = plugin.getStats().filtered;
+    unregister(plugin);
+    parentPort.postMessage(result);
+  })();
+} else {
+  const addon = path.resolve(process.argv[2]);
+  // eslint-disable-next-line import/no-dynamic-require
+  const plugin = require(addon);
+
+  (async () => {
+    const main = observe(plugin, undefined);
+    const worker = await new Promise((resolve, reject) => {
+      const thread = new Worker(__filename, {
+        argv: process.argv.slice(2),
+        workerData: { addon },
+      });
+      thread.once('message', resolve);
+      thread.once('error', reject);
+    });
+    const filtered = plugin.getStats().filtered;
+    unregister(plugin);
+
+    console.log(
+      `main thread got ${main.geometry} rects, ${main.smallSteps} steps ` +
+        `below ${MIN_DELTA} pixels, worker got ${worker.geometry} rects, ` +
+        `${worker.fractional} extrapolated, dropped ${worker.filtered}`
+    );
+    // the lead and the min delta of the worker never reach the main thread
+    assert.strictEqual(main.fractional, 0, 'rects extrapolated without lead');
+    assert(main.smallSteps > 0, 'min delta of another environment applied');
+    assert.strictEqual(filtered, 0);
+    // while the worker gets its own
+    assert(worker.fractional > 0, 'nothing extrapolated with a lead');
+    assert(worker.filtered > 0, 'nothing dropped by the min delta');
+    assert(worker.geometry < main.geometry);
+    process.exit(0);
+  })().catch((error) => {
+    console.error(`env options test failed: ${error.message}`);
+    process.exit(1);
+  });
+}
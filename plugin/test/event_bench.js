@@ -0,0 +1,79 @@
+// Compare js crossings of the per event delivery and the batch delivery of
+// NodeValoranEventBase. Usage: node event_bench.js <event_bench_addon.node>
+const path = require('path');
+
+// eslint-disable-next-line import/no-dynamic-require
+const addon = require(path.resolve(process.argv[2]));
+const quick = process.argv.includes('--quick');
+
+const BATCH_STRIDE = 7;
+const BURST = 512;
+const EVENTS = BURST * (quick ? 100 : 2000);
+
+const nextTick = () => new Promise((resolve) => setImmediate(resolve));
+
+const run = async (batch, key) => {
+  let calls = 0;
+  let received = 0;
+  let lastLeft = -1;
+  let ordered = true;
+
+  const onEvent = (winId, event, bounds) => {
+    calls += 1;
+    received += 1;
+    if (bounds.left !== (lastLeft + 1) % BURST) ordered = false;
+    lastLeft = bounds.left;
+  };
+  const onBatch = (records) => {
+    calls += 1;
+    for (let i = 0; i < records.length; i += BATCH_STRIDE) {
+      received += 1;
+      if (records[i + 2] !== (lastLeft + 1) % BURST) ordered = false;
+      lastLeft = records[i + 2];
+    }
+  };
+
+  addon.subscribe(key, batch, batch ? onBatch : onEvent);
+
+  const begin = process.hrtime.bigint();
+  for (let fired = 0; fired < EVENTS; fired += BURST) {
+    addon.fire(key, BURST);
+    while (received < fired + BURST) {
+      // eslint-disable-next-line no-await-in-loop
+      await nextTick();
+    }
+  }
+  const seconds = Number(process.hrtime.bigint() - begin) / 1e9;
+
+  addon.unsubscribe(key);
+
+  return { calls, received, ordered, seconds };
+};
+
+const report = (name, r) => {
+  console.log(
+    `${name.padEnd(10)} events: ${r.received}  js calls: ${r.calls}  ` +
+      `${(r.received / r.seconds / 1e6).toFixed(2)} M events/s  ` +
+      `${(r.calls / r.seconds / 1e3).toFixed(1)} K calls/s`
+  );
+};
+
+(async () => {
+  const perEvent = await run(false, 1);
+  const batch = await run(true, 2);
+
+  report('per-event', perEvent);
+  report('batch', batch);
+
+  const ok =
+    perEvent.ordered &&
+    batch.ordered &&
+    perEvent.received === EVENTS &&
+    batch.received === EVENTS &&
+    batch.calls < perEvent.calls;
+  if (!ok) {
+    console.error('event bench failed');
+    process.exit(1);
+  }
+  process.exit(0);
+})();
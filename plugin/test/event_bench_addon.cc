@@ -0,0 +1,124 @@
+// Native side of event_bench.js, drives NodeValoranEventBase inside node so
+// the per event and the batch delivery can be compared with real js calls.
+#include <node_api.h>
+
+#include "napi_event.h"
+#include "napi_utils.h"
+
+namespace {
+using namespace agora::plugin;
+
+struct BenchPayload {
+  int32_t event;
+  float left;
+  float top;
+  float right;
+  float bottom;
+};
+
+using BenchRecord = NodeValoranEventRecord<int32_t, BenchPayload>;
+}  // namespace
+
+namespace agora {
+namespace plugin {
+
+template <>
+struct NodeValoranEventPacker<int32_t, BenchPayload> {
+  static const int argc = 3;
+  static void Pack(napi_env &env, const BenchRecord &record,
+                   napi_value argv[]) {
+    NAPI_CALL_NORETURN(env, napi_create_int32(env, record.key, &argv[0]));
+    NAPI_CALL_NORETURN(env,
+                       napi_create_int32(env, record.payload.event, &argv[1]));
+    NAPI_CALL_NORETURN(env, napi_create_object(env, &argv[2]));
+    NAPI_CALL_NORETURN(env, napi_obj_set_property(env, argv[2], "left",
+                                                  record.payload.left));
+    NAPI_CALL_NORETURN(
+        env, napi_obj_set_property(env, argv[2], "top", record.payload.top));
+    NAPI_CALL_NORETURN(env, napi_obj_set_property(env, argv[2], "right",
+                                                  record.payload.right));
+    NAPI_CALL_NORETURN(env, napi_obj_set_property(env, argv[2], "bottom",
+                                                  record.payload.bottom));
+  }
+
+  static const int batch_fields = 7;
+  static void PackBatch(const BenchRecord &record, double data[]) {
+    data[0] = record.key;
+    data[1] = record.payload.event;
+    data[2] = record.payload.left;
+    data[3] = record.payload.top;
+    data[4] = record.payload.right;
+    data[5] = record.payload.bottom;
+    data[6] = (double)record.ts;
+  }
+};
+
+}  // namespace plugin
+}  // namespace agora
+
+namespace {
+static NodeValoranEventBase<int32_t, BenchPayload> *_bench_events = nullptr;
+
+napi_value subscribe(napi_env env, napi_callback_info info) {
+  size_t argc = 3;
+  napi_value args[3];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+  int32_t key;
+  NAPI_CALL(env, napi_get_value_int32(env, args[0], &key));
+  bool batch;
+  NAPI_CALL(env, napi_get_value_bool(env, args[1], &batch));
+
+  napi_value global;
+  NAPI_CALL(env, napi_get_global(env, &global));
+
+  if (batch)
+    _bench_events->AddBatchEvent(key, env, args[2], global);
+  else
+    _bench_events->AddEvent(key, env, args[2], global);
+
+  return nullptr;
+}
+
+napi_value unsubscribe(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+  int32_t key;
+  NAPI_CALL(env, napi_get_value_int32(env, args[0], &key));
+  _bench_events->RemoveEvent(key);
+
+  return nullptr;
+}
+
+napi_value fire(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[2];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+  int32_t key, count;
+  NAPI_CALL(env, napi_get_value_int32(env, args[0], &key));
+  NAPI_CALL(env, napi_get_value_int32(env, args[1], &count));
+
+  for (int32_t i = 0; i < count; i++) {
+    _bench_events->Fire(key, BenchPayload{4, (float)i, 0.f, 100.f, 100.f});
+  }
+
+  return nullptr;
+}
+
+napi_value init(napi_env env, napi_value exports) {
+  uv_loop_t *loop = nullptr;
+  NAPI_CALL(env, napi_get_uv_event_loop(env, &loop));
+  _bench_events = new NodeValoranEventBase<int32_t, BenchPayload>(loop);
+
+  NAPI_DEFINE_FUNC(env, exports, subscribe, "subscribe");
+  NAPI_DEFINE_FUNC(env, exports, unsubscribe, "unsubscribe");
+  NAPI_DEFINE_FUNC(env, exports, fire, "fire");
+
+  return exports;
+}
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, init);
+}  // namespace
@@ -0,0 +1,147 @@
+// Native side of event_env_test.js, every node environment which loads it
+// gets its own NodeValoranEventBase as instance data, events are fired from a
+// native thread through a process wide NodeValoranEventHub like the window
+// monitor hooks do.
+#include <node_api.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "napi_event.h"
+#include "napi_utils.h"
+
+namespace {
+using namespace agora::plugin;
+
+struct EnvPayload {
+  int32_t value;
+};
+
+using EnvRecord = NodeValoranEventRecord<int32_t, EnvPayload>;
+}  // namespace
+
+namespace agora {
+namespace plugin {
+
+template <>
+struct NodeValoranEventPacker<int32_t, EnvPayload> {
+  static const int argc = 2;
+  static void Pack(napi_env &env, const EnvRecord &record, napi_value argv[]) {
+    NAPI_CALL_NORETURN(env, napi_create_int32(env, record.key, &argv[0]));
+    NAPI_CALL_NORETURN(env,
+                       napi_create_int32(env, record.payload.value, &argv[1]));
+  }
+
+  static const int batch_fields = 2;
+  static void PackBatch(const EnvRecord &record, double data[]) {
+    data[0] = record.key;
+    data[1] = record.payload.value;
+  }
+};
+
+}  // namespace plugin
+}  // namespace agora
+
+namespace {
+using EnvEvents = NodeValoranEventBase<int32_t, EnvPayload>;
+
+static NodeValoranEventHub<int32_t, EnvPayload> _env_hub;
+static std::atomic<int32_t> _env_instances(0);
+
+class EnvInstance {
+ public:
+  explicit EnvInstance(napi_env env) : env_(env), detached_(false) {
+    uv_loop_t *loop = nullptr;
+    napi_get_uv_event_loop(env, &loop);
+    events_.reset(new EnvEvents(loop));
+    napi_add_env_cleanup_hook(env, Cleanup, this);
+    _env_instances++;
+  }
+
+  ~EnvInstance() {
+    if (!detached_) {
+      napi_remove_env_cleanup_hook(env_, Cleanup, this);
+      Detach();
+    }
+    _env_instances--;
+  }
+
+  EnvEvents *events() { return events_.get(); }
+
+ private:
+  static void Cleanup(void *arg) {
+    reinterpret_cast<EnvInstance *>(arg)->Detach();
+  }
+
+  void Detach() {
+    detached_ = true;
+    _env_hub.UnsubscribeAll(events_.get());
+  }
+
+  napi_env env_;
+  bool detached_;
+  std::unique_ptr<EnvEvents> events_;
+};
+
+napi_value subscribe(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[2];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+  int32_t key;
+  NAPI_CALL(env, napi_get_value_int32(env, args[0], &key));
+
+  napi_value global;
+  NAPI_CALL(env, napi_get_global(env, &global));
+
+  EnvInstance *instance = napi_get_instance<EnvInstance>(env);
+  if (!instance) return nullptr;
+  instance->events()->AddEvent(key, env, args[1], global);
+  _env_hub.Subscribe(key, instance->events());
+
+  return nullptr;
+}
+
+// fire count events of key from a native thread
+napi_value fire(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[2];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+  int32_t key, count;
+  NAPI_CALL(env, napi_get_value_int32(env, args[0], &key));
+  NAPI_CALL(env, napi_get_value_int32(env, args[1], &count));
+
+  std::thread([key, count] {
+    for (int32_t i = 0; i < count; i++) _env_hub.Fire(key, EnvPayload{i});
+  }).join();
+
+  return nullptr;
+}
+
+napi_value instances(napi_env env, napi_callback_info info) {
+  napi_value result;
+  NAPI_CALL(env, napi_create_int32(env, _env_instances.load(), &result));
+  return result;
+}
+
+napi_value subscribedKeys(napi_env env, napi_callback_info info) {
+  napi_value result;
+  NAPI_CALL(env, napi_create_int32(env, (int32_t)_env_hub.size(), &result));
+  return result;
+}
+
+napi_value init(napi_env env, napi_value exports) {
+  if (!napi_get_instance<EnvInstance>(env)) return nullptr;
+
+  NAPI_DEFINE_FUNC(env, exports, subscribe, "subscribe");
+  NAPI_DEFINE_FUNC(env, exports, fire, "fire");
+  NAPI_DEFINE_FUNC(env, exports, instances, "instances");
+  NAPI_DEFINE_FUNC(env, exports, subscribedKeys, "subscribedKeys");
+
+  return exports;
+}
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, init);
+}  // namespace
@@ -0,0 +1,99 @@
+// Load the addon in the main thread and in several workers at once, every
+// environment must only receive the events of its own keys on its own thread
+// and its instance must be gone once the worker has exited.
+// Usage: node event_env_test.js <event_env_addon.node>
+const path = require('path');
+const { Worker, isMainThread, parentPort, workerData } = require(
+  'worker_threads'
+);
+
+const WORKERS = 4;
+// below the ring size, fire blocks the loop until all of them are queued
+const EVENTS = 200;
+// key subscribed by the main thread and by worker 0
+const SHARED_KEY = 1;
+
+const nextTick = () => new Promise((resolve) => setImmediate(resolve));
+
+const receive = (addon, key, expected) => {
+  const state = { received: 0, wrongKey: false };
+  addon.subscribe(key, (winId) => {
+    if (winId !== key) state.wrongKey = true;
+    state.received += 1;
+  });
+  state.done = async () => {
+    while (state.received < expected) {
+      // eslint-disable-next-line no-await-in-loop
+      await nextTick();
+    }
+    // late extra events would show up here
+    await nextTick();
+    return state.received === expected && !state.wrongKey;
+  };
+  return state;
+};
+
+if (!isMainThread) {
+  // eslint-disable-next-line import/no-dynamic-require
+  const addon = require(workerData.addon);
+  const key = workerData.index + 1;
+  // every worker fires every key once
+  const state = receive(addon, key, EVENTS * WORKERS);
+
+  parentPort.postMessage('ready');
+  parentPort.once('message', async () => {
+    for (let k = 1; k <= WORKERS; k += 1) addon.fire(k, EVENTS);
+    const ok = await state.done();
+    parentPort.postMessage(ok);
+    // the event queue keeps the loop alive, leave subscriptions to teardown
+    process.exit(0);
+  });
+} else {
+  const addonPath = path.resolve(process.argv[2]);
+  // eslint-disable-next-line import/no-dynamic-require
+  const addon = require(addonPath);
+  const shared = receive(addon, SHARED_KEY, EVENTS * WORKERS);
+
+  const fail = (message) => {
+    console.error(`event env test failed: ${message}`);
+    process.exit(1);
+  };
+
+  let ready = 0;
+  let passed = 0;
+  let exited = 0;
+  const workers = [];
+  for (let index = 0; index < WORKERS; index += 1) {
+    const worker = new Worker(__filename, {
+      workerData: { addon: addonPath, index },
+    });
+    worker.on('message', (message) => {
+      if (message === 'ready') {
+        ready += 1;
+        if (ready === WORKERS) workers.forEach((w) => w.postMessage('fire'));
+      } else if (message === true) {
+        passed += 1;
+      } else {
+        fail(`worker ${index} received wrong events`);
+      }
+    });
+    worker.on('error', (error) => fail(error.message));
+    worker.on('exit', async () => {
+      exited += 1;
+      if (exited < WORKERS) return;
+
+      if (passed !== WORKERS) fail('workers did not report');
+      if (!(await shared.done())) fail('main thread received wrong events');
+      if (addon.instances() !== 1) fail(`${addon.instances()} instances left`);
+      if (addon.subscribedKeys() !== 1) fail('worker keys are still hooked');
+
+      console.log(
+        `${WORKERS} workers and main thread received ${
+          EVENTS * WORKERS
+        } events each, instances left: ${addon.instances()}`
+      );
+      process.exit(0);
+    });
+    workers.push(worker);
+  }
+}
@@ -0,0 +1,344 @@
+// Check the order and coalescing of events fired through NodeValoranEventBase,
+// that firing and delivering them does not allocate once warmed up, that
+// the latencies of every stage are recorded and that a hub only fires the
+// kinds of events its subscribers asked for.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <vector>
+
+#include "napi_event.h"
+#include "napi_stub.h"
+
+using namespace agora::plugin;
+
+namespace {
+
+std::atomic<uint64_t> g_allocations(0);
+
+enum TestEvent { kMoving = 1, kHide = 2, kMoved = 3 };
+
+struct TestPayload {
+  int event;
+  double value;
+};
+
+struct Delivered {
+  int key;
+  int event;
+  double value;
+};
+
+std::vector<Delivered> g_delivered;
+size_t g_delivered_count = 0;
+
+void recordCall(size_t argc, const double argv[]) {
+  g_delivered_count++;
+  if (g_delivered.size() < g_delivered.capacity()) {
+    g_delivered.push_back(Delivered{(int)argv[0], (int)argv[1], argv[2]});
+  }
+}
+
+}  // namespace
+
+namespace agora {
+namespace plugin {
+
+template <>
+struct NodeValoranEventPacker<int, TestPayload> {
+  static const int argc = 3;
+  static void Pack(napi_env& env,
+                   const NodeValoranEventRecord<int, TestPayload>& record,
+                   napi_value argv[]) {
+    NAPI_CALL_NORETURN(env, napi_create_int32(env, record.key, &argv[0]));
+    NAPI_CALL_NORETURN(env,
+                       napi_create_int32(env, record.payload.event, &argv[1]));
+    NAPI_CALL_NORETURN(env,
+                       napi_create_double(env, record.payload.value, &argv[2]));
+  }
+
+  static const int batch_fields = 3;
+  static void PackBatch(const NodeValoranEventRecord<int, TestPayload>& record,
+                        double data[]) {
+    data[0] = record.key;
+    data[1] = record.payload.event;
+    data[2] = record.payload.value;
+  }
+};
+
+}  // namespace plugin
+}  // namespace agora
+
+namespace {
+
+// every form of new counts, every form of delete frees what malloc returned
+void* countedAlloc(size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+}  // namespace
+
+void* operator new(size_t size) { return countedAlloc(size); }
+
+void* operator new[](size_t size) { return countedAlloc(size); }
+
+void operator delete(void* p) noexcept { free(p); }
+
+void operator delete[](void* p) noexcept { free(p); }
+
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+#define EXPECT(cond)                                                   \
+  do {                                                                 \
+    if (!(cond)) {                                                     \
+      printf("%s:%d expect failed: %s\r\n", __FILE__, __LINE__, #cond); \
+      return false;                                                    \
+    }                                                                  \
+  } while (0)
+
+namespace {
+
+using TestEvents = NodeValoranEventBase<int, TestPayload>;
+
+void drain(uv_loop_t* loop) { uv_run(loop, UV_RUN_NOWAIT); }
+
+bool testOrder(uv_loop_t* loop) {
+  TestEvents events(loop);
+  events.AddEvent(1, (napi_env)napi_stub::FakeEnv(),
+                  (napi_value)napi_stub::FakeFunction(), nullptr);
+
+  g_delivered.clear();
+  events.FireLatest(1, TestPayload{kMoving, 1});
+  events.FireLatest(1, TestPayload{kMoving, 2});
+  events.Fire(1, TestPayload{kHide, 3});
+  events.FireLatest(1, TestPayload{kMoving, 4});
+  events.FireLatest(1, TestPayload{kMoved, 5});
+  // not registered, never delivered
+  events.Fire(2, TestPayload{kHide, 6});
+  drain(loop);
+
+  EXPECT(g_delivered.size() == 3);
+  EXPECT(g_delivered[0].event == kMoving && g_delivered[0].value == 2);
+  EXPECT(g_delivered[1].event == kHide && g_delivered[1].value == 3);
+  EXPECT(g_delivered[2].event == kMoved && g_delivered[2].value == 5);
+  EXPECT(events.coalesced() == 2);
+  EXPECT(events.queued() == 0);
+  // updates of keys which were not added are not even queued
+  events.FireLatest(2, TestPayload{kMoving, 7});
+  EXPECT(events.queued() == 0);
+
+  // rates beyond the drain rate keep one marker per key in the queue
+  for (int i = 0; i < 10000; i++) {
+    events.FireLatest(1, TestPayload{kMoving, (double)i});
+  }
+  EXPECT(events.queued() == 1);
+  drain(loop);
+  EXPECT(g_delivered.size() == 4 && g_delivered[3].value == 9999);
+
+  return true;
+}
+
+// The events of one key are delivered in the order they were fired whatever
+// their lanes, those of other keys still by priority.
+bool testCrossLaneOrder(uv_loop_t* loop) {
+  TestEvents events(loop);
+  for (int key = 1; key <= 2; key++) {
+    events.AddEvent(key, (napi_env)napi_stub::FakeEnv(),
+                    (napi_value)napi_stub::FakeFunction(), nullptr);
+  }
+
+  g_delivered.clear();
+  // an update pending in the low lane ahead of an event of the high one
+  events.Fire(2, TestPayload{kHide, 1}, kEventPriorityLow);
+  events.FireLatest(1, TestPayload{kMoving, 2}, kEventPriorityLow);
+  events.FireLatest(1, TestPayload{kMoved, 3}, kEventPriorityLow);
+  events.Fire(1, TestPayload{kHide, 4}, kEventPriorityHigh);
+  drain(loop);
+
+  EXPECT(g_delivered.size() == 3);
+  EXPECT(g_delivered[0].key == 1 && g_delivered[0].value == 3);
+  EXPECT(g_delivered[1].key == 1 && g_delivered[1].value == 4);
+  EXPECT(g_delivered[2].key == 2 && g_delivered[2].value == 1);
+  EXPECT(events.queued() == 0);
+
+  // an update and an event of the high lane after an event of the low one
+  events.Fire(1, TestPayload{kHide, 5}, kEventPriorityLow);
+  events.FireLatest(1, TestPayload{kMoving, 6}, kEventPriorityHigh);
+  events.Fire(1, TestPayload{kHide, 7}, kEventPriorityHigh);
+  events.Fire(2, TestPayload{kHide, 8}, kEventPriorityHigh);
+  drain(loop);
+
+  EXPECT(g_delivered.size() == 7);
+  EXPECT(g_delivered[3].key == 2 && g_delivered[3].value == 8);
+  EXPECT(g_delivered[4].key == 1 && g_delivered[4].value == 5);
+  EXPECT(g_delivered[5].key == 1 && g_delivered[5].value == 6);
+  EXPECT(g_delivered[6].key == 1 && g_delivered[6].value == 7);
+
+  // once delivered, the events of the key take their own lane again
+  events.Fire(1, TestPayload{kHide, 9}, kEventPriorityLow);
+  events.FireLatest(1, TestPayload{kMoving, 10}, kEventPriorityHigh);
+  EXPECT(events.lane_queued(kEventPriorityHigh) == 0);
+  drain(loop);
+  events.FireLatest(1, TestPayload{kMoving, 11}, kEventPriorityHigh);
+  EXPECT(events.lane_queued(kEventPriorityHigh) == 1);
+  drain(loop);
+  EXPECT(g_delivered.size() == 10 && g_delivered[9].value == 11);
+
+  return true;
+}
+
+bool testNoAllocation(uv_loop_t* loop) {
+  TestEvents events(loop);
+  events.AddEvent(1, (napi_env)napi_stub::FakeEnv(),
+                  (napi_value)napi_stub::FakeFunction(), nullptr);
+
+  // warm up, what the first deliveries allocate is kept
+  for (int i = 0; i < 16; i++) {
+    events.FireLatest(1, TestPayload{kMoving, (double)i});
+    events.Fire(1, TestPayload{kHide, (double)i});
+    drain(loop);
+  }
+
+  const int kEvents = 100000;
+  g_delivered_count = 0;
+  uint64_t before = g_allocations.load();
+  for (int i = 0; i < kEvents; i++) {
+    events.FireLatest(1, TestPayload{kMoving, (double)i});
+    events.Fire(1, TestPayload{kHide, (double)i});
+    if (i % 64 == 0) drain(loop);
+  }
+  drain(loop);
+  uint64_t allocations = g_allocations.load() - before;
+
+  printf("fired %d events, delivered %zu, allocations %llu\r\n", kEvents * 2,
+         g_delivered_count, (unsigned long long)allocations);
+  EXPECT(g_delivered_count >= (size_t)kEvents);
+  EXPECT(allocations == 0);
+
+  return true;
+}
+
+uint64_t nowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+bool testHistogram() {
+  latency_histogram histogram;
+  EXPECT(histogram.count() == 0 && histogram.percentile(99) == 0);
+
+  for (uint64_t i = 1; i <= 1000; i++) histogram.record(i);
+  EXPECT(histogram.count() == 1000 && histogram.max() == 1000);
+  EXPECT(histogram.mean() == 500.5);
+  // buckets are 1/16 of their power of two wide
+  EXPECT(histogram.percentile(50) >= 500 && histogram.percentile(50) < 532);
+  EXPECT(histogram.percentile(99) >= 990 && histogram.percentile(99) < 1024);
+  EXPECT(histogram.percentile(100) == 1000);
+
+  histogram.record(5);
+  histogram.record(uint64_t(1) << 40);
+  EXPECT(histogram.max() == uint64_t(1) << 40);
+
+  histogram.reset();
+  EXPECT(histogram.count() == 0 && histogram.max() == 0);
+  return true;
+}
+
+bool testLatencies(uv_loop_t* loop) {
+  TestEvents events(loop);
+  events.AddEvent(1, (napi_env)napi_stub::FakeEnv(),
+                  (napi_value)napi_stub::FakeFunction(), nullptr);
+  events.AddBatchEvent(2, (napi_env)napi_stub::FakeEnv(),
+                       (napi_value)napi_stub::FakeFunction(), nullptr);
+
+  // captured 5ms before they are fired
+  const uint64_t captured = nowUs() - 5000;
+  for (int i = 0; i < 10; i++) {
+    events.Fire(1, TestPayload{kHide, (double)i}, kEventPriorityHigh,
+                captured);
+    events.Fire(2, TestPayload{kHide, (double)i}, kEventPriorityHigh,
+                captured);
+  }
+  // fired without a capture time, it follows the undelivered events of its
+  // key in the high lane
+  events.FireLatest(1, TestPayload{kMoving, 1});
+  drain(loop);
+
+  for (int stage = 0; stage < kEventStageCount; stage++) {
+    EXPECT(events.latency((NodeValoranEventStage)stage).count() == 21);
+  }
+  const latency_histogram& capture = events.latency(kEventStageCapture);
+  EXPECT(capture.percentile(50) >= 5000 && capture.max() < 1000000);
+  const latency_histogram& total = events.latency(kEventStageTotal);
+  EXPECT(total.percentile(50) >= 5000);
+  EXPECT(events.lane_high_water(kEventPriorityHigh) == 21);
+  EXPECT(events.lane_high_water(kEventPriorityNormal) == 0);
+
+  events.ResetStats();
+  EXPECT(events.latency(kEventStageTotal).count() == 0);
+  EXPECT(events.lane_high_water(kEventPriorityHigh) == 0);
+  return true;
+}
+
+bool testHubKinds(uv_loop_t* loop) {
+  NodeValoranEventHub<int, TestPayload> hub;
+  TestEvents all(loop);
+  TestEvents hides(loop);
+  all.AddEvent(1, (napi_env)napi_stub::FakeEnv(),
+               (napi_value)napi_stub::FakeFunction(), nullptr);
+  hides.AddEvent(1, (napi_env)napi_stub::FakeEnv(),
+                 (napi_value)napi_stub::FakeFunction(), nullptr);
+  EXPECT(hub.Subscribe(1, &all));
+  EXPECT(!hub.Subscribe(1, &hides, 1u << kHide));
+
+  g_delivered.clear();
+  hub.FireLatest(1, TestPayload{kMoving, 1}, kEventPriorityLow, 0,
+                 1u << kMoving);
+  hub.Fire(1, TestPayload{kHide, 2}, kEventPriorityHigh, 0, 1u << kHide);
+  // the pending update of all is queued again ahead of the hide
+  EXPECT(all.queued() == 3 && hides.queued() == 1);
+  EXPECT(all.filtered() == 0 && hides.filtered() == 1);
+  drain(loop);
+  EXPECT(g_delivered.size() == 3);
+
+  // subscribing again changes the kinds
+  EXPECT(!hub.Subscribe(1, &hides, 1u << kMoving));
+  hub.Fire(1, TestPayload{kHide, 3}, kEventPriorityHigh, 0, 1u << kHide);
+  EXPECT(hides.queued() == 0 && hides.filtered() == 2);
+  hides.ResetStats();
+  EXPECT(hides.filtered() == 0);
+
+  EXPECT(!hub.Unsubscribe(1, &hides));
+  EXPECT(hub.Unsubscribe(1, &all));
+  drain(loop);
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  uv_loop_t loop;
+  uv_loop_init(&loop);
+
+  g_delivered.reserve(64);
+  napi_stub::SetCallHook(recordCall);
+
+  bool ok = testOrder(&loop) && testCrossLaneOrder(&loop) &&
+            testNoAllocation(&loop) && testHistogram() &&
+            testLatencies(&loop) && testHubKinds(&loop);
+
+  uv_run(&loop, UV_RUN_DEFAULT);
+  uv_loop_close(&loop);
+
+  printf("event test %s\r\n", ok ? "passed" : "failed");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+// Register windows of a drag storm on the simulated desktop with filters and
+// check that js only gets the event types it asked for and that the counters
+// report what the monitor dropped by type and by min delta. The deltas
+// themselves are checked by the core test, coalescing in the queue may
+// merge updates which passed. The moves of the second half are predicted.
+// Usage: node filter_test.js <agora_plugin_sim.node>
+const assert = require('assert');
+const path = require('path');
+
+const WINDOWS = 8;
+const MIN_DELTA = 20;
+const FOCUSED = 1;
+const UNFOCUSED = 2;
+
+// read by the monitor core when the first window is registered
+process.env.WINDOW_MONITOR_BACKEND = 'simulated';
+process.env.WINDOW_MONITOR_SIMULATED_WINDOWS = `${WINDOWS}`;
+process.env.WINDOW_MONITOR_SIMULATED_RATE = '20000';
+
+// eslint-disable-next-line import/no-dynamic-require
+const plugin = require(path.resolve(process.argv[2]));
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+(async () => {
+  const focusMask = (1 << FOCUSED) | (1 << UNFOCUSED);
+  const unexpected = [];
+  let focusEvents = 0;
+  let otherEvents = 0;
+
+  // the first half only wants focus changes, the other half no small moves
+  const half = WINDOWS / 2;
+  for (let winId = 1; winId <= half; winId += 1) {
+    const code = plugin.registerWindowMonitor(
+      winId,
+      (id, event) => {
+        if (!(focusMask & (1 << event))) unexpected.push(event);
+        focusEvents += 1;
+      },
+      { events: focusMask }
+    );
+    assert.strictEqual(code, 0);
+  }
+  for (let winId = half + 1; winId <= WINDOWS; winId += 1) {
+    const code = plugin.registerWindowMonitor(
+      winId,
+      () => {
+        otherEvents += 1;
+      },
+      { minDelta: MIN_DELTA, predictMs: 16 }
+    );
+    assert.strictEqual(code, 0);
+  }
+
+  await sleep(500);
+
+  const stats = plugin.getStats();
+  for (let winId = 1; winId <= WINDOWS; winId += 1) {
+    plugin.unregisterWindowMonitor(winId);
+  }
+
+  console.log(
+    `delivered ${focusEvents} focus and ${otherEvents} other events, ` +
+      `filtered ${stats.filteredTypes} by type and ` +
+      `${stats.filteredUnchanged} below ${MIN_DELTA} pixels`
+  );
+  assert.deepStrictEqual(unexpected, [], 'filtered types delivered');
+  assert(focusEvents > 0, 'no focus change delivered');
+  assert(otherEvents > 0, 'nothing delivered with a min delta');
+  assert(stats.filteredTypes > 0, 'nothing filtered by type');
+  assert(stats.filteredUnchanged > 0, 'nothing filtered by delta');
+  // one environment, the monitor dropped what it did not want, the
+  // environment only the few updates coalescing brought within its delta
+  assert(stats.filtered < stats.filteredUnchanged / 10);
+  // the counters of the monitor restart for this environment
+  plugin.resetStats();
+  assert(plugin.getStats().filteredTypes < stats.filteredTypes);
+  process.exit(0);
+})().catch((error) => {
+  console.error(`filter test failed: ${error.message}`);
+  process.exit(1);
+});
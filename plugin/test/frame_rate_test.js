@@ -0,0 +1,71 @@
+// Pace the geometry updates of a drag storm on the simulated desktop to a
+// frame rate and check that js gets at most one rect per window and frame,
+// that the ends of drags still arrive and that pacing can be turned off.
+// Usage: node frame_rate_test.js <agora_plugin_sim.node>
+const assert = require('assert');
+const path = require('path');
+
+const WINDOWS = 8;
+const FRAME_RATE = 60;
+const MOVED = 3;
+const MOVING = 4;
+
+// read by the monitor core when the first window is registered
+process.env.WINDOW_MONITOR_BACKEND = 'simulated';
+process.env.WINDOW_MONITOR_SIMULATED_WINDOWS = `${WINDOWS}`;
+process.env.WINDOW_MONITOR_SIMULATED_RATE = '50000';
+
+// eslint-disable-next-line import/no-dynamic-require
+const plugin = require(path.resolve(process.argv[2]));
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+// moving and moved events per window per second
+const measure = async (counts, ms) => {
+  counts.moving = 0;
+  counts.moved = 0;
+  const begin = process.hrtime.bigint();
+  await sleep(ms);
+  const seconds = Number(process.hrtime.bigint() - begin) / 1e9;
+  return {
+    moving: counts.moving / WINDOWS / seconds,
+    moved: counts.moved / WINDOWS / seconds,
+  };
+};
+
+(async () => {
+  const counts = { moving: 0, moved: 0 };
+  for (let winId = 1; winId <= WINDOWS; winId += 1) {
+    plugin.registerWindowMonitor(winId, (id, event) => {
+      if (event === MOVING) counts.moving += 1;
+      if (event === MOVED) counts.moved += 1;
+    });
+  }
+
+  const unpaced = await measure(counts, 500);
+  // the simulated desktop does not know its display
+  assert.strictEqual(plugin.setWindowMonitorFrameRate('display'), 60);
+  assert.strictEqual(plugin.setWindowMonitorFrameRate(FRAME_RATE), FRAME_RATE);
+  await sleep(50);
+  const paced = await measure(counts, 1000);
+  assert.strictEqual(plugin.setWindowMonitorFrameRate(0), 0);
+  assert.strictEqual(plugin.setWindowMonitorFrameRate(-5), 0);
+
+  for (let winId = 1; winId <= WINDOWS; winId += 1) {
+    plugin.unregisterWindowMonitor(winId);
+  }
+
+  console.log(
+    `moving per window and second: ${unpaced.moving.toFixed(0)} unpaced, ` +
+      `${paced.moving.toFixed(0)} at ${FRAME_RATE} fps, ` +
+      `moved ${unpaced.moved.toFixed(0)} and ${paced.moved.toFixed(0)}`
+  );
+  assert(unpaced.moving > FRAME_RATE * 2, 'storm too small to pace');
+  // a frame may be late on a busy box but never doubled
+  assert(paced.moving <= FRAME_RATE * 1.1, 'more than one rect per frame');
+  assert(paced.moving > 0, 'no rect delivered while pacing');
+  assert(paced.moved > 0, 'ends of drags not delivered');
+  process.exit(0);
+})().catch((error) => {
+  console.error(`frame rate test failed: ${error.message}`);
+  process.exit(1);
+});
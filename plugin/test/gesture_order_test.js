@@ -0,0 +1,88 @@
+// Drag windows of the simulated desktop with a slow callback so that the
+// lanes back up, and check that every drag is delivered in the order it
+// happened although its updates and its end are queued in different lanes:
+// the final Moved of a drag right before its GestureEnded, at the rect the
+// drag ended at, and nothing of a drag after the start of the next one.
+// Usage: node gesture_order_test.js <agora_plugin_sim.node>
+const assert = require('assert');
+const path = require('path');
+
+const WINDOWS = 2;
+const MOVED = 3;
+const MOVING = 4;
+const GESTURE_STARTED = 11;
+const GESTURE_ENDED = 12;
+// time spent in every callback
+const CALLBACK_US = 200;
+
+// read by the monitor core when the first window is registered
+process.env.WINDOW_MONITOR_BACKEND = 'simulated';
+process.env.WINDOW_MONITOR_SIMULATED_WINDOWS = `${WINDOWS}`;
+process.env.WINDOW_MONITOR_SIMULATED_RATE = '2000';
+
+// eslint-disable-next-line import/no-dynamic-require
+const plugin = require(path.resolve(process.argv[2]));
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+const busy = (us) => {
+  const end = process.hrtime.bigint() + BigInt(us * 1000);
+  while (process.hrtime.bigint() < end);
+};
+const sameRect = (a, b) =>
+  a.left === b.left &&
+  a.top === b.top &&
+  a.right === b.right &&
+  a.bottom === b.bottom;
+
+(async () => {
+  const windows = {};
+  const misordered = [];
+  let ended = 0;
+
+  const onEvent = (winId, event, bounds) => {
+    busy(CALLBACK_US);
+    const window = windows[winId];
+    if (event === GESTURE_STARTED) {
+      window.dragging = true;
+    } else if (event === GESTURE_ENDED) {
+      // drags started before registering are not checked
+      if (window.dragging) {
+        ended += 1;
+        const last = window.last;
+        if (!last || last.event !== MOVED || !sameRect(last.bounds, bounds)) {
+          misordered.push(`${winId}: ended after ${last && last.event}`);
+        }
+      }
+      window.dragging = false;
+    } else if (event === MOVED || event === MOVING) {
+      // the start of the next drag is not delivered ahead of its Moving
+      if (!window.dragging && event === MOVING && window.started) {
+        misordered.push(`${winId}: moving outside of a drag`);
+      }
+    }
+    if (event === GESTURE_STARTED) window.started = true;
+    window.last = { event, bounds };
+  };
+
+  for (let winId = 1; winId <= WINDOWS; winId += 1) {
+    windows[winId] = { dragging: false, started: false, last: undefined };
+    assert.strictEqual(plugin.registerWindowMonitor(winId, onEvent), 0);
+  }
+
+  await sleep(1500);
+
+  const stats = plugin.getStats();
+  for (let winId = 1; winId <= WINDOWS; winId += 1) {
+    plugin.unregisterWindowMonitor(winId);
+  }
+
+  console.log(
+    `${ended} drags ended, ${misordered.length} out of order, ` +
+      `high water ${stats.lanes.map((lane) => lane.highWater).join('/')}`
+  );
+  assert(ended > 0, 'no drag ended');
+  assert.deepStrictEqual(misordered, [], 'drags delivered out of order');
+  process.exit(0);
+})().catch((error) => {
+  console.error(`gesture order test failed: ${error.message}`);
+  process.exit(1);
+});
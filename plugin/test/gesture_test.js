@@ -0,0 +1,92 @@
+// Register windows of a drag storm on the simulated desktop, half of them
+// streaming the updates of drags live and half only wanting where drags
+// settled, and check that the drags are bracketed by GestureStarted and
+// GestureEnded, that the end carries the summary of the drag and that the
+// settled half never gets an update in the middle of one.
+// Usage: node gesture_test.js <agora_plugin_sim.node>
+const assert = require('assert');
+const path = require('path');
+
+const WINDOWS = 8;
+const MOVED = 3;
+const MOVING = 4;
+const GESTURE_STARTED = 11;
+const GESTURE_ENDED = 12;
+
+// read by the monitor core when the first window is registered
+process.env.WINDOW_MONITOR_BACKEND = 'simulated';
+process.env.WINDOW_MONITOR_SIMULATED_WINDOWS = `${WINDOWS}`;
+process.env.WINDOW_MONITOR_SIMULATED_RATE = '20000';
+
+// eslint-disable-next-line import/no-dynamic-require
+const plugin = require(path.resolve(process.argv[2]));
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+(async () => {
+  const settledMask =
+    (1 << MOVED) | (1 << GESTURE_STARTED) | (1 << GESTURE_ENDED);
+  const counts = (live) => ({ live, started: 0, ended: 0, moving: 0 });
+  const windows = {};
+  const invalid = [];
+  let samples = 0;
+
+  const onEvent = (winId, event, bounds, gesture) => {
+    const window = windows[winId];
+    if (event === MOVING) window.moving += 1;
+    if (event === GESTURE_STARTED) window.started += 1;
+    if (event !== GESTURE_ENDED) {
+      if (gesture !== undefined) invalid.push(event);
+      return;
+    }
+    window.ended += 1;
+    if (
+      !gesture ||
+      gesture.duration < 0 ||
+      gesture.endRect.left !== bounds.left ||
+      gesture.endRect.bottom !== bounds.bottom
+    ) {
+      invalid.push(event);
+      return;
+    }
+    samples += gesture.samples;
+  };
+
+  for (let winId = 1; winId <= WINDOWS; winId += 1) {
+    const live = winId % 2 === 0;
+    windows[winId] = counts(live);
+    const code = plugin.registerWindowMonitor(
+      winId,
+      onEvent,
+      live ? undefined : { events: settledMask }
+    );
+    assert.strictEqual(code, 0);
+  }
+
+  await sleep(500);
+
+  for (let winId = 1; winId <= WINDOWS; winId += 1) {
+    plugin.unregisterWindowMonitor(winId);
+  }
+
+  const total = counts(false);
+  for (const window of Object.values(windows)) {
+    total.started += window.started;
+    total.ended += window.ended;
+    if (window.live) total.moving += window.moving;
+    else assert.strictEqual(window.moving, 0, 'live update delivered');
+    // drags started before registering end without a summary
+    assert(window.ended <= window.started, 'drag ended without a start');
+  }
+  console.log(
+    `${total.started} drags started, ${total.ended} ended with ` +
+      `${samples} updates, ${total.moving} delivered live`
+  );
+  assert.deepStrictEqual(invalid, [], 'summaries missing or wrong');
+  assert(total.ended > 0, 'no drag ended');
+  assert(samples > 0, 'drags without updates');
+  assert(total.moving > 0, 'nothing delivered live');
+  process.exit(0);
+})().catch((error) => {
+  console.error(`gesture test failed: ${error.message}`);
+  process.exit(1);
+});
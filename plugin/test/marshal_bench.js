@@ -0,0 +1,99 @@
+// Compare marshalling of rects and lists of windows by napi_obj_set_property,
+// by a napi_object_shape and by the NAPI_STRUCT converters, and reading
+// arrays of strings the former two pass way, into std::string and into a
+// napi_string_arena.
+// Usage: node marshal_bench.js <marshal_bench_addon.node> [--quick]
+const assert = require('assert');
+const path = require('path');
+
+// eslint-disable-next-line import/no-dynamic-require
+const addon = require(path.resolve(process.argv[2]));
+const quick = process.argv.includes('--quick');
+
+const MODES = [
+  ['named', 0],
+  ['shape', 1],
+  ['struct', 2],
+];
+const KINDS = [
+  ['rect', quick ? 100000 : 2000000],
+  ['windows', quick ? 5000 : 100000],
+];
+
+const perSecond = (count, fn) => {
+  // warm up
+  fn(Math.max(1, count / 10));
+  const begin = process.hrtime.bigint();
+  fn(count);
+  return count / (Number(process.hrtime.bigint() - begin) / 1e9);
+};
+
+const report = (name, results) => {
+  const base = results.named;
+  Object.keys(results).forEach((mode) => {
+    console.log(
+      `${name.padEnd(14)} ${mode.padEnd(8)} ` +
+        `${(results[mode] / 1e6).toFixed(2).padStart(6)} M/s  ` +
+        `${(results[mode] / base).toFixed(2)}x`
+    );
+  });
+};
+
+// a shape takes up to 16 keys, it refuses more instead of dropping them
+assert.strictEqual(addon.shapeStatus(16), 0);
+assert.strictEqual(addon.shapeStatus(17), 1, 'napi_invalid_arg');
+
+KINDS.forEach(([kind, count]) => {
+  const expected = addon.sample(kind, 0);
+  const results = {};
+  MODES.forEach(([name, mode]) => {
+    const value = addon.sample(kind, mode);
+    assert.deepStrictEqual(value, expected, `${name} marshals another ${kind}`);
+    assert.deepStrictEqual(
+      JSON.stringify(value),
+      JSON.stringify(expected),
+      `${name} orders the fields of ${kind} differently`
+    );
+    results[name] = perSecond(count, (n) => addon.run(kind, mode, n));
+  });
+  report(`to js ${kind}`, results);
+});
+
+const rect = { left: 1, top: 1.5, right: 101, bottom: 200 };
+const results = {};
+[
+  ['named', 0],
+  ['struct', 2],
+].forEach(([name, mode]) => {
+  assert.deepStrictEqual(addon.read(mode, rect, 1), rect);
+  results[name] = perSecond(quick ? 100000 : 2000000, (n) =>
+    addon.read(mode, rect, n)
+  );
+});
+report('from js rect', results);
+
+// window exclusion list like ids, a few long and non ascii ones
+const strings = [];
+for (let i = 0; i < 64; i += 1) {
+  strings.push(`window-source-${i}-${'x'.repeat(i)}`);
+}
+strings.push('\u7a97\u53e3-\ud83d\ude00'.repeat(40));
+strings.push('a'.repeat(4000));
+strings.push('with\0null');
+const stringModes = [
+  ['named', 0],
+  ['string', 1],
+  ['arena', 2],
+];
+const stringResults = {};
+stringModes.forEach(([name, mode]) => {
+  const read = addon.readStrings(mode, strings, 1);
+  // the two pass read stops at embedded nulls
+  const expected =
+    mode === 0 ? strings.map((s) => s.split('\0')[0]) : strings;
+  assert.deepStrictEqual(read, expected, `${name} reads other strings`);
+  stringResults[name] = perSecond(quick ? 2000 : 50000, (n) =>
+    addon.readStrings(mode, strings, n)
+  );
+});
+report('from js strs', stringResults);
@@ -0,0 +1,316 @@
+// Native side of marshal_bench.js, marshals rects and lists of windows the
+// way plugin.cc did with napi_obj_set_property, by a napi_object_shape and
+// through the NAPI_STRUCT converters. Arrays of strings are read the former
+// two pass way, by napi_get_value_utf8string and into a napi_string_arena.
+#include <node_api.h>
+
+#include <string.h>
+
+#include <vector>
+
+#include "napi_struct.h"
+#include "napi_utils.h"
+
+namespace {
+using namespace agora::plugin;
+
+struct BenchRect {
+  float left;
+  float top;
+  float right;
+  float bottom;
+};
+
+struct BenchWindow {
+  int32_t id;
+  BenchRect rect;
+};
+
+const size_t kWindowCount = 16;
+
+enum MarshalMode { kNamed = 0, kShape = 1, kStruct = 2 };
+}  // namespace
+
+namespace agora {
+namespace plugin {
+
+NAPI_STRUCT(BenchRect, left, top, right, bottom);
+NAPI_STRUCT(BenchWindow, id, rect);
+
+}  // namespace plugin
+}  // namespace agora
+
+namespace {
+
+class MarshalInstance {
+ public:
+  explicit MarshalInstance(napi_env env)
+      : rect_shape(env, {"left", "top", "right", "bottom"}) {}
+
+  napi_object_shape rect_shape;
+};
+
+napi_status packNamed(napi_env env, const BenchRect &rect, napi_value &value) {
+  napi_status status = napi_create_object(env, &value);
+  if (status != napi_ok) return status;
+  napi_obj_set_property(env, value, "left", rect.left);
+  napi_obj_set_property(env, value, "top", rect.top);
+  napi_obj_set_property(env, value, "right", rect.right);
+  return napi_obj_set_property(env, value, "bottom", rect.bottom);
+}
+
+napi_status packShape(napi_env env, const napi_object_shape &shape,
+                      const BenchRect &rect, napi_value &value) {
+  napi_value values[4];
+  napi_create_double(env, rect.left, &values[0]);
+  napi_create_double(env, rect.top, &values[1]);
+  napi_create_double(env, rect.right, &values[2]);
+  napi_create_double(env, rect.bottom, &values[3]);
+  return shape.create_object(values, &value);
+}
+
+napi_status packRect(napi_env env, int mode, const BenchRect &rect,
+                     napi_value &value) {
+  switch (mode) {
+    case kShape:
+      return packShape(env,
+                       napi_get_instance<MarshalInstance>(env)->rect_shape,
+                       rect, value);
+    case kStruct:
+      return napi_to_value(env, rect, &value);
+    default:
+      return packNamed(env, rect, value);
+  }
+}
+
+napi_status packWindows(napi_env env, int mode,
+                        const std::vector<BenchWindow> &windows,
+                        napi_value &value) {
+  if (mode == kStruct) return napi_to_value(env, windows, &value);
+
+  napi_status status =
+      napi_create_array_with_length(env, windows.size(), &value);
+  for (size_t i = 0; status == napi_ok && i < windows.size(); i++) {
+    napi_value window, rect;
+    status = napi_create_object(env, &window);
+    if (status != napi_ok) break;
+    napi_obj_set_property(env, window, "id", windows[i].id);
+    packRect(env, mode, windows[i].rect, rect);
+    napi_obj_set_property(env, window, "rect", rect);
+    status = napi_set_element(env, value, (uint32_t)i, window);
+  }
+  return status;
+}
+
+napi_status readNamed(napi_env env, napi_value value, BenchRect &rect) {
+  float *fields[] = {&rect.left, &rect.top, &rect.right, &rect.bottom};
+  const char *names[] = {"left", "top", "right", "bottom"};
+  for (size_t i = 0; i < 4; i++) {
+    napi_value field;
+    double number;
+    napi_get_named_property(env, value, names[i], &field);
+    napi_status status = napi_get_value_double(env, field, &number);
+    if (status != napi_ok) return status;
+    *fields[i] = (float)number;
+  }
+  return napi_ok;
+}
+
+std::vector<BenchWindow> makeWindows(int32_t seed) {
+  std::vector<BenchWindow> windows(kWindowCount);
+  for (size_t i = 0; i < kWindowCount; i++) {
+    windows[i].id = seed + (int32_t)i;
+    windows[i].rect = BenchRect{(float)i, 1.5f, (float)i + 100.f, 200.f};
+  }
+  return windows;
+}
+
+// run(kind, mode, count), marshals count rects or window lists each in its
+// own handle scope like the event delivery does
+napi_value run(napi_env env, napi_callback_info info) {
+  size_t argc = 3;
+  napi_value args[3];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+  std::string kind;
+  int32_t mode, count;
+  NAPI_CALL(env, napi_get_value_utf8string(env, args[0], kind));
+  NAPI_CALL(env, napi_get_value_int32(env, args[1], &mode));
+  NAPI_CALL(env, napi_get_value_int32(env, args[2], &count));
+
+  const bool windows = kind == "windows";
+  const std::vector<BenchWindow> list = makeWindows(0);
+  for (int32_t i = 0; i < count; i++) {
+    napi_handle_scope scope;
+    NAPI_CALL(env, napi_open_handle_scope(env, &scope));
+    napi_value value;
+    if (windows) {
+      NAPI_CALL(env, packWindows(env, mode, list, value));
+    } else {
+      NAPI_CALL(env, packRect(
+                         env, mode,
+                         BenchRect{(float)i, 1.5f, (float)i + 100.f, 200.f},
+                         value));
+    }
+    NAPI_CALL(env, napi_close_handle_scope(env, scope));
+  }
+
+  return nullptr;
+}
+
+// sample(kind, mode), one value to compare the results of the modes
+napi_value sample(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[2];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+  std::string kind;
+  int32_t mode;
+  NAPI_CALL(env, napi_get_value_utf8string(env, args[0], kind));
+  NAPI_CALL(env, napi_get_value_int32(env, args[1], &mode));
+
+  napi_value value;
+  if (kind == "windows") {
+    NAPI_CALL(env, packWindows(env, mode, makeWindows(7), value));
+  } else {
+    NAPI_CALL(env,
+              packRect(env, mode, BenchRect{1.f, 1.5f, 101.f, 200.f}, value));
+  }
+  return value;
+}
+
+// read(mode, rect, count), reads the rect count times and returns it back
+napi_value read(napi_env env, napi_callback_info info) {
+  size_t argc = 3;
+  napi_value args[3];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+  int32_t mode, count;
+  NAPI_CALL(env, napi_get_value_int32(env, args[0], &mode));
+  NAPI_CALL(env, napi_get_value_int32(env, args[2], &count));
+
+  BenchRect rect = {};
+  for (int32_t i = 0; i < count; i++) {
+    if (mode == kStruct) {
+      NAPI_CALL(env, napi_from_value(env, args[1], rect));
+    } else {
+      NAPI_CALL(env, readNamed(env, args[1], rect));
+    }
+  }
+
+  napi_value value;
+  NAPI_CALL(env, napi_to_value(env, rect, &value));
+  return value;
+}
+
+// the former napi_get_value_utf8string
+napi_status readStringTwoPass(napi_env env, napi_value value,
+                              std::string &str) {
+  size_t length = 0;
+  napi_status status =
+      napi_get_value_string_utf8(env, value, nullptr, 0, &length);
+
+  std::vector<char> strData;
+  length += 1;
+  strData.resize(length, '\0');
+
+  size_t result = 0;
+  status =
+      napi_get_value_string_utf8(env, value, strData.data(), length, &result);
+  str = strData.data();
+  return status;
+}
+
+napi_status readStringsTwoPass(napi_env env, napi_value value,
+                               std::vector<std::string> &result) {
+  uint32_t length = 0;
+  napi_status status = napi_get_array_length(env, value, &length);
+  for (uint32_t i = 0; status == napi_ok && i < length; i++) {
+    napi_value element;
+    status = napi_get_element(env, value, i, &element);
+    std::string str;
+    if (status == napi_ok) status = readStringTwoPass(env, element, str);
+    result.emplace_back(str);
+  }
+  return status;
+}
+
+// readStrings(mode, array, count), reads the array count times and returns
+// the last read
+napi_value readStrings(napi_env env, napi_callback_info info) {
+  size_t argc = 3;
+  napi_value args[3];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+  int32_t mode, count;
+  NAPI_CALL(env, napi_get_value_int32(env, args[0], &mode));
+  NAPI_CALL(env, napi_get_value_int32(env, args[2], &count));
+
+  std::vector<std::string> strings;
+  napi_string_arena arena;
+  std::vector<napi_string_view> views;
+  for (int32_t i = 0; i < count; i++) {
+    strings.clear();
+    arena.clear();
+    views.clear();
+    switch (mode) {
+      case kShape:
+        NAPI_CALL(env, napi_from_value(env, args[1], strings));
+        break;
+      case kStruct:
+        NAPI_CALL(env, napi_get_value_string_array(env, args[1], arena, views));
+        break;
+      default:
+        NAPI_CALL(env, readStringsTwoPass(env, args[1], strings));
+        break;
+    }
+  }
+
+  if (mode == kStruct) {
+    for (auto &view : views) strings.push_back(view.str());
+  }
+
+  napi_value value;
+  NAPI_CALL(env, napi_to_value(env, strings, &value));
+  return value;
+}
+
+// shapeStatus(count), status of creating an object of a shape of count keys
+napi_value shapeStatus(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+  uint32_t count;
+  NAPI_CALL(env, napi_get_value_uint32(env, args[0], &count));
+
+  std::vector<std::string> names(count);
+  std::vector<const char *> pointers(count);
+  std::vector<napi_value> values(count);
+  for (uint32_t i = 0; i < count; i++) {
+    names[i] = "key" + std::to_string(i);
+    pointers[i] = names[i].c_str();
+    NAPI_CALL(env, napi_create_uint32(env, i, &values[i]));
+  }
+
+  napi_object_shape shape(env, pointers.data(), count);
+  napi_value object, value;
+  const napi_status created = shape.create_object(values.data(), &object);
+  NAPI_CALL(env, napi_create_int32(env, (int32_t)created, &value));
+  return value;
+}
+
+napi_value init(napi_env env, napi_value exports) {
+  if (!napi_get_instance<MarshalInstance>(env)) return nullptr;
+
+  NAPI_DEFINE_FUNC(env, exports, run, "run");
+  NAPI_DEFINE_FUNC(env, exports, sample, "sample");
+  NAPI_DEFINE_FUNC(env, exports, read, "read");
+  NAPI_DEFINE_FUNC(env, exports, readStrings, "readStrings");
+  NAPI_DEFINE_FUNC(env, exports, shapeStatus, "shapeStatus");
+
+  return exports;
+}
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, init);
+}  // namespace
@@ -0,0 +1,108 @@
+// Drive the plugin on the simulated desktop of the window monitor: events are
+// generated on a native thread for hundreds of windows and go through the
+// classification of the monitor core, the event hub, the async queue and
+// marshalling into js callbacks, while the main loop delay is watched. The
+// monitor thread attaches windows and the platform thread classifies events,
+// the main loop only drains finished records within its budget, so its delay
+// stays bounded however many events the storm has.
+// Usage: node monitor_sim_bench.js <agora_plugin_sim.node> [--quick]
+const assert = require('assert');
+const path = require('path');
+const { monitorEventLoopDelay } = require('perf_hooks');
+
+const quick = process.argv.includes('--quick');
+const WINDOWS = quick ? 200 : 1000;
+// raw events per second of the simulated desktop
+const RATE = quick ? 200000 : 1000000;
+const SECONDS = quick ? 1 : 5;
+// p99 of the main loop delay, generous for shared ci boxes
+const MAX_LOOP_DELAY_MS = 50;
+
+// read by the monitor core when the first window is registered, without
+// WINDOW_MONITOR_BACKEND an X server in DISPLAY would be monitored instead
+process.env.WINDOW_MONITOR_BACKEND = 'simulated';
+process.env.WINDOW_MONITOR_SIMULATED_WINDOWS = `${WINDOWS}`;
+process.env.WINDOW_MONITOR_SIMULATED_RATE = `${RATE}`;
+
+// eslint-disable-next-line import/no-dynamic-require
+const plugin = require(path.resolve(process.argv[2]));
+
+const MOVED = 3;
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+(async () => {
+  const byType = new Array(11).fill(0);
+  const initial = new Set();
+  let received = 0;
+  let wrongWindow = false;
+
+  const registerBegin = process.hrtime.bigint();
+  for (let winId = 1; winId <= WINDOWS; winId += 1) {
+    const code = plugin.registerWindowMonitor(winId, (id, event, bounds) => {
+      if (id !== winId || typeof bounds.left !== 'number') wrongWindow = true;
+      if (event === MOVED) initial.add(id);
+      byType[event] += 1;
+      received += 1;
+    });
+    assert.strictEqual(code, 0, `register ${winId} failed with ${code}`);
+  }
+  // windows registered later wait for the monitor thread during the storm
+  const registerUs = Number(process.hrtime.bigint() - registerBegin) / 1e3;
+  assert.strictEqual(plugin.registerWindowMonitor(1, () => {}), 2);
+  assert.strictEqual(plugin.registerWindowMonitor(WINDOWS + 1, () => {}), 4);
+
+  const delay = monitorEventLoopDelay({ resolution: 1 });
+  delay.enable();
+  const begin = process.hrtime.bigint();
+  await sleep(SECONDS * 1000);
+  const seconds = Number(process.hrtime.bigint() - begin) / 1e9;
+  delay.disable();
+  const stats = plugin.getStats();
+  const { latency, lanes } = stats;
+  // every delivered event is in the histograms
+  assert.strictEqual(latency.total.count, received, 'events without latency');
+
+  for (let winId = 1; winId <= WINDOWS; winId += 1) {
+    plugin.unregisterWindowMonitor(winId);
+  }
+  // let queued events drain, nothing may follow
+  await sleep(100);
+  const drained = received;
+  await sleep(100);
+
+  console.log(
+    `${WINDOWS} windows at ${RATE / 1e3}K raw events/s: ` +
+      `${(received / seconds / 1e3).toFixed(1)}K js events/s, ` +
+      `coalesced ${stats.coalesced}, dropped ${stats.dropped}, ` +
+      `loop delay p99 ${(delay.percentile(99) / 1e6).toFixed(2)} ms ` +
+      `max ${(delay.max / 1e6).toFixed(2)} ms`
+  );
+  console.log(
+    `register ${(registerUs / WINDOWS).toFixed(1)} us per window ` +
+      `during the storm`
+  );
+  console.log(`events by type: ${byType.join(' ')}`);
+  Object.keys(latency).forEach((stage) => {
+    const { p50, p99, p999, max } = latency[stage];
+    console.log(
+      `${stage.padEnd(8)} latency us p50 ${p50} p99 ${p99} p999 ${p999} ` +
+        `max ${max}`
+    );
+  });
+  console.log(`lane high water: ${lanes.map((l) => l.highWater).join(' ')}`);
+
+  plugin.resetStats();
+  assert.strictEqual(plugin.getStats().latency.total.count, 0);
+
+  assert(!wrongWindow, 'events of other windows received');
+  assert.strictEqual(byType[0], 0, 'unknown events received');
+  assert.strictEqual(initial.size, WINDOWS, 'windows without a first rect');
+  assert(byType[4] > 0 && byType[6] > 0, 'no moving or shown events');
+  assert.strictEqual(received, drained, 'events after unregister');
+  const p99 = delay.percentile(99) / 1e6;
+  assert(p99 < MAX_LOOP_DELAY_MS, `main loop delay p99 ${p99} ms`);
+  process.exit(0);
+})().catch((error) => {
+  console.error(`monitor sim bench failed: ${error.message}`);
+  process.exit(1);
+});
@@ -0,0 +1,152 @@
+#include "napi_stub.h"
+
+#include <stdint.h>
+
+#include <vector>
+
+// Node headers are not included on purpose, the functions have c linkage so
+// opaque handles can be described by plain pointers here.
+namespace {
+
+typedef void* napi_env;
+typedef void* napi_value;
+typedef void* napi_ref;
+typedef void* napi_handle_scope;
+typedef int napi_status;
+
+const napi_status napi_ok = 0;
+
+struct napi_extended_error_info {
+  const char* error_message;
+  void* engine_reserved;
+  uint32_t engine_error_code;
+  napi_status error_code;
+};
+
+const size_t kMaxValues = 1024;
+// every thread is an engine of its own, like the threads of node workers
+thread_local double g_values[kMaxValues];
+thread_local size_t g_top = 0;
+int g_env = 0;
+int g_function = 0;
+int g_undefined = 0;
+napi_stub::CallHook g_hook = nullptr;
+
+napi_value newNumber(double number) {
+  if (g_top == kMaxValues) g_top = 0;
+  g_values[g_top] = number;
+  return &g_values[g_top++];
+}
+
+}  // namespace
+
+namespace napi_stub {
+
+void SetCallHook(CallHook hook) { g_hook = hook; }
+
+void* FakeEnv() { return &g_env; }
+
+void* FakeFunction() { return &g_function; }
+
+}  // namespace napi_stub
+
+extern "C" {
+
+napi_status napi_get_last_error_info(napi_env env,
+                                     const napi_extended_error_info** result) {
+  static napi_extended_error_info info = {"napi stub error", nullptr, 0, 0};
+  *result = &info;
+  return napi_ok;
+}
+
+napi_status napi_is_exception_pending(napi_env env, bool* result) {
+  *result = false;
+  return napi_ok;
+}
+
+napi_status napi_throw_error(napi_env env, const char* code, const char* msg) {
+  return napi_ok;
+}
+
+napi_status napi_create_reference(napi_env env, napi_value value,
+                                  uint32_t initial_refcount, napi_ref* result) {
+  *result = value;
+  return napi_ok;
+}
+
+napi_status napi_delete_reference(napi_env env, napi_ref ref) {
+  return napi_ok;
+}
+
+napi_status napi_get_reference_value(napi_env env, napi_ref ref,
+                                     napi_value* result) {
+  *result = ref;
+  return napi_ok;
+}
+
+napi_status napi_open_handle_scope(napi_env env, napi_handle_scope* result) {
+  *result = reinterpret_cast<napi_handle_scope>(g_top);
+  return napi_ok;
+}
+
+napi_status napi_close_handle_scope(napi_env env, napi_handle_scope scope) {
+  g_top = reinterpret_cast<size_t>(scope);
+  return napi_ok;
+}
+
+napi_status napi_get_undefined(napi_env env, napi_value* result) {
+  *result = &g_undefined;
+  return napi_ok;
+}
+
+napi_status napi_create_int32(napi_env env, int32_t value,
+                              napi_value* result) {
+  *result = newNumber(value);
+  return napi_ok;
+}
+
+napi_status napi_create_double(napi_env env, double value,
+                               napi_value* result) {
+  *result = newNumber(value);
+  return napi_ok;
+}
+
+napi_status napi_strict_equals(napi_env env, napi_value lhs, napi_value rhs,
+                               bool* result) {
+  *result = lhs == rhs;
+  return napi_ok;
+}
+
+// a typed array is seen by the call hook as its element count
+napi_status napi_create_arraybuffer(napi_env env, size_t byte_length,
+                                    void** data, napi_value* result) {
+  static thread_local std::vector<double> buffer;
+  if (buffer.size() * sizeof(double) < byte_length)
+    buffer.resize(byte_length / sizeof(double) + 1);
+  *data = buffer.data();
+  *result = buffer.data();
+  return napi_ok;
+}
+
+napi_status napi_create_typedarray(napi_env env, int type, size_t length,
+                                   napi_value arraybuffer, size_t byte_offset,
+                                   napi_value* result) {
+  *result = newNumber((double)length);
+  return napi_ok;
+}
+
+napi_status napi_call_function(napi_env env, napi_value recv, napi_value func,
+                               size_t argc, const napi_value* argv,
+                               napi_value* result) {
+  if (g_hook) {
+    double args[16];
+    for (size_t i = 0; i < argc && i < 16; i++) {
+      args[i] = *reinterpret_cast<double*>(argv[i]);
+    }
+    g_hook(argc, args);
+  }
+  *result = &g_undefined;
+  return napi_ok;
+}
+
+}  // extern "C"
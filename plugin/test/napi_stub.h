@@ -0,0 +1,22 @@
+#ifndef AGORA_PLUGIN_TEST_NAPI_STUB_H_
+#define AGORA_PLUGIN_TEST_NAPI_STUB_H_
+
+#include <stddef.h>
+
+// A minimal stand in for the N-API functions used by the event path, so it
+// can be tested without a js engine. Numbers created by napi_create_int32 and
+// napi_create_double are kept in a fixed table per thread, napi_call_function
+// hands them to the call hook.
+namespace napi_stub {
+
+using CallHook = void (*)(size_t argc, const double argv[]);
+
+void SetCallHook(CallHook hook);
+
+// non null handles to register as env and js callback
+void* FakeEnv();
+void* FakeFunction();
+
+}  // namespace napi_stub
+
+#endif  // AGORA_PLUGIN_TEST_NAPI_STUB_H_
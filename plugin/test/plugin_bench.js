@@ -0,0 +1,20 @@
+// Runs the google benchmark suite of plugin_bench_addon inside node, the
+// arguments after the addon are google benchmark flags, for example
+// node plugin_bench.js <plugin_bench_addon.node> \
+//   --benchmark_out=plugin_bench.json --benchmark_out_format=json
+const path = require('path');
+
+// eslint-disable-next-line import/no-dynamic-require
+const addon = require(path.resolve(process.argv[2]));
+
+let calls = 0;
+const onEvent = () => {
+  calls += 1;
+};
+
+const ran = addon.run(onEvent, process.argv.slice(3));
+if (!ran) {
+  console.error('no benchmark ran');
+  process.exit(1);
+}
+console.log(`${ran} benchmarks, ${calls} js callbacks`);
@@ -0,0 +1,363 @@
+// Google benchmark suite of the plugin hot paths, run inside node by
+// plugin_bench.js so events are delivered to a real js function and values
+// are marshalled by a real js engine: async_queue with 1 to 8 producer
+// threads, NodeValoranEventBase from Fire to the js callback and the
+// napi_utils / NAPI_STRUCT converters.
+#include <node_api.h>
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "napi_async.h"
+#include "napi_event.h"
+#include "napi_stats.h"
+#include "napi_struct.h"
+#include "napi_utils.h"
+
+namespace {
+using namespace agora::plugin;
+
+struct BenchRect {
+  float left;
+  float top;
+  float right;
+  float bottom;
+};
+
+struct BenchWindow {
+  int32_t id;
+  BenchRect rect;
+};
+
+struct BenchPayload {
+  int32_t event;
+  BenchRect rect;
+};
+
+using BenchRecord = NodeValoranEventRecord<int32_t, BenchPayload>;
+}  // namespace
+
+namespace agora {
+namespace plugin {
+
+NAPI_STRUCT(BenchRect, left, top, right, bottom);
+NAPI_STRUCT(BenchWindow, id, rect);
+
+template <>
+struct NodeValoranEventPacker<int32_t, BenchPayload> {
+  static const int argc = 3;
+  static void Pack(napi_env &env, const BenchRecord &record,
+                   napi_value argv[]) {
+    NAPI_CALL_NORETURN(env, napi_create_int32(env, record.key, &argv[0]));
+    NAPI_CALL_NORETURN(env,
+                       napi_create_int32(env, record.payload.event, &argv[1]));
+    NAPI_CALL_NORETURN(env, napi_to_value(env, record.payload.rect, &argv[2]));
+  }
+
+  static const int batch_fields = 7;
+  static void PackBatch(const BenchRecord &record, double data[]) {
+    data[0] = record.key;
+    data[1] = record.payload.event;
+    data[2] = record.payload.rect.left;
+    data[3] = record.payload.rect.top;
+    data[4] = record.payload.rect.right;
+    data[5] = record.payload.rect.bottom;
+    data[6] = (double)record.ts;
+  }
+};
+
+}  // namespace plugin
+}  // namespace agora
+
+namespace {
+
+using BenchEvents = NodeValoranEventBase<int32_t, BenchPayload>;
+
+// env and js callback of the running run() call
+static napi_env _env = nullptr;
+static napi_value _callback = nullptr;
+
+const size_t kWindowCount = 16;
+const size_t kStringCount = 16;
+
+uint64_t nowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void closeLoop(uv_loop_t *loop) {
+  uv_run(loop, UV_RUN_DEFAULT);
+  uv_loop_close(loop);
+}
+
+// Producer threads push rounds of kRoundSize timestamps, the benchmark
+// thread drains them from its uv loop like the main loop of node does. The
+// latency counters are from async_call to the queue callback.
+void BM_AsyncQueue(benchmark::State &state) {
+  const int producers = (int)state.range(0);
+  const uint64_t kRoundSize = 1024;
+  const size_t kBacklogLimit = 512;
+
+  uv_loop_t loop;
+  uv_loop_init(&loop);
+
+  latency_histogram latency;
+  uint64_t executed = 0;
+  auto queue = new async_queue<uint64_t>(&loop, [&](uint64_t &enqueued) {
+    latency.record(nowNs() - enqueued);
+    executed++;
+  });
+
+  std::atomic<uint64_t> round(0);
+  std::atomic<bool> quit(false);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < producers; i++) {
+    threads.emplace_back([&] {
+      uint64_t seen = 0;
+      while (true) {
+        while (round.load() == seen && !quit.load()) std::this_thread::yield();
+        if (quit.load()) return;
+        seen++;
+        for (uint64_t n = 0; n < kRoundSize; n++) {
+          queue->async_call(nowNs());
+          while (queue->size() > kBacklogLimit) std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  uint64_t expected = 0;
+  for (auto _ : state) {
+    expected += kRoundSize * producers;
+    round.fetch_add(1);
+    while (executed + queue->dropped() < expected) uv_run(&loop, UV_RUN_ONCE);
+  }
+
+  quit.store(true);
+  for (auto &thread : threads) thread.join();
+
+  state.SetItemsProcessed(expected);
+  state.counters["dropped"] = (double)queue->dropped();
+  state.counters["p50_ns"] = (double)latency.percentile(50);
+  state.counters["p99_ns"] = (double)latency.percentile(99);
+  state.counters["max_ns"] = (double)latency.max();
+
+  delete queue;
+  closeLoop(&loop);
+}
+BENCHMARK(BM_AsyncQueue)
+    ->ArgName("producers")
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(8)
+    ->UseRealTime();
+
+// range(0) events fired and delivered to the js callback one by one, in one
+// batch or coalesced to the latest, per iteration.
+enum FireMode { kFireEach = 0, kFireBatch = 1, kFireLatest = 2 };
+
+void BM_Fire(benchmark::State &state) {
+  const int32_t burst = (int32_t)state.range(0);
+  const int mode = (int)state.range(1);
+
+  uv_loop_t loop;
+  uv_loop_init(&loop);
+
+  napi_value global;
+  napi_get_global(_env, &global);
+
+  auto events = new BenchEvents(&loop);
+  if (mode == kFireBatch)
+    events->AddBatchEvent(1, _env, _callback, global);
+  else
+    events->AddEvent(1, _env, _callback, global);
+
+  for (auto _ : state) {
+    for (int32_t i = 0; i < burst; i++) {
+      BenchPayload payload = {4, BenchRect{(float)i, 0.f, 100.f, 100.f}};
+      if (mode == kFireLatest)
+        events->FireLatest(1, payload);
+      else
+        events->Fire(1, payload);
+    }
+    uv_run(&loop, UV_RUN_NOWAIT);
+  }
+
+  state.SetItemsProcessed(state.iterations() * burst);
+  state.counters["p99_callback_us"] =
+      (double)events->latency(kEventStageCallback).percentile(99);
+
+  delete events;
+  closeLoop(&loop);
+}
+BENCHMARK(BM_Fire)
+    ->ArgNames({"burst", "mode"})
+    ->ArgsProduct({{1, 64, 512}, {kFireEach, kFireBatch, kFireLatest}});
+
+// Rects to js by name, by a napi_object_shape and by NAPI_STRUCT, every one
+// in its own handle scope like the event delivery does.
+enum MarshalMode { kNamed = 0, kShape = 1, kStruct = 2 };
+
+napi_status packNamed(napi_env env, const BenchRect &rect, napi_value &value) {
+  napi_status status = napi_create_object(env, &value);
+  if (status != napi_ok) return status;
+  napi_obj_set_property(env, value, "left", rect.left);
+  napi_obj_set_property(env, value, "top", rect.top);
+  napi_obj_set_property(env, value, "right", rect.right);
+  return napi_obj_set_property(env, value, "bottom", rect.bottom);
+}
+
+napi_status packShape(napi_env env, const napi_object_shape &shape,
+                      const BenchRect &rect, napi_value &value) {
+  napi_value values[4];
+  napi_create_double(env, rect.left, &values[0]);
+  napi_create_double(env, rect.top, &values[1]);
+  napi_create_double(env, rect.right, &values[2]);
+  napi_create_double(env, rect.bottom, &values[3]);
+  return shape.create_object(values, &value);
+}
+
+void BM_RectToJs(benchmark::State &state) {
+  const int mode = (int)state.range(0);
+  napi_object_shape shape(_env, {"left", "top", "right", "bottom"});
+
+  float i = 0;
+  for (auto _ : state) {
+    napi_handle_scope scope;
+    napi_open_handle_scope(_env, &scope);
+    const BenchRect rect = {i++, 1.5f, i + 100.f, 200.f};
+    napi_value value;
+    if (mode == kNamed)
+      packNamed(_env, rect, value);
+    else if (mode == kShape)
+      packShape(_env, shape, rect, value);
+    else
+      napi_to_value(_env, rect, &value);
+    benchmark::DoNotOptimize(value);
+    napi_close_handle_scope(_env, scope);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RectToJs)->ArgName("mode")->Arg(kNamed)->Arg(kShape)->Arg(
+    kStruct);
+
+void BM_RectFromJs(benchmark::State &state) {
+  napi_value value;
+  napi_to_value(_env, BenchRect{1.f, 1.5f, 101.f, 200.f}, &value);
+
+  BenchRect rect = {};
+  for (auto _ : state) {
+    napi_from_value(_env, value, rect);
+    benchmark::DoNotOptimize(rect);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RectFromJs);
+
+void BM_WindowsToJs(benchmark::State &state) {
+  std::vector<BenchWindow> windows(kWindowCount);
+  for (size_t i = 0; i < kWindowCount; i++) {
+    windows[i].id = (int32_t)i;
+    windows[i].rect = BenchRect{(float)i, 1.5f, (float)i + 100.f, 200.f};
+  }
+
+  for (auto _ : state) {
+    napi_handle_scope scope;
+    napi_open_handle_scope(_env, &scope);
+    napi_value value;
+    napi_to_value(_env, windows, &value);
+    benchmark::DoNotOptimize(value);
+    napi_close_handle_scope(_env, scope);
+  }
+  state.SetItemsProcessed(state.iterations() * kWindowCount);
+}
+BENCHMARK(BM_WindowsToJs);
+
+// An array of ids read into std::string one by one or into an arena.
+void BM_StringArrayFromJs(benchmark::State &state) {
+  const bool arena_mode = state.range(0) != 0;
+
+  napi_value array;
+  napi_create_array_with_length(_env, kStringCount, &array);
+  for (uint32_t i = 0; i < kStringCount; i++) {
+    const std::string id = "window-" + std::to_string(i * 7919);
+    napi_value str;
+    napi_create_string_utf8(_env, id.c_str(), id.size(), &str);
+    napi_set_element(_env, array, i, str);
+  }
+
+  napi_string_arena arena;
+  std::vector<napi_string_view> views;
+  std::vector<std::string> strings;
+  for (auto _ : state) {
+    if (arena_mode) {
+      arena.clear();
+      views.clear();
+      napi_get_value_string_array(_env, array, arena, views);
+      benchmark::DoNotOptimize(views.data());
+    } else {
+      strings.clear();
+      for (uint32_t i = 0; i < kStringCount; i++) {
+        napi_value element;
+        napi_get_element(_env, array, i, &element);
+        std::string str;
+        napi_get_value_utf8string(_env, element, str);
+        strings.emplace_back(std::move(str));
+      }
+      benchmark::DoNotOptimize(strings.data());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kStringCount);
+}
+BENCHMARK(BM_StringArrayFromJs)->ArgName("arena")->Arg(0)->Arg(1);
+
+// run(callback, flags), runs the benchmarks selected by the google benchmark
+// flags, delivering events to callback, returns how many ran
+napi_value run(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[2];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+  std::vector<std::string> flags = {"plugin_bench"};
+  uint32_t length = 0;
+  NAPI_CALL(env, napi_get_array_length(env, args[1], &length));
+  for (uint32_t i = 0; i < length; i++) {
+    napi_value element;
+    NAPI_CALL(env, napi_get_element(env, args[1], i, &element));
+    std::string flag;
+    NAPI_CALL(env, napi_get_value_utf8string(env, element, flag));
+    flags.emplace_back(flag);
+  }
+
+  std::vector<char *> argv;
+  for (auto &flag : flags) argv.push_back(&flag[0]);
+  int count = (int)argv.size();
+  benchmark::Initialize(&count, argv.data());
+  if (benchmark::ReportUnrecognizedArguments(count, argv.data()))
+    return nullptr;
+
+  _env = env;
+  _callback = args[0];
+  size_t ran = benchmark::RunSpecifiedBenchmarks();
+  _env = nullptr;
+  _callback = nullptr;
+
+  napi_value result;
+  NAPI_CALL(env, napi_create_uint32(env, (uint32_t)ran, &result));
+  return result;
+}
+
+napi_value init(napi_env env, napi_value exports) {
+  NAPI_DEFINE_FUNC(env, exports, run, "run");
+  return exports;
+}
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, init);
+}  // namespace
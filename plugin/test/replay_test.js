@@ -0,0 +1,127 @@
+// Record the raw events of the simulated desktop in a child process, then
+// replay the trace to the plugin as fast as possible, at an accelerated and
+// at the recorded pace and check that all of them deliver the same events to
+// js.
+// Usage: node replay_test.js <agora_plugin_sim.node>
+const assert = require('assert');
+const childProcess = require('child_process');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const WINDOWS = 8;
+const MOVED = 3;
+const MOVING = 4;
+const RESIZED = 5;
+
+const addonPath = path.resolve(process.argv[2]);
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+// read by the monitor core when the first window is registered
+process.env.WINDOW_MONITOR_BACKEND = 'simulated';
+process.env.WINDOW_MONITOR_SIMULATED_WINDOWS = `${WINDOWS}`;
+
+// node replay_test.js <addon> record <trace>, prints the count recorded
+const record = async (plugin, tracePath) => {
+  for (let winId = 1; winId <= WINDOWS; winId += 1) {
+    plugin.registerWindowMonitor(winId, () => {});
+  }
+  assert.strictEqual(plugin.stopWindowMonitorRecording(), -1);
+  assert.strictEqual(plugin.startWindowMonitorRecording(tracePath), true);
+  assert.strictEqual(plugin.startWindowMonitorRecording(tracePath), false);
+  await sleep(200);
+  const recorded = plugin.stopWindowMonitorRecording();
+  for (let winId = 1; winId <= WINDOWS; winId += 1) {
+    plugin.unregisterWindowMonitor(winId);
+  }
+  console.log(recorded);
+};
+
+// What is deterministic whatever the pace: the state changes in order and
+// the latest geometry of every window, moves and resizes of a window are
+// coalesced into one update.
+const replay = async (plugin, tracePath, speed) => {
+  const windows = {};
+  for (let winId = 1; winId <= WINDOWS; winId += 1) {
+    windows[winId] = { states: [], latest: null };
+    plugin.registerWindowMonitor(winId, (id, event, bounds) => {
+      const rect = [bounds.left, bounds.top, bounds.right, bounds.bottom];
+      if (event === MOVED || event === MOVING || event === RESIZED) {
+        windows[id].latest = [event, rect];
+      } else {
+        windows[id].states.push([event, rect]);
+      }
+    });
+  }
+  // the rects reported by registering are not part of the trace
+  await sleep(50);
+  Object.values(windows).forEach((window) => {
+    window.states.length = 0;
+    window.latest = null;
+  });
+
+  const replayed = await (speed === undefined
+    ? plugin.replayWindowMonitorTrace(tracePath)
+    : plugin.replayWindowMonitorTrace(tracePath, speed));
+  await sleep(100);
+  for (let winId = 1; winId <= WINDOWS; winId += 1) {
+    plugin.unregisterWindowMonitor(winId);
+  }
+  return { replayed, windows };
+};
+
+const main = async () => {
+  // eslint-disable-next-line import/no-dynamic-require
+  const plugin = require(addonPath);
+  if (process.argv[3] === 'record') {
+    await record(plugin, process.argv[4]);
+    return;
+  }
+
+  const tracePath = path.join(
+    os.tmpdir(),
+    `agora_plugin_replay_${process.pid}.wmtr`
+  );
+  const child = childProcess.spawnSync(
+    process.execPath,
+    [__filename, addonPath, 'record', tracePath],
+    {
+      env: { ...process.env, WINDOW_MONITOR_SIMULATED_RATE: '20000' },
+      encoding: 'utf8',
+    }
+  );
+  assert.strictEqual(child.status, 0, `recording failed: ${child.stderr}`);
+  const recorded = parseInt(child.stdout, 10);
+  assert(recorded > 0, 'nothing recorded');
+
+  const fast = await replay(plugin, tracePath, 0);
+  const paced = await replay(plugin, tracePath, 4);
+  // without a speed the trace replays at the recorded pace
+  const recordedPace = await replay(plugin, tracePath);
+  fs.unlinkSync(tracePath);
+
+  assert.strictEqual(fast.replayed, recorded);
+  assert.strictEqual(paced.replayed, recorded);
+  assert.strictEqual(recordedPace.replayed, recorded);
+  assert.deepStrictEqual(paced.windows, fast.windows);
+  assert.deepStrictEqual(recordedPace.windows, fast.windows);
+  const states = Object.values(fast.windows).reduce(
+    (count, window) => count + window.states.length,
+    0
+  );
+  assert(states > 0, 'no state change replayed');
+
+  await plugin.replayWindowMonitorTrace(tracePath, 0).then(
+    () => assert.fail('replayed a missing trace'),
+    (error) => assert(error instanceof Error)
+  );
+
+  console.log(`${recorded} events recorded, ${states} state changes replayed`);
+};
+
+main()
+  .then(() => process.exit(0))
+  .catch((error) => {
+    console.error(`replay test failed: ${error.message}`);
+    process.exit(1);
+  });
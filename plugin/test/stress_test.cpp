@@ -0,0 +1,357 @@
+// Random interleavings of register, unregister, fire, close and teardown on
+// many threads, to be run under ThreadSanitizer or AddressSanitizer, see
+// PLUGIN_SANITIZER in CMakeLists.txt.
+//
+// async_queue is hammered by producers on every lane while its lanes are
+// closed and reopened. Then the whole path of the plugin runs: the simulated
+// desktop and extra hook threads report raw events to a MonitorCore, whose
+// callback fires them into a hub like plugin.cc does, and env threads with a
+// loop each register and unregister windows, tear their events down and
+// drain them, while the raw events are recorded to an event trace.
+// Usage: stress_test [--quick] [seed]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../window-monitor/src/core/monitor_core.h"
+#include "../window-monitor/src/simulated/simulated_backend.h"
+#include "napi_event.h"
+#include "napi_stub.h"
+
+using namespace agora::plugin;
+using namespace agora::plugin::windowmonitor;
+
+namespace {
+
+struct StressPayload {
+  int32_t event;
+  float left;
+};
+
+}  // namespace
+
+namespace agora {
+namespace plugin {
+
+template <>
+struct NodeValoranEventPacker<WNDID, StressPayload> {
+  static const int argc = 2;
+  static void Pack(napi_env& env,
+                   const NodeValoranEventRecord<WNDID, StressPayload>& record,
+                   napi_value argv[]) {
+    NAPI_CALL_NORETURN(env, napi_create_int32(env, record.payload.event,
+                                              &argv[0]));
+    NAPI_CALL_NORETURN(env,
+                       napi_create_double(env, record.payload.left, &argv[1]));
+  }
+
+  static const int batch_fields = 2;
+  static void PackBatch(
+      const NodeValoranEventRecord<WNDID, StressPayload>& record,
+      double data[]) {
+    data[0] = record.payload.event;
+    data[1] = record.payload.left;
+  }
+};
+
+}  // namespace plugin
+}  // namespace agora
+
+#define EXPECT(cond)                                                   \
+  do {                                                                 \
+    if (!(cond)) {                                                     \
+      printf("%s:%d expect failed: %s\r\n", __FILE__, __LINE__, #cond); \
+      return false;                                                    \
+    }                                                                  \
+  } while (0)
+
+namespace {
+
+using StressEvents = NodeValoranEventBase<WNDID, StressPayload>;
+using StressHub = NodeValoranEventHub<WNDID, StressPayload>;
+
+const size_t kWindows = 32;
+
+struct StressOptions {
+  uint32_t seed;
+  int producers;
+  int calls;
+  int envs;
+  int env_ops;
+  int hooks;
+  int hook_ops;
+};
+
+static std::atomic<uint64_t> _delivered(0);
+static std::atomic<uint64_t> _fired(0);
+
+void countCall(size_t argc, const double argv[]) {
+  _delivered.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool testQueueChurn(const StressOptions& options) {
+  uv_loop_t loop;
+  uv_loop_init(&loop);
+
+  // only touched on this thread, the uv thread
+  uint64_t executed = 0;
+  bool sentinel = false;
+  auto queue = new async_queue<uint64_t>(
+      &loop,
+      [&](uint64_t& value) {
+        executed++;
+        if (value == UINT64_MAX) sentinel = true;
+      },
+      3);
+  queue->set_lane(0, 0, async_drop_policy::never_drop);
+  queue->set_lane(1, 64, async_drop_policy::drop_oldest);
+  queue->set_lane(2, 32, async_drop_policy::drop_newest);
+
+  std::atomic<uint64_t> accepted(0);
+  std::atomic<bool> producing(true);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < options.producers; i++) {
+    threads.emplace_back([&, i] {
+      std::minstd_rand rng(options.seed + i);
+      for (int n = 0; n < options.calls; n++) {
+        if (!queue->async_call((uint64_t)n, 0, rng() % 3))
+          accepted.fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+  }
+
+  // closes and reopens the queue and changes the budget under the producers
+  std::thread chaos([&] {
+    std::minstd_rand rng(options.seed);
+    while (producing.load()) {
+      queue->close(true);
+      std::this_thread::yield();
+      queue->close(false);
+      queue->set_budget(rng() % 64, rng() % 2 ? 0 : 200);
+      for (int i = rng() % 64; i > 0; i--) std::this_thread::yield();
+    }
+  });
+
+  uv_async_t stop;
+  uv_async_init(&loop, &stop, [](uv_async_t* handle) { uv_stop(handle->loop); });
+  std::thread watcher([&] {
+    for (auto& thread : threads) thread.join();
+    producing.store(false);
+    chaos.join();
+    uv_async_send(&stop);
+  });
+
+  uv_run(&loop, UV_RUN_DEFAULT);
+  watcher.join();
+
+  // reopened, the never dropping lane still delivers
+  queue->set_budget(0, 0);
+  EXPECT(queue->async_call(UINT64_MAX, 0, 0) == 0);
+  while (!sentinel) uv_run(&loop, UV_RUN_ONCE);
+  EXPECT(executed <= accepted.load() + 1);
+
+  queue->close(true);
+  EXPECT(queue->async_call(1, 0, 0) != 0);
+
+  delete queue;
+  uv_close((uv_handle_t*)&stop, nullptr);
+  uv_run(&loop, UV_RUN_DEFAULT);
+  uv_loop_close(&loop);
+  return true;
+}
+
+// The plugin side of the pipeline, mirrors PluginInstance of plugin.cc.
+static StressHub _hub;
+static std::mutex _register_lock;
+static MonitorCore* _core = nullptr;
+
+void onMonitorEvent(WNDID id, EventType type, CRect rect) {
+  _fired.fetch_add(1, std::memory_order_relaxed);
+  StressPayload payload = {(int32_t)type, rect.left};
+  uint64_t captured = MonitorCore::CurrentTimestamp();
+  switch (type) {
+    case EventType::Moving:
+      _hub.FireLatest(id, payload, kEventPriorityLow, captured);
+      break;
+    case EventType::Moved:
+    case EventType::Resized:
+      _hub.FireLatest(id, payload, kEventPriorityNormal, captured);
+      break;
+    default:
+      _hub.Fire(id, payload, kEventPriorityHigh, captured);
+      break;
+  }
+}
+
+WNDID windowAt(WNDID first, size_t index) {
+  return (WNDID)((uintptr_t)first + index);
+}
+
+void registerWindow(StressEvents* events, WNDID id, bool batch) {
+  {
+    std::lock_guard<std::mutex> guard(_register_lock);
+    if (!_hub.Subscribed(id, events) && _hub.Subscribe(id, events) &&
+        _core->Register(id, onMonitorEvent) != ErrorCode::Success) {
+      _hub.Unsubscribe(id, events);
+    }
+  }
+
+  if (batch)
+    events->AddBatchEvent(id, (napi_env)napi_stub::FakeEnv(),
+                          (napi_value)napi_stub::FakeFunction(), nullptr);
+  else
+    events->AddEvent(id, (napi_env)napi_stub::FakeEnv(),
+                     (napi_value)napi_stub::FakeFunction(), nullptr);
+}
+
+void unregisterWindow(StressEvents* events, WNDID id) {
+  {
+    std::lock_guard<std::mutex> guard(_register_lock);
+    if (_hub.Unsubscribe(id, events)) _core->Unregister(id);
+  }
+  events->RemoveEvent(id);
+}
+
+void detach(StressEvents* events) {
+  std::lock_guard<std::mutex> guard(_register_lock);
+  for (auto id : _hub.UnsubscribeAll(events)) _core->Unregister(id);
+}
+
+// A js thread with its own loop, like a node worker running the plugin.
+void runEnv(const StressOptions& options, int index, WNDID first) {
+  std::minstd_rand rng(options.seed * 31 + index);
+  uv_loop_t loop;
+  uv_loop_init(&loop);
+  std::unique_ptr<StressEvents> events(new StressEvents(&loop));
+
+  for (int op = 0; op < options.env_ops; op++) {
+    const WNDID id = windowAt(first, rng() % kWindows);
+    switch (rng() % 10) {
+      case 0:
+      case 1:
+      case 2:
+        registerWindow(events.get(), id, rng() % 4 == 0);
+        break;
+      case 3:
+      case 4:
+        unregisterWindow(events.get(), id);
+        break;
+      case 5:
+        // the env goes away and a new one comes up on the same thread
+        if (rng() % 8 == 0) {
+          detach(events.get());
+          events.reset(new StressEvents(&loop));
+        }
+        break;
+      case 6:
+        events->SetLane(kEventPriorityLow, rng() % 128,
+                        async_drop_policy::drop_newest);
+        events->SetDrainBudget(rng() % 32, 0);
+        if (rng() % 16 == 0) events->ResetStats();
+        break;
+      case 7: {
+        CRect rect;
+        _core->GetWindowRect(id, rect);
+        break;
+      }
+      default:
+        break;
+    }
+    uv_run(&loop, UV_RUN_NOWAIT);
+  }
+
+  detach(events.get());
+  events.reset();
+  uv_run(&loop, UV_RUN_DEFAULT);
+  uv_loop_close(&loop);
+}
+
+// More threads reporting raw events, like hooks of several processes.
+void runHooks(const StressOptions& options, int index, WNDID first) {
+  std::minstd_rand rng(options.seed * 17 + index);
+  const RawEventKind kinds[] = {RawLocationChange, RawLocationChange,
+                                RawMoved,          RawResized,
+                                RawShow,           RawHide,
+                                RawFocus,          RawUnfocus};
+  for (int op = 0; op < options.hook_ops; op++) {
+    RawEvent event;
+    event.id = windowAt(first, rng() % (kWindows + 4));
+    event.kind = kinds[rng() % (sizeof(kinds) / sizeof(kinds[0]))];
+    event.state = WindowStateNormal;
+    event.has_rect = rng() % 2 == 0;
+    event.rect = CRect((float)op, 0.f, (float)op + 100.f, 100.f);
+    event.timestamp = 0;
+    _core->OnRawEvent(event);
+  }
+}
+
+bool testPipeline(const StressOptions& options) {
+  // even seeds share one subscription between the windows of an owner
+  SimulatedBackend::Options backend_options =
+      SimulatedBackend::DefaultOptions();
+  backend_options.shared_sources = options.seed % 2 == 0;
+  SimulatedBackend* backend = new SimulatedBackend(backend_options);
+  MonitorCore core{std::unique_ptr<Backend>(backend)};
+  _core = &core;
+  const WNDID first = backend->AddWindows(kWindows);
+  backend->Start(100000);
+  const char* trace = "stress_test.wmtr";
+  EXPECT(core.StartRecording(trace));
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < options.envs; i++)
+    threads.emplace_back(runEnv, std::cref(options), i, first);
+  for (int i = 0; i < options.hooks; i++)
+    threads.emplace_back(runHooks, std::cref(options), i, first);
+  for (auto& thread : threads) thread.join();
+
+  backend->Stop();
+  _core = nullptr;
+  EXPECT(core.StopRecording() > 0);
+  remove(trace);
+
+  EXPECT(core.size() == 0);
+  EXPECT(_hub.size() == 0);
+  EXPECT(backend->attached_count() == 0);
+  EXPECT(backend->hook_count() == 0);
+  EXPECT(_fired.load() > 0);
+  EXPECT(_delivered.load() > 0);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  bool quick = false;
+  StressOptions options;
+  options.seed = 1;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--quick") == 0)
+      quick = true;
+    else
+      options.seed = (uint32_t)strtoul(argv[i], nullptr, 10);
+  }
+  options.producers = 8;
+  options.calls = quick ? 20000 : 500000;
+  options.envs = 3;
+  options.env_ops = quick ? 4000 : 100000;
+  options.hooks = 4;
+  options.hook_ops = quick ? 20000 : 500000;
+
+  printf("seed %u\r\n", options.seed);
+  napi_stub::SetCallHook(countCall);
+
+  bool ok = testQueueChurn(options) && testPipeline(options);
+  printf("%llu fired, %llu delivered\r\n",
+         (unsigned long long)_fired.load(),
+         (unsigned long long)_delivered.load());
+  printf("%s\r\n", ok ? "stress test passed" : "stress test failed");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+// Cost of the trace call sites on the event path: events fired through
+// NodeValoranEventBase and delivered to a stub js callback, with tracing
+// stopped and running. trace_bench_notrace is the same source built with
+// AGORA_PLUGIN_TRACING=0, its numbers are those without any call site.
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+
+#include "napi_event.h"
+#include "napi_stub.h"
+
+using namespace agora::plugin;
+
+namespace {
+
+struct BenchPayload {
+  int event;
+  double value;
+};
+
+}  // namespace
+
+namespace agora {
+namespace plugin {
+
+template <>
+struct NodeValoranEventPacker<int, BenchPayload> {
+  static const int argc = 2;
+  static void Pack(napi_env& env,
+                   const NodeValoranEventRecord<int, BenchPayload>& record,
+                   napi_value argv[]) {
+    NAPI_CALL_NORETURN(env, napi_create_int32(env, record.key, &argv[0]));
+    NAPI_CALL_NORETURN(env,
+                       napi_create_double(env, record.payload.value, &argv[1]));
+  }
+
+  static const int batch_fields = 2;
+  static void PackBatch(const NodeValoranEventRecord<int, BenchPayload>& record,
+                        double data[]) {
+    data[0] = record.key;
+    data[1] = record.payload.value;
+  }
+};
+
+}  // namespace plugin
+}  // namespace agora
+
+namespace {
+
+using BenchEvents = NodeValoranEventBase<int, BenchPayload>;
+
+const int kRounds = 5;
+// below the ring size, one drain delivers a burst
+const int kBurst = 512;
+
+void ignoreCall(size_t argc, const double argv[]) {}
+
+// best of kRounds, nanoseconds per event fired and delivered
+double measure(uv_loop_t* loop, int events) {
+  BenchEvents queue(loop);
+  queue.AddEvent(1, (napi_env)napi_stub::FakeEnv(),
+                 (napi_value)napi_stub::FakeFunction(), nullptr);
+
+  double best = 0;
+  for (int round = 0; round < kRounds; round++) {
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < events; i += kBurst) {
+      for (int b = 0; b < kBurst; b++) {
+        queue.Fire(1, BenchPayload{1, (double)b}, kEventPriorityHigh);
+      }
+      uv_run(loop, UV_RUN_NOWAIT);
+    }
+    double ns = std::chrono::duration<double, std::nano>(
+                    std::chrono::steady_clock::now() - begin)
+                    .count() /
+                events;
+    if (!round || ns < best) best = ns;
+  }
+  return best;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+  const int events = quick ? 100000 : 2000000;
+
+  uv_loop_t loop;
+  uv_loop_init(&loop);
+  napi_stub::SetCallHook(ignoreCall);
+
+#if AGORA_PLUGIN_TRACING
+  double stopped = measure(&loop, events);
+  printf("tracing stopped      %6.1f ns/event\r\n", stopped);
+
+  // every thread keeps kEventsPerThread events, the rest are dropped
+  napi_tracer::start();
+  double running = measure(&loop, events);
+  std::string path = std::string(P_tmpdir) + "/trace_bench.json";
+  int64_t written = napi_tracer::stop(path.c_str());
+  remove(path.c_str());
+  printf("tracing running      %6.1f ns/event, %lld trace events\r\n",
+         running, (long long)written);
+#else
+  printf("tracing compiled out %6.1f ns/event\r\n", measure(&loop, events));
+#endif
+
+  uv_run(&loop, UV_RUN_DEFAULT);
+  uv_loop_close(&loop);
+  return 0;
+}
@@ -0,0 +1,75 @@
+// Trace the plugin on the simulated desktop and check that the Chrome JSON
+// trace it writes parses and has spans of every stage of the pipeline.
+// Usage: node trace_test.js <agora_plugin_sim.node>
+const assert = require('assert');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+// read by the monitor core when the first window is registered
+process.env.WINDOW_MONITOR_BACKEND = 'simulated';
+process.env.WINDOW_MONITOR_SIMULATED_WINDOWS = '16';
+process.env.WINDOW_MONITOR_SIMULATED_RATE = '20000';
+
+// eslint-disable-next-line import/no-dynamic-require
+const plugin = require(path.resolve(process.argv[2]));
+
+const WINDOWS = 16;
+const tracePath = path.join(os.tmpdir(), `agora_plugin_trace_${process.pid}.json`);
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+(async () => {
+  assert.strictEqual(plugin.stopTracing(), -1, 'stopped while not tracing');
+  assert.strictEqual(plugin.startTracing(tracePath), true);
+  assert.strictEqual(plugin.startTracing(tracePath), false);
+
+  let received = 0;
+  for (let winId = 1; winId <= WINDOWS; winId += 1) {
+    plugin.registerWindowMonitor(winId, () => {
+      received += 1;
+    });
+  }
+  plugin.getWindowRect(1);
+  await sleep(200);
+  for (let winId = 1; winId <= WINDOWS; winId += 1) {
+    plugin.unregisterWindowMonitor(winId);
+  }
+
+  const written = plugin.stopTracing();
+  const trace = JSON.parse(fs.readFileSync(tracePath, 'utf8'));
+  fs.unlinkSync(tracePath);
+  assert.strictEqual(trace.traceEvents.length, written);
+
+  const counts = {};
+  trace.traceEvents.forEach((event) => {
+    counts[event.name] = (counts[event.name] || 0) + 1;
+    if (event.ph === 'X') {
+      assert(event.ts > 0 && event.dur >= 0, `bad span ${event.name}`);
+    }
+  });
+  [
+    'simulated_batch',
+    'classify',
+    'callback',
+    'get_window_rect',
+    'async_call',
+    'drain',
+    'js_callback',
+  ].forEach((name) => assert(counts[name] > 0, `no ${name} span`));
+  assert.strictEqual(counts.js_callback, received, 'js callbacks not traced');
+
+  const names = trace.traceEvents
+    .filter((event) => event.ph === 'M')
+    .map((event) => event.args.name);
+  assert(names.includes('js'), 'js thread is not named');
+
+  console.log(
+    `${written} trace events: ${Object.keys(counts)
+      .map((name) => `${name} ${counts[name]}`)
+      .join(', ')}`
+  );
+  process.exit(0);
+})().catch((error) => {
+  console.error(`trace test failed: ${error.message}`);
+  process.exit(1);
+});
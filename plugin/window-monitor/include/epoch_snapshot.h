@@ -0,0 +1,171 @@
+#ifndef AGORA_WINDOW_MONITOR_EPOCH_SNAPSHOT_H
+#define AGORA_WINDOW_MONITOR_EPOCH_SNAPSHOT_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace agora {
+namespace plugin {
+
+// Readers of every epoch_snapshot of the process, those of the window
+// registry and those of the plugin alike, announce the epoch they read in,
+// writers wait for the readers which may still see what they replaced.
+// Reader records are never freed, a thread which exits leaves its record to
+// the next one.
+class epoch_domain {
+ public:
+  // Scopes of a thread nest, it reads in the epoch of the outermost one.
+  static void enter() {
+    reader* self = current();
+    if (self->depth++ == 0) self->epoch.store(clock().load());
+  }
+
+  static void leave() {
+    reader* self = current();
+    if (--self->depth == 0) self->epoch.store(0, std::memory_order_release);
+  }
+
+  // Whether the calling thread is inside a read scope.
+  static bool reading() { return current()->depth > 0; }
+
+  // Waits until the readers which entered before it have left, never call it
+  // inside a read scope.
+  static void synchronize() {
+    const uint64_t epoch = clock().fetch_add(1) + 1;
+    for (reader* item = readers().load(std::memory_order_acquire); item;
+         item = item->next) {
+      while (true) {
+        const uint64_t seen = item->epoch.load();
+        if (seen == 0 || seen >= epoch) break;
+        std::this_thread::yield();
+      }
+    }
+  }
+
+ private:
+  struct reader {
+    std::atomic<uint64_t> epoch;
+    std::atomic<bool> used;
+    // only touched by the thread owning the record
+    uint32_t depth;
+    reader* next;
+  };
+
+  struct thread_reader {
+    thread_reader() : self(acquire()) {}
+    ~thread_reader() { self->used.store(false, std::memory_order_release); }
+    reader* self;
+  };
+
+  static std::atomic<uint64_t>& clock() {
+    static std::atomic<uint64_t> epoch(1);
+    return epoch;
+  }
+
+  static std::atomic<reader*>& readers() {
+    static std::atomic<reader*> head(nullptr);
+    return head;
+  }
+
+  static reader* acquire() {
+    for (reader* item = readers().load(std::memory_order_acquire); item;
+         item = item->next) {
+      bool used = false;
+      if (item->used.compare_exchange_strong(used, true)) return item;
+    }
+
+    reader* item = new reader();
+    item->epoch.store(0);
+    item->used.store(true);
+    item->depth = 0;
+    item->next = readers().load(std::memory_order_relaxed);
+    while (!readers().compare_exchange_weak(item->next, item,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+    }
+    return item;
+  }
+
+  static reader* current() {
+    thread_local thread_reader local;
+    return local.self;
+  }
+};
+
+// What epoch_snapshot::read returns stays alive until the scope ends.
+class epoch_read_scope {
+ public:
+  epoch_read_scope() { epoch_domain::enter(); }
+  ~epoch_read_scope() { epoch_domain::leave(); }
+
+  epoch_read_scope(const epoch_read_scope&) = delete;
+  epoch_read_scope& operator=(const epoch_read_scope&) = delete;
+};
+
+// Value read on every event and changed rarely, like the registered windows
+// or the subscribers of a hub. Readers never wait, writers are serialized, publish a changed copy and
+// free the replaced one once no reader may see it anymore. A writer inside a
+// read scope cannot wait for the others, it leaves what it replaced to the
+// next writer outside of one.
+template <typename T>
+class epoch_snapshot {
+  epoch_snapshot(const epoch_snapshot&) = delete;
+  epoch_snapshot& operator=(const epoch_snapshot&) = delete;
+
+ public:
+  epoch_snapshot() : value_(new T()) {}
+
+  // no reader is left
+  ~epoch_snapshot() {
+    delete value_.load();
+    for (const T* item : retired_) delete item;
+  }
+
+  // Only inside an epoch_read_scope.
+  const T& read() const { return *value_.load(); }
+
+  // Publishes what build makes of the current value, build returns null to
+  // leave it. Outside of a read scope it returns once no reader sees the
+  // replaced values anymore. Returns whether build made a new value.
+  template <typename F>
+  bool replace(F&& build) {
+    std::vector<const T*> replaced;
+    {
+      std::lock_guard<std::mutex> guard(write_lock_);
+      const T* next = build(*value_.load(std::memory_order_relaxed));
+      if (!next) return false;
+      retired_.push_back(value_.exchange(next));
+      if (epoch_domain::reading()) return true;
+      replaced.swap(retired_);
+    }
+    // never waits holding the lock, writers inside a read scope take it
+    epoch_domain::synchronize();
+    for (const T* item : replaced) delete item;
+    return true;
+  }
+
+  // Applies change to a copy and publishes it, see replace.
+  template <typename F>
+  void update(F&& change) {
+    replace([&change](const T& current) {
+      T* next = new T(current);
+      change(*next);
+      return next;
+    });
+  }
+
+ private:
+  std::mutex write_lock_;
+  std::atomic<const T*> value_;
+  // replaced by writers inside a read scope, guarded by write_lock_
+  std::vector<const T*> retired_;
+};
+
+}  // namespace plugin
+}  // namespace agora
+
+#endif  // AGORA_WINDOW_MONITOR_EPOCH_SNAPSHOT_H
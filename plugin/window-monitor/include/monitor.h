@@ -4,6 +4,7 @@
 #if defined(_WIN32)
 #include <Windows.h>
 #endif
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "export.h"
@@ -36,6 +37,10 @@ typedef enum _EventType{
   Minimized,
   Maxmized,
   Restore,
+  // a drag of the window started, the updates until GestureEnded are Moving
+  GestureStarted,
+  // the drag ended, after its final Moved, see getEventGesture
+  GestureEnded,
 } EventType;
 
 /**
@@ -43,7 +48,7 @@ typedef enum _EventType{
  */
 #if defined(_WIN32)
 typedef HWND WNDID;
-#elif defined(__APPLE__)
+#else
 typedef uint32_t WNDID;
 #endif
 
@@ -60,11 +65,73 @@ typedef struct _CRECT {
       : left(left), top(top), right(right), bottom(bottom) {}
 } CRect;
 
+/**
+ * @brief Events reported to the callback of a window, the monitor drops the
+ * others before it looks up anything about them.
+ */
+typedef struct _EventFilter {
+  // bit 1 << EventType of every type reported
+  uint32_t types;
+  // Pixels an edge has to move since the rect last reported for Moving,
+  // Moved and Resized to be reported, 1 drops unchanged rects, 0 none. The
+  // end of a drag is only dropped when its rect is unchanged.
+  float min_delta;
+  _EventFilter() : types(0xffffffff), min_delta(0) {}
+  _EventFilter(uint32_t types, float min_delta)
+      : types(types), min_delta(min_delta) {}
+} EventFilter;
+
+/**
+ * @brief Counts of events dropped by the filters of the windows.
+ */
+typedef struct _EventFilterStats {
+  // events of types a window was not registered for
+  uint64_t types;
+  // geometry updates which moved no edge by the min delta
+  uint64_t unchanged;
+} EventFilterStats;
+
+/**
+ * @brief Summary of a move or resize gesture of a window.
+ */
+typedef struct _GestureSummary {
+  // rects when it started and ended
+  CRect start;
+  CRect end;
+  // steady clock microseconds when it started and how long it lasted
+  uint64_t timestamp;
+  uint64_t duration;
+  // updates of the rect the platform reported during it
+  uint32_t samples;
+  _GestureSummary() : timestamp(0), duration(0), samples(0) {}
+} GestureSummary;
+
+/**
+ * @brief Motion of a window being dragged, what the rects of its Moving are
+ * extrapolated from.
+ */
+typedef struct _WindowMotion {
+  // rect of the latest sample reported by the platform
+  CRect rect;
+  // steady clock microseconds when it was captured
+  uint64_t timestamp;
+  // pixels per microsecond of left, top, right and bottom
+  float velocity[4];
+  _WindowMotion() : timestamp(0), velocity() {}
+} WindowMotion;
+
 /**
  * @brief Window monitor event callback.
  */
 typedef void (*EventCallback)(WNDID, EventType, CRect);
 
+/**
+ * @brief Window monitor trace callback, called with the name of a span, the
+ * window it is about or zero, and when it began and ended in steady clock
+ * nanoseconds.
+ */
+typedef void (*TraceCallback)(const char*, WNDID, uint64_t, uint64_t);
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -87,6 +154,48 @@ bool MONITOR_EXPORT checkPrivileges();
 int MONITOR_EXPORT registerWindowMonitorCallback(WNDID id,
                                                  EventCallback callback);
 
+/**
+ * @brief Register a callback function with specified window id, reporting
+ * only the events which pass filter.
+ *
+ * @param id Window id.
+ * @param callback Callback function.
+ * @param filter Types and min delta reported, the first Moved is reported
+ * unless its type is filtered.
+ * @return Zero for success, others for error codes.
+ */
+int MONITOR_EXPORT registerWindowMonitorFilteredCallback(
+    WNDID id, EventCallback callback, EventFilter filter);
+
+/**
+ * @brief Change the filter of a registered window.
+ *
+ * @param id Window id.
+ * @param filter Types and min delta reported from now on.
+ * @return Zero for success, WindowNotFound when id is not registered.
+ */
+int MONITOR_EXPORT setWindowMonitorFilter(WNDID id, EventFilter filter);
+
+/**
+ * @brief Extrapolate the rects of Moving of a registered window to when they
+ * will be presented, from the recent samples of the drag. Moved and state
+ * changes report the rect of the platform and stop the extrapolation.
+ *
+ * @param id Window id.
+ * @param lead_us Microseconds past when an event is reported its rect is
+ * extrapolated to, zero reports the rects of the platform again.
+ * @return Zero for success, WindowNotFound when id is not registered.
+ */
+int MONITOR_EXPORT setWindowMonitorPrediction(WNDID id, uint32_t lead_us);
+
+/**
+ * @brief Get the counts of events dropped by filters since the monitor
+ * started.
+ *
+ * @param stats EventFilterStats
+ */
+void MONITOR_EXPORT getEventFilterStats(EventFilterStats& stats);
+
 /**
  * @brief Unregister callback function with specified window id.
  *
@@ -103,6 +212,95 @@ void MONITOR_EXPORT unregisterWindowMonitorCallback(WNDID id);
  */
 int MONITOR_EXPORT getWindowRect(WNDID id, CRect& crect);
 
+/**
+ * @brief Pace geometry updates to a frame rate: Moving and the moves and
+ * resizes of platforms without drag gestures wait for the next frame, only
+ * the latest rect of a window is reported then. The end of a drag and state
+ * changes are reported right away.
+ *
+ * @param rate Frames per second, zero reports every event as it happens,
+ * which is the default, and negative paces at the refresh rate of the
+ * display.
+ * @return double The frames per second now paced at, zero when not pacing.
+ */
+double MONITOR_EXPORT setFrameRate(double rate);
+
+/**
+ * @brief Get the capture time of the event being reported.
+ *
+ * @return uint64_t Steady clock microseconds when the event which is being
+ * passed to an EventCallback on the calling thread was captured, zero outside
+ * of a callback or when it is unknown.
+ */
+uint64_t MONITOR_EXPORT getEventTimestamp();
+
+/**
+ * @brief Get the summary of the gesture which ended.
+ *
+ * @param summary GestureSummary of the GestureEnded being passed to an
+ * EventCallback on the calling thread.
+ * @return false Outside of the callback of a GestureEnded.
+ */
+bool MONITOR_EXPORT getEventGesture(GestureSummary& summary);
+
+/**
+ * @brief Get the motion the rect of the Moving being reported was
+ * extrapolated from, for consumers predicting with leads of their own.
+ *
+ * @param motion WindowMotion of the Moving being passed to an EventCallback
+ * on the calling thread.
+ * @return false Outside of the callback of a Moving of a window with a
+ * prediction lead, or when the drag has no velocity yet.
+ */
+bool MONITOR_EXPORT getEventMotion(WindowMotion& motion);
+
+/**
+ * @brief Extrapolate a motion got by getEventMotion lead_us microseconds
+ * past now, like setWindowMonitorPrediction does at most 100 ms past the
+ * sample.
+ *
+ * @param motion WindowMotion
+ * @param lead_us Microseconds past now, zero for the rect of now.
+ * @param crect Extrapolated rect.
+ */
+void MONITOR_EXPORT predictWindowRect(const WindowMotion& motion,
+                                      uint32_t lead_us, CRect& crect);
+
+/**
+ * @brief Set the callback receiving the spans of the monitor.
+ *
+ * @param callback Trace callback, null stops tracing.
+ */
+void MONITOR_EXPORT setTraceCallback(TraceCallback callback);
+
+/**
+ * @brief Start writing the raw events of the monitor to a binary event trace,
+ * which replayEventTrace can feed to the monitor again.
+ *
+ * @param path File the trace is written to, replaced when it exists.
+ * @return false When the file can not be written or already recording.
+ */
+bool MONITOR_EXPORT startEventRecording(const char* path);
+
+/**
+ * @brief Stop writing the event trace.
+ *
+ * @return int64_t Count of events recorded, -1 when not recording or writing
+ * failed.
+ */
+int64_t MONITOR_EXPORT stopEventRecording();
+
+/**
+ * @brief Report the events of a trace to the registered callbacks as if the
+ * platform reported them, blocks until all are reported.
+ *
+ * @param path Trace written by startEventRecording.
+ * @param speed Multiple of the recorded pace, zero or less for as fast as
+ * possible.
+ * @return int64_t Count of events replayed, -1 when path is not a trace.
+ */
+int64_t MONITOR_EXPORT replayEventTrace(const char* path, double speed);
+
 #ifdef __cplusplus
 }
 #endif  // __cplusplus
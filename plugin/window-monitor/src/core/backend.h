@@ -0,0 +1,82 @@
+#ifndef AGORA_PLUGIN_WINDOW_MONITOR_BACKEND_H
+#define AGORA_PLUGIN_WINDOW_MONITOR_BACKEND_H
+
+#include <memory>
+
+#include "monitor.h"
+#include "monitor_thread.h"
+#include "raw_event.h"
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+class BackendSink {
+ public:
+  virtual ~BackendSink() {}
+
+  // Called on the thread the backend observes windows on, the monitor thread
+  // unless the platform reports on threads of its own.
+  virtual void OnRawEvent(const RawEvent& event) = 0;
+
+  // Whether events of id are wanted, for backends whose subscriptions report
+  // windows which were not attached, checked before querying the platform.
+  virtual bool Observes(WNDID id) const { return true; }
+};
+
+/**
+ * @brief Platform part of the window monitor, it observes windows and reports
+ * what happened to them as raw events, the MonitorCore does the rest.
+ */
+class Backend {
+ public:
+  Backend() : sink_(nullptr) {}
+  Backend(const Backend&) = delete;
+  virtual ~Backend() {}
+
+  void SetSink(BackendSink* sink) { sink_ = sink; }
+
+  virtual bool CheckPrivileges() = 0;
+
+  // Pump of the monitor thread the core runs, which platforms reporting
+  // through a loop of the thread which subscribed replace. The default only
+  // runs tasks.
+  virtual std::unique_ptr<MonitorLoop> CreateLoop() {
+    return std::unique_ptr<MonitorLoop>(new TaskLoop());
+  }
+
+  // Start reporting raw events of id, returns an ErrorCode. Attach and Detach
+  // are called on the monitor thread, never concurrently.
+  virtual int Attach(WNDID id) = 0;
+  virtual void Detach(WNDID id) = 0;
+
+  // Thread safe, the core also calls it on the threads of its callers.
+  virtual int GetWindowRect(WNDID id, CRect& crect) = 0;
+
+  // Refresh rate of the main display in frames per second, zero when
+  // unknown.
+  virtual double GetDisplayRate() { return 0; }
+
+  // Process owning id, zero when unknown.
+  virtual uint32_t GetWindowOwner(WNDID id) { return 0; }
+
+  // Windows with the same non zero source share one subscription of the
+  // platform, like the hooks of a thread on win32: the core attaches the
+  // first window of a source and detaches it with the last one, the backend
+  // reports the events of every window of the source and the core drops
+  // those of windows which are not registered. Zero, the default, attaches
+  // every window on its own.
+  virtual uint64_t GetEventSource(WNDID id) { return 0; }
+
+ protected:
+  BackendSink* sink_;
+};
+
+// Backend of the platform the library is built for, used by the default core.
+std::unique_ptr<Backend> CreatePlatformBackend();
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
+
+#endif  // AGORA_PLUGIN_WINDOW_MONITOR_BACKEND_H
@@ -0,0 +1,63 @@
+#include "event_filter.h"
+
+#include <math.h>
+
+#include "frame_pacer.h"
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+namespace {
+
+float maxEdgeDelta(const CRect& a, const CRect& b) {
+  float delta = fabsf(a.left - b.left);
+  delta = fmaxf(delta, fabsf(a.top - b.top));
+  delta = fmaxf(delta, fabsf(a.right - b.right));
+  return fmaxf(delta, fabsf(a.bottom - b.bottom));
+}
+
+}  // namespace
+
+EventFilters::EventFilters() : types_(0), unchanged_(0) {}
+
+bool EventFilters::AcceptType(const EventFilter& filter, EventType type) {
+  if (Reports(filter, type)) return true;
+  types_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+bool EventFilters::AcceptRect(WNDID id, const EventFilter& filter,
+                              EventType type, const CRect& crect,
+                              bool settled) {
+  if (!(filter.min_delta > 0) || !FramePacer::IsGeometry(type)) return true;
+
+  std::lock_guard<std::mutex> guard(lock_);
+  auto result = reported_.emplace(id, crect);
+  if (result.second) return true;
+
+  CRect& reported = result.first->second;
+  const float delta = maxEdgeDelta(reported, crect);
+  if (settled ? delta == 0 : delta < filter.min_delta) {
+    unchanged_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  reported = crect;
+  return true;
+}
+
+void EventFilters::Forget(WNDID id) {
+  std::lock_guard<std::mutex> guard(lock_);
+  reported_.erase(id);
+}
+
+EventFilterStats EventFilters::stats() const {
+  EventFilterStats stats;
+  stats.types = types_.load(std::memory_order_relaxed);
+  stats.unchanged = unchanged_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
@@ -0,0 +1,61 @@
+#ifndef AGORA_PLUGIN_WINDOW_MONITOR_EVENT_FILTER_H
+#define AGORA_PLUGIN_WINDOW_MONITOR_EVENT_FILTER_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+#include "monitor.h"
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+/**
+ * @brief Applies the EventFilter of windows to their events before they are
+ * dispatched and counts what it drops.
+ *
+ * The type check is lock free and comes before anything is looked up about
+ * an event. Only windows with a min delta pay for the delta check, which
+ * keeps the rect last reported for them under a lock of its own.
+ */
+class EventFilters {
+ public:
+  EventFilters();
+  EventFilters(const EventFilters&) = delete;
+
+  static bool Reports(const EventFilter& filter, EventType type) {
+    return (filter.types & (1u << type)) != 0;
+  }
+
+  // False and counted when filter drops type.
+  bool AcceptType(const EventFilter& filter, EventType type);
+
+  // False and counted when a geometry update moved no edge of the rect last
+  // reported for id by the min delta of filter, which remembers crect as the
+  // last reported otherwise. Settled updates, like the end of a drag, are
+  // only dropped when unchanged so the final rect always arrives.
+  bool AcceptRect(WNDID id, const EventFilter& filter, EventType type,
+                  const CRect& crect, bool settled = false);
+
+  // Forgets the rect last reported for id, once it is unregistered or its
+  // filter changed.
+  void Forget(WNDID id);
+
+  EventFilterStats stats() const;
+
+ private:
+  std::mutex lock_;
+  std::unordered_map<WNDID, CRect> reported_;
+
+  std::atomic<uint64_t> types_;
+  std::atomic<uint64_t> unchanged_;
+};
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
+
+#endif  // AGORA_PLUGIN_WINDOW_MONITOR_EVENT_FILTER_H
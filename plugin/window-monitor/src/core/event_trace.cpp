@@ -0,0 +1,158 @@
+#include "event_trace.h"
+
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+
+#include "monitor_core.h"
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+namespace {
+
+const char kMagic[4] = {'W', 'M', 'T', 'R'};
+const size_t kHeaderSize = 8;
+const uint8_t kFlagHasRect = 1 << 0;
+
+void putU16(uint8_t* out, uint16_t value) {
+  out[0] = (uint8_t)value;
+  out[1] = (uint8_t)(value >> 8);
+}
+
+void putU32(uint8_t* out, uint32_t value) {
+  for (int i = 0; i < 4; i++) out[i] = (uint8_t)(value >> (i * 8));
+}
+
+void putU64(uint8_t* out, uint64_t value) {
+  for (int i = 0; i < 8; i++) out[i] = (uint8_t)(value >> (i * 8));
+}
+
+void putFloat(uint8_t* out, float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  putU32(out, bits);
+}
+
+uint16_t getU16(const uint8_t* in) {
+  return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+uint32_t getU32(const uint8_t* in) {
+  uint32_t value = 0;
+  for (int i = 3; i >= 0; i--) value = (value << 8) | in[i];
+  return value;
+}
+
+uint64_t getU64(const uint8_t* in) {
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; i--) value = (value << 8) | in[i];
+  return value;
+}
+
+float getFloat(const uint8_t* in) {
+  uint32_t bits = getU32(in);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+}  // namespace
+
+EventTraceWriter::EventTraceWriter() : file_(nullptr), count_(0) {}
+
+EventTraceWriter::~EventTraceWriter() { Close(); }
+
+bool EventTraceWriter::Open(const char* path) {
+  Close();
+  file_ = fopen(path, "wb");
+  if (!file_) return false;
+
+  uint8_t header[kHeaderSize];
+  memcpy(header, kMagic, sizeof(kMagic));
+  putU16(header + 4, kVersion);
+  putU16(header + 6, kRecordSize);
+  fwrite(header, 1, sizeof(header), file_);
+  count_ = 0;
+  return true;
+}
+
+void EventTraceWriter::Write(const RawEvent& event) {
+  if (!file_) return;
+
+  uint8_t record[kRecordSize];
+  putU64(record, event.timestamp);
+  putU64(record + 8, (uint64_t)(uintptr_t)event.id);
+  record[16] = (uint8_t)event.kind;
+  record[17] = event.has_rect ? kFlagHasRect : 0;
+  putU16(record + 18, (uint16_t)event.state);
+  putFloat(record + 20, event.rect.left);
+  putFloat(record + 24, event.rect.top);
+  putFloat(record + 28, event.rect.right);
+  putFloat(record + 32, event.rect.bottom);
+  fwrite(record, 1, sizeof(record), file_);
+  count_++;
+}
+
+int64_t EventTraceWriter::Close() {
+  if (!file_) return -1;
+  bool failed = ferror(file_) != 0;
+  failed = fclose(file_) != 0 || failed;
+  file_ = nullptr;
+  return failed ? -1 : count_;
+}
+
+bool ReadEventTrace(const char* path, std::vector<RawEvent>& events) {
+  FILE* file = fopen(path, "rb");
+  if (!file) return false;
+
+  uint8_t header[kHeaderSize];
+  if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+      memcmp(header, kMagic, sizeof(kMagic)) != 0 ||
+      getU16(header + 6) < EventTraceWriter::kRecordSize) {
+    fclose(file);
+    return false;
+  }
+
+  std::vector<uint8_t> record(getU16(header + 6));
+  while (fread(record.data(), 1, record.size(), file) == record.size()) {
+    RawEvent event;
+    event.timestamp = getU64(&record[0]);
+    event.id = (WNDID)(uintptr_t)getU64(&record[8]);
+    event.kind = (RawEventKind)record[16];
+    event.has_rect = (record[17] & kFlagHasRect) != 0;
+    event.state = getU16(&record[18]);
+    event.rect = CRect(getFloat(&record[20]), getFloat(&record[24]),
+                       getFloat(&record[28]), getFloat(&record[32]));
+    events.push_back(event);
+  }
+
+  fclose(file);
+  return true;
+}
+
+int64_t ReplayEvents(const std::vector<RawEvent>& events, BackendSink* sink,
+                     double speed) {
+  if (events.empty()) return 0;
+
+  const uint64_t first = events.front().timestamp;
+  const auto begin = std::chrono::steady_clock::now();
+  for (const RawEvent& recorded : events) {
+    if (speed > 0 && recorded.timestamp > first) {
+      std::this_thread::sleep_until(
+          begin + std::chrono::microseconds(
+                      (uint64_t)((recorded.timestamp - first) / speed)));
+    }
+
+    RawEvent event = recorded;
+    event.timestamp = MonitorCore::Now();
+    sink->OnRawEvent(event);
+  }
+  return (int64_t)events.size();
+}
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
@@ -0,0 +1,63 @@
+#ifndef AGORA_PLUGIN_WINDOW_MONITOR_EVENT_TRACE_H
+#define AGORA_PLUGIN_WINDOW_MONITOR_EVENT_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <vector>
+
+#include "backend.h"
+#include "raw_event.h"
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+/**
+ * @brief Binary trace of raw events, to feed exactly what a user did to the
+ * core again in tests and benchmarks.
+ *
+ * An 8 byte header, "WMTR", the version and the size of a record, is
+ * followed by fixed size little endian records: steady clock microseconds,
+ * window id, kind, flags, state and rect. Readers skip the bytes of records
+ * larger than they know, so fields can be appended.
+ */
+class EventTraceWriter {
+ public:
+  static const uint16_t kVersion = 1;
+  static const uint16_t kRecordSize = 36;
+
+  EventTraceWriter();
+  EventTraceWriter(const EventTraceWriter&) = delete;
+  ~EventTraceWriter();
+
+  bool Open(const char* path);
+
+  // Not thread safe, the core serializes the writes.
+  void Write(const RawEvent& event);
+
+  // Returns the count of records written, -1 when writing failed.
+  int64_t Close();
+
+ private:
+  FILE* file_;
+  int64_t count_;
+};
+
+// Reads all the records of path, false when it is not a trace.
+bool ReadEventTrace(const char* path, std::vector<RawEvent>& events);
+
+/**
+ * @brief Reports events to sink on the calling thread at speed times their
+ * recorded pace, zero or less reports them as fast as possible. Timestamps
+ * are those of the replay so latencies are measured like for live events.
+ * Returns the count of events reported.
+ */
+int64_t ReplayEvents(const std::vector<RawEvent>& events, BackendSink* sink,
+                     double speed);
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
+
+#endif  // AGORA_PLUGIN_WINDOW_MONITOR_EVENT_TRACE_H
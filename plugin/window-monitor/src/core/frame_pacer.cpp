@@ -0,0 +1,152 @@
+#include "frame_pacer.h"
+
+#include <utility>
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+const double FramePacer::kDefaultDisplayRate = 60;
+
+FramePacer::FramePacer(Deliver deliver)
+    : deliver_(std::move(deliver)),
+      rate_(0),
+      period_(Clock::duration::zero()),
+      quit_(false),
+      coalesced_(0),
+      frames_(0) {}
+
+FramePacer::~FramePacer() {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    quit_ = true;
+    wake_.notify_one();
+  }
+  if (timer_.joinable()) timer_.join();
+}
+
+void FramePacer::SetRate(double rate) {
+  if (!(rate > 0)) rate = 0;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    rate_.store(rate);
+    if (rate > 0) {
+      period_ = std::chrono::duration_cast<Clock::duration>(
+          std::chrono::duration<double>(1 / rate));
+      // started by the first rate, it sleeps while nothing is pending
+      if (!timer_.joinable()) {
+        origin_ = Clock::now();
+        timer_ = std::thread(&FramePacer::Run, this);
+      }
+    } else {
+      period_ = Clock::duration::zero();
+    }
+    wake_.notify_one();
+  }
+
+  if (rate == 0) Flush();
+}
+
+void FramePacer::Submit(EventCallback callback, WNDID id, EventType type,
+                        const CRect& crect, uint64_t timestamp,
+                        bool settled) {
+  if (!active()) {
+    deliver_(callback, id, type, crect, timestamp);
+    return;
+  }
+
+  const bool geometry = IsGeometry(type);
+  if (geometry && !settled) {
+    std::unique_lock<std::mutex> guard(lock_);
+    // pacing stopped meanwhile
+    if (period_ == Clock::duration::zero()) {
+      guard.unlock();
+      deliver_(callback, id, type, crect, timestamp);
+      return;
+    }
+
+    const Update update = {callback, type, crect, timestamp};
+    auto result = pending_.emplace(id, update);
+    if (!result.second) {
+      result.first->second = update;
+      coalesced_.fetch_add(1, std::memory_order_relaxed);
+    } else if (pending_.size() == 1) {
+      wake_.notify_one();
+    }
+    return;
+  }
+
+  std::lock_guard<std::mutex> deliver_guard(deliver_lock_);
+  Update previous;
+  bool has_previous = false;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    auto itr = pending_.find(id);
+    if (itr != pending_.end()) {
+      previous = itr->second;
+      has_previous = true;
+      pending_.erase(itr);
+    }
+  }
+
+  if (has_previous) {
+    if (geometry) {
+      // the settled rect is the fresher one
+      coalesced_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      deliver_(previous.callback, id, previous.type, previous.crect,
+               previous.timestamp);
+    }
+  }
+  deliver_(callback, id, type, crect, timestamp);
+}
+
+void FramePacer::Drop(WNDID id) {
+  std::lock_guard<std::mutex> guard(lock_);
+  pending_.erase(id);
+}
+
+void FramePacer::Run() {
+  std::unique_lock<std::mutex> guard(lock_);
+  while (!quit_) {
+    if (pending_.empty() || period_ == Clock::duration::zero()) {
+      wake_.wait(guard);
+      continue;
+    }
+
+    const Clock::time_point frame = NextFrame(Clock::now());
+    if (wake_.wait_until(guard, frame) != std::cv_status::timeout) continue;
+
+    guard.unlock();
+    Flush();
+    guard.lock();
+  }
+}
+
+void FramePacer::Flush() {
+  std::lock_guard<std::mutex> deliver_guard(deliver_lock_);
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (pending_.empty()) return;
+    delivering_.swap(pending_);
+  }
+
+  frames_.fetch_add(1, std::memory_order_relaxed);
+  for (auto& item : delivering_) {
+    const Update& update = item.second;
+    deliver_(update.callback, item.first, update.type, update.crect,
+             update.timestamp);
+  }
+  delivering_.clear();
+}
+
+// frames are on a grid from when the timer started, the first one after now
+FramePacer::Clock::time_point FramePacer::NextFrame(
+    Clock::time_point now) const {
+  const auto frames = (now - origin_) / period_ + 1;
+  return origin_ + frames * period_;
+}
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
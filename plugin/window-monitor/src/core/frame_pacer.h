@@ -0,0 +1,116 @@
+#ifndef AGORA_PLUGIN_WINDOW_MONITOR_FRAME_PACER_H
+#define AGORA_PLUGIN_WINDOW_MONITOR_FRAME_PACER_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "monitor.h"
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+/**
+ * @brief Paces the geometry updates of windows to a frame rate, consumers
+ * drawing over a window need one rect per frame, not every notification of
+ * a drag.
+ *
+ * Updates wait for the next frame of a fixed grid, a fresher one of the same
+ * window replaces them. A timer thread delivers what is pending on every
+ * frame and sleeps without a deadline once nothing is. Updates which settle
+ * a gesture, like the end of a drag, and state changes are delivered right
+ * away, the pending update of their window is dropped or delivered first so
+ * a window never goes back to an older rect.
+ */
+class FramePacer {
+ public:
+  // Called on the thread which submitted or on the timer thread, never
+  // concurrently.
+  using Deliver = std::function<void(EventCallback callback, WNDID id,
+                                     EventType type, const CRect& crect,
+                                     uint64_t timestamp)>;
+
+  // when the platform does not know the rate of the display
+  static const double kDefaultDisplayRate;
+
+  FramePacer() = delete;
+  FramePacer(const FramePacer&) = delete;
+
+  explicit FramePacer(Deliver deliver);
+  ~FramePacer();
+
+  // Frames per second, zero or less delivers every update right away, which
+  // is the default. Pending updates are delivered when pacing stops.
+  void SetRate(double rate);
+  double rate() const { return rate_.load(std::memory_order_relaxed); }
+
+  // Whether updates may wait, lock free.
+  bool active() const { return rate() > 0; }
+
+  // Geometry updates like Moving wait for the next frame unless settled,
+  // everything else is delivered right away.
+  void Submit(EventCallback callback, WNDID id, EventType type,
+              const CRect& crect, uint64_t timestamp, bool settled);
+
+  // Forgets the pending update of id, one being delivered may still arrive
+  // like events reported while a window is unregistered.
+  void Drop(WNDID id);
+
+  // updates replaced by a fresher one before their frame
+  uint64_t coalesced() const { return coalesced_.load(); }
+  // frames which delivered updates
+  uint64_t frames() const { return frames_.load(); }
+
+  static bool IsGeometry(EventType type) {
+    return type == EventType::Moving || type == EventType::Moved ||
+           type == EventType::Resized;
+  }
+
+ private:
+  struct Update {
+    EventCallback callback;
+    EventType type;
+    CRect crect;
+    uint64_t timestamp;
+  };
+
+  using Clock = std::chrono::steady_clock;
+
+  void Run();
+  void Flush();
+  Clock::time_point NextFrame(Clock::time_point now) const;
+
+  const Deliver deliver_;
+  std::atomic<double> rate_;
+
+  // Held while delivering, so an update delivered on the timer thread never
+  // overtakes a later one of its window delivered by a submitting thread.
+  // Taken before lock_.
+  std::mutex deliver_lock_;
+
+  std::mutex lock_;
+  std::condition_variable wake_;
+  std::unordered_map<WNDID, Update> pending_;
+  // the updates of the frame being delivered, kept for its buckets
+  std::unordered_map<WNDID, Update> delivering_;
+  Clock::duration period_;
+  Clock::time_point origin_;
+  bool quit_;
+  std::thread timer_;
+
+  std::atomic<uint64_t> coalesced_;
+  std::atomic<uint64_t> frames_;
+};
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
+
+#endif  // AGORA_PLUGIN_WINDOW_MONITOR_FRAME_PACER_H
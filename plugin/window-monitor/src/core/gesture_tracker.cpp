@@ -0,0 +1,73 @@
+#include "gesture_tracker.h"
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+namespace {
+
+// updates of the gestures running on the calling thread, a gesture of a
+// window which went away is reset when the window starts the next one
+thread_local std::unordered_map<WNDID, uint32_t> _samples;
+
+}  // namespace
+
+GestureTracker::GestureTracker() : ended_(0) {}
+
+void GestureTracker::Start(WNDID id, const CRect& crect,
+                           uint64_t timestamp) {
+  _samples[id] = 0;
+
+  std::lock_guard<std::mutex> guard(lock_);
+  Window& window = windows_[id];
+  window.running = true;
+  window.summary = GestureSummary();
+  window.summary.start = crect;
+  window.summary.end = crect;
+  window.summary.timestamp = timestamp;
+}
+
+void GestureTracker::Sample(WNDID id) { _samples[id]++; }
+
+bool GestureTracker::End(WNDID id, const CRect& crect, uint64_t timestamp) {
+  uint32_t samples = 0;
+  auto sampled = _samples.find(id);
+  if (sampled != _samples.end()) {
+    samples = sampled->second;
+    _samples.erase(sampled);
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  auto itr = windows_.find(id);
+  if (itr == windows_.end() || !itr->second.running) return false;
+
+  Window& window = itr->second;
+  window.running = false;
+  window.summary.end = crect;
+  // capture times of platforms are coarser than the drag may be short
+  window.summary.duration = timestamp > window.summary.timestamp
+                                ? timestamp - window.summary.timestamp
+                                : 0;
+  window.summary.samples = samples;
+  ended_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool GestureTracker::Last(WNDID id, GestureSummary& summary) {
+  std::lock_guard<std::mutex> guard(lock_);
+  auto itr = windows_.find(id);
+  if (itr == windows_.end() || itr->second.running ||
+      !itr->second.summary.timestamp)
+    return false;
+  summary = itr->second.summary;
+  return true;
+}
+
+void GestureTracker::Forget(WNDID id) {
+  std::lock_guard<std::mutex> guard(lock_);
+  windows_.erase(id);
+}
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
@@ -0,0 +1,62 @@
+#ifndef AGORA_PLUGIN_WINDOW_MONITOR_GESTURE_TRACKER_H
+#define AGORA_PLUGIN_WINDOW_MONITOR_GESTURE_TRACKER_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+#include "monitor.h"
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+/**
+ * @brief Summarizes the move size gestures of windows, the drags between a
+ * RawMoveSizeStart and a RawMoveSizeEnd.
+ *
+ * The start and the end of a gesture take a lock. Its updates are counted
+ * without one on the thread reporting them, backends report the events of a
+ * window on one thread.
+ */
+class GestureTracker {
+ public:
+  GestureTracker();
+  GestureTracker(const GestureTracker&) = delete;
+
+  // Starts a gesture of id at crect, one already running starts over.
+  void Start(WNDID id, const CRect& crect, uint64_t timestamp);
+
+  // Counts an update of the gesture of id running on the calling thread.
+  void Sample(WNDID id);
+
+  // Ends the gesture of id at crect, false when none was running.
+  bool End(WNDID id, const CRect& crect, uint64_t timestamp);
+
+  // The last gesture of id which ended, false when none did.
+  bool Last(WNDID id, GestureSummary& summary);
+
+  // Once id is unregistered, a gesture running is never summarized.
+  void Forget(WNDID id);
+
+  // gestures which ended
+  uint64_t ended() const { return ended_.load(); }
+
+ private:
+  struct Window {
+    bool running;
+    GestureSummary summary;
+  };
+
+  std::mutex lock_;
+  std::unordered_map<WNDID, Window> windows_;
+  std::atomic<uint64_t> ended_;
+};
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
+
+#endif  // AGORA_PLUGIN_WINDOW_MONITOR_GESTURE_TRACKER_H
@@ -0,0 +1,94 @@
+#include "monitor.h"
+
+#include <vector>
+
+#include "event_trace.h"
+#include "monitor_core.h"
+#include "trace.h"
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+MonitorCore* MonitorCore::Default() {
+  // never deleted, backends may still report while the process exits
+  static MonitorCore* core = new MonitorCore(CreatePlatformBackend());
+  return core;
+}
+
+bool MONITOR_EXPORT checkPrivileges() {
+  return MonitorCore::Default()->CheckPrivileges();
+}
+
+int MONITOR_EXPORT registerWindowMonitorCallback(WNDID id,
+                                                 EventCallback callback) {
+  return MonitorCore::Default()->Register(id, callback);
+}
+
+int MONITOR_EXPORT registerWindowMonitorFilteredCallback(
+    WNDID id, EventCallback callback, EventFilter filter) {
+  return MonitorCore::Default()->Register(id, callback, filter);
+}
+
+int MONITOR_EXPORT setWindowMonitorFilter(WNDID id, EventFilter filter) {
+  return MonitorCore::Default()->SetFilter(id, filter);
+}
+
+int MONITOR_EXPORT setWindowMonitorPrediction(WNDID id, uint32_t lead_us) {
+  return MonitorCore::Default()->SetPrediction(id, lead_us);
+}
+
+void MONITOR_EXPORT getEventFilterStats(EventFilterStats& stats) {
+  stats = MonitorCore::Default()->filter_stats();
+}
+
+void MONITOR_EXPORT unregisterWindowMonitorCallback(WNDID id) {
+  MonitorCore::Default()->Unregister(id);
+}
+
+int MONITOR_EXPORT getWindowRect(WNDID id, CRect& crect) {
+  return MonitorCore::Default()->GetWindowRect(id, crect);
+}
+
+double MONITOR_EXPORT setFrameRate(double rate) {
+  return MonitorCore::Default()->SetFrameRate(rate);
+}
+
+uint64_t MONITOR_EXPORT getEventTimestamp() {
+  return MonitorCore::CurrentTimestamp();
+}
+
+bool MONITOR_EXPORT getEventGesture(GestureSummary& summary) {
+  return MonitorCore::CurrentGesture(summary);
+}
+
+bool MONITOR_EXPORT getEventMotion(WindowMotion& motion) {
+  return MonitorCore::CurrentMotion(motion);
+}
+
+void MONITOR_EXPORT predictWindowRect(const WindowMotion& motion,
+                                      uint32_t lead_us, CRect& crect) {
+  MotionTrack::Extrapolate(motion, MonitorCore::Now() + lead_us, crect);
+}
+
+void MONITOR_EXPORT setTraceCallback(TraceCallback callback) {
+  TraceScope::SetCallback(callback);
+}
+
+bool MONITOR_EXPORT startEventRecording(const char* path) {
+  return MonitorCore::Default()->StartRecording(path);
+}
+
+int64_t MONITOR_EXPORT stopEventRecording() {
+  return MonitorCore::Default()->StopRecording();
+}
+
+int64_t MONITOR_EXPORT replayEventTrace(const char* path, double speed) {
+  std::vector<RawEvent> events;
+  if (!ReadEventTrace(path, events)) return -1;
+  return ReplayEvents(events, MonitorCore::Default(), speed);
+}
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
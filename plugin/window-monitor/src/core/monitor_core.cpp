@@ -0,0 +1,356 @@
+#include "monitor_core.h"
+
+#include <chrono>
+#include <utility>
+
+#include "trace.h"
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+namespace {
+
+thread_local uint64_t _current_timestamp = 0;
+thread_local const GestureSummary* _current_gesture = nullptr;
+thread_local const WindowMotion* _current_motion = nullptr;
+
+}  // namespace
+
+MonitorCore::MonitorCore(std::unique_ptr<Backend> backend)
+    : backend_(std::move(backend)),
+      pacer_([this](EventCallback callback, WNDID id, EventType eventType,
+                    const CRect& crect, uint64_t timestamp) {
+        Dispatch(callback, id, eventType, crect, timestamp);
+      }),
+      recording_(false) {
+  backend_->SetSink(this);
+  thread_.reset(new MonitorThread(backend_->CreateLoop()));
+}
+
+// the threads of the backend are stopped before the callbacks go away
+MonitorCore::~MonitorCore() {
+  thread_->Stop();
+  backend_.reset();
+}
+
+EventType MonitorCore::Classify(const RawEvent& event) {
+  switch (event.kind) {
+    case RawShow:
+      // shown while minimized, it will be reported by the restore
+      if (event.state & WindowStateMinimized) return EventType::Unknown;
+      return EventType::Shown;
+    case RawHide:
+      return EventType::Hide;
+    case RawLocationChange:
+      if (event.state & WindowStateMaximized) return EventType::Maxmized;
+      if (event.state & WindowStateMinimized) return EventType::Unknown;
+      // outside of a drag the window was relocated once
+      if (event.state & WindowStateDragging) return EventType::Moving;
+      return EventType::Moved;
+    case RawMoveSizeEnd:
+    case RawMoved:
+      return EventType::Moved;
+    case RawResized:
+      return EventType::Resized;
+    case RawMinimizeStart:
+      return EventType::Minimized;
+    case RawMinimizeEnd:
+      // some apps minimize themselves again right away
+      if (event.state & WindowStateMinimized) return EventType::Unknown;
+      return EventType::Restore;
+    case RawFocus:
+      return EventType::Focused;
+    case RawUnfocus:
+      return EventType::UnFocused;
+    case RawMoveSizeStart:
+      return EventType::GestureStarted;
+    default:
+      return EventType::Unknown;
+  }
+}
+
+bool MonitorCore::CheckPrivileges() { return backend_->CheckPrivileges(); }
+
+int MonitorCore::Register(WNDID id, EventCallback callback,
+                          const EventFilter& filter) {
+  int code = ErrorCode::Success;
+  thread_->Invoke([this, id, callback, &filter, &code] {
+    bool report = false;
+    CRect crect;
+    {
+      std::lock_guard<std::mutex> register_guard(register_lock_);
+      WindowRegistry::Entry entry = {id, backend_->GetWindowOwner(id),
+                                     backend_->GetEventSource(id), callback,
+                                     filter};
+      if (!registry_.Add(entry)) {
+        code = ErrorCode::AlreadyExist;
+        return;
+      }
+
+      code = Attach(entry);
+      if (code != ErrorCode::Success) {
+        registry_.Remove(id);
+        return;
+      }
+
+      // the rect the delta of later ones starts from
+      if (callback && filters_.AcceptType(filter, EventType::Moved)) {
+        backend_->GetWindowRect(id, crect);
+        filters_.Forget(id);
+        filters_.AcceptRect(id, filter, EventType::Moved, crect);
+        report = true;
+      }
+    }
+
+    // trigger it immediately, without the lock so the callback may register
+    // or unregister windows
+    if (report) Dispatch(callback, id, EventType::Moved, crect, Now());
+  });
+  return code;
+}
+
+void MonitorCore::Unregister(WNDID id) {
+  thread_->Invoke([this, id] {
+    std::lock_guard<std::mutex> register_guard(register_lock_);
+    WindowRegistry::Entry entry;
+    if (!registry_.Remove(id, &entry)) return;
+
+    pacer_.Drop(id);
+    gestures_.Forget(id);
+    filters_.Forget(id);
+    predictor_.Forget(id);
+    Detach(entry);
+  });
+}
+
+int MonitorCore::SetFilter(WNDID id, const EventFilter& filter) {
+  int code = ErrorCode::Success;
+  thread_->Invoke([this, id, &filter, &code] {
+    std::lock_guard<std::mutex> register_guard(register_lock_);
+    WindowRegistry::Entry entry;
+    if (!registry_.Find(id, entry)) {
+      code = ErrorCode::WindowNotFound;
+      return;
+    }
+
+    entry.filter = filter;
+    registry_.Replace(entry);
+    // the next update is reported whatever its delta
+    filters_.Forget(id);
+  });
+  return code;
+}
+
+int MonitorCore::Attach(const WindowRegistry::Entry& entry) {
+  if (!entry.source) return backend_->Attach(entry.id);
+
+  Source& source = sources_[entry.source];
+  if (source.windows == 0) {
+    int code = backend_->Attach(entry.id);
+    if (code != ErrorCode::Success) {
+      sources_.erase(entry.source);
+      return code;
+    }
+    source.attached = entry.id;
+  }
+  source.windows++;
+  return ErrorCode::Success;
+}
+
+void MonitorCore::Detach(const WindowRegistry::Entry& entry) {
+  if (!entry.source) {
+    backend_->Detach(entry.id);
+    return;
+  }
+
+  auto itr = sources_.find(entry.source);
+  if (itr == sources_.end() || --itr->second.windows > 0) return;
+  // the window the source was attached with may be gone already
+  backend_->Detach(itr->second.attached);
+  sources_.erase(itr);
+}
+
+int MonitorCore::GetWindowRect(WNDID id, CRect& crect) {
+  MONITOR_TRACE_SCOPE("get_window_rect", id);
+  return backend_->GetWindowRect(id, crect);
+}
+
+size_t MonitorCore::size() const { return registry_.size(); }
+
+int MonitorCore::SetPrediction(WNDID id, uint32_t lead_us) {
+  int code = ErrorCode::Success;
+  thread_->Invoke([this, id, lead_us, &code] {
+    std::lock_guard<std::mutex> register_guard(register_lock_);
+    WindowRegistry::Entry entry;
+    if (!registry_.Find(id, entry)) {
+      code = ErrorCode::WindowNotFound;
+      return;
+    }
+    predictor_.SetLead(id, lead_us);
+  });
+  return code;
+}
+
+double MonitorCore::SetFrameRate(double rate) {
+  if (rate < 0) {
+    rate = backend_->GetDisplayRate();
+    if (rate <= 0) rate = FramePacer::kDefaultDisplayRate;
+  }
+  pacer_.SetRate(rate);
+  return pacer_.rate();
+}
+
+bool MonitorCore::Observes(WNDID id) const {
+  WindowRegistry::Entry entry;
+  return registry_.Find(id, entry);
+}
+
+bool MonitorCore::StartRecording(const char* path) {
+  std::unique_ptr<EventTraceWriter> recorder(new EventTraceWriter());
+  if (!recorder->Open(path)) return false;
+
+  std::lock_guard<std::mutex> guard(record_lock_);
+  if (recorder_) return false;
+  recorder_ = std::move(recorder);
+  recording_.store(true);
+  return true;
+}
+
+int64_t MonitorCore::StopRecording() {
+  std::unique_ptr<EventTraceWriter> recorder;
+  {
+    std::lock_guard<std::mutex> guard(record_lock_);
+    recording_.store(false);
+    recorder = std::move(recorder_);
+  }
+  return recorder ? recorder->Close() : -1;
+}
+
+uint64_t MonitorCore::CurrentTimestamp() { return _current_timestamp; }
+
+bool MonitorCore::CurrentMotion(WindowMotion& motion) {
+  if (!_current_motion) return false;
+  motion = *_current_motion;
+  return true;
+}
+
+bool MonitorCore::CurrentGesture(GestureSummary& summary) {
+  if (!_current_gesture) return false;
+  summary = *_current_gesture;
+  return true;
+}
+
+uint64_t MonitorCore::Now() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void MonitorCore::OnRawEvent(const RawEvent& event) {
+  EventType eventType;
+  EventCallback callback = nullptr;
+  WindowRegistry::Entry entry;
+  // starts and ends of drags are followed whatever the window reports
+  bool gesture = false;
+  {
+    MONITOR_TRACE_SCOPE("classify", event.id);
+    eventType = Classify(event);
+    if (eventType != EventType::Unknown && registry_.Find(event.id, entry)) {
+      if (eventType == EventType::Moving) gestures_.Sample(event.id);
+      gesture = event.kind == RawMoveSizeStart || event.kind == RawMoveSizeEnd;
+      if (filters_.AcceptType(entry.filter, eventType))
+        callback = entry.callback;
+    }
+  }
+  if (!callback && !gesture) {
+    // kept in traces so a replay classifies them again
+    if (recording_.load(std::memory_order_relaxed)) Record(event);
+    return;
+  }
+
+  uint64_t timestamp = event.timestamp ? event.timestamp : Now();
+  CRect crect = event.rect;
+  if (!event.has_rect) GetWindowRect(event.id, crect);
+
+  if (recording_.load(std::memory_order_relaxed)) {
+    // with the rect, a replay needs no window of the recording desktop
+    RawEvent recorded = event;
+    recorded.has_rect = true;
+    recorded.rect = crect;
+    recorded.timestamp = timestamp;
+    Record(recorded);
+  }
+
+  bool ended = false;
+  if (event.kind == RawMoveSizeStart) {
+    gestures_.Start(event.id, crect, timestamp);
+  } else if (event.kind == RawMoveSizeEnd) {
+    ended = gestures_.End(event.id, crect, timestamp);
+  }
+
+  const bool settled = event.kind == RawMoveSizeEnd;
+  if (callback) Report(entry, eventType, crect, timestamp, settled);
+  // after the final rect of the drag
+  if (ended && entry.callback &&
+      filters_.AcceptType(entry.filter, EventType::GestureEnded))
+    Report(entry, EventType::GestureEnded, crect, timestamp, settled);
+}
+
+void MonitorCore::Report(const WindowRegistry::Entry& entry,
+                         EventType eventType, const CRect& crect,
+                         uint64_t timestamp, bool settled) {
+  // before the delta filter, every sample helps the track
+  if (predictor_.active())
+    predictor_.Observe(entry.id, eventType, crect, timestamp);
+
+  if (!filters_.AcceptRect(entry.id, entry.filter, eventType, crect, settled))
+    return;
+
+  if (pacer_.active()) {
+    // the end of a drag flushes, moves of platforms without drags are paced
+    pacer_.Submit(entry.callback, entry.id, eventType, crect, timestamp,
+                  settled);
+    return;
+  }
+  Dispatch(entry.callback, entry.id, eventType, crect, timestamp);
+}
+
+void MonitorCore::Dispatch(EventCallback callback, WNDID id,
+                           EventType eventType, const CRect& crect,
+                           uint64_t timestamp) {
+  MONITOR_TRACE_SCOPE("callback", id);
+  _current_timestamp = timestamp;
+  CRect predicted;
+  WindowMotion motion;
+  if (eventType == EventType::Moving && predictor_.active() &&
+      predictor_.Predict(id, Now(), predicted, &motion)) {
+    _current_motion = &motion;
+    callback(id, eventType, predicted);
+    _current_motion = nullptr;
+  } else if (eventType == EventType::GestureEnded) {
+    GestureSummary summary;
+    if (gestures_.Last(id, summary)) _current_gesture = &summary;
+    callback(id, eventType, crect);
+    _current_gesture = nullptr;
+  } else {
+    callback(id, eventType, crect);
+  }
+  _current_timestamp = 0;
+}
+
+void MonitorCore::Record(const RawEvent& event) {
+  std::lock_guard<std::mutex> guard(record_lock_);
+  if (!recorder_) return;
+  if (event.timestamp) {
+    recorder_->Write(event);
+  } else {
+    RawEvent stamped = event;
+    stamped.timestamp = Now();
+    recorder_->Write(stamped);
+  }
+}
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
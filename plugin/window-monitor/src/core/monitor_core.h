@@ -0,0 +1,162 @@
+#ifndef AGORA_PLUGIN_WINDOW_MONITOR_MONITOR_CORE_H
+#define AGORA_PLUGIN_WINDOW_MONITOR_MONITOR_CORE_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "backend.h"
+#include "event_filter.h"
+#include "event_trace.h"
+#include "frame_pacer.h"
+#include "gesture_tracker.h"
+#include "monitor.h"
+#include "monitor_thread.h"
+#include "motion_predictor.h"
+#include "raw_event.h"
+#include "window_registry.h"
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+/**
+ * @brief Platform neutral part of the window monitor, keeps the registered
+ * callbacks, classifies raw events of its backend and dispatches them with
+ * the window rect.
+ *
+ * The backend runs on a monitor thread of the core, registering attaches
+ * windows there and callbacks are called there or on the threads the
+ * platform reports on, never on the thread which registered.
+ */
+class MonitorCore : public BackendSink {
+ public:
+  MonitorCore() = delete;
+  MonitorCore(const MonitorCore&) = delete;
+
+  explicit MonitorCore(std::unique_ptr<Backend> backend);
+  ~MonitorCore();
+
+  // Core of the exported functions, backed by CreatePlatformBackend.
+  static MonitorCore* Default();
+
+  // Unknown for raw events which are not reported.
+  static EventType Classify(const RawEvent& event);
+
+  bool CheckPrivileges();
+
+  // Both wait for the monitor thread, which reports the rect of a window it
+  // registered right away unless filter drops Moved.
+  int Register(WNDID id, EventCallback callback,
+               const EventFilter& filter = EventFilter());
+  void Unregister(WNDID id);
+
+  // Filters the events of a registered window from now on.
+  int SetFilter(WNDID id, const EventFilter& filter);
+  EventFilterStats filter_stats() const { return filters_.stats(); }
+
+  // Extrapolates the rects of Moving of a registered window lead_us past
+  // when they are reported, zero stops it.
+  int SetPrediction(WNDID id, uint32_t lead_us);
+  const MotionPredictor& predictor() const { return predictor_; }
+
+  const GestureTracker& gestures() const { return gestures_; }
+
+  const WindowRegistry& registry() const { return registry_; }
+
+  // Queried on the calling thread, waiting for the monitor thread would wait
+  // for the events it is busy with.
+  int GetWindowRect(WNDID id, CRect& crect);
+
+  size_t size() const;
+
+  // Paces geometry updates, see setFrameRate, returns the rate paced at.
+  double SetFrameRate(double rate);
+  const FramePacer& pacer() const { return pacer_; }
+
+  // Writes the raw events reported from now on to an event trace at path,
+  // with the rects they were dispatched with, see EventTraceWriter.
+  bool StartRecording(const char* path);
+  // Returns the count of events recorded, -1 when not recording or writing
+  // failed.
+  int64_t StopRecording();
+
+  // Capture time of the event being reported on the calling thread, zero
+  // outside of a callback.
+  static uint64_t CurrentTimestamp();
+
+  // Summary of the GestureEnded being reported on the calling thread, false
+  // outside of its callback.
+  static bool CurrentGesture(GestureSummary& summary);
+
+  // Motion the rect of the Moving being reported on the calling thread was
+  // extrapolated from, false outside of its callback or when not predicted.
+  static bool CurrentMotion(WindowMotion& motion);
+
+  // steady clock microseconds, the clock of RawEvent::timestamp
+  static uint64_t Now();
+
+  Backend* backend() { return backend_.get(); }
+  MonitorThread& thread() { return *thread_; }
+
+  void OnRawEvent(const RawEvent& event) override;
+  bool Observes(WNDID id) const override;
+
+ private:
+  // filters, predicts and paces an event the window registered for
+  void Report(const WindowRegistry::Entry& entry, EventType eventType,
+              const CRect& crect, uint64_t timestamp, bool settled);
+  void Dispatch(EventCallback callback, WNDID id, EventType eventType,
+                const CRect& crect, uint64_t timestamp);
+  void Record(const RawEvent& event);
+
+  // attach the window or its source to the backend, with register_lock_
+  int Attach(const WindowRegistry::Entry& entry);
+  void Detach(const WindowRegistry::Entry& entry);
+
+  struct Source {
+    // the window the backend attached the source with
+    WNDID attached;
+    // registered windows of the source
+    size_t windows;
+  };
+
+  std::unique_ptr<Backend> backend_;
+
+  // started once the backend reports to the core, stopped before it goes
+  std::unique_ptr<MonitorThread> thread_;
+
+  // Serializes Register and Unregister with the Attach and Detach of the
+  // backend, which the monitor thread runs, and the tasks which run on their
+  // callers once it stopped. Never taken by the threads reporting events.
+  std::mutex register_lock_;
+  // looked up without a lock by the threads reporting events
+  WindowRegistry registry_;
+  // shared sources of the backend, guarded by register_lock_
+  std::unordered_map<uint64_t, Source> sources_;
+
+  // summarizes drags whatever the windows report
+  GestureTracker gestures_;
+
+  // dropped events never get a rect or reach the pacer
+  EventFilters filters_;
+
+  // sees every rect of the predicted windows, extrapolates when dispatching
+  MotionPredictor predictor_;
+
+  // between classification and the callbacks, passes events through unless
+  // a frame rate is set
+  FramePacer pacer_;
+
+  // checked without the lock so events pay nothing when not recording
+  std::atomic<bool> recording_;
+  std::mutex record_lock_;
+  std::unique_ptr<EventTraceWriter> recorder_;
+};
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
+
+#endif  // AGORA_PLUGIN_WINDOW_MONITOR_MONITOR_CORE_H
@@ -0,0 +1,113 @@
+#include "monitor_thread.h"
+
+#include <utility>
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+TaskLoop::TaskLoop() : woken_(false), quit_(false) {}
+
+void TaskLoop::Run(const std::function<void()>& run_tasks) {
+  std::unique_lock<std::mutex> guard(lock_);
+  while (true) {
+    wake_.wait(guard, [this] { return woken_ || quit_; });
+    if (quit_) return;
+    woken_ = false;
+
+    guard.unlock();
+    run_tasks();
+    guard.lock();
+  }
+}
+
+void TaskLoop::Wake() {
+  std::lock_guard<std::mutex> guard(lock_);
+  woken_ = true;
+  wake_.notify_one();
+}
+
+void TaskLoop::Quit() {
+  std::lock_guard<std::mutex> guard(lock_);
+  quit_ = true;
+  wake_.notify_one();
+}
+
+MonitorThread::MonitorThread(std::unique_ptr<MonitorLoop> loop)
+    : loop_(std::move(loop)), stopped_(false) {
+  // the thread reads id_ once it got the lock
+  std::lock_guard<std::mutex> guard(lock_);
+  thread_ = std::thread(&MonitorThread::Main, this);
+  id_ = thread_.get_id();
+}
+
+MonitorThread::~MonitorThread() { Stop(); }
+
+void MonitorThread::Post(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!stopped_) {
+      tasks_.push_back(std::move(task));
+      loop_->Wake();
+      return;
+    }
+  }
+  task();
+}
+
+void MonitorThread::Invoke(const std::function<void()>& task) {
+  if (IsCurrent()) {
+    task();
+    return;
+  }
+
+  bool done = false;
+  Post([this, &task, &done] {
+    task();
+    std::lock_guard<std::mutex> guard(lock_);
+    done = true;
+  });
+
+  std::unique_lock<std::mutex> guard(lock_);
+  ran_.wait(guard, [&done] { return done; });
+}
+
+bool MonitorThread::IsCurrent() const {
+  return std::this_thread::get_id() == id_;
+}
+
+void MonitorThread::Stop() {
+  loop_->Quit();
+  if (thread_.joinable() && !IsCurrent()) thread_.join();
+}
+
+void MonitorThread::Main() {
+  { std::lock_guard<std::mutex> guard(lock_); }
+
+  loop_->Run([this] { RunTasks(); });
+
+  // posting runs tasks on the caller from now on, these were posted before
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    stopped_ = true;
+  }
+  RunTasks();
+}
+
+void MonitorThread::RunTasks() {
+  std::vector<std::function<void()>> tasks;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    tasks.swap(tasks_);
+  }
+  if (tasks.empty()) return;
+
+  for (auto& task : tasks) task();
+
+  std::lock_guard<std::mutex> guard(lock_);
+  ran_.notify_all();
+}
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
@@ -0,0 +1,96 @@
+#ifndef AGORA_PLUGIN_WINDOW_MONITOR_MONITOR_THREAD_H
+#define AGORA_PLUGIN_WINDOW_MONITOR_MONITOR_THREAD_H
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+/**
+ * @brief Event pump of the platform, run by the monitor thread: the message
+ * loop the win32 hooks report through, the run loop of the accessibility
+ * observers or the poll of an X connection. The default one only runs the
+ * tasks of the thread.
+ */
+class MonitorLoop {
+ public:
+  virtual ~MonitorLoop() {}
+
+  // Pumps on the calling thread until Quit, calling run_tasks there soon
+  // after every Wake.
+  virtual void Run(const std::function<void()>& run_tasks) = 0;
+
+  // Thread safe, both may be called before Run, which then runs the tasks
+  // once or returns right away.
+  virtual void Wake() = 0;
+  virtual void Quit() = 0;
+};
+
+// Loop without platform events, waits for tasks.
+class TaskLoop : public MonitorLoop {
+ public:
+  TaskLoop();
+
+  void Run(const std::function<void()>& run_tasks) override;
+  void Wake() override;
+  void Quit() override;
+
+ private:
+  std::mutex lock_;
+  std::condition_variable wake_;
+  bool woken_;
+  bool quit_;
+};
+
+/**
+ * @brief Thread of the core its backend observes windows on, so neither the
+ * platform callbacks nor the queries for the geometry of a window run on
+ * the threads of the callers. Registration is marshalled onto it as tasks,
+ * run in the order they were posted between the events of the loop.
+ */
+class MonitorThread {
+ public:
+  MonitorThread() = delete;
+  MonitorThread(const MonitorThread&) = delete;
+
+  explicit MonitorThread(std::unique_ptr<MonitorLoop> loop);
+  ~MonitorThread();
+
+  void Post(std::function<void()> task);
+
+  // Runs task on the thread and returns once it did, right away when called
+  // there. Once the thread stopped tasks run on the caller.
+  void Invoke(const std::function<void()>& task);
+
+  bool IsCurrent() const;
+
+  // Quits the loop and joins the thread, which runs the pending tasks first.
+  void Stop();
+
+ private:
+  void Main();
+  void RunTasks();
+
+  std::unique_ptr<MonitorLoop> loop_;
+
+  std::mutex lock_;
+  // signaled whenever tasks ran
+  std::condition_variable ran_;
+  std::vector<std::function<void()>> tasks_;
+  bool stopped_;
+
+  std::thread::id id_;
+  std::thread thread_;
+};
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
+
+#endif  // AGORA_PLUGIN_WINDOW_MONITOR_MONITOR_THREAD_H
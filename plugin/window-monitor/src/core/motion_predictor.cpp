@@ -0,0 +1,140 @@
+#include "motion_predictor.h"
+
+#include <math.h>
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+namespace {
+
+void toEdges(const CRect& crect, float edges[]) {
+  edges[0] = crect.left;
+  edges[1] = crect.top;
+  edges[2] = crect.right;
+  edges[3] = crect.bottom;
+}
+
+}  // namespace
+
+const float MotionTrack::kBeta = 0.5f;
+const uint64_t MotionTrack::kMinSpanUs = 4000;
+const uint64_t MotionTrack::kMaxGapUs = 100000;
+const uint64_t MotionTrack::kMaxHorizonUs = 100000;
+const float MotionTrack::kMaxResidual = 200;
+
+MotionTrack::MotionTrack()
+    : latest_time_(0), base_time_(0), primed_(false), moving_(false) {
+  for (int i = 0; i < kEdges; i++) latest_[i] = base_[i] = velocity_[i] = 0;
+}
+
+void MotionTrack::Observe(EventType type, const CRect& crect,
+                          uint64_t timestamp) {
+  if (type != EventType::Moving || !primed_ || timestamp < latest_time_ ||
+      timestamp - latest_time_ > kMaxGapUs) {
+    Snap(crect, timestamp);
+    // the first sample of a drag has no velocity yet
+    moving_ = type == EventType::Moving;
+    return;
+  }
+
+  float measured[kEdges];
+  toEdges(crect, measured);
+  const float dt = (float)(timestamp - latest_time_);
+  for (int i = 0; i < kEdges; i++) {
+    const float residual = measured[i] - (latest_[i] + velocity_[i] * dt);
+    if (fabsf(residual) > kMaxResidual) {
+      Snap(crect, timestamp);
+      moving_ = true;
+      return;
+    }
+  }
+
+  for (int i = 0; i < kEdges; i++) latest_[i] = measured[i];
+  latest_time_ = timestamp;
+  moving_ = true;
+
+  const uint64_t span = timestamp - base_time_;
+  if (span < kMinSpanUs) return;
+  for (int i = 0; i < kEdges; i++) {
+    const float velocity = (measured[i] - base_[i]) / (float)span;
+    velocity_[i] += kBeta * (velocity - velocity_[i]);
+    base_[i] = measured[i];
+  }
+  base_time_ = timestamp;
+}
+
+bool MotionTrack::Predict(uint64_t target, CRect& crect) const {
+  WindowMotion motion;
+  if (!Motion(motion)) return false;
+  Extrapolate(motion, target, crect);
+  return true;
+}
+
+bool MotionTrack::Motion(WindowMotion& motion) const {
+  if (!moving_) return false;
+
+  motion.rect = CRect(latest_[0], latest_[1], latest_[2], latest_[3]);
+  motion.timestamp = latest_time_;
+  for (int i = 0; i < kEdges; i++) motion.velocity[i] = velocity_[i];
+  return true;
+}
+
+void MotionTrack::Extrapolate(const WindowMotion& motion, uint64_t target,
+                              CRect& crect) {
+  uint64_t horizon =
+      target > motion.timestamp ? target - motion.timestamp : 0;
+  if (horizon > kMaxHorizonUs) horizon = kMaxHorizonUs;
+  const float dt = (float)horizon;
+  const CRect& from = motion.rect;
+  const float* velocity = motion.velocity;
+  crect = CRect(from.left + velocity[0] * dt, from.top + velocity[1] * dt,
+                from.right + velocity[2] * dt, from.bottom + velocity[3] * dt);
+}
+
+void MotionTrack::Snap(const CRect& crect, uint64_t timestamp) {
+  toEdges(crect, latest_);
+  toEdges(crect, base_);
+  for (int i = 0; i < kEdges; i++) velocity_[i] = 0;
+  latest_time_ = base_time_ = timestamp;
+  primed_ = true;
+  moving_ = false;
+}
+
+MotionPredictor::MotionPredictor() : windows_(0), predicted_(0) {}
+
+void MotionPredictor::SetLead(WNDID id, uint32_t lead_us) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (lead_us == 0) {
+    tracks_.erase(id);
+  } else {
+    tracks_[id].lead_us = lead_us;
+  }
+  windows_.store(tracks_.size(), std::memory_order_relaxed);
+}
+
+void MotionPredictor::Observe(WNDID id, EventType type, const CRect& crect,
+                              uint64_t timestamp) {
+  std::lock_guard<std::mutex> guard(lock_);
+  auto itr = tracks_.find(id);
+  if (itr != tracks_.end()) itr->second.track.Observe(type, crect, timestamp);
+}
+
+bool MotionPredictor::Predict(WNDID id, uint64_t now, CRect& crect,
+                              WindowMotion* motion) {
+  std::lock_guard<std::mutex> guard(lock_);
+  auto itr = tracks_.find(id);
+  if (itr == tracks_.end()) return false;
+
+  const Window& window = itr->second;
+  WindowMotion current;
+  if (!window.track.Motion(current)) return false;
+  MotionTrack::Extrapolate(current, now + window.lead_us, crect);
+  if (motion) *motion = current;
+  predicted_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
@@ -0,0 +1,121 @@
+#ifndef AGORA_PLUGIN_WINDOW_MONITOR_MOTION_PREDICTOR_H
+#define AGORA_PLUGIN_WINDOW_MONITOR_MOTION_PREDICTOR_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+#include "monitor.h"
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+/**
+ * @brief Alpha-beta filter over the rects of one window being dragged,
+ * tracks the velocity of every edge to extrapolate where the window will be.
+ *
+ * The rects of the platform are exact, the filter takes them as they are
+ * (alpha is 1) and only smooths the velocity, measured over spans of at
+ * least kMinSpanUs since platforms report samples in bursts with almost the
+ * same capture time. Moving samples update the track. Any other event snaps
+ * it to its rect and stops it, a window never overshoots where it settled.
+ * A pause longer than kMaxGapUs or a jump starts the track over.
+ */
+class MotionTrack {
+ public:
+  // beta of the filter, tuned with simulated_bench --predict
+  static const float kBeta;
+  // shortest span a velocity is measured over
+  static const uint64_t kMinSpanUs;
+  // pause after which a drag is tracked from scratch
+  static const uint64_t kMaxGapUs;
+  // farthest a rect is extrapolated past its last sample
+  static const uint64_t kMaxHorizonUs;
+  // pixels off the track which are a jump, like a restore, and start the
+  // track over instead of flinging it
+  static const float kMaxResidual;
+
+  MotionTrack();
+
+  // crect of type captured at timestamp in microseconds.
+  void Observe(EventType type, const CRect& crect, uint64_t timestamp);
+
+  // The rect at target, false when the window is not being dragged.
+  bool Predict(uint64_t target, CRect& crect) const;
+
+  // What Predict extrapolates from, false when the window is not being
+  // dragged.
+  bool Motion(WindowMotion& motion) const;
+
+  // The rect of motion at target, at most kMaxHorizonUs past its sample.
+  static void Extrapolate(const WindowMotion& motion, uint64_t target,
+                          CRect& crect);
+
+ private:
+  static const int kEdges = 4;
+
+  void Snap(const CRect& crect, uint64_t timestamp);
+
+  // left, top, right, bottom in pixels and pixels per microsecond
+  float latest_[kEdges];
+  uint64_t latest_time_;
+  // sample the next velocity is measured from
+  float base_[kEdges];
+  uint64_t base_time_;
+  float velocity_[kEdges];
+  bool primed_;
+  bool moving_;
+};
+
+/**
+ * @brief Extrapolates the rects of windows being dragged to when they will
+ * be presented, an overlay following a window is otherwise a frame or more
+ * behind the compositor. Only the windows given a lead are tracked, under a
+ * lock of the predictor.
+ */
+class MotionPredictor {
+ public:
+  MotionPredictor();
+  MotionPredictor(const MotionPredictor&) = delete;
+
+  // Rects of Moving are extrapolated lead_us past when they are reported,
+  // zero stops predicting id.
+  void SetLead(WNDID id, uint32_t lead_us);
+
+  // Whether any window is predicted, lock free.
+  bool active() const { return windows_.load(std::memory_order_relaxed) > 0; }
+
+  // Feeds the rect of an event of id, ignored unless id is predicted.
+  void Observe(WNDID id, EventType type, const CRect& crect,
+               uint64_t timestamp);
+
+  // The rect of id lead past now, false and crect untouched unless id is
+  // predicted and being dragged, motion gets what it was extrapolated from.
+  bool Predict(WNDID id, uint64_t now, CRect& crect,
+               WindowMotion* motion = nullptr);
+
+  void Forget(WNDID id) { SetLead(id, 0); }
+
+  // rects extrapolated
+  uint64_t predicted() const { return predicted_.load(); }
+
+ private:
+  struct Window {
+    uint32_t lead_us;
+    MotionTrack track;
+  };
+
+  std::mutex lock_;
+  std::unordered_map<WNDID, Window> tracks_;
+  std::atomic<size_t> windows_;
+  std::atomic<uint64_t> predicted_;
+};
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
+
+#endif  // AGORA_PLUGIN_WINDOW_MONITOR_MOTION_PREDICTOR_H
@@ -0,0 +1,61 @@
+#ifndef AGORA_PLUGIN_WINDOW_MONITOR_RAW_EVENT_H
+#define AGORA_PLUGIN_WINDOW_MONITOR_RAW_EVENT_H
+
+#include <stdint.h>
+
+#include "monitor.h"
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+/**
+ * @brief What a backend observed on a window, before the core classifies it
+ * into an EventType.
+ */
+typedef enum _RawEventKind {
+  RawShow = 0,
+  RawHide,
+  // position or size changed, while dragging on most platforms
+  RawLocationChange,
+  RawMoveSizeStart,
+  RawMoveSizeEnd,
+  // settled position or size, for platforms without move size gestures
+  RawMoved,
+  RawResized,
+  RawMinimizeStart,
+  RawMinimizeEnd,
+  RawFocus,
+  RawUnfocus,
+} RawEventKind;
+
+/**
+ * @brief Window state flags of a raw event.
+ */
+typedef enum _WindowState {
+  WindowStateNormal = 0,
+  WindowStateMinimized = 1 << 0,
+  WindowStateMaximized = 1 << 1,
+  // a move or resize gesture is running, location changes are its updates
+  WindowStateDragging = 1 << 2,
+} WindowState;
+
+typedef struct _RawEvent {
+  WNDID id;
+  RawEventKind kind;
+  // WindowState flags at the time of the event
+  uint32_t state;
+  // backends which get the geometry with the event set it, the core looks
+  // the rect up otherwise
+  bool has_rect;
+  CRect rect;
+  // steady clock microseconds when the event was captured, zero lets the core
+  // stamp it when the backend reports it
+  uint64_t timestamp;
+} RawEvent;
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
+
+#endif  // AGORA_PLUGIN_WINDOW_MONITOR_RAW_EVENT_H
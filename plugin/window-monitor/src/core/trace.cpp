@@ -0,0 +1,23 @@
+#include "trace.h"
+
+#include <chrono>
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+std::atomic<TraceCallback> TraceScope::callback_slot_(nullptr);
+
+void TraceScope::SetCallback(TraceCallback callback) {
+  callback_slot_.store(callback);
+}
+
+uint64_t TraceScope::Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
@@ -0,0 +1,65 @@
+#ifndef AGORA_PLUGIN_WINDOW_MONITOR_TRACE_H
+#define AGORA_PLUGIN_WINDOW_MONITOR_TRACE_H
+
+#include <atomic>
+
+#include "monitor.h"
+
+// Call sites are compiled in unless WINDOW_MONITOR_TRACING is 0, while no
+// trace callback is set one costs a relaxed load.
+#ifndef WINDOW_MONITOR_TRACING
+#define WINDOW_MONITOR_TRACING 1
+#endif
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+/**
+ * @brief Span of the monitor from its construction to its destruction,
+ * handed to the callback of setTraceCallback.
+ */
+class TraceScope {
+ public:
+  TraceScope(const char* name, WNDID id)
+      : name_(name),
+        id_(id),
+        callback_(callback_slot_.load(std::memory_order_relaxed)),
+        begin_(callback_ ? Now() : 0) {}
+
+  ~TraceScope() {
+    if (callback_) callback_(name_, id_, begin_, Now());
+  }
+
+  static void SetCallback(TraceCallback callback);
+
+  // steady clock nanoseconds
+  static uint64_t Now();
+
+ private:
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+  static std::atomic<TraceCallback> callback_slot_;
+
+  const char* name_;
+  WNDID id_;
+  TraceCallback callback_;
+  uint64_t begin_;
+};
+
+#define MONITOR_TRACE_CONCAT_(a, b) a##b
+#define MONITOR_TRACE_CONCAT(a, b) MONITOR_TRACE_CONCAT_(a, b)
+
+#if WINDOW_MONITOR_TRACING
+#define MONITOR_TRACE_SCOPE(name, id) \
+  TraceScope MONITOR_TRACE_CONCAT(_trace_scope_, __LINE__)(name, id)
+#else
+#define MONITOR_TRACE_SCOPE(name, id)
+#endif
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
+
+#endif  // AGORA_PLUGIN_WINDOW_MONITOR_TRACE_H
@@ -0,0 +1,159 @@
+#include "window_registry.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+namespace {
+
+size_t hashId(WNDID id) {
+  uint64_t key = (uint64_t)(uintptr_t)id;
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  return (size_t)key;
+}
+
+size_t hashOwner(uint32_t owner) { return (size_t)(owner * 2654435761U); }
+
+}  // namespace
+
+struct WindowRegistry::Table {
+  struct Owner {
+    uint32_t owner;
+    uint32_t begin;
+    // zero for free buckets
+    uint32_t count;
+  };
+
+  // sorted by owner, the windows of an owner are adjacent
+  std::vector<Entry> entries;
+  // open addressing by id and by owner, at most half full, ids holds indexes
+  // of entries and -1 for free buckets
+  std::vector<int32_t> ids;
+  std::vector<Owner> owners;
+  size_t mask;
+
+  Table() : Table(std::vector<Entry>()) {}
+  explicit Table(std::vector<Entry> sorted);
+
+  const Entry* Find(WNDID id) const {
+    for (size_t bucket = hashId(id) & mask;; bucket = (bucket + 1) & mask) {
+      const int32_t index = ids[bucket];
+      if (index < 0) return nullptr;
+      if (entries[index].id == id) return &entries[index];
+    }
+  }
+
+  const Owner* FindOwner(uint32_t owner) const {
+    for (size_t bucket = hashOwner(owner) & mask;;
+         bucket = (bucket + 1) & mask) {
+      const Owner& item = owners[bucket];
+      if (!item.count) return nullptr;
+      if (item.owner == owner) return &item;
+    }
+  }
+};
+
+WindowRegistry::Table::Table(std::vector<Entry> sorted)
+    : entries(std::move(sorted)) {
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const Entry& a, const Entry& b) {
+                     return a.owner < b.owner;
+                   });
+
+  size_t capacity = 8;
+  while (capacity < entries.size() * 2) capacity *= 2;
+  mask = capacity - 1;
+  ids.assign(capacity, -1);
+  owners.assign(capacity, Owner{0, 0, 0});
+
+  for (size_t i = 0; i < entries.size(); i++) {
+    size_t bucket = hashId(entries[i].id) & mask;
+    while (ids[bucket] >= 0) bucket = (bucket + 1) & mask;
+    ids[bucket] = (int32_t)i;
+
+    if (i > 0 && entries[i - 1].owner == entries[i].owner) continue;
+    bucket = hashOwner(entries[i].owner) & mask;
+    while (owners[bucket].count) bucket = (bucket + 1) & mask;
+    owners[bucket].owner = entries[i].owner;
+    owners[bucket].begin = (uint32_t)i;
+    size_t end = i;
+    while (end < entries.size() && entries[end].owner == entries[i].owner)
+      end++;
+    owners[bucket].count = (uint32_t)(end - i);
+  }
+}
+
+WindowRegistry::WindowRegistry() {}
+
+// no reader is left, the threads of the backend are gone
+WindowRegistry::~WindowRegistry() {}
+
+bool WindowRegistry::Add(const Entry& entry) {
+  return table_.replace([&entry](const Table& table) -> const Table* {
+    if (table.Find(entry.id)) return nullptr;
+
+    std::vector<Entry> entries(table.entries);
+    entries.push_back(entry);
+    return new Table(std::move(entries));
+  });
+}
+
+bool WindowRegistry::Replace(const Entry& entry) {
+  return table_.replace([&entry](const Table& table) -> const Table* {
+    if (!table.Find(entry.id)) return nullptr;
+
+    std::vector<Entry> entries(table.entries);
+    for (auto& item : entries) {
+      if (item.id == entry.id) item = entry;
+    }
+    return new Table(std::move(entries));
+  });
+}
+
+bool WindowRegistry::Remove(WNDID id, Entry* entry) {
+  return table_.replace([id, entry](const Table& table) -> const Table* {
+    const Entry* found = table.Find(id);
+    if (!found) return nullptr;
+    if (entry) *entry = *found;
+
+    std::vector<Entry> entries;
+    entries.reserve(table.entries.size() - 1);
+    for (auto& item : table.entries) {
+      if (item.id != id) entries.push_back(item);
+    }
+    return new Table(std::move(entries));
+  });
+}
+
+bool WindowRegistry::Find(WNDID id, Entry& entry) const {
+  epoch_read_scope scope;
+  const Entry* found = table_.read().Find(id);
+  if (!found) return false;
+  entry = *found;
+  return true;
+}
+
+size_t WindowRegistry::FindOwner(uint32_t owner,
+                                 std::vector<Entry>& entries) const {
+  epoch_read_scope scope;
+  const Table& table = table_.read();
+  const Table::Owner* found = table.FindOwner(owner);
+  if (!found) return 0;
+  entries.insert(entries.end(), table.entries.begin() + found->begin,
+                 table.entries.begin() + found->begin + found->count);
+  return found->count;
+}
+
+size_t WindowRegistry::size() const {
+  epoch_read_scope scope;
+  return table_.read().entries.size();
+}
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
@@ -0,0 +1,72 @@
+#ifndef AGORA_PLUGIN_WINDOW_MONITOR_WINDOW_REGISTRY_H
+#define AGORA_PLUGIN_WINDOW_MONITOR_WINDOW_REGISTRY_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "epoch_snapshot.h"
+#include "monitor.h"
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+/**
+ * @brief Registered windows, looked up on every event by the threads the
+ * platform reports on, changed only when a window is registered.
+ *
+ * The table is an immutable flat hash keyed by window id with a second index
+ * by owning process, writers build a new one and publish it as an
+ * epoch_snapshot. Readers never wait: they announce the epoch they read in,
+ * probe the published table and leave. A writer frees the table it replaced
+ * once every reader which could still see it has left, readers which came
+ * later see the new one.
+ *
+ * Lookups copy entries out and never call anything while reading, so a
+ * callback may register and unregister windows itself.
+ */
+class WindowRegistry {
+ public:
+  struct Entry {
+    WNDID id;
+    // owning process, zero when the platform does not know it
+    uint32_t owner;
+    // subscription of the platform the events of the window come from, see
+    // Backend::GetEventSource
+    uint64_t source;
+    EventCallback callback;
+    // events reported to callback
+    EventFilter filter;
+  };
+
+  WindowRegistry();
+  WindowRegistry(const WindowRegistry&) = delete;
+  ~WindowRegistry();
+
+  // False when id is registered already.
+  bool Add(const Entry& entry);
+  // Replaces the entry of the same id, false when it is not registered.
+  bool Replace(const Entry& entry);
+  // False when id is not registered, entry is what was removed otherwise.
+  bool Remove(WNDID id, Entry* entry = nullptr);
+
+  // Wait-free, false when id is not registered.
+  bool Find(WNDID id, Entry& entry) const;
+
+  // Appends the windows of owner to entries, returns how many there are.
+  size_t FindOwner(uint32_t owner, std::vector<Entry>& entries) const;
+
+  size_t size() const;
+
+ private:
+  struct Table;
+
+  epoch_snapshot<Table> table_;
+};
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
+
+#endif  // AGORA_PLUGIN_WINDOW_MONITOR_WINDOW_REGISTRY_H
@@ -0,0 +1,71 @@
+#include "../core/backend.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../simulated/simulated_backend.h"
+#if defined(WINDOW_MONITOR_HAS_XCB)
+#include "xcb_backend.h"
+#endif
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+namespace {
+SimulatedBackend* _simulated = nullptr;
+#if defined(WINDOW_MONITOR_HAS_XCB)
+XcbBackend* _xcb = nullptr;
+#endif
+
+uint64_t getEnvNumber(const char* name) {
+  const char* value = getenv(name);
+  return value ? strtoull(value, nullptr, 10) : 0;
+}
+
+// before the statics of the callbacks are destroyed
+void stopBackend() {
+  if (_simulated) _simulated->Stop();
+#if defined(WINDOW_MONITOR_HAS_XCB)
+  if (_xcb) _xcb->Stop();
+#endif
+}
+}  // namespace
+
+// Windows of the X server of DISPLAY, or simulated ones without a server or
+// with WINDOW_MONITOR_BACKEND=simulated. The simulated desktop has
+// WINDOW_MONITOR_SIMULATED_WINDOWS windows with ids from 1 and generates
+// WINDOW_MONITOR_SIMULATED_RATE events per second on them once they are
+// registered.
+std::unique_ptr<Backend> CreatePlatformBackend() {
+  const char* name = getenv("WINDOW_MONITOR_BACKEND");
+  const bool simulated = name && strcmp(name, "simulated") == 0;
+
+#if defined(WINDOW_MONITOR_HAS_XCB)
+  if (!simulated && getenv("DISPLAY")) {
+    std::unique_ptr<XcbBackend> backend = XcbBackend::Connect();
+    if (backend) {
+      _xcb = backend.get();
+      atexit(stopBackend);
+      return std::unique_ptr<Backend>(backend.release());
+    }
+  }
+#else
+  (void)simulated;
+#endif
+
+  SimulatedBackend* backend = new SimulatedBackend();
+  const uint64_t windows = getEnvNumber("WINDOW_MONITOR_SIMULATED_WINDOWS");
+  const uint64_t rate = getEnvNumber("WINDOW_MONITOR_SIMULATED_RATE");
+  if (windows) backend->AddWindows((size_t)windows);
+  if (rate) {
+    _simulated = backend;
+    atexit(stopBackend);
+    backend->Start(rate);
+  }
+  return std::unique_ptr<Backend>(backend);
+}
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
@@ -0,0 +1,534 @@
+#include "xcb_backend.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "../core/trace.h"
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+namespace {
+
+const char* const kAtomNames[] = {
+    "_NET_WM_STATE", "_NET_WM_STATE_HIDDEN", "_NET_WM_STATE_MAXIMIZED_VERT",
+    "_NET_WM_STATE_MAXIMIZED_HORZ", "_NET_ACTIVE_WINDOW"};
+
+const uint32_t kWindowEventMask =
+    XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_PROPERTY_CHANGE;
+
+// what a batch reports of a window, in the order the events arrived
+enum PendingType {
+  kPendingGeometry = 0,
+  kPendingMap,
+  kPendingUnmap,
+  kPendingDestroy,
+  kPendingState
+};
+
+struct Pending {
+  xcb_window_t window;
+  PendingType type;
+};
+
+// queries of one window in a batch, value initialized
+struct Query {
+  bool geometry;
+  bool state;
+  bool state_reported;
+  xcb_get_geometry_cookie_t geometry_cookie;
+  xcb_translate_coordinates_cookie_t translate_cookie;
+  xcb_get_property_cookie_t state_cookie;
+  bool has_rect;
+  CRect rect;
+  bool has_state;
+  uint32_t new_state;
+};
+
+uint64_t nowMicroseconds() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+RawEvent makeRawEvent(xcb_window_t window, RawEventKind kind,
+                      uint32_t state, const CRect& rect) {
+  RawEvent event;
+  event.id = (WNDID)window;
+  event.kind = kind;
+  event.state = state;
+  event.has_rect = true;
+  event.rect = rect;
+  event.timestamp = nowMicroseconds();
+  return event;
+}
+
+}  // namespace
+
+std::unique_ptr<XcbBackend> XcbBackend::Connect(const char* display) {
+  int screen_number = 0;
+  xcb_connection_t* connection = xcb_connect(display, &screen_number);
+  if (xcb_connection_has_error(connection)) {
+    xcb_disconnect(connection);
+    return nullptr;
+  }
+
+  xcb_screen_iterator_t itr = xcb_setup_roots_iterator(xcb_get_setup(connection));
+  for (int i = 0; i < screen_number && itr.rem; i++) xcb_screen_next(&itr);
+  if (!itr.rem) {
+    xcb_disconnect(connection);
+    return nullptr;
+  }
+
+  std::unique_ptr<XcbBackend> backend(
+      new XcbBackend(connection, itr.data->root));
+  if (!backend->Init()) return nullptr;
+  return backend;
+}
+
+XcbBackend::XcbBackend(xcb_connection_t* connection, xcb_window_t root)
+    : connection_(connection),
+      root_(root),
+      active_(0),
+      quit_(false),
+      running_(false) {
+  memset(atoms_, 0, sizeof(atoms_));
+  wake_[0] = wake_[1] = -1;
+}
+
+XcbBackend::~XcbBackend() {
+  Stop();
+  if (wake_[0] >= 0) close(wake_[0]);
+  if (wake_[1] >= 0) close(wake_[1]);
+  xcb_disconnect(connection_);
+}
+
+bool XcbBackend::Init() {
+  xcb_intern_atom_cookie_t cookies[kAtomCount];
+  for (int i = 0; i < kAtomCount; i++) {
+    cookies[i] = xcb_intern_atom(connection_, 0,
+                                 (uint16_t)strlen(kAtomNames[i]),
+                                 kAtomNames[i]);
+  }
+  for (int i = 0; i < kAtomCount; i++) {
+    xcb_intern_atom_reply_t* reply =
+        xcb_intern_atom_reply(connection_, cookies[i], nullptr);
+    if (reply) atoms_[i] = reply->atom;
+    free(reply);
+  }
+
+  // _NET_ACTIVE_WINDOW changes
+  const uint32_t mask[] = {XCB_EVENT_MASK_PROPERTY_CHANGE};
+  xcb_change_window_attributes(connection_, root_, XCB_CW_EVENT_MASK, mask);
+  xcb_flush(connection_);
+
+  if (pipe(wake_) != 0) return false;
+  // a full pipe wakes the loop as well
+  fcntl(wake_[0], F_SETFL, O_NONBLOCK);
+  fcntl(wake_[1], F_SETFL, O_NONBLOCK);
+  return true;
+}
+
+// The poll of the backend pumps the monitor thread, tasks run when the wake
+// pipe is readable.
+class XcbBackend::Loop : public MonitorLoop {
+ public:
+  explicit Loop(XcbBackend* backend) : backend_(backend) {}
+
+  void Run(const std::function<void()>& run_tasks) override {
+    backend_->Run(run_tasks);
+  }
+  void Wake() override { backend_->Wake(); }
+  void Quit() override {
+    backend_->quit_ = true;
+    backend_->Wake();
+  }
+
+ private:
+  XcbBackend* backend_;
+};
+
+std::unique_ptr<MonitorLoop> XcbBackend::CreateLoop() {
+  return std::unique_ptr<MonitorLoop>(new Loop(this));
+}
+
+void XcbBackend::Stop() {
+  quit_ = true;
+  Wake();
+
+  std::unique_lock<std::mutex> guard(lock_);
+  stopped_.wait(guard, [this] { return !running_; });
+}
+
+int XcbBackend::Attach(WNDID id) {
+  const xcb_window_t window = (xcb_window_t)id;
+
+  // select first, nothing which happens after the query is missed
+  const uint32_t mask[] = {kWindowEventMask};
+  xcb_void_cookie_t select = xcb_change_window_attributes_checked(
+      connection_, window, XCB_CW_EVENT_MASK, mask);
+  xcb_get_geometry_cookie_t geometry = xcb_get_geometry(connection_, window);
+  xcb_translate_coordinates_cookie_t translate =
+      xcb_translate_coordinates(connection_, window, root_, 0, 0);
+  xcb_get_property_cookie_t state = QueryState(window);
+
+  xcb_generic_error_t* error = xcb_request_check(connection_, select);
+  Window entry;
+  const bool found = ReadRect(geometry, translate, entry.rect);
+  entry.state = ReadState(state);
+  Wake();
+
+  if (!found || error) {
+    free(error);
+    return found ? ErrorCode::CreateObserverFailed : ErrorCode::WindowNotFound;
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  if (!windows_.emplace(window, entry).second) return ErrorCode::AlreadyExist;
+  return ErrorCode::Success;
+}
+
+void XcbBackend::Detach(WNDID id) {
+  const xcb_window_t window = (xcb_window_t)id;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!windows_.erase(window)) return;
+  }
+
+  const uint32_t mask[] = {XCB_EVENT_MASK_NO_EVENT};
+  xcb_change_window_attributes(connection_, window, XCB_CW_EVENT_MASK, mask);
+  xcb_flush(connection_);
+}
+
+int XcbBackend::GetWindowRect(WNDID id, CRect& crect) {
+  const xcb_window_t window = (xcb_window_t)id;
+  xcb_get_geometry_cookie_t geometry = xcb_get_geometry(connection_, window);
+  xcb_translate_coordinates_cookie_t translate =
+      xcb_translate_coordinates(connection_, window, root_, 0, 0);
+  const bool found = ReadRect(geometry, translate, crect);
+  Wake();
+  return found ? ErrorCode::Success : ErrorCode::WindowNotFound;
+}
+
+size_t XcbBackend::attached_count() const {
+  std::lock_guard<std::mutex> guard(lock_);
+  return windows_.size();
+}
+
+// Replies read by other threads may have queued events which the poll of the
+// loop does not see.
+void XcbBackend::Wake() {
+  const char wake = 0;
+  if (write(wake_[1], &wake, 1) < 0) return;
+}
+
+void XcbBackend::Run(const std::function<void()>& run_tasks) {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    running_ = true;
+  }
+
+  pollfd fds[2];
+  fds[0].fd = xcb_get_file_descriptor(connection_);
+  fds[0].events = POLLIN;
+  fds[1].fd = wake_[0];
+  fds[1].events = POLLIN;
+
+  std::vector<xcb_generic_event_t*> batch;
+  std::vector<RawEvent> raws;
+  while (!quit_) {
+    xcb_generic_event_t* event;
+    while ((event = xcb_poll_for_event(connection_)) != nullptr) {
+      batch.push_back(event);
+    }
+
+    if (!batch.empty()) {
+      HandleBatch(batch, raws);
+      for (auto item : batch) free(item);
+      batch.clear();
+
+      for (auto& raw : raws) {
+        if (sink_) sink_->OnRawEvent(raw);
+      }
+      raws.clear();
+      // waiting for the replies of the batch may have queued more events
+      continue;
+    }
+
+    // nothing is reported once the connection broke, tasks still run
+    if (xcb_connection_has_error(connection_)) fds[0].fd = -1;
+
+    fds[0].revents = fds[1].revents = 0;
+    poll(fds, 2, -1);
+    if (fds[1].revents & POLLIN) {
+      char drain[64];
+      if (read(wake_[0], drain, sizeof(drain)) < 0) continue;
+      // replies read by the tasks are followed by a new batch
+      run_tasks();
+    }
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  running_ = false;
+  stopped_.notify_all();
+}
+
+void XcbBackend::HandleBatch(const std::vector<xcb_generic_event_t*>& batch,
+                             std::vector<RawEvent>& raws) {
+  MONITOR_TRACE_SCOPE("xcb_batch", 0);
+  std::unordered_map<xcb_window_t, Query> queries;
+  std::vector<Pending> pending;
+  bool active_changed = false;
+
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    auto attached = [this](xcb_window_t window) {
+      return windows_.find(window) != windows_.end();
+    };
+
+    for (auto event : batch) {
+      switch (event->response_type & ~0x80) {
+        case XCB_CONFIGURE_NOTIFY: {
+          auto configure =
+              reinterpret_cast<xcb_configure_notify_event_t*>(event);
+          if (configure->event != configure->window ||
+              !attached(configure->window))
+            break;
+          // the latest rect once per batch
+          Query& q = queries[configure->window];
+          if (!q.geometry) {
+            q.geometry = true;
+            pending.push_back(Pending{configure->window, kPendingGeometry});
+          }
+          break;
+        }
+        case XCB_MAP_NOTIFY: {
+          auto map = reinterpret_cast<xcb_map_notify_event_t*>(event);
+          if (map->event != map->window || !attached(map->window)) break;
+          pending.push_back(Pending{map->window, kPendingMap});
+          break;
+        }
+        case XCB_UNMAP_NOTIFY: {
+          auto unmap = reinterpret_cast<xcb_unmap_notify_event_t*>(event);
+          if (unmap->event != unmap->window || !attached(unmap->window)) break;
+          // iconified windows are unmapped too, the state tells
+          queries[unmap->window].state = true;
+          pending.push_back(Pending{unmap->window, kPendingUnmap});
+          break;
+        }
+        case XCB_DESTROY_NOTIFY: {
+          auto destroy = reinterpret_cast<xcb_destroy_notify_event_t*>(event);
+          if (destroy->event != destroy->window || !attached(destroy->window))
+            break;
+          pending.push_back(Pending{destroy->window, kPendingDestroy});
+          break;
+        }
+        case XCB_PROPERTY_NOTIFY: {
+          auto property = reinterpret_cast<xcb_property_notify_event_t*>(event);
+          if (property->window == root_ &&
+              property->atom == atoms_[kNetActiveWindow]) {
+            active_changed = true;
+          } else if (property->atom == atoms_[kNetWmState] &&
+                     attached(property->window)) {
+            Query& q = queries[property->window];
+            q.state = true;
+            if (!q.state_reported) {
+              q.state_reported = true;
+              pending.push_back(Pending{property->window, kPendingState});
+            }
+          }
+          break;
+        }
+        default:
+          break;
+      }
+    }
+  }
+
+  if (pending.empty() && !active_changed) return;
+
+  // one round trip for the whole batch
+  for (auto& item : queries) {
+    Query& q = item.second;
+    if (q.geometry) {
+      q.geometry_cookie = xcb_get_geometry(connection_, item.first);
+      q.translate_cookie =
+          xcb_translate_coordinates(connection_, item.first, root_, 0, 0);
+    }
+    if (q.state) q.state_cookie = QueryState(item.first);
+  }
+  xcb_get_property_cookie_t active_cookie;
+  if (active_changed) {
+    active_cookie =
+        xcb_get_property(connection_, 0, root_, atoms_[kNetActiveWindow],
+                         XCB_ATOM_WINDOW, 0, 1);
+  }
+
+  for (auto& item : queries) {
+    Query& q = item.second;
+    if (q.geometry) {
+      q.has_rect = ReadRect(q.geometry_cookie, q.translate_cookie, q.rect);
+    }
+    if (q.state) {
+      q.new_state = ReadState(q.state_cookie);
+      q.has_state = true;
+    }
+  }
+  xcb_window_t active = active_;
+  if (active_changed) {
+    xcb_get_property_reply_t* reply =
+        xcb_get_property_reply(connection_, active_cookie, nullptr);
+    if (reply) {
+      active = 0;
+      if (reply->format == 32 && xcb_get_property_value_length(reply) >= 4) {
+        active = *reinterpret_cast<xcb_window_t*>(
+            xcb_get_property_value(reply));
+      }
+    }
+    free(reply);
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  for (auto& item : pending) {
+    auto itr = windows_.find(item.window);
+    // unregistered in the meantime
+    if (itr == windows_.end()) continue;
+    Window& window = itr->second;
+    Query& q = queries[item.window];
+
+    switch (item.type) {
+      case kPendingGeometry: {
+        if (!q.has_rect) break;
+        const CRect old = window.rect;
+        window.rect = q.rect;
+        if (q.rect.right - q.rect.left != old.right - old.left ||
+            q.rect.bottom - q.rect.top != old.bottom - old.top) {
+          raws.push_back(makeRawEvent(item.window, RawResized, window.state,
+                                      window.rect));
+        } else if (q.rect.left != old.left || q.rect.top != old.top) {
+          raws.push_back(makeRawEvent(item.window, RawMoved, window.state,
+                                      window.rect));
+        }
+        break;
+      }
+      case kPendingMap:
+        raws.push_back(
+            makeRawEvent(item.window, RawShow, window.state, window.rect));
+        break;
+      case kPendingUnmap: {
+        const uint32_t state = q.has_state ? q.new_state : window.state;
+        // reported as minimized by the state change
+        if (state & WindowStateMinimized) break;
+        raws.push_back(
+            makeRawEvent(item.window, RawHide, window.state, window.rect));
+        break;
+      }
+      case kPendingDestroy:
+        raws.push_back(
+            makeRawEvent(item.window, RawHide, window.state, window.rect));
+        break;
+      case kPendingState: {
+        if (!q.has_state) break;
+        const uint32_t old = window.state;
+        window.state = q.new_state;
+        const uint32_t changed = old ^ window.state;
+        if (changed & WindowStateMinimized) {
+          raws.push_back(makeRawEvent(
+              item.window,
+              (window.state & WindowStateMinimized) ? RawMinimizeStart
+                                                    : RawMinimizeEnd,
+              window.state, window.rect));
+        }
+        // unmaximizing is reported by the resize which follows
+        if ((changed & WindowStateMaximized) &&
+            (window.state & WindowStateMaximized)) {
+          raws.push_back(makeRawEvent(item.window, RawLocationChange,
+                                      window.state, window.rect));
+        }
+        break;
+      }
+    }
+  }
+
+  if (active != active_) {
+    auto previous = windows_.find(active_);
+    if (previous != windows_.end()) {
+      raws.push_back(makeRawEvent(active_, RawUnfocus, previous->second.state,
+                                  previous->second.rect));
+    }
+    auto next = windows_.find(active);
+    if (next != windows_.end()) {
+      raws.push_back(makeRawEvent(active, RawFocus, next->second.state,
+                                  next->second.rect));
+    }
+    active_ = active;
+  }
+}
+
+xcb_get_property_cookie_t XcbBackend::QueryState(xcb_window_t window) {
+  // a window has a few states, 32 atoms is plenty
+  return xcb_get_property(connection_, 0, window, atoms_[kNetWmState],
+                          XCB_ATOM_ATOM, 0, 32);
+}
+
+uint32_t XcbBackend::ReadState(xcb_get_property_cookie_t cookie) {
+  xcb_generic_error_t* error = nullptr;
+  xcb_get_property_reply_t* reply =
+      xcb_get_property_reply(connection_, cookie, &error);
+  free(error);
+  if (!reply) return WindowStateNormal;
+
+  bool maximized_vert = false, maximized_horz = false;
+  uint32_t state = WindowStateNormal;
+  if (reply->format == 32) {
+    const xcb_atom_t* atoms =
+        reinterpret_cast<const xcb_atom_t*>(xcb_get_property_value(reply));
+    const int count = xcb_get_property_value_length(reply) / 4;
+    for (int i = 0; i < count; i++) {
+      if (atoms[i] == atoms_[kNetWmStateHidden]) {
+        state |= WindowStateMinimized;
+      } else if (atoms[i] == atoms_[kNetWmStateMaximizedVert]) {
+        maximized_vert = true;
+      } else if (atoms[i] == atoms_[kNetWmStateMaximizedHorz]) {
+        maximized_horz = true;
+      }
+    }
+  }
+  free(reply);
+
+  if (maximized_vert && maximized_horz) state |= WindowStateMaximized;
+  return state;
+}
+
+bool XcbBackend::ReadRect(xcb_get_geometry_cookie_t geometry,
+                          xcb_translate_coordinates_cookie_t translate,
+                          CRect& crect) {
+  xcb_generic_error_t* error = nullptr;
+  xcb_get_geometry_reply_t* size =
+      xcb_get_geometry_reply(connection_, geometry, &error);
+  free(error);
+  error = nullptr;
+  xcb_translate_coordinates_reply_t* origin =
+      xcb_translate_coordinates_reply(connection_, translate, &error);
+  free(error);
+
+  const bool found = size && origin;
+  if (found) {
+    crect = CRect((float)origin->dst_x, (float)origin->dst_y,
+                  (float)origin->dst_x + size->width,
+                  (float)origin->dst_y + size->height);
+  }
+  free(size);
+  free(origin);
+  return found;
+}
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
@@ -0,0 +1,101 @@
+#ifndef AGORA_PLUGIN_WINDOW_MONITOR_XCB_BACKEND_H
+#define AGORA_PLUGIN_WINDOW_MONITOR_XCB_BACKEND_H
+
+#include <xcb/xcb.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "../core/backend.h"
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+/**
+ * @brief Window monitor backend of X11 servers.
+ *
+ * Only registered windows get StructureNotify and PropertyChange selected,
+ * plus PropertyChange on the root window for _NET_ACTIVE_WINDOW. Its poll is
+ * the loop of the monitor thread of the core, which attaches windows and
+ * reads events there. Everything read at once is one batch and the geometry
+ * and state of its windows are queried with one round trip of pipelined
+ * cookies, a window moved several times in a batch reports its latest rect
+ * once.
+ */
+class XcbBackend : public Backend {
+ public:
+  XcbBackend(const XcbBackend&) = delete;
+
+  // Connects to display or DISPLAY, null when there is no server.
+  static std::unique_ptr<XcbBackend> Connect(const char* display = nullptr);
+
+  ~XcbBackend();
+
+  // Quits the loop and waits until it left, no events are reported after it.
+  void Stop();
+
+  std::unique_ptr<MonitorLoop> CreateLoop() override;
+  bool CheckPrivileges() override { return true; }
+  int Attach(WNDID id) override;
+  void Detach(WNDID id) override;
+  int GetWindowRect(WNDID id, CRect& crect) override;
+
+  size_t attached_count() const;
+
+ private:
+  enum Atom {
+    kNetWmState = 0,
+    kNetWmStateHidden,
+    kNetWmStateMaximizedVert,
+    kNetWmStateMaximizedHorz,
+    kNetActiveWindow,
+    kAtomCount
+  };
+
+  struct Window {
+    CRect rect;
+    uint32_t state;
+  };
+
+  class Loop;
+
+  XcbBackend(xcb_connection_t* connection, xcb_window_t root);
+
+  bool Init();
+  void Wake();
+  void Run(const std::function<void()>& run_tasks);
+  void HandleBatch(const std::vector<xcb_generic_event_t*>& batch,
+                   std::vector<RawEvent>& raws);
+
+  xcb_get_property_cookie_t QueryState(xcb_window_t window);
+  uint32_t ReadState(xcb_get_property_cookie_t cookie);
+  bool ReadRect(xcb_get_geometry_cookie_t geometry,
+                xcb_translate_coordinates_cookie_t translate, CRect& crect);
+
+  xcb_connection_t* connection_;
+  xcb_window_t root_;
+  xcb_atom_t atoms_[kAtomCount];
+
+  mutable std::mutex lock_;
+  std::unordered_map<xcb_window_t, Window> windows_;
+  // only touched by the monitor thread
+  xcb_window_t active_;
+
+  int wake_[2];
+  std::atomic<bool> quit_;
+  // whether the monitor thread is in Run, guarded by lock_
+  bool running_;
+  std::condition_variable stopped_;
+};
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
+
+#endif  // AGORA_PLUGIN_WINDOW_MONITOR_XCB_BACKEND_H
@@ -0,0 +1,400 @@
+#import <AppKit/AppKit.h>
+#import <AppKit/NSAccessibility.h>
+#import "monitor.h"
+#import "bridging.h"
+#import "../core/backend.h"
+#import "../core/trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+namespace {
+
+// The run loop of the monitor thread, the sources of the observers are added
+// to it by attaching there, a source of its own runs the tasks.
+class RunLoop : public MonitorLoop {
+ public:
+  RunLoop() : loop_(nullptr), source_(nullptr), quit_(false) {}
+
+  void Run(const std::function<void()> &run_tasks) override {
+    CFRunLoopSourceContext context = {};
+    context.info = const_cast<std::function<void()> *>(&run_tasks);
+    context.perform = [](void *info) { (*static_cast<std::function<void()> *>(info))(); };
+    CFRunLoopSourceRef source = CFRunLoopSourceCreate(kCFAllocatorDefault, 0, &context);
+    CFRunLoopAddSource(CFRunLoopGetCurrent(), source, kCFRunLoopDefaultMode);
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      loop_ = CFRunLoopGetCurrent();
+      source_ = source;
+    }
+    // tasks posted before could not wake it
+    run_tasks();
+
+    while (!quit_.load()) {
+      @autoreleasepool {
+        CFRunLoopRunInMode(kCFRunLoopDefaultMode, 1e10, false);
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      loop_ = nullptr;
+      source_ = nullptr;
+    }
+    CFRunLoopSourceInvalidate(source);
+    CFRelease(source);
+  }
+
+  void Wake() override {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!source_) return;
+    CFRunLoopSourceSignal(source_);
+    CFRunLoopWakeUp(loop_);
+  }
+
+  void Quit() override {
+    quit_.store(true);
+    std::lock_guard<std::mutex> guard(lock_);
+    if (loop_) CFRunLoopStop(loop_);
+  }
+
+ private:
+  std::mutex lock_;
+  CFRunLoopRef loop_;
+  CFRunLoopSourceRef source_;
+  std::atomic<bool> quit_;
+};
+
+static const CFStringRef _NOTIFICATIONS[] = {
+    kAXApplicationActivatedNotification, kAXApplicationDeactivatedNotification,
+    kAXApplicationShownNotification,     kAXApplicationHiddenNotification,
+    kAXWindowMovedNotification,          kAXWindowResizedNotification,
+    kAXWindowMiniaturizedNotification,   kAXWindowDeminiaturizedNotification,
+    kAXFocusedWindowChangedNotification};
+static const int _NOTIFICATIONS_SIZE = sizeof(_NOTIFICATIONS) / sizeof(_NOTIFICATIONS[0]);
+
+bool isNotification(CFStringRef name, CFStringRef notification) {
+  return kCFCompareEqualTo == CFStringCompare(name, notification, 0);
+}
+
+bool getWindowRef(CGWindowID id, std::function<void(CFDictionaryRef)> onWindow) {
+  CFArrayRef ids = CFArrayCreate(NULL, (const void **)&id, 1, NULL);
+  CFArrayRef windows = CGWindowListCreateDescriptionFromArray(ids);
+  bool result = false;
+  if (windows && CFArrayGetCount(windows)) {
+    onWindow((CFDictionaryRef)(CFArrayGetValueAtIndex(windows, 0)));
+    result = true;
+  }
+  if (windows) {
+    CFRelease(windows);
+  }
+  CFRelease(ids);
+  return result;
+}
+
+int getWindowOwnerPid(CFDictionaryRef window) {
+  CFNumberRef refPid =
+      reinterpret_cast<CFNumberRef>(CFDictionaryGetValue(window, kCGWindowOwnerPID));
+  if (!refPid) {
+    return 0;
+  }
+  int pid;
+  if (!CFNumberGetValue(refPid, kCFNumberIntType, &pid)) {
+    return 0;
+  }
+  return pid;
+}
+
+int getWindowOwnerPid(CGWindowID id) {
+  int pid;
+  if (getWindowRef(id, [&pid](CFDictionaryRef window) { pid = getWindowOwnerPid(window); })) {
+    return pid;
+  }
+  return 0;
+}
+
+CRect getWindowBounds(CFDictionaryRef window) {
+  CFDictionaryRef window_bounds = reinterpret_cast<CFDictionaryRef>(
+      CFDictionaryGetValue(window, kCGWindowBounds));
+  if (!window_bounds) {
+    return CRect();
+  }
+  CGRect gc_window_rect;
+  if (!CGRectMakeWithDictionaryRepresentation(window_bounds, &gc_window_rect)) {
+    return CRect();
+  }
+  return CRect(gc_window_rect.origin.x, gc_window_rect.origin.y,
+               gc_window_rect.origin.x + gc_window_rect.size.width,
+               gc_window_rect.origin.y + gc_window_rect.size.height);
+}
+
+AXUIElementRef createApplicationAXUIElement(int pid) {
+  AXUIElementRef axApp = AXUIElementCreateApplication(pid);
+  if (!axApp) {
+    NSLog(@"can not create axuielement with %d", pid);
+    return nullptr;
+  }
+
+  return axApp;
+}
+
+AXUIElementRef findWindowAXUIElement(AXUIElementRef axApp, CGWindowID id) {
+  if (!axApp) return nullptr;
+
+  CFArrayRef windows;
+  AXUIElementCopyAttributeValue(axApp, kAXWindowsAttribute, (CFTypeRef *)&windows);
+  if (windows) {
+    for (int i = 0; i < CFArrayGetCount(windows); i++) {
+      AXUIElementRef window = (AXUIElementRef)CFArrayGetValueAtIndex(windows, i);
+      CGWindowID tempId = 0;
+      _AXUIElementGetWindow(window, &tempId);
+      if (tempId == id) {
+        CFRetain(window);
+        CFRelease(windows);
+        return window;
+      }
+    }
+  }
+
+  if (windows) CFRelease(windows);
+
+  return nullptr;
+}
+
+bool registerObserverNotifications(AXObserverRef observer, AXUIElementRef element,
+                                   void *refCon) {
+  for (int i = 0; i < _NOTIFICATIONS_SIZE; i++) {
+    AXError axErr = AXObserverAddNotification(observer, element, _NOTIFICATIONS[i], refCon);
+    if (axErr != kAXErrorSuccess) {
+      NSLog(@"add notification %@ failed %d", _NOTIFICATIONS[i], axErr);
+      return false;
+    }
+  }
+  return true;
+}
+
+void unregisterObserverNotifications(AXObserverRef observer, AXUIElementRef element) {
+  if (!observer || !element) return;
+
+  for (int i = 0; i < _NOTIFICATIONS_SIZE; i++) {
+    AXObserverRemoveNotification(observer, element, _NOTIFICATIONS[i]);
+  }
+}
+
+// Windows of the accessibility api, one observer per application reports the
+// notifications of all of its windows on the run loop of the monitor thread,
+// which attaches them. Notifications carry no time, the core stamps them when
+// they are reported. Moves and resizes are reported once they happened, there
+// is no start or end of a drag.
+class MacBackend : public Backend {
+ public:
+  std::unique_ptr<MonitorLoop> CreateLoop() override {
+    return std::unique_ptr<MonitorLoop>(new RunLoop());
+  }
+
+  bool CheckPrivileges() override {
+    const void *keys[] = {kAXTrustedCheckOptionPrompt};
+    const void *values[] = {kCFBooleanTrue};
+
+    CFDictionaryRef options =
+        CFDictionaryCreate(kCFAllocatorDefault, keys, values, sizeof(keys) / sizeof(*keys),
+                           &kCFCopyStringDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+
+    bool result = AXIsProcessTrustedWithOptions(options);
+    CFRelease(options);
+    return result;
+  }
+
+  int Attach(WNDID id) override {
+    if (!CheckPrivileges()) return ErrorCode::NoRights;
+
+    int pid = getWindowOwnerPid(id);
+    if (pid == 0) return ErrorCode::ApplicationNotFound;
+
+    Application &app = applications_[pid];
+    int code = Observe(pid, app, id);
+    if (code != ErrorCode::Success) {
+      if (app.windows.empty()) {
+        Release(app);
+        applications_.erase(pid);
+      }
+      return code;
+    }
+
+    app.windows.push_back(id);
+    owners_[id] = pid;
+    return ErrorCode::Success;
+  }
+
+  void Detach(WNDID id) override {
+    auto owner = owners_.find(id);
+    if (owner == owners_.end()) return;
+    auto itr = applications_.find(owner->second);
+    owners_.erase(owner);
+    if (itr == applications_.end()) return;
+
+    std::vector<WNDID> &windows = itr->second.windows;
+    windows.erase(std::remove(windows.begin(), windows.end(), id), windows.end());
+    if (!windows.empty()) return;
+
+    Release(itr->second);
+    applications_.erase(itr);
+  }
+
+  int GetWindowRect(WNDID id, CRect &crect) override {
+    if (!getWindowRef(id, [&crect](CFDictionaryRef window) { crect = getWindowBounds(window); }))
+      return ErrorCode::WindowNotFound;
+    return ErrorCode::Success;
+  }
+
+  // https://developer.apple.com/documentation/coregraphics/1454661-cgdisplaymodegetrefreshrate
+  double GetDisplayRate() override {
+    double rate = 0;
+    CGDisplayModeRef mode = CGDisplayCopyDisplayMode(CGMainDisplayID());
+    if (mode) {
+      // zero for most built in displays
+      rate = CGDisplayModeGetRefreshRate(mode);
+      CGDisplayModeRelease(mode);
+    }
+    return rate;
+  }
+
+  uint32_t GetWindowOwner(WNDID id) override { return (uint32_t)getWindowOwnerPid(id); }
+
+ private:
+  struct Application {
+    Application() : element(nullptr), observer(nullptr) {}
+
+    AXUIElementRef element;
+    AXObserverRef observer;
+    // attached windows of the application
+    std::vector<WNDID> windows;
+  };
+
+  // the observer of the application of id, created by its first window
+  int Observe(int pid, Application &app, WNDID id) {
+    if (!app.element) app.element = createApplicationAXUIElement(pid);
+    if (!app.element) return ErrorCode::ApplicationNotFound;
+
+    AXUIElementRef axWindow = findWindowAXUIElement(app.element, id);
+    if (!axWindow) return ErrorCode::WindowNotFound;
+    CFRelease(axWindow);
+
+    if (app.observer) return ErrorCode::Success;
+
+    AXObserverRef observer = nullptr;
+    AXError axErr = AXObserverCreate(pid, OnNotification, &observer);
+    if (axErr != kAXErrorSuccess) {
+      NSLog(@"create observer error %d", axErr);
+      return ErrorCode::CreateObserverFailed;
+    }
+    if (!registerObserverNotifications(observer, app.element, this)) {
+      unregisterObserverNotifications(observer, app.element);
+      CFRelease(observer);
+      return ErrorCode::CreateObserverFailed;
+    }
+    CFRunLoopAddSource(CFRunLoopGetCurrent(), AXObserverGetRunLoopSource(observer),
+                       kCFRunLoopDefaultMode);
+    app.observer = observer;
+    return ErrorCode::Success;
+  }
+
+  void Release(Application &app) {
+    if (app.observer) {
+      unregisterObserverNotifications(app.observer, app.element);
+      CFRunLoopRemoveSource(CFRunLoopGetCurrent(), AXObserverGetRunLoopSource(app.observer),
+                            kCFRunLoopDefaultMode);
+      CFRelease(app.observer);
+      app.observer = nullptr;
+    }
+    if (app.element) {
+      CFRelease(app.element);
+      app.element = nullptr;
+    }
+  }
+
+  static void OnNotification(AXObserverRef observer, AXUIElementRef element,
+                             CFStringRef notificationName, void *refCon) {
+    reinterpret_cast<MacBackend *>(refCon)->Report(element, notificationName);
+  }
+
+  // application notifications are reported to every attached window of the
+  // application, the core classifies the raw events
+  void Report(AXUIElementRef element, CFStringRef name) {
+    int pid = 0;
+    if (AXUIElementGetPid(element, &pid) != kAXErrorSuccess) return;
+    auto app = applications_.find(pid);
+    if (app == applications_.end()) return;
+
+    // fails for the notifications of the application
+    CGWindowID winId = 0;
+    AXError axErr = _AXUIElementGetWindow(element, &winId);
+    MONITOR_TRACE_SCOPE("observer", winId);
+
+    if (axErr != kAXErrorSuccess || winId == 0) {
+      RawEventKind kind;
+      if (isNotification(name, kAXApplicationActivatedNotification) ||
+          isNotification(name, kAXApplicationShownNotification)) {
+        kind = RawShow;
+      } else if (isNotification(name, kAXApplicationDeactivatedNotification) ||
+                 isNotification(name, kAXApplicationHiddenNotification)) {
+        kind = RawHide;
+      } else {
+        return;
+      }
+      for (WNDID id : app->second.windows) Emit(id, kind);
+      return;
+    }
+
+    if (isNotification(name, kAXWindowMovedNotification)) {
+      Emit(winId, RawMoved);
+    } else if (isNotification(name, kAXWindowResizedNotification)) {
+      Emit(winId, RawResized);
+    } else if (isNotification(name, kAXWindowMiniaturizedNotification)) {
+      Emit(winId, RawMinimizeStart);
+    } else if (isNotification(name, kAXWindowDeminiaturizedNotification)) {
+      Emit(winId, RawMinimizeEnd);
+    } else if (isNotification(name, kAXFocusedWindowChangedNotification)) {
+      // the other windows of the application lost the focus
+      for (WNDID id : app->second.windows) {
+        if (id != winId) Emit(id, RawUnfocus);
+      }
+      Emit(winId, RawFocus);
+    }
+  }
+
+  void Emit(WNDID id, RawEventKind kind) {
+    if (!sink_ || !sink_->Observes(id)) return;
+
+    RawEvent raw;
+    raw.id = id;
+    raw.kind = kind;
+    raw.state = WindowStateNormal;
+    raw.has_rect = false;
+    raw.timestamp = 0;
+    sink_->OnRawEvent(raw);
+  }
+
+  // Only touched on the monitor thread, which attaches windows and runs the
+  // observers.
+  std::map<int, Application> applications_;
+  std::map<WNDID, int> owners_;
+};
+
+}  // namespace
+
+std::unique_ptr<Backend> CreatePlatformBackend() {
+  return std::unique_ptr<Backend>(new MacBackend());
+}
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
@@ -0,0 +1,378 @@
+#include "simulated_backend.h"
+
+#include <chrono>
+
+#include "../core/trace.h"
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+namespace {
+// events built under the lock and reported after it
+const size_t kBatchSize = 256;
+
+// the generator thread catches up every tick
+const std::chrono::microseconds kGeneratorTick(1000);
+
+const float kMaximizedWidth = 1920.f;
+const float kMaximizedHeight = 1080.f;
+}  // namespace
+
+SimulatedBackend::Options SimulatedBackend::DefaultOptions() {
+  Options options;
+  options.seed = 1;
+  options.windows_per_owner = 4;
+  // a 1000hz mouse
+  options.event_interval_us = 1000;
+  options.min_gesture_steps = 8;
+  options.max_gesture_steps = 64;
+  options.lookup_rects = false;
+  options.shared_sources = false;
+  return options;
+}
+
+SimulatedBackend::SimulatedBackend() : SimulatedBackend(DefaultOptions()) {}
+
+SimulatedBackend::SimulatedBackend(const Options& options)
+    : options_(options),
+      random_(options.seed ? options.seed : 1),
+      now_(0),
+      running_(false) {}
+
+SimulatedBackend::~SimulatedBackend() { Stop(); }
+
+WNDID SimulatedBackend::AddWindows(size_t count) {
+  std::lock_guard<std::mutex> guard(lock_);
+  const size_t first = windows_.size();
+  const uint32_t per_owner =
+      options_.windows_per_owner ? options_.windows_per_owner : 1;
+  for (size_t i = first; i < first + count; i++) {
+    Window window;
+    const float left = (float)(i % 16) * 120.f;
+    const float top = (float)(i / 16 % 8) * 90.f;
+    window.rect = CRect(left, top, left + 800.f, top + 600.f);
+    window.state = WindowStateNormal;
+    window.owner = (uint32_t)(i / per_owner) + 1;
+    window.exists = true;
+    window.visible = true;
+    window.attached_index = -1;
+    window.gesture_steps = 0;
+    window.gesture_resize = false;
+    window.dx = window.dy = 0.f;
+    windows_.push_back(window);
+    // new windows of a hooked thread are reported right away
+    if (hooked_owners_.count(window.owner)) Observe(i);
+  }
+  return ToId(first);
+}
+
+void SimulatedBackend::RemoveWindow(WNDID id) {
+  std::lock_guard<std::mutex> guard(lock_);
+  Window* window = Find(id);
+  if (!window) return;
+  Unobserve((size_t)((uintptr_t)id - 1));
+  window->exists = false;
+}
+
+size_t SimulatedBackend::window_count() const {
+  std::lock_guard<std::mutex> guard(lock_);
+  size_t count = 0;
+  for (auto& window : windows_) {
+    if (window.exists) count++;
+  }
+  return count;
+}
+
+size_t SimulatedBackend::attached_count() const {
+  std::lock_guard<std::mutex> guard(lock_);
+  return attached_.size();
+}
+
+size_t SimulatedBackend::hook_count() const {
+  std::lock_guard<std::mutex> guard(lock_);
+  return options_.shared_sources ? hooked_owners_.size() : attached_.size();
+}
+
+uint32_t SimulatedBackend::OwnerOf(WNDID id) const {
+  std::lock_guard<std::mutex> guard(lock_);
+  const Window* window = Find(id);
+  return window ? window->owner : 0;
+}
+
+void SimulatedBackend::Emit(WNDID id, RawEventKind kind, const CRect& rect) {
+  RawEvent event;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    Window* window = Find(id);
+    if (!window) return;
+
+    switch (kind) {
+      case RawLocationChange:
+      case RawMoved:
+      case RawResized:
+        window->rect = rect;
+        break;
+      case RawShow:
+        window->visible = true;
+        break;
+      case RawHide:
+        window->visible = false;
+        break;
+      case RawMinimizeStart:
+        window->state |= WindowStateMinimized;
+        break;
+      case RawMinimizeEnd:
+        window->state &= ~WindowStateMinimized;
+        break;
+      case RawMoveSizeStart:
+        window->state |= WindowStateDragging;
+        break;
+      case RawMoveSizeEnd:
+        window->state &= ~WindowStateDragging;
+        break;
+      default:
+        break;
+    }
+
+    // only attached windows are observed
+    if (window->attached_index < 0) return;
+    event = MakeEvent((size_t)((uintptr_t)id - 1), kind);
+  }
+
+  Deliver(&event, 1);
+}
+
+size_t SimulatedBackend::Generate(size_t count) {
+  RawEvent batch[kBatchSize];
+  size_t generated = 0;
+  while (generated < count) {
+    size_t size = 0;
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      if (attached_.empty()) break;
+
+      while (size < kBatchSize && generated + size < count) {
+        const size_t index = attached_[Random() % attached_.size()];
+        batch[size++] = Next(index);
+      }
+    }
+
+    Deliver(batch, size);
+    generated += size;
+  }
+  return generated;
+}
+
+void SimulatedBackend::Start(uint64_t events_per_second) {
+  Stop();
+  running_ = true;
+  generator_ = std::thread(&SimulatedBackend::Run, this, events_per_second);
+}
+
+void SimulatedBackend::Stop() {
+  running_ = false;
+  if (generator_.joinable()) generator_.join();
+}
+
+uint64_t SimulatedBackend::now() const {
+  std::lock_guard<std::mutex> guard(lock_);
+  return now_;
+}
+
+uint64_t SimulatedBackend::GetEventSource(WNDID id) {
+  if (!options_.shared_sources) return 0;
+  return OwnerOf(id);
+}
+
+int SimulatedBackend::Attach(WNDID id) {
+  std::lock_guard<std::mutex> guard(lock_);
+  Window* window = Find(id);
+  if (!window) return ErrorCode::WindowNotFound;
+
+  if (!options_.shared_sources) {
+    if (window->attached_index >= 0) return ErrorCode::AlreadyExist;
+    Observe((size_t)((uintptr_t)id - 1));
+    return ErrorCode::Success;
+  }
+
+  if (!hooked_owners_.insert(window->owner).second)
+    return ErrorCode::AlreadyExist;
+  for (size_t i = 0; i < windows_.size(); i++) {
+    if (windows_[i].exists && windows_[i].owner == window->owner) Observe(i);
+  }
+  return ErrorCode::Success;
+}
+
+void SimulatedBackend::Detach(WNDID id) {
+  std::lock_guard<std::mutex> guard(lock_);
+  const size_t index = (size_t)((uintptr_t)id - 1);
+  if (index >= windows_.size()) return;
+
+  if (!options_.shared_sources) {
+    Unobserve(index);
+    return;
+  }
+
+  // the window may be removed already, its owner is still known
+  const uint32_t owner = windows_[index].owner;
+  if (!hooked_owners_.erase(owner)) return;
+  for (size_t i = 0; i < windows_.size(); i++) {
+    if (windows_[i].owner == owner) Unobserve(i);
+  }
+}
+
+int SimulatedBackend::GetWindowRect(WNDID id, CRect& crect) {
+  std::lock_guard<std::mutex> guard(lock_);
+  const Window* window = Find(id);
+  if (!window) return ErrorCode::WindowNotFound;
+
+  crect = window->rect;
+  return ErrorCode::Success;
+}
+
+SimulatedBackend::Window* SimulatedBackend::Find(WNDID id) {
+  const size_t index = (size_t)((uintptr_t)id - 1);
+  if (index >= windows_.size() || !windows_[index].exists) return nullptr;
+  return &windows_[index];
+}
+
+const SimulatedBackend::Window* SimulatedBackend::Find(WNDID id) const {
+  return const_cast<SimulatedBackend*>(this)->Find(id);
+}
+
+void SimulatedBackend::Observe(size_t index) {
+  Window& window = windows_[index];
+  if (window.attached_index >= 0) return;
+
+  window.attached_index = (int64_t)attached_.size();
+  attached_.push_back(index);
+}
+
+void SimulatedBackend::Unobserve(size_t index) {
+  Window& window = windows_[index];
+  if (window.attached_index < 0) return;
+
+  // swap with the last attached window
+  const size_t position = (size_t)window.attached_index;
+  attached_[position] = attached_.back();
+  windows_[attached_[position]].attached_index = (int64_t)position;
+  attached_.pop_back();
+  window.attached_index = -1;
+}
+
+// xorshift64*
+uint32_t SimulatedBackend::Random() {
+  random_ ^= random_ >> 12;
+  random_ ^= random_ << 25;
+  random_ ^= random_ >> 27;
+  return (uint32_t)((random_ * 2685821657736338717ULL) >> 32);
+}
+
+RawEvent SimulatedBackend::Next(size_t index) {
+  Window& window = windows_[index];
+
+  if (window.gesture_steps > 0) {
+    if (--window.gesture_steps == 0) {
+      window.state &= ~WindowStateDragging;
+      return MakeEvent(index, RawMoveSizeEnd);
+    }
+
+    if (window.gesture_resize) {
+      window.rect.right += window.dx;
+      window.rect.bottom += window.dy;
+    } else {
+      window.rect.left += window.dx;
+      window.rect.top += window.dy;
+      window.rect.right += window.dx;
+      window.rect.bottom += window.dy;
+    }
+    return MakeEvent(index, RawLocationChange);
+  }
+
+  if (!window.visible) {
+    window.visible = true;
+    return MakeEvent(index, RawShow);
+  }
+  if (window.state & WindowStateMinimized) {
+    window.state &= ~WindowStateMinimized;
+    return MakeEvent(index, RawMinimizeEnd);
+  }
+
+  const uint32_t roll = Random() % 100;
+  if (roll < 80 && !(window.state & WindowStateMaximized)) {
+    const uint32_t range =
+        options_.max_gesture_steps - options_.min_gesture_steps + 1;
+    // one more step for the end of the gesture
+    window.gesture_steps = options_.min_gesture_steps + Random() % range + 1;
+    window.gesture_resize = roll >= 60;
+    window.dx = (float)(Random() % 17) - 8.f;
+    window.dy = (float)(Random() % 17) - 8.f;
+    window.state |= WindowStateDragging;
+    return MakeEvent(index, RawMoveSizeStart);
+  }
+  if (roll < 88) return MakeEvent(index, RawFocus);
+  if (roll < 92) return MakeEvent(index, RawUnfocus);
+  if (roll < 95) {
+    window.state |= WindowStateMinimized;
+    return MakeEvent(index, RawMinimizeStart);
+  }
+  if (roll < 98) {
+    window.state ^= WindowStateMaximized;
+    if (window.state & WindowStateMaximized) {
+      window.rect = CRect(0.f, 0.f, kMaximizedWidth, kMaximizedHeight);
+    } else {
+      const float left = (float)(index % 16) * 120.f;
+      window.rect = CRect(left, 0.f, left + 800.f, 600.f);
+    }
+    return MakeEvent(index, RawLocationChange);
+  }
+
+  window.visible = false;
+  return MakeEvent(index, RawHide);
+}
+
+RawEvent SimulatedBackend::MakeEvent(size_t index, RawEventKind kind) {
+  const Window& window = windows_[index];
+  now_ += options_.event_interval_us;
+
+  RawEvent event;
+  event.id = ToId(index);
+  event.kind = kind;
+  event.state = window.state;
+  event.has_rect = !options_.lookup_rects;
+  event.rect = window.rect;
+  // now_ is virtual, the core stamps the event when it is delivered
+  event.timestamp = 0;
+  return event;
+}
+
+void SimulatedBackend::Run(uint64_t events_per_second) {
+  typedef std::chrono::steady_clock clock;
+  const clock::time_point begin = clock::now();
+  uint64_t generated = 0;
+  clock::time_point tick = begin;
+  while (running_) {
+    tick += kGeneratorTick;
+    std::this_thread::sleep_until(tick);
+
+    const uint64_t elapsed_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(clock::now() -
+                                                              begin)
+            .count();
+    const uint64_t due = events_per_second * elapsed_us / 1000000;
+    // events missed while nothing was attached are not made up later
+    Generate((size_t)(due - generated));
+    generated = due;
+  }
+}
+
+void SimulatedBackend::Deliver(const RawEvent* events, size_t count) {
+  MONITOR_TRACE_SCOPE("simulated_batch", 0);
+  if (!sink_) return;
+  for (size_t i = 0; i < count; i++) sink_->OnRawEvent(events[i]);
+}
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
@@ -0,0 +1,134 @@
+#ifndef AGORA_PLUGIN_WINDOW_MONITOR_SIMULATED_BACKEND_H
+#define AGORA_PLUGIN_WINDOW_MONITOR_SIMULATED_BACKEND_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "../core/backend.h"
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+/**
+ * @brief Deterministic desktop without a display, to run and profile the
+ * monitor pipeline in CI and on perf boxes.
+ *
+ * Windows live in a table, Generate synthesizes what users do to the
+ * attached ones, drags and resizes as move size gestures plus minimize,
+ * show and focus changes, on a virtual clock. The same seed gives the same
+ * events. Events are delivered on the thread calling Generate or Emit, or
+ * on the generator thread between Start and Stop.
+ */
+class SimulatedBackend : public Backend {
+ public:
+  struct Options {
+    uint32_t seed;
+    // windows sharing one owning process
+    uint32_t windows_per_owner;
+    // virtual time between two events
+    uint64_t event_interval_us;
+    // location changes of one drag or resize gesture
+    uint32_t min_gesture_steps;
+    uint32_t max_gesture_steps;
+    // events carry no rect and the core looks it up like for the win32
+    // hooks, which sees the rect after the whole batch was generated
+    bool lookup_rects;
+    // the windows of an owner share one subscription like the hooks of a
+    // win32 thread, attaching one observes all of them
+    bool shared_sources;
+  };
+
+  static Options DefaultOptions();
+
+  SimulatedBackend();
+  explicit SimulatedBackend(const Options& options);
+  ~SimulatedBackend();
+
+  // Adds count windows with consecutive ids, returns the first one.
+  WNDID AddWindows(size_t count);
+  void RemoveWindow(WNDID id);
+
+  size_t window_count() const;
+  // windows whose events are reported
+  size_t attached_count() const;
+  // subscriptions, one per attached owner with shared_sources
+  size_t hook_count() const;
+
+  // Owning process of id, zero for unknown windows.
+  uint32_t OwnerOf(WNDID id) const;
+
+  // Applies kind to id like the platform would and reports it, rect is used
+  // by location changes only.
+  void Emit(WNDID id, RawEventKind kind, const CRect& rect = CRect());
+
+  // Synthesizes count events on the attached windows, returns how many were
+  // reported, which is count unless no window is attached.
+  size_t Generate(size_t count);
+
+  // Generates events_per_second on a thread of its own until Stop, like a
+  // platform event thread.
+  void Start(uint64_t events_per_second);
+  void Stop();
+
+  // Virtual clock in microseconds.
+  uint64_t now() const;
+
+  bool CheckPrivileges() override { return true; }
+  int Attach(WNDID id) override;
+  void Detach(WNDID id) override;
+  int GetWindowRect(WNDID id, CRect& crect) override;
+  uint32_t GetWindowOwner(WNDID id) override { return OwnerOf(id); }
+  uint64_t GetEventSource(WNDID id) override;
+
+ private:
+  struct Window {
+    CRect rect;
+    uint32_t state;
+    uint32_t owner;
+    bool exists;
+    bool visible;
+    // index in attached_ or -1
+    int64_t attached_index;
+    // remaining location changes of the running gesture
+    uint32_t gesture_steps;
+    bool gesture_resize;
+    float dx;
+    float dy;
+  };
+
+  static WNDID ToId(size_t index) { return (WNDID)(uintptr_t)(index + 1); }
+  Window* Find(WNDID id);
+  const Window* Find(WNDID id) const;
+  void Observe(size_t index);
+  void Unobserve(size_t index);
+
+  uint32_t Random();
+  RawEvent Next(size_t index);
+  RawEvent MakeEvent(size_t index, RawEventKind kind);
+  void Deliver(const RawEvent* events, size_t count);
+  void Run(uint64_t events_per_second);
+
+  const Options options_;
+
+  mutable std::mutex lock_;
+  std::vector<Window> windows_;
+  std::vector<size_t> attached_;
+  std::unordered_set<uint32_t> hooked_owners_;
+  uint64_t random_;
+  uint64_t now_;
+
+  std::thread generator_;
+  std::atomic<bool> running_;
+};
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
+
+#endif  // AGORA_PLUGIN_WINDOW_MONITOR_SIMULATED_BACKEND_H
@@ -0,0 +1,256 @@
+#include "monitor.h"
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "../core/backend.h"
+#include "../core/monitor_core.h"
+#include "../core/trace.h"
+#include "hooker.h"
+
+namespace agora {
+namespace plugin {
+namespace windowmonitor {
+
+namespace {
+
+uint32_t getWindowState(HWND hwnd) {
+  WINDOWPLACEMENT wp;
+  wp.length = sizeof(WINDOWPLACEMENT);
+  if (!GetWindowPlacement(hwnd, &wp)) return WindowStateNormal;
+  if (SW_SHOWMINIMIZED == wp.showCmd) return WindowStateMinimized;
+  if (SW_SHOWMAXIMIZED == wp.showCmd) return WindowStateMaximized;
+  return WindowStateNormal;
+}
+
+// dwmsEventTime is on the tick count clock, move it to the steady clock of
+// the core by its age
+uint64_t toSteadyMicroseconds(DWORD eventTime) {
+  uint64_t now = MonitorCore::Now();
+  // unsigned, still right when the tick count wrapped in between
+  uint64_t age = (uint64_t)(DWORD)(::GetTickCount() - eventTime) * 1000;
+  return age < now ? now - age : now;
+}
+
+// windows being dragged, the hooks report the events of a window on the
+// thread of its hooker only
+thread_local std::unordered_set<HWND> _dragging;
+// visibility last reported of the windows, the show and hide events of their
+// child windows only count when it changed
+thread_local std::unordered_map<HWND, bool> _visible;
+
+// posted to the monitor thread to run its tasks
+const UINT kWakeMessage = WM_APP + 1;
+
+class Win32Backend : public Backend {
+ public:
+  std::unique_ptr<MonitorLoop> CreateLoop() override {
+    return std::unique_ptr<MonitorLoop>(new HookLoop(this));
+  }
+
+  bool CheckPrivileges() override { return true; }
+
+  int Attach(WNDID wid) override {
+    if (hookers_.find(wid) != hookers_.end()) {
+      return ErrorCode::AlreadyExist;
+    }
+
+    auto hooker = new Hooker(
+        wid, std::bind(&Win32Backend::HookerCallback, this,
+                       std::placeholders::_1, std::placeholders::_2,
+                       std::placeholders::_3, std::placeholders::_4,
+                       std::placeholders::_5));
+
+    if (!hooker->HaveHooks()) {
+      delete hooker;
+      return ErrorCode::CreateObserverFailed;
+    }
+
+    hookers_[wid].reset(hooker);
+    return ErrorCode::Success;
+  }
+
+  void Detach(WNDID wid) override {
+    std::map<WNDID, std::unique_ptr<Hooker>>::iterator itr;
+    if ((itr = hookers_.find(wid)) == hookers_.end()) return;
+
+    hookers_.erase(itr);
+  }
+
+  int GetWindowRect(WNDID id, CRect& crect) override {
+    RECT rect;
+    ::GetWindowRect(id, &rect);
+
+    // https://docs.microsoft.com/en-us/windows/win32/api/winuser/nf-winuser-getdpiforwindow
+    float dpi = (float)::GetDpiForWindow(id);
+    if (dpi != 0)
+      crect = CRect((float)rect.left * 96.f / dpi,
+                    (float)rect.top * 96.f / dpi,
+                    (float)rect.right * 96.f / dpi,
+                    (float)rect.bottom * 96.f / dpi);
+    else
+      crect = CRect((float)rect.left, (float)rect.top, (float)rect.right,
+                    (float)rect.bottom);
+
+    return ErrorCode::Success;
+  }
+
+  // https://docs.microsoft.com/en-us/windows/win32/api/winuser/nf-winuser-enumdisplaysettingsw
+  double GetDisplayRate() override {
+    DEVMODE mode = {};
+    mode.dmSize = sizeof(mode);
+    if (!::EnumDisplaySettings(NULL, ENUM_CURRENT_SETTINGS, &mode)) return 0;
+    // 0 and 1 stand for the default rate of the hardware
+    return mode.dmDisplayFrequency > 1 ? (double)mode.dmDisplayFrequency : 0;
+  }
+
+  uint32_t GetWindowOwner(WNDID id) override {
+    DWORD pid = 0;
+    ::GetWindowThreadProcessId(id, &pid);
+    return (uint32_t)pid;
+  }
+
+  // the hooks are per thread, the windows of a thread share them
+  uint64_t GetEventSource(WNDID id) override {
+    DWORD pid = 0;
+    DWORD tid = ::GetWindowThreadProcessId(id, &pid);
+    if (!pid || !tid) return 0;
+    return ((uint64_t)pid << 32) | tid;
+  }
+
+ private:
+  // WINEVENT_OUTOFCONTEXT hooks report through the message queue of the
+  // thread which set them, GetMessage calls the hook procedures. The hooks
+  // are set by Attach on the monitor thread, so they and the queries of the
+  // events run there instead of on the thread which registered.
+  // https://docs.microsoft.com/en-us/windows/win32/api/winuser/nf-winuser-setwineventhook
+  class HookLoop : public MonitorLoop {
+   public:
+    explicit HookLoop(Win32Backend* backend)
+        : backend_(backend), thread_id_(0), quit_(false) {}
+
+    void Run(const std::function<void()>& run_tasks) override {
+      MSG msg;
+      // the queue of the thread exists once it peeked, tasks posted before
+      // could not wake it
+      ::PeekMessage(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE);
+      thread_id_.store(::GetCurrentThreadId());
+      run_tasks();
+
+      while (!quit_.load() && ::GetMessage(&msg, NULL, 0, 0) > 0) {
+        if (msg.hwnd == NULL && msg.message == kWakeMessage) {
+          run_tasks();
+          continue;
+        }
+        ::TranslateMessage(&msg);
+        ::DispatchMessage(&msg);
+      }
+
+      // hooks are removed by the thread which set them
+      backend_->hookers_.clear();
+    }
+
+    void Wake() override {
+      DWORD thread_id = thread_id_.load();
+      if (thread_id) ::PostThreadMessage(thread_id, kWakeMessage, 0, 0);
+    }
+
+    void Quit() override {
+      quit_.store(true);
+      Wake();
+    }
+
+   private:
+    Win32Backend* backend_;
+    std::atomic<DWORD> thread_id_;
+    std::atomic<bool> quit_;
+  };
+
+  // one hooker reports the events of every window of its thread, those of
+  // windows which are not registered are dropped before asking windows
+  // anything about them, the core classifies the raw event
+  // https://docs.microsoft.com/en-us/windows/win32/api/winuser/nc-winuser-wineventproc
+  // https://docs.microsoft.com/en-us/windows/win32/winauto/event-constants
+  void HookerCallback(HWND hwnd, DWORD event, LONG idObject, LONG idChild,
+                      DWORD time) {
+    MONITOR_TRACE_SCOPE("hook", hwnd);
+    // of every window, one may be registered while it is dragged
+    if (event == EVENT_SYSTEM_MOVESIZESTART) _dragging.insert(hwnd);
+    if (event == EVENT_SYSTEM_MOVESIZEEND) _dragging.erase(hwnd);
+    if (!sink_ || !hwnd) return;
+
+    // a window may only show or hide its child windows, like the content of
+    // a browser, they stand for the top level window they belong to
+    HWND id = hwnd;
+    if ((event == EVENT_OBJECT_SHOW || event == EVENT_OBJECT_HIDE) &&
+        !sink_->Observes(id))
+      id = ::GetAncestor(hwnd, GA_ROOT);
+    if (!id || !sink_->Observes(id)) return;
+
+    RawEvent raw;
+    raw.id = id;
+    raw.state = WindowStateNormal;
+    raw.has_rect = false;
+    raw.timestamp = toSteadyMicroseconds(time);
+
+    switch (event) {
+      case EVENT_OBJECT_SHOW:
+      case EVENT_OBJECT_HIDE: {
+        if (idObject != OBJID_WINDOW) return;
+        const bool visible = ::IsWindowVisible(id) != FALSE;
+        if (visible != (event == EVENT_OBJECT_SHOW)) return;
+        auto itr = _visible.find(id);
+        if (id != hwnd && itr != _visible.end() && itr->second == visible)
+          return;
+        _visible[id] = visible;
+        raw.kind = visible ? RawShow : RawHide;
+        if (visible) raw.state = getWindowState(id);
+        break;
+      }
+      case EVENT_OBJECT_LOCATIONCHANGE:
+        if (idObject == OBJID_CURSOR) return;
+        raw.kind = RawLocationChange;
+        raw.state = getWindowState(hwnd);
+        // only care about maximized and window moves here.
+        if (!(raw.state & WindowStateMaximized) && idObject != OBJID_WINDOW)
+          return;
+        if (_dragging.count(hwnd)) raw.state |= WindowStateDragging;
+        break;
+      case EVENT_SYSTEM_MOVESIZESTART:
+        raw.kind = RawMoveSizeStart;
+        break;
+      case EVENT_SYSTEM_MOVESIZEEND:
+        raw.kind = RawMoveSizeEnd;
+        break;
+      case EVENT_SYSTEM_MINIMIZESTART:
+        raw.kind = RawMinimizeStart;
+        break;
+      case EVENT_SYSTEM_MINIMIZEEND:
+        raw.kind = RawMinimizeEnd;
+        raw.state = getWindowState(hwnd);
+        break;
+      default:
+        return;
+    }
+
+    sink_->OnRawEvent(raw);
+  }
+
+  // One per thread, by the window it was attached with. Only touched on the
+  // monitor thread.
+  std::map<WNDID, std::unique_ptr<Hooker>> hookers_;
+};
+
+}  // namespace
+
+std::unique_ptr<Backend> CreatePlatformBackend() {
+  return std::unique_ptr<Backend>(new Win32Backend());
+}
+
+}  // namespace windowmonitor
+}  // namespace plugin
+}  // namespace agora
@@ -42,7 +42,8 @@ void __stdcall Hooker::WinEventProc(Hooker* me, HWINEVENTHOOK hWinEventHook,
                                     DWORD event, HWND hwnd, LONG idObject,
                                     LONG idChild, DWORD idEventThread,
                                     DWORD dwmsEventTime) {
-  if (me->callback_) me->callback_(event, idObject, idChild);
+  if (me->callback_)
+    me->callback_(hwnd, event, idObject, idChild, dwmsEventTime);
 }
 
 }  // namespace windowmonitor
@@ -12,13 +12,21 @@ namespace agora {
 namespace plugin {
 namespace windowmonitor {
 
+/**
+ * @brief The WinEvent hooks of the thread owning a window, they report the
+ * events of every window of the thread.
+ */
 class Hooker {
  public:
   Hooker() = delete;
   Hooker(const Hooker&) = delete;
 
-  using HookerCallback =
-      std::function<void(DWORD event, LONG idObject, LONG idChild)>;
+  // hwnd is the window of the event, which may be a child of the window
+  // shown or hidden, time is the GetTickCount() milliseconds when the event
+  // was generated
+  using HookerCallback = std::function<void(HWND hwnd, DWORD event,
+                                            LONG idObject, LONG idChild,
+                                            DWORD time)>;
 
   Hooker(HWND hwnd, HookerCallback callback);
   ~Hooker();
@@ -26,9 +34,8 @@ class Hooker {
   bool HaveHooks() { return !hooks_.empty(); }
 
  private:
-  // coz we can not get correct hwnd when the event is EVENT_OBJECT_SHOW and
-  // EVENT_OBJECT_HIDE. so we use the FunctionStub to combine Hooker with
-  // callback function
+  // SetWinEventHook passes no context to its procedure, the FunctionStub
+  // binds this one to its Hooker
   static void CALLBACK WinEventProc(Hooker* me, HWINEVENTHOOK hWinEventHook,
                                     DWORD event, HWND hwnd, LONG idObject,
                                     LONG idChild, DWORD idEventThread,
@@ -0,0 +1,874 @@
+// Check the platform neutral monitor core against the simulated backend:
+// classification of raw events, registration and dispatch only to the
+// registered windows with their capture time, that the simulated desktop
+// is deterministic, that a recorded event trace replays the same events, that
+// the registry of windows can be read while it changes, that windows of
+// one owner share one subscription of the backend, that windows are
+// attached on the monitor thread, that geometry updates are paced to a
+// frame rate, that filters drop events before they are dispatched, that
+// drags are extrapolated and that they are reported as gestures.
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../src/core/event_filter.h"
+#include "../src/core/event_trace.h"
+#include "../src/core/frame_pacer.h"
+#include "../src/core/gesture_tracker.h"
+#include "../src/core/monitor_core.h"
+#include "../src/core/monitor_thread.h"
+#include "../src/core/motion_predictor.h"
+#include "../src/core/window_registry.h"
+#include "../src/simulated/simulated_backend.h"
+
+using namespace agora::plugin::windowmonitor;
+
+#define EXPECT(cond)                                                   \
+  do {                                                                 \
+    if (!(cond)) {                                                     \
+      printf("%s:%d expect failed: %s\r\n", __FILE__, __LINE__, #cond); \
+      return false;                                                    \
+    }                                                                  \
+  } while (0)
+
+namespace {
+
+struct Received {
+  WNDID id;
+  EventType type;
+  CRect rect;
+  uint64_t timestamp;
+};
+
+static std::vector<Received> _received;
+// motions of the predicted Moving received
+static std::vector<WindowMotion> _motions;
+
+void onEvent(WNDID id, EventType type, CRect rect) {
+  _received.push_back(
+      Received{id, type, rect, MonitorCore::CurrentTimestamp()});
+  WindowMotion motion;
+  if (MonitorCore::CurrentMotion(motion)) _motions.push_back(motion);
+}
+
+static MonitorCore* _core = nullptr;
+
+// swaps its window for the next one on the first report
+void onEventReregister(WNDID id, EventType type, CRect rect) {
+  onEvent(id, type, rect);
+  _core->Unregister(id);
+  _core->Register((WNDID)((uintptr_t)id + 1), onEvent);
+}
+
+// ids of the simulated windows are consecutive, HWND on windows
+WNDID nth(WNDID first, size_t index) {
+  return (WNDID)((uintptr_t)first + index);
+}
+
+RawEvent makeRaw(RawEventKind kind, uint32_t state) {
+  RawEvent event;
+  event.id = 1;
+  event.kind = kind;
+  event.state = state;
+  event.has_rect = false;
+  event.timestamp = 0;
+  return event;
+}
+
+bool testClassify() {
+  struct {
+    RawEventKind kind;
+    uint32_t state;
+    EventType expected;
+  } cases[] = {
+      {RawShow, WindowStateNormal, EventType::Shown},
+      {RawShow, WindowStateMinimized, EventType::Unknown},
+      {RawHide, WindowStateNormal, EventType::Hide},
+      {RawLocationChange, WindowStateNormal, EventType::Moved},
+      {RawLocationChange, WindowStateDragging, EventType::Moving},
+      {RawLocationChange, WindowStateMaximized, EventType::Maxmized},
+      {RawLocationChange, WindowStateMinimized, EventType::Unknown},
+      {RawMoveSizeStart, WindowStateNormal, EventType::GestureStarted},
+      {RawMoveSizeEnd, WindowStateNormal, EventType::Moved},
+      {RawMoved, WindowStateNormal, EventType::Moved},
+      {RawResized, WindowStateNormal, EventType::Resized},
+      {RawMinimizeStart, WindowStateNormal, EventType::Minimized},
+      {RawMinimizeEnd, WindowStateNormal, EventType::Restore},
+      {RawMinimizeEnd, WindowStateMinimized, EventType::Unknown},
+      {RawFocus, WindowStateNormal, EventType::Focused},
+      {RawUnfocus, WindowStateNormal, EventType::UnFocused},
+  };
+  for (auto& item : cases) {
+    EXPECT(MonitorCore::Classify(makeRaw(item.kind, item.state)) ==
+           item.expected);
+  }
+  return true;
+}
+
+bool testRegister() {
+  SimulatedBackend* backend = new SimulatedBackend();
+  MonitorCore core{std::unique_ptr<Backend>(backend)};
+  const WNDID first = backend->AddWindows(3);
+  const WNDID second = nth(first, 1);
+  const WNDID third = nth(first, 2);
+  _received.clear();
+
+  EXPECT(core.Register(first, onEvent) == ErrorCode::Success);
+  EXPECT(core.Register(first, onEvent) == ErrorCode::AlreadyExist);
+  EXPECT(core.Register(nth(first, 3), onEvent) == ErrorCode::WindowNotFound);
+  EXPECT(core.Register(second, onEvent) == ErrorCode::Success);
+  EXPECT(core.size() == 2);
+  EXPECT(backend->attached_count() == 2);
+
+  // registering reports the current rect right away
+  EXPECT(_received.size() == 2);
+  EXPECT(_received[0].id == first && _received[0].type == EventType::Moved);
+  CRect rect;
+  EXPECT(core.GetWindowRect(first, rect) == ErrorCode::Success);
+  EXPECT(rect.right - rect.left == 800.f);
+
+  _received.clear();
+  backend->Emit(first, RawMoveSizeStart);
+  backend->Emit(first, RawLocationChange, CRect(10.f, 20.f, 30.f, 40.f));
+  backend->Emit(third, RawLocationChange, CRect(1.f, 1.f, 1.f, 1.f));
+  backend->Emit(second, RawMinimizeStart);
+  EXPECT(_received.size() == 3);
+  EXPECT(_received[0].id == first &&
+         _received[0].type == EventType::GestureStarted);
+  EXPECT(_received[1].id == first && _received[1].type == EventType::Moving);
+  EXPECT(_received[1].rect.left == 10.f && _received[1].rect.bottom == 40.f);
+  EXPECT(_received[2].id == second &&
+         _received[2].type == EventType::Minimized);
+
+  // events are stamped when the backend has no capture time
+  const uint64_t now = MonitorCore::Now();
+  EXPECT(_received[0].timestamp && _received[0].timestamp <= now);
+  EXPECT(MonitorCore::CurrentTimestamp() == 0);
+  RawEvent raw = makeRaw(RawMoved, WindowStateNormal);
+  raw.id = first;
+  raw.timestamp = 42;
+  core.OnRawEvent(raw);
+  EXPECT(_received.size() == 4 && _received[3].timestamp == 42);
+
+  core.Unregister(first);
+  core.Unregister(first);
+  EXPECT(core.size() == 1);
+  EXPECT(backend->attached_count() == 1);
+
+  _received.clear();
+  backend->Emit(first, RawHide);
+  backend->Emit(second, RawMinimizeEnd);
+  EXPECT(_received.size() == 1);
+  EXPECT(_received[0].id == second && _received[0].type == EventType::Restore);
+
+  // removed windows are gone for the backend
+  backend->RemoveWindow(second);
+  CRect ignored;
+  EXPECT(core.GetWindowRect(second, ignored) == ErrorCode::WindowNotFound);
+  EXPECT(backend->attached_count() == 0);
+
+  // the first report of a window may register and unregister windows
+  const WNDID other = backend->AddWindows(2);
+  _core = &core;
+  _received.clear();
+  EXPECT(core.Register(other, onEventReregister) == ErrorCode::Success);
+  EXPECT(!core.Observes(other) && core.Observes(nth(other, 1)));
+  EXPECT(_received.size() == 2);
+  EXPECT(_received[1].id == nth(other, 1));
+  core.Unregister(nth(other, 1));
+  _core = nullptr;
+  return true;
+}
+
+// hash of what the callback received
+uint64_t generateHash(uint32_t seed, size_t windows, size_t events) {
+  SimulatedBackend::Options options = SimulatedBackend::DefaultOptions();
+  options.seed = seed;
+  SimulatedBackend* backend = new SimulatedBackend(options);
+  MonitorCore core{std::unique_ptr<Backend>(backend)};
+  const WNDID first = backend->AddWindows(windows);
+  for (size_t i = 0; i < windows; i++) core.Register(nth(first, i), onEvent);
+
+  _received.clear();
+  if (backend->Generate(events) != events) return 0;
+
+  uint64_t hash = 1469598103934665603ULL;
+  for (auto& item : _received) {
+    const uint64_t values[] = {(uint64_t)(uintptr_t)item.id, (uint64_t)item.type,
+                               (uint64_t)(int64_t)item.rect.left,
+                               (uint64_t)(int64_t)item.rect.bottom};
+    for (uint64_t value : values) hash = (hash ^ value) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+bool testSharedSources() {
+  SimulatedBackend::Options options = SimulatedBackend::DefaultOptions();
+  options.shared_sources = true;
+  options.windows_per_owner = 4;
+  SimulatedBackend* backend = new SimulatedBackend(options);
+  MonitorCore core{std::unique_ptr<Backend>(backend)};
+  // owners 1 and 2
+  const WNDID first = backend->AddWindows(8);
+  _received.clear();
+
+  // the first window of an owner hooks all of its windows
+  EXPECT(core.Register(first, onEvent) == ErrorCode::Success);
+  EXPECT(backend->hook_count() == 1);
+  EXPECT(backend->attached_count() == 4);
+  EXPECT(core.Register(nth(first, 2), onEvent) == ErrorCode::Success);
+  EXPECT(core.Register(nth(first, 4), onEvent) == ErrorCode::Success);
+  EXPECT(backend->hook_count() == 2);
+  EXPECT(backend->attached_count() == 8);
+  EXPECT(core.Observes(first) && !core.Observes(nth(first, 1)));
+
+  // events of windows of a hooked owner which are not registered are dropped
+  _received.clear();
+  backend->Emit(nth(first, 1), RawFocus);
+  backend->Emit(nth(first, 2), RawFocus);
+  backend->Emit(nth(first, 5), RawFocus);
+  EXPECT(_received.size() == 1 && _received[0].id == nth(first, 2));
+  EXPECT(backend->Generate(10000) == 10000);
+
+  // the hook stays while a window of the owner is registered, even when the
+  // one it was attached with is gone
+  core.Unregister(first);
+  EXPECT(backend->hook_count() == 2);
+  _received.clear();
+  backend->Emit(nth(first, 2), RawUnfocus);
+  EXPECT(_received.size() == 1);
+  backend->RemoveWindow(nth(first, 2));
+  EXPECT(backend->attached_count() == 7);
+  core.Unregister(nth(first, 2));
+  EXPECT(backend->hook_count() == 1);
+  EXPECT(backend->attached_count() == 4);
+  core.Unregister(nth(first, 4));
+  EXPECT(backend->hook_count() == 0);
+  EXPECT(backend->attached_count() == 0);
+
+  // windows of other owners are not found
+  EXPECT(core.Register(nth(first, 8), onEvent) == ErrorCode::WindowNotFound);
+  EXPECT(core.size() == 0);
+  return true;
+}
+
+bool testGenerate() {
+  const uint64_t hash = generateHash(7, 64, 100000);
+  EXPECT(hash != 0);
+  EXPECT(generateHash(7, 64, 100000) == hash);
+  EXPECT(generateHash(8, 64, 100000) != hash);
+
+  // every kind of event shows up
+  size_t counts[EventType::Restore + 1] = {};
+  generateHash(7, 64, 100000);
+  for (auto& item : _received) counts[item.type]++;
+  EXPECT(counts[EventType::Unknown] == 0);
+  EXPECT(counts[EventType::Moving] > counts[EventType::Moved]);
+  // like the win32 hooks resizes are location changes
+  EXPECT(counts[EventType::Resized] == 0);
+  for (int type = EventType::Focused; type <= EventType::Restore; type++) {
+    EXPECT(type == EventType::Resized || counts[type] > 0);
+  }
+
+  // no window attached, nothing to generate
+  SimulatedBackend backend;
+  backend.AddWindows(4);
+  EXPECT(backend.Generate(100) == 0);
+  return true;
+}
+
+bool sameEvents(const std::vector<Received>& a,
+                const std::vector<Received>& b) {
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i].id != b[i].id || a[i].type != b[i].type ||
+        a[i].rect.left != b[i].rect.left ||
+        a[i].rect.top != b[i].rect.top ||
+        a[i].rect.right != b[i].rect.right ||
+        a[i].rect.bottom != b[i].rect.bottom)
+      return false;
+  }
+  return true;
+}
+
+bool testRecordReplay() {
+  const char* path = "core_test.wmtr";
+  const size_t kWindows = 16;
+  const size_t kEvents = 20000;
+
+  // rects are looked up by the core, the trace has to keep them
+  SimulatedBackend::Options options = SimulatedBackend::DefaultOptions();
+  options.lookup_rects = true;
+  std::vector<Received> recorded;
+  {
+    SimulatedBackend* backend = new SimulatedBackend(options);
+    MonitorCore core{std::unique_ptr<Backend>(backend)};
+    const WNDID first = backend->AddWindows(kWindows);
+    for (size_t i = 0; i < kWindows; i++) core.Register(nth(first, i), onEvent);
+
+    EXPECT(core.StopRecording() == -1);
+    EXPECT(core.StartRecording(path));
+    EXPECT(!core.StartRecording(path));
+    _received.clear();
+    EXPECT(backend->Generate(kEvents) == kEvents);
+    EXPECT(core.StopRecording() == (int64_t)kEvents);
+    recorded = _received;
+  }
+
+  std::vector<RawEvent> events;
+  EXPECT(ReadEventTrace(path, events));
+  EXPECT(events.size() == kEvents);
+  EXPECT(!ReadEventTrace("core_test.missing", events));
+  for (size_t i = 1; i < events.size(); i++)
+    EXPECT(events[i].timestamp >= events[i - 1].timestamp);
+
+  // replayed to other windows with the same ids, the rects of the trace win
+  for (int run = 0; run < 2; run++) {
+    SimulatedBackend* backend = new SimulatedBackend();
+    MonitorCore core{std::unique_ptr<Backend>(backend)};
+    const WNDID first = backend->AddWindows(kWindows);
+    for (size_t i = 0; i < kWindows; i++) core.Register(nth(first, i), onEvent);
+
+    _received.clear();
+    const uint64_t begin = MonitorCore::Now();
+    EXPECT(ReplayEvents(events, &core, 0) == (int64_t)kEvents);
+    EXPECT(sameEvents(_received, recorded));
+    EXPECT(_received.front().timestamp >= begin);
+  }
+
+  remove(path);
+  return true;
+}
+
+void otherEvent(WNDID id, EventType type, CRect rect) {}
+
+bool testRegistry() {
+  WindowRegistry registry;
+  WindowRegistry::Entry entry;
+  std::vector<WindowRegistry::Entry> entries;
+  EXPECT(registry.size() == 0);
+  EXPECT(!registry.Find(1, entry));
+  EXPECT(registry.FindOwner(0, entries) == 0);
+
+  // owners 1 to 7, enough windows to grow the table a few times
+  for (uintptr_t i = 1; i <= 100; i++) {
+    WindowRegistry::Entry added = {(WNDID)i, (uint32_t)(i % 7 + 1), 0,
+                                   i % 2 ? onEvent : otherEvent};
+    EXPECT(registry.Add(added));
+  }
+  EXPECT(!registry.Add(WindowRegistry::Entry{(WNDID)5, 1, 0, onEvent}));
+  EXPECT(registry.size() == 100);
+  EXPECT(registry.Find((WNDID)5, entry));
+  EXPECT(entry.id == (WNDID)5 && entry.owner == 6 && entry.callback == onEvent);
+  EXPECT(!registry.Find((WNDID)101, entry));
+
+  EXPECT(registry.FindOwner(3, entries) == 15);
+  for (auto& item : entries) EXPECT(item.owner == 3);
+  EXPECT(registry.Remove((WNDID)2, &entry) && entry.owner == 3);
+  EXPECT(!registry.Remove((WNDID)2));
+  entries.clear();
+  EXPECT(registry.FindOwner(3, entries) == 14);
+
+  for (uintptr_t i = 1; i <= 100; i++) registry.Remove((WNDID)i);
+  EXPECT(registry.size() == 0);
+  EXPECT(registry.FindOwner(3, entries) == 0);
+
+  // readers see a window with its own callback or not at all while writers
+  // add and remove it, the writers start once every reader looked up a
+  // window of the full registry so that some lookups find one even when the
+  // readers only get to run after the writers on a single cpu
+  const int kReaders = 4;
+  for (uintptr_t i = 1; i <= 64; i++) {
+    registry.Add(WindowRegistry::Entry{(WNDID)i, (uint32_t)i, 0,
+                                       i % 2 ? onEvent : otherEvent});
+  }
+  std::atomic<bool> running(true);
+  std::atomic<bool> torn(false);
+  std::atomic<uint64_t> found(0);
+  std::atomic<int> started(0);
+  std::vector<std::thread> readers;
+  for (int r = 0; r < kReaders; r++) {
+    readers.emplace_back([&, r] {
+      WindowRegistry::Entry item;
+      for (uintptr_t n = r; running.load(); n++) {
+        const WNDID id = (WNDID)(n % 64 + 1);
+        const bool exists = registry.Find(id, item);
+        if (n == (uintptr_t)r) started.fetch_add(1);
+        if (!exists) continue;
+        found.fetch_add(1, std::memory_order_relaxed);
+        if (item.id != id || item.owner != (uint32_t)(uintptr_t)id ||
+            item.callback != ((uintptr_t)id % 2 ? onEvent : otherEvent))
+          torn.store(true);
+      }
+    });
+  }
+  while (started.load() < kReaders) std::this_thread::yield();
+  for (int round = 0; round < 50; round++) {
+    for (uintptr_t i = 1; i <= 64; i++) {
+      if ((i + round) % 3 == 0)
+        registry.Remove((WNDID)i);
+      else
+        registry.Add(WindowRegistry::Entry{(WNDID)i, (uint32_t)i, 0,
+                                           i % 2 ? onEvent : otherEvent});
+    }
+  }
+  running.store(false);
+  for (auto& reader : readers) reader.join();
+  EXPECT(!torn.load());
+  EXPECT(found.load() > 0);
+  return true;
+}
+
+// Remembers whether windows were attached on the monitor thread of its core.
+class ThreadCheckBackend : public SimulatedBackend {
+ public:
+  MonitorCore* core = nullptr;
+  std::atomic<int> attached_elsewhere{0};
+
+  int Attach(WNDID id) override {
+    if (!core->thread().IsCurrent()) attached_elsewhere++;
+    return SimulatedBackend::Attach(id);
+  }
+  void Detach(WNDID id) override {
+    if (!core->thread().IsCurrent()) attached_elsewhere++;
+    SimulatedBackend::Detach(id);
+  }
+};
+
+static MonitorCore* _thread_core = nullptr;
+static std::atomic<int> _callbacks_elsewhere(0);
+
+void onThreadEvent(WNDID id, EventType type, CRect rect) {
+  if (!_thread_core->thread().IsCurrent()) _callbacks_elsewhere++;
+}
+
+bool testMonitorThread() {
+  {
+    MonitorThread thread(std::unique_ptr<MonitorLoop>(new TaskLoop()));
+    EXPECT(!thread.IsCurrent());
+    std::vector<int> order;
+    for (int i = 0; i < 100; i++) {
+      thread.Post([&order, i] { order.push_back(i); });
+    }
+    bool nested = false;
+    thread.Invoke([&thread, &nested] {
+      // tasks invoked on the thread run right away
+      thread.Invoke([&thread, &nested] { nested = thread.IsCurrent(); });
+    });
+    EXPECT(nested);
+    EXPECT(order.size() == 100 && order[0] == 0 && order[99] == 99);
+
+    // posted before stopping still run, after it on the caller
+    bool pending = false;
+    thread.Post([&pending] { pending = true; });
+    thread.Stop();
+    EXPECT(pending);
+    bool inline_ran = false;
+    thread.Invoke([&inline_ran] { inline_ran = true; });
+    EXPECT(inline_ran);
+  }
+
+  ThreadCheckBackend* backend = new ThreadCheckBackend();
+  MonitorCore core{std::unique_ptr<Backend>(backend)};
+  backend->core = &core;
+  _thread_core = &core;
+  const WNDID first = backend->AddWindows(4);
+
+  // registering attaches and reports the first rect on the monitor thread
+  for (size_t i = 0; i < 4; i++) {
+    EXPECT(core.Register(nth(first, i), onThreadEvent) == ErrorCode::Success);
+  }
+  EXPECT(core.Register(first, onThreadEvent) == ErrorCode::AlreadyExist);
+  EXPECT(backend->attached_count() == 4);
+  core.Unregister(nth(first, 3));
+  EXPECT(backend->attached_count() == 3);
+  EXPECT(backend->attached_elsewhere.load() == 0);
+  EXPECT(_callbacks_elsewhere.load() == 0);
+
+  // events of a platform thread are reported there, tasks of the monitor
+  // thread keep running meanwhile
+  backend->Start(100000);
+  for (int i = 0; i < 20; i++) {
+    core.Unregister(nth(first, i % 3));
+    EXPECT(core.Register(nth(first, i % 3), onThreadEvent) ==
+           ErrorCode::Success);
+  }
+  backend->Stop();
+  EXPECT(backend->attached_elsewhere.load() == 0);
+
+  for (size_t i = 0; i < 3; i++) core.Unregister(nth(first, i));
+  EXPECT(backend->attached_count() == 0);
+  return true;
+}
+
+static std::mutex _paced_lock;
+static std::vector<Received> _paced;
+
+void onPacedEvent(WNDID id, EventType type, CRect rect) {
+  std::lock_guard<std::mutex> guard(_paced_lock);
+  _paced.push_back(Received{id, type, rect, MonitorCore::CurrentTimestamp()});
+}
+
+size_t pacedCount() {
+  std::lock_guard<std::mutex> guard(_paced_lock);
+  return _paced.size();
+}
+
+bool testFramePacer() {
+  SimulatedBackend* backend = new SimulatedBackend();
+  MonitorCore core{std::unique_ptr<Backend>(backend)};
+  const WNDID first = backend->AddWindows(2);
+  const WNDID second = nth(first, 1);
+  EXPECT(core.Register(first, onPacedEvent) == ErrorCode::Success);
+  EXPECT(core.Register(second, onPacedEvent) == ErrorCode::Success);
+  _paced.clear();
+
+  // the simulated desktop does not know its display
+  EXPECT(core.SetFrameRate(-1) == FramePacer::kDefaultDisplayRate);
+  EXPECT(core.SetFrameRate(20) == 20);
+
+  // a drag waits for the next frame, which reports its latest rect
+  backend->Emit(first, RawMoveSizeStart);
+  backend->Emit(second, RawMoveSizeStart);
+  EXPECT(pacedCount() == 2);
+  _paced.clear();
+  for (int i = 1; i <= 50; i++) {
+    backend->Emit(first, RawLocationChange,
+                  CRect((float)i, 0.f, (float)i + 10.f, 10.f));
+  }
+  EXPECT(pacedCount() == 0);
+  for (int i = 0; i < 50 && pacedCount() == 0; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  {
+    std::lock_guard<std::mutex> guard(_paced_lock);
+    EXPECT(_paced.size() == 1);
+    EXPECT(_paced[0].type == EventType::Moving && _paced[0].rect.left == 50.f);
+    // captured by the last event, not when the frame delivered it
+    EXPECT(_paced[0].timestamp != 0);
+    _paced.clear();
+  }
+  EXPECT(core.pacer().frames() == 1 && core.pacer().coalesced() == 49);
+
+  // the end of a drag is reported right away and replaces the pending rect,
+  // a state change reports the pending rect first
+  backend->Emit(first, RawLocationChange, CRect(1.f, 1.f, 2.f, 2.f));
+  backend->Emit(first, RawMoveSizeEnd);
+  backend->Emit(second, RawLocationChange, CRect(3.f, 3.f, 4.f, 4.f));
+  backend->Emit(second, RawFocus);
+  {
+    std::lock_guard<std::mutex> guard(_paced_lock);
+    EXPECT(_paced.size() == 4);
+    EXPECT(_paced[0].id == first && _paced[0].type == EventType::Moved);
+    EXPECT(_paced[1].id == first &&
+           _paced[1].type == EventType::GestureEnded);
+    EXPECT(_paced[2].id == second && _paced[2].type == EventType::Moving &&
+           _paced[2].rect.left == 3.f);
+    EXPECT(_paced[3].id == second && _paced[3].type == EventType::Focused);
+    _paced.clear();
+  }
+
+  // idle, the timer delivers no frames
+  const uint64_t frames = core.pacer().frames();
+  std::this_thread::sleep_for(std::chrono::milliseconds(120));
+  EXPECT(core.pacer().frames() == frames && pacedCount() == 0);
+
+  // unregistered windows lose their pending rect, stopping delivers the rest,
+  // long frames so none comes in between
+  core.SetFrameRate(0.1);
+  backend->Emit(first, RawLocationChange, CRect(5.f, 5.f, 6.f, 6.f));
+  backend->Emit(second, RawLocationChange, CRect(7.f, 7.f, 8.f, 8.f));
+  core.Unregister(first);
+  EXPECT(core.SetFrameRate(0) == 0);
+  {
+    std::lock_guard<std::mutex> guard(_paced_lock);
+    EXPECT(_paced.size() == 1 && _paced[0].id == second);
+    _paced.clear();
+  }
+  backend->Emit(second, RawLocationChange, CRect(9.f, 9.f, 9.f, 9.f));
+  EXPECT(pacedCount() == 1);
+
+  // a storm of a thread of the platform is paced as well
+  _paced.clear();
+  core.SetFrameRate(100);
+  backend->Start(50000);
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  backend->Stop();
+  core.SetFrameRate(0);
+  size_t moving = 0;
+  for (auto& item : _paced) moving += item.type == EventType::Moving;
+  // 20 frames, give the box some slack
+  EXPECT(moving > 0 && moving <= 30);
+  EXPECT(core.pacer().coalesced() > moving);
+
+  core.Unregister(second);
+  return true;
+}
+
+bool testEventFilter() {
+  SimulatedBackend* backend = new SimulatedBackend();
+  MonitorCore core{std::unique_ptr<Backend>(backend)};
+  const WNDID first = backend->AddWindows(2);
+  const WNDID second = nth(first, 1);
+  _received.clear();
+
+  // no Moved on registering when it is filtered
+  const uint32_t states = (1u << EventType::Focused) |
+                          (1u << EventType::Minimized);
+  EXPECT(core.Register(first, onEvent, EventFilter(states, 0)) ==
+         ErrorCode::Success);
+  EXPECT(_received.empty());
+  backend->Emit(first, RawLocationChange, CRect(1.f, 1.f, 2.f, 2.f));
+  backend->Emit(first, RawResized, CRect(1.f, 1.f, 3.f, 3.f));
+  backend->Emit(first, RawFocus);
+  EXPECT(_received.size() == 1 && _received[0].type == EventType::Focused);
+  // with the Moved of registering
+  EXPECT(core.filter_stats().types == 3);
+
+  // updates below the min delta from the last reported rect are dropped,
+  // the rect reported on registering is the first one
+  _received.clear();
+  EXPECT(core.Register(second, onEvent, EventFilter(0xffffffff, 4)) ==
+         ErrorCode::Success);
+  EXPECT(_received.size() == 1);
+  const CRect origin = _received[0].rect;
+  for (int i = 1; i <= 9; i++) {
+    backend->Emit(second, RawLocationChange,
+                  CRect(origin.left + (float)i, origin.top,
+                        origin.right + (float)i, origin.bottom));
+  }
+  EXPECT(_received.size() == 3);
+  EXPECT(_received[1].rect.left == origin.left + 4.f);
+  EXPECT(_received[2].rect.left == origin.left + 8.f);
+  EXPECT(core.filter_stats().unchanged == 7);
+  // the end of a drag brings the rect the last moves were dropped for, it is
+  // dropped when it brings nothing new
+  backend->Emit(second, RawMoveSizeEnd);
+  backend->Emit(second, RawMoveSizeEnd);
+  EXPECT(_received.size() == 4 && _received[3].type == EventType::Moved);
+  EXPECT(_received[3].rect.left == origin.left + 9.f);
+  EXPECT(core.filter_stats().unchanged == 8);
+  // state changes pass whatever the rect
+  backend->Emit(second, RawFocus);
+  EXPECT(_received.size() == 5);
+
+  // a new filter applies right away and forgets the last rect
+  _received.clear();
+  EXPECT(core.SetFilter(second, EventFilter(1u << EventType::Moving, 1)) ==
+         ErrorCode::Success);
+  backend->Emit(second, RawFocus);
+  backend->Emit(second, RawMoveSizeStart);
+  backend->Emit(second, RawLocationChange, origin);
+  backend->Emit(second, RawLocationChange, origin);
+  EXPECT(_received.size() == 1 && _received[0].type == EventType::Moving);
+  EXPECT(core.SetFilter(nth(first, 2), EventFilter()) ==
+         ErrorCode::WindowNotFound);
+
+  core.Unregister(first);
+  core.Unregister(second);
+  EXPECT(core.size() == 0);
+  return true;
+}
+
+bool testMotionPredictor() {
+  // 2 pixels per millisecond to the right, sampled every millisecond
+  MotionTrack track;
+  CRect rect;
+  EXPECT(!track.Predict(0, rect));
+  track.Observe(EventType::Moved, CRect(0.f, 0.f, 100.f, 100.f), 1000);
+  EXPECT(!track.Predict(2000, rect));
+  for (int i = 1; i <= 40; i++) {
+    const float left = 2.f * i;
+    track.Observe(EventType::Moving, CRect(left, 0.f, left + 100.f, 100.f),
+                  1000 + i * 1000);
+  }
+  EXPECT(track.Predict(41000 + 16000, rect));
+  EXPECT(rect.left > 80.f + 30.f && rect.left < 80.f + 34.f);
+  EXPECT(rect.top == 0.f && rect.right - rect.left > 99.f);
+  // never extrapolated past kMaxHorizonUs
+  CRect far;
+  EXPECT(track.Predict(41000 + 10 * MotionTrack::kMaxHorizonUs, far));
+  EXPECT(far.left < 80.f + 2.1f * (MotionTrack::kMaxHorizonUs / 1000));
+
+  // a jump starts over, a settled rect stops it
+  track.Observe(EventType::Moving, CRect(900.f, 0.f, 1000.f, 100.f), 42000);
+  EXPECT(track.Predict(60000, rect) && rect.left == 900.f);
+  track.Observe(EventType::Moved, CRect(900.f, 0.f, 1000.f, 100.f), 43000);
+  EXPECT(!track.Predict(60000, rect));
+
+  // the core extrapolates Moving of predicted windows only and reports the
+  // rect of the platform for Moved
+  SimulatedBackend* backend = new SimulatedBackend();
+  MonitorCore core{std::unique_ptr<Backend>(backend)};
+  const WNDID first = backend->AddWindows(2);
+  EXPECT(core.SetPrediction(first, 16000) == ErrorCode::WindowNotFound);
+  EXPECT(core.Register(first, onEvent) == ErrorCode::Success);
+  EXPECT(core.SetPrediction(first, 16000) == ErrorCode::Success);
+
+  _received.clear();
+  _motions.clear();
+  const uint64_t begin = MonitorCore::Now() - 40000;
+  RawEvent raw = makeRaw(RawMoveSizeStart, WindowStateNormal);
+  raw.id = first;
+  raw.has_rect = true;
+  raw.rect = CRect(0.f, 0.f, 100.f, 100.f);
+  raw.timestamp = begin;
+  core.OnRawEvent(raw);
+  raw.kind = RawLocationChange;
+  raw.state = WindowStateDragging;
+  for (int i = 1; i <= 40; i++) {
+    const float left = 2.f * i;
+    raw.rect = CRect(left, 0.f, left + 100.f, 100.f);
+    raw.timestamp = begin + i * 1000;
+    core.OnRawEvent(raw);
+  }
+  raw.kind = RawMoveSizeEnd;
+  core.OnRawEvent(raw);
+  EXPECT(_received.size() == 43);
+  EXPECT(_received[40].type == EventType::Moving &&
+         _received[40].rect.left > 80.f + 30.f);
+  EXPECT(_received[41].type == EventType::Moved &&
+         _received[41].rect.left == 80.f);
+  EXPECT(core.predictor().predicted() == 40);
+  // with the sample it was extrapolated from, for leads of consumers
+  EXPECT(_motions.size() == 40 && _motions[39].rect.left == 80.f);
+  EXPECT(_motions[39].timestamp == begin + 40000);
+  MotionTrack::Extrapolate(_motions[39], begin + 40000 + 16000, rect);
+  EXPECT(rect.left > 80.f + 30.f && rect.left < 80.f + 34.f);
+
+  // zero stops it
+  EXPECT(core.SetPrediction(first, 0) == ErrorCode::Success);
+  raw.kind = RawMoveSizeStart;
+  raw.timestamp = MonitorCore::Now();
+  core.OnRawEvent(raw);
+  raw.kind = RawLocationChange;
+  core.OnRawEvent(raw);
+  EXPECT(_received.size() == 45 && _received[44].type == EventType::Moving &&
+         _received[44].rect.left == 80.f);
+  EXPECT(_motions.size() == 40);
+
+  core.Unregister(first);
+  return true;
+}
+
+static std::vector<GestureSummary> _gestures;
+
+void onGestureEvent(WNDID id, EventType type, CRect rect) {
+  onEvent(id, type, rect);
+  GestureSummary summary;
+  if (MonitorCore::CurrentGesture(summary)) _gestures.push_back(summary);
+}
+
+bool testGestures() {
+  SimulatedBackend* backend = new SimulatedBackend();
+  MonitorCore core{std::unique_ptr<Backend>(backend)};
+  const WNDID first = backend->AddWindows(2);
+  const WNDID second = nth(first, 1);
+  EXPECT(core.Register(first, onGestureEvent) == ErrorCode::Success);
+  // only the start and the end of drags, no live updates
+  const uint32_t settled = (1u << EventType::Moved) |
+                           (1u << EventType::GestureStarted) |
+                           (1u << EventType::GestureEnded);
+  EXPECT(core.Register(second, onGestureEvent, EventFilter(settled, 0)) ==
+         ErrorCode::Success);
+  _received.clear();
+  _gestures.clear();
+
+  RawEvent raw = makeRaw(RawMoveSizeStart, WindowStateNormal);
+  raw.has_rect = true;
+  raw.rect = CRect(0.f, 0.f, 100.f, 100.f);
+  raw.timestamp = 1000;
+  for (WNDID id : {first, second}) {
+    raw.id = id;
+    core.OnRawEvent(raw);
+  }
+  raw.kind = RawLocationChange;
+  raw.state = WindowStateDragging;
+  for (int i = 1; i <= 5; i++) {
+    raw.rect = CRect(10.f * i, 0.f, 10.f * i + 100.f, 100.f);
+    raw.timestamp = 1000 + i * 1000;
+    for (WNDID id : {first, second}) {
+      raw.id = id;
+      core.OnRawEvent(raw);
+    }
+  }
+  EXPECT(_received.size() == 7);
+  EXPECT(_received[0].type == EventType::GestureStarted &&
+         _received[0].rect.left == 0.f);
+  EXPECT(_received[1].type == EventType::GestureStarted &&
+         _received[1].id == second);
+  EXPECT(_received[6].type == EventType::Moving && _received[6].id == first);
+
+  // the end reports the final rect, then the summary of the drag
+  raw.kind = RawMoveSizeEnd;
+  raw.timestamp = 9000;
+  for (WNDID id : {first, second}) {
+    raw.id = id;
+    core.OnRawEvent(raw);
+  }
+  EXPECT(_received.size() == 11);
+  EXPECT(_received[9].id == second && _received[9].type == EventType::Moved &&
+         _received[9].rect.left == 50.f);
+  EXPECT(_received[10].type == EventType::GestureEnded);
+  EXPECT(_gestures.size() == 2);
+  for (auto& gesture : _gestures) {
+    EXPECT(gesture.start.left == 0.f && gesture.end.left == 50.f);
+    EXPECT(gesture.timestamp == 1000 && gesture.duration == 8000);
+    EXPECT(gesture.samples == 5);
+  }
+  EXPECT(core.gestures().ended() == 2);
+  GestureSummary summary;
+  EXPECT(!MonitorCore::CurrentGesture(summary));
+
+  // outside of a drag a move relocated the window, an end without a start
+  // has nothing to summarize
+  _received.clear();
+  raw.id = second;
+  raw.kind = RawLocationChange;
+  raw.state = WindowStateNormal;
+  raw.rect = CRect(200.f, 0.f, 300.f, 100.f);
+  core.OnRawEvent(raw);
+  raw.kind = RawMoveSizeEnd;
+  core.OnRawEvent(raw);
+  EXPECT(_received.size() == 2 && _received[0].type == EventType::Moved &&
+         _received[1].type == EventType::Moved);
+  EXPECT(core.gestures().ended() == 2);
+
+  // the drag of an unregistered window is forgotten, registered during a
+  // drag its updates are still Moving
+  raw.kind = RawMoveSizeStart;
+  core.OnRawEvent(raw);
+  core.Unregister(second);
+  EXPECT(core.Register(second, onGestureEvent) == ErrorCode::Success);
+  _received.clear();
+  raw.kind = RawLocationChange;
+  raw.state = WindowStateDragging;
+  core.OnRawEvent(raw);
+  raw.kind = RawMoveSizeEnd;
+  core.OnRawEvent(raw);
+  EXPECT(_received.size() == 2 && _received[0].type == EventType::Moving &&
+         _received[1].type == EventType::Moved);
+  EXPECT(core.gestures().ended() == 2);
+
+  core.Unregister(first);
+  core.Unregister(second);
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  bool ok = testClassify() && testRegister() && testSharedSources() &&
+            testGenerate() &&
+            testRecordReplay() && testRegistry() && testMonitorThread() &&
+            testFramePacer() && testEventFilter() && testMotionPredictor() &&
+            testGestures();
+
+  printf("monitor core test %s\r\n", ok ? "passed" : "failed");
+  return ok ? 0 : 1;
+}
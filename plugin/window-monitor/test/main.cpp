@@ -5,6 +5,9 @@
 #include <Windows.h>
 #elif defined(__APPLE__)
 #include <Foundation/Foundation.h>
+#else
+#include "../src/core/monitor_core.h"
+#include "../src/simulated/simulated_backend.h"
 #endif
 
 #include "../include/monitor.h"
@@ -20,6 +23,19 @@ void onWindowMonitorCallback(windowmonitor::WNDID id,
 
 int main() {
   int ret = 0;
+#if !defined(_WIN32) && !defined(__APPLE__)
+  // the simulated desktop, windows 1 to 3
+  auto backend = static_cast<windowmonitor::SimulatedBackend*>(
+      windowmonitor::MonitorCore::Default()->backend());
+  backend->AddWindows(3);
+  ret = windowmonitor::registerWindowMonitorCallback(1, onWindowMonitorCallback);
+  printf("register result %d\r\n", ret);
+  ret = windowmonitor::registerWindowMonitorCallback(2, onWindowMonitorCallback);
+  printf("register result %d\r\n", ret);
+  backend->Generate(40);
+  return 0;
+#endif
+
   ret = windowmonitor::registerWindowMonitorCallback(
       (windowmonitor::WNDID)2491936, onWindowMonitorCallback);
   printf("register result %d\r\n", ret);
@@ -0,0 +1,230 @@
+// Google benchmark suite of the monitor core: classification of raw events,
+// their dispatch to a registered callback, events of windows sharing a
+// subscription, lookups in the registry of windows against a locked map and
+// GetWindowRect through the simulated and the X11 backends. Run with
+// --benchmark_out=<file> --benchmark_out_format=json to keep the numbers.
+#include <stdlib.h>
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "../src/core/monitor_core.h"
+#include "../src/core/window_registry.h"
+#include "../src/simulated/simulated_backend.h"
+#if defined(WINDOW_MONITOR_HAS_XCB)
+#include "../src/linux/xcb_backend.h"
+#endif
+
+using namespace agora::plugin::windowmonitor;
+
+namespace {
+
+static uint64_t _callbacks = 0;
+
+void onEvent(WNDID id, EventType type, CRect rect) {
+  _callbacks++;
+  benchmark::DoNotOptimize(rect);
+}
+
+RawEvent makeRaw(WNDID id, RawEventKind kind, uint32_t state) {
+  RawEvent event;
+  event.id = id;
+  event.kind = kind;
+  event.state = state;
+  event.has_rect = true;
+  event.rect = CRect{10.f, 20.f, 810.f, 620.f};
+  event.timestamp = 0;
+  return event;
+}
+
+// what a drag looks like to the core, mostly location changes
+std::vector<RawEvent> makeEvents(WNDID id) {
+  std::vector<RawEvent> events;
+  events.push_back(makeRaw(id, RawFocus, WindowStateNormal));
+  events.push_back(makeRaw(id, RawMoveSizeStart, WindowStateNormal));
+  for (int i = 0; i < 12; i++)
+    events.push_back(makeRaw(id, RawLocationChange, WindowStateNormal));
+  events.push_back(makeRaw(id, RawMoveSizeEnd, WindowStateNormal));
+  events.push_back(makeRaw(id, RawLocationChange, WindowStateMaximized));
+  return events;
+}
+
+void BM_Classify(benchmark::State& state) {
+  const std::vector<RawEvent> events = makeEvents((WNDID)1);
+  for (auto _ : state) {
+    for (const RawEvent& event : events) {
+      benchmark::DoNotOptimize(MonitorCore::Classify(event));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * events.size());
+}
+BENCHMARK(BM_Classify);
+
+// Classify, find the callback among range(0) registered windows and
+// dispatch, with the rect of the event or looked up from the backend.
+void BM_OnRawEvent(benchmark::State& state) {
+  const size_t windows = (size_t)state.range(0);
+  const bool lookup = state.range(1) != 0;
+
+  SimulatedBackend* backend = new SimulatedBackend();
+  MonitorCore core{std::unique_ptr<Backend>(backend)};
+  const WNDID first = backend->AddWindows(windows);
+  for (size_t i = 0; i < windows; i++) {
+    core.Register((WNDID)((uintptr_t)first + i), onEvent);
+  }
+
+  std::vector<RawEvent> events =
+      makeEvents((WNDID)((uintptr_t)first + windows / 2));
+  for (RawEvent& event : events) event.has_rect = !lookup;
+
+  _callbacks = 0;
+  for (auto _ : state) {
+    for (const RawEvent& event : events) core.OnRawEvent(event);
+  }
+  state.SetItemsProcessed(state.iterations() * events.size());
+  state.counters["callbacks"] = benchmark::Counter(
+      (double)_callbacks, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_OnRawEvent)
+    ->ArgNames({"windows", "lookup"})
+    ->ArgsProduct({{1, 64, 5000}, {0, 1}});
+
+// A process with range(0) windows on one hooked thread, one of them
+// registered: every window of the process reports its events to the shared
+// hook and the core keeps those of the registered one, at the same cost per
+// event whatever the count of windows.
+void BM_SharedSource(benchmark::State& state) {
+  const size_t windows = (size_t)state.range(0);
+  SimulatedBackend::Options options = SimulatedBackend::DefaultOptions();
+  options.shared_sources = true;
+  options.windows_per_owner = (uint32_t)windows;
+
+  SimulatedBackend* backend = new SimulatedBackend(options);
+  MonitorCore core{std::unique_ptr<Backend>(backend)};
+  core.Register(backend->AddWindows(windows), onEvent);
+
+  const size_t kBatch = 1024;
+  _callbacks = 0;
+  for (auto _ : state) backend->Generate(kBatch);
+  state.SetItemsProcessed(state.iterations() * kBatch);
+  state.counters["callbacks"] = benchmark::Counter(
+      (double)_callbacks, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_SharedSource)->ArgName("windows")->Arg(1)->Arg(16)->Arg(256);
+
+// Lookups of the event threads, range(0) windows registered, by one to four
+// threads at once.
+void BM_RegistryFind(benchmark::State& state) {
+  static WindowRegistry* registry = nullptr;
+  const size_t windows = (size_t)state.range(0);
+  if (state.thread_index() == 0) {
+    registry = new WindowRegistry();
+    for (size_t i = 1; i <= windows; i++)
+      registry->Add(
+          WindowRegistry::Entry{(WNDID)i, (uint32_t)(i % 8), 0, onEvent});
+  }
+
+  WindowRegistry::Entry entry;
+  size_t i = state.thread_index();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(registry->Find((WNDID)(i++ % windows + 1), entry));
+  }
+  state.SetItemsProcessed(state.iterations());
+
+  if (state.thread_index() == 0) {
+    delete registry;
+    registry = nullptr;
+  }
+}
+BENCHMARK(BM_RegistryFind)
+    ->ArgName("windows")
+    ->Arg(64)
+    ->Arg(1024)
+    ->ThreadRange(1, 4);
+
+// the table the core had before, for comparison
+void BM_LockedMapFind(benchmark::State& state) {
+  static std::mutex lock;
+  static std::unordered_map<WNDID, EventCallback>* callbacks = nullptr;
+  const size_t windows = (size_t)state.range(0);
+  if (state.thread_index() == 0) {
+    callbacks = new std::unordered_map<WNDID, EventCallback>();
+    for (size_t i = 1; i <= windows; i++) (*callbacks)[(WNDID)i] = onEvent;
+  }
+
+  size_t i = state.thread_index();
+  for (auto _ : state) {
+    std::lock_guard<std::mutex> guard(lock);
+    benchmark::DoNotOptimize(callbacks->find((WNDID)(i++ % windows + 1)));
+  }
+  state.SetItemsProcessed(state.iterations());
+
+  if (state.thread_index() == 0) {
+    delete callbacks;
+    callbacks = nullptr;
+  }
+}
+BENCHMARK(BM_LockedMapFind)
+    ->ArgName("windows")
+    ->Arg(64)
+    ->Arg(1024)
+    ->ThreadRange(1, 4);
+
+void BM_GetWindowRectSimulated(benchmark::State& state) {
+  SimulatedBackend* backend = new SimulatedBackend();
+  MonitorCore core{std::unique_ptr<Backend>(backend)};
+  const WNDID first = backend->AddWindows((size_t)state.range(0));
+  const WNDID id = (WNDID)((uintptr_t)first + state.range(0) / 2);
+
+  CRect crect;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(core.GetWindowRect(id, crect));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetWindowRectSimulated)->ArgName("windows")->Arg(1)->Arg(5000);
+
+// A round trip to the X server per call, skipped without one.
+void BM_GetWindowRectXcb(benchmark::State& state) {
+#if defined(WINDOW_MONITOR_HAS_XCB)
+  std::unique_ptr<XcbBackend> backend = XcbBackend::Connect();
+  xcb_connection_t* connection = xcb_connect(nullptr, nullptr);
+  if (!backend || xcb_connection_has_error(connection)) {
+    xcb_disconnect(connection);
+    state.SkipWithError("no X server");
+    return;
+  }
+
+  xcb_screen_t* screen =
+      xcb_setup_roots_iterator(xcb_get_setup(connection)).data;
+  const xcb_window_t window = xcb_generate_id(connection);
+  const uint32_t values[] = {1};
+  xcb_create_window(connection, XCB_COPY_FROM_PARENT, window, screen->root,
+                    100, 100, 640, 480, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                    screen->root_visual, XCB_CW_OVERRIDE_REDIRECT, values);
+  xcb_map_window(connection, window);
+  free(xcb_get_input_focus_reply(connection, xcb_get_input_focus(connection),
+                                 nullptr));
+
+  MonitorCore core{std::move(backend)};
+  CRect crect;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(core.GetWindowRect((WNDID)window, crect));
+  }
+  state.SetItemsProcessed(state.iterations());
+
+  xcb_destroy_window(connection, window);
+  xcb_disconnect(connection);
+#else
+  state.SkipWithError("built without XCB");
+#endif
+}
+BENCHMARK(BM_GetWindowRectXcb);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,273 @@
+// Throughput of the monitor core on the simulated desktop: raw events are
+// generated on 1 to 5000 registered windows, classified and dispatched to a
+// callback with the rect of the event or one looked up from the backend, the
+// path every platform event takes before it reaches the plugin.
+// With --replay <trace> [speed] the events of a recorded trace go the same
+// path instead, see startEventRecording.
+// With --predict <lead ms> [trace] the drags of the simulated desktop or of
+// a trace are extrapolated by the MotionPredictor, printing how far the rect
+// of a window lead after a sample is from the sample and from the prediction,
+// and what tracking and predicting costs per event.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../src/core/event_trace.h"
+#include "../src/core/monitor_core.h"
+#include "../src/core/motion_predictor.h"
+#include "../src/simulated/simulated_backend.h"
+
+using namespace agora::plugin::windowmonitor;
+
+namespace {
+
+static uint64_t _callbacks = 0;
+static float _checksum = 0.f;
+
+void onEvent(WNDID id, EventType type, CRect rect) {
+  _callbacks++;
+  _checksum += rect.left;
+}
+
+struct BenchResult {
+  double events_per_second;
+  double callbacks_per_second;
+};
+
+BenchResult runBench(size_t windows, size_t events, bool lookup_rects) {
+  SimulatedBackend::Options options = SimulatedBackend::DefaultOptions();
+  options.lookup_rects = lookup_rects;
+  SimulatedBackend* backend = new SimulatedBackend(options);
+  MonitorCore core{std::unique_ptr<Backend>(backend)};
+  const WNDID first = backend->AddWindows(windows);
+  for (size_t i = 0; i < windows; i++) {
+    core.Register((WNDID)((uintptr_t)first + i), onEvent);
+  }
+
+  // warm up
+  backend->Generate(events / 10);
+
+  _callbacks = 0;
+  auto begin = std::chrono::steady_clock::now();
+  const size_t generated = backend->Generate(events);
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - begin)
+                             .count();
+
+  BenchResult result;
+  result.events_per_second = generated / seconds;
+  result.callbacks_per_second = _callbacks / seconds;
+  return result;
+}
+
+// Accepts any window, the windows of a trace are gone when it is replayed.
+class ReplayBackend : public Backend {
+ public:
+  bool CheckPrivileges() override { return true; }
+  int Attach(WNDID id) override { return ErrorCode::Success; }
+  void Detach(WNDID id) override {}
+  int GetWindowRect(WNDID id, CRect& crect) override {
+    return ErrorCode::WindowNotFound;
+  }
+};
+
+int runReplay(const char* path, double speed) {
+  std::vector<RawEvent> events;
+  if (!ReadEventTrace(path, events)) {
+    printf("%s is not an event trace\r\n", path);
+    return 1;
+  }
+
+  MonitorCore core{std::unique_ptr<Backend>(new ReplayBackend())};
+  std::unordered_set<WNDID> windows;
+  for (auto& event : events) {
+    if (windows.insert(event.id).second) core.Register(event.id, onEvent);
+  }
+
+  _callbacks = 0;
+  auto begin = std::chrono::steady_clock::now();
+  const int64_t replayed = ReplayEvents(events, &core, speed);
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - begin)
+                             .count();
+  printf("%5zu windows replay      raw %7.2f M/s  callbacks %7.2f M/s\r\n",
+         windows.size(), replayed / seconds / 1e6, _callbacks / seconds / 1e6);
+  return 0;
+}
+
+struct Sample {
+  WNDID id;
+  EventType type;
+  CRect rect;
+  uint64_t timestamp;
+};
+
+// Collects the classified events of the simulated desktop. Its windows move
+// a step per event of their own, each is stamped with a clock of its window
+// as if a mouse of its own reported it every interval.
+class SampleSink : public BackendSink {
+ public:
+  SampleSink(uint64_t interval_us, std::vector<Sample>& samples)
+      : interval_us_(interval_us), samples_(samples) {}
+
+  void OnRawEvent(const RawEvent& event) override {
+    const uint64_t now = clocks_[event.id] += interval_us_;
+    const EventType type = MonitorCore::Classify(event);
+    if (type != EventType::Unknown)
+      samples_.push_back(Sample{event.id, type, event.rect, now});
+  }
+
+ private:
+  const uint64_t interval_us_;
+  std::unordered_map<WNDID, uint64_t> clocks_;
+  std::vector<Sample>& samples_;
+};
+
+struct Errors {
+  double mean;
+  double p99;
+};
+
+Errors summarize(std::vector<float>& errors) {
+  Errors result = {0, 0};
+  if (errors.empty()) return result;
+  for (float error : errors) result.mean += error;
+  result.mean /= errors.size();
+  std::sort(errors.begin(), errors.end());
+  result.p99 = errors[(errors.size() - 1) * 99 / 100];
+  return result;
+}
+
+float edgeError(const CRect& a, const CRect& b) {
+  return fmaxf(fmaxf(fabsf(a.left - b.left), fabsf(a.top - b.top)),
+               fmaxf(fabsf(a.right - b.right), fabsf(a.bottom - b.bottom)));
+}
+
+// Returns false when predicting is worse than holding the last rect.
+bool evaluatePrediction(const char* name, const std::vector<Sample>& samples,
+                        uint32_t lead_us) {
+  std::unordered_map<WNDID, std::vector<Sample>> windows;
+  for (auto& sample : samples) windows[sample.id].push_back(sample);
+
+  // the rect of a window at a time is the last one captured by then
+  std::vector<float> held;
+  std::vector<float> predicted;
+  for (auto& item : windows) {
+    const std::vector<Sample>& list = item.second;
+    MotionTrack track;
+    size_t truth = 0;
+    for (size_t i = 0; i < list.size(); i++) {
+      track.Observe(list[i].type, list[i].rect, list[i].timestamp);
+      if (list[i].type != EventType::Moving) continue;
+
+      const uint64_t target = list[i].timestamp + lead_us;
+      if (truth < i) truth = i;
+      while (truth + 1 < list.size() && list[truth + 1].timestamp <= target)
+        truth++;
+      // not known how long the last rect stayed
+      if (truth + 1 == list.size()) break;
+
+      CRect rect;
+      track.Predict(target, rect);
+      held.push_back(edgeError(list[i].rect, list[truth].rect));
+      predicted.push_back(edgeError(rect, list[truth].rect));
+    }
+  }
+
+  // the cost inside the core, with the lock and lookup of the window
+  MotionPredictor predictor;
+  for (auto& item : windows) predictor.SetLead(item.first, lead_us);
+  float checksum = 0;
+  auto begin = std::chrono::steady_clock::now();
+  for (auto& sample : samples) {
+    predictor.Observe(sample.id, sample.type, sample.rect, sample.timestamp);
+    CRect rect;
+    if (sample.type == EventType::Moving &&
+        predictor.Predict(sample.id, sample.timestamp, rect))
+      checksum += rect.left;
+  }
+  const double ns = std::chrono::duration<double, std::nano>(
+                        std::chrono::steady_clock::now() - begin)
+                        .count();
+
+  const size_t count = held.size();
+  const Errors hold = summarize(held);
+  const Errors predict = summarize(predicted);
+  printf("%-16s lead %2u ms %8zu moving  error held %6.2f / %6.2f px"
+         "  predicted %6.2f / %6.2f px (mean / p99)  %5.1f ns per event\r\n",
+         name, lead_us / 1000, count, hold.mean, hold.p99, predict.mean,
+         predict.p99, samples.empty() ? 0 : ns / samples.size());
+  return checksum != -1.f && (count == 0 || predict.mean <= hold.mean);
+}
+
+int runPredict(uint32_t lead_us, const char* path) {
+  std::vector<Sample> samples;
+  if (path) {
+    std::vector<RawEvent> events;
+    if (!ReadEventTrace(path, events)) {
+      printf("%s is not an event trace\r\n", path);
+      return 1;
+    }
+    for (auto& event : events) {
+      const EventType type = MonitorCore::Classify(event);
+      if (type != EventType::Unknown)
+        samples.push_back(Sample{event.id, type, event.rect, event.timestamp});
+    }
+    return evaluatePrediction("replay", samples, lead_us) ? 0 : 1;
+  }
+
+  const size_t windows[] = {1, 16};
+  bool ok = true;
+  for (size_t count : windows) {
+    SimulatedBackend::Options options = SimulatedBackend::DefaultOptions();
+    SimulatedBackend backend(options);
+    samples.clear();
+    SampleSink sink(options.event_interval_us, samples);
+    backend.SetSink(&sink);
+    const WNDID first = backend.AddWindows(count);
+    for (size_t i = 0; i < count; i++)
+      backend.Attach((WNDID)((uintptr_t)first + i));
+    backend.Generate(200000);
+
+    char name[32];
+    snprintf(name, sizeof(name), "%zu windows", count);
+    ok = evaluatePrediction(name, samples, lead_us) && ok;
+  }
+  return ok ? 0 : 1;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc > 2 && strcmp(argv[1], "--replay") == 0)
+    return runReplay(argv[2], argc > 3 ? atof(argv[3]) : 0);
+  if (argc > 2 && strcmp(argv[1], "--predict") == 0)
+    return runPredict((uint32_t)(atof(argv[2]) * 1000),
+                      argc > 3 ? argv[3] : nullptr);
+
+  bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+  const size_t events = quick ? 200000 : 10000000;
+
+  const size_t windows[] = {1, 100, 5000};
+  for (int lookup = 0; lookup < 2; lookup++) {
+    for (size_t count : windows) {
+      BenchResult result = runBench(count, events, lookup != 0);
+      printf("%5zu windows %-11s raw %7.2f M/s  callbacks %7.2f M/s\r\n",
+             count, lookup ? "rect lookup" : "event rect",
+             result.events_per_second / 1e6,
+             result.callbacks_per_second / 1e6);
+      if (result.callbacks_per_second <= 0) return 1;
+    }
+  }
+
+  // keep the callback from being optimized away
+  return _checksum == -1.f ? 1 : 0;
+}
@@ -0,0 +1,286 @@
+// Check the xcb backend against a running X server like Xvfb: a second
+// connection plays the application and the window manager, moves, resizes,
+// maps and changes _NET_WM_STATE and _NET_ACTIVE_WINDOW, and every change
+// must reach the callback as the matching EventType. Then many windows are
+// moved at once to measure how fast configure events are delivered.
+// Skipped when DISPLAY is not set.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "../src/core/monitor_core.h"
+#include "../src/linux/xcb_backend.h"
+
+using namespace agora::plugin::windowmonitor;
+
+#define EXPECT(cond)                                                   \
+  do {                                                                 \
+    if (!(cond)) {                                                     \
+      printf("%s:%d expect failed: %s\r\n", __FILE__, __LINE__, #cond); \
+      return false;                                                    \
+    }                                                                  \
+  } while (0)
+
+namespace {
+
+// ctest SKIP_RETURN_CODE
+const int kSkipped = 77;
+const std::chrono::seconds kTimeout(2);
+
+struct Received {
+  WNDID id;
+  EventType type;
+  CRect rect;
+};
+
+static std::mutex _lock;
+static std::condition_variable _cond;
+static std::vector<Received> _received;
+
+void onEvent(WNDID id, EventType type, CRect rect) {
+  std::lock_guard<std::mutex> guard(_lock);
+  _received.push_back(Received{id, type, rect});
+  _cond.notify_all();
+}
+
+// Waits for type on id and returns it, events before it are dropped.
+bool waitFor(WNDID id, EventType type, Received* result = nullptr) {
+  std::unique_lock<std::mutex> guard(_lock);
+  auto deadline = std::chrono::steady_clock::now() + kTimeout;
+  while (true) {
+    for (size_t i = 0; i < _received.size(); i++) {
+      if (_received[i].id == id && _received[i].type == type) {
+        if (result) *result = _received[i];
+        _received.erase(_received.begin(), _received.begin() + i + 1);
+        return true;
+      }
+    }
+    if (_cond.wait_until(guard, deadline) == std::cv_status::timeout) {
+      return false;
+    }
+  }
+}
+
+// The application side of the test.
+class App {
+ public:
+  App() : connection_(xcb_connect(nullptr, nullptr)) {
+    const xcb_setup_t* setup = xcb_get_setup(connection_);
+    screen_ = xcb_setup_roots_iterator(setup).data;
+  }
+  ~App() { xcb_disconnect(connection_); }
+
+  xcb_window_t CreateWindow(int16_t x, int16_t y, uint16_t width,
+                            uint16_t height) {
+    xcb_window_t window = xcb_generate_id(connection_);
+    // no window manager, place it where it is asked to be
+    const uint32_t values[] = {1};
+    xcb_create_window(connection_, XCB_COPY_FROM_PARENT, window, screen_->root,
+                      x, y, width, height, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                      screen_->root_visual, XCB_CW_OVERRIDE_REDIRECT, values);
+    xcb_map_window(connection_, window);
+    Sync();
+    return window;
+  }
+
+  void Move(xcb_window_t window, int32_t x, int32_t y) {
+    const uint32_t values[] = {(uint32_t)x, (uint32_t)y};
+    xcb_configure_window(connection_, window,
+                         XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y, values);
+  }
+
+  void Resize(xcb_window_t window, uint32_t width, uint32_t height) {
+    const uint32_t values[] = {width, height};
+    xcb_configure_window(
+        connection_, window,
+        XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, values);
+  }
+
+  void Map(xcb_window_t window, bool mapped) {
+    if (mapped) {
+      xcb_map_window(connection_, window);
+    } else {
+      xcb_unmap_window(connection_, window);
+    }
+  }
+
+  // what a window manager does
+  void SetState(xcb_window_t window, const std::vector<const char*>& names) {
+    std::vector<xcb_atom_t> atoms;
+    for (auto name : names) atoms.push_back(Atom(name));
+    xcb_change_property(connection_, XCB_PROP_MODE_REPLACE, window,
+                        Atom("_NET_WM_STATE"), XCB_ATOM_ATOM, 32,
+                        (uint32_t)atoms.size(), atoms.data());
+  }
+
+  void Activate(xcb_window_t window) {
+    xcb_change_property(connection_, XCB_PROP_MODE_REPLACE, screen_->root,
+                        Atom("_NET_ACTIVE_WINDOW"), XCB_ATOM_WINDOW, 32, 1,
+                        &window);
+  }
+
+  void Destroy(xcb_window_t window) {
+    xcb_destroy_window(connection_, window);
+  }
+
+  void Sync() {
+    free(xcb_get_input_focus_reply(
+        connection_, xcb_get_input_focus(connection_), nullptr));
+  }
+
+ private:
+  xcb_atom_t Atom(const char* name) {
+    xcb_intern_atom_reply_t* reply = xcb_intern_atom_reply(
+        connection_,
+        xcb_intern_atom(connection_, 0, (uint16_t)strlen(name), name),
+        nullptr);
+    xcb_atom_t atom = reply ? reply->atom : XCB_ATOM_NONE;
+    free(reply);
+    return atom;
+  }
+
+  xcb_connection_t* connection_;
+  xcb_screen_t* screen_;
+};
+
+bool testEvents(MonitorCore& core, App& app) {
+  const xcb_window_t window = app.CreateWindow(10, 20, 300, 200);
+  const WNDID id = (WNDID)window;
+
+  Received received;
+  EXPECT(core.Register(id, onEvent) == ErrorCode::Success);
+  EXPECT(waitFor(id, EventType::Moved, &received));
+  EXPECT(received.rect.left == 10.f && received.rect.top == 20.f);
+  EXPECT(received.rect.right == 310.f && received.rect.bottom == 220.f);
+  EXPECT(core.Register((WNDID)(window + 1000), onEvent) ==
+         ErrorCode::WindowNotFound);
+
+  app.Move(window, 50, 60);
+  app.Sync();
+  EXPECT(waitFor(id, EventType::Moved, &received));
+  EXPECT(received.rect.left == 50.f && received.rect.top == 60.f);
+
+  app.Resize(window, 400, 250);
+  app.Sync();
+  EXPECT(waitFor(id, EventType::Resized, &received));
+  EXPECT(received.rect.right == 450.f && received.rect.bottom == 310.f);
+
+  app.Map(window, false);
+  app.Sync();
+  EXPECT(waitFor(id, EventType::Hide));
+  app.Map(window, true);
+  app.Sync();
+  EXPECT(waitFor(id, EventType::Shown));
+
+  app.SetState(window,
+               {"_NET_WM_STATE_MAXIMIZED_VERT", "_NET_WM_STATE_MAXIMIZED_HORZ"});
+  app.Sync();
+  EXPECT(waitFor(id, EventType::Maxmized));
+  app.SetState(window, {"_NET_WM_STATE_HIDDEN"});
+  app.Sync();
+  EXPECT(waitFor(id, EventType::Minimized));
+  app.SetState(window, {});
+  app.Sync();
+  EXPECT(waitFor(id, EventType::Restore));
+
+  app.Activate(window);
+  app.Sync();
+  EXPECT(waitFor(id, EventType::Focused));
+  app.Activate(XCB_WINDOW_NONE);
+  app.Sync();
+  EXPECT(waitFor(id, EventType::UnFocused));
+
+  CRect rect;
+  EXPECT(core.GetWindowRect(id, rect) == ErrorCode::Success);
+  EXPECT(rect.left == 50.f && rect.right == 450.f);
+
+  // nothing after unregistering
+  core.Unregister(id);
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    _received.clear();
+  }
+  app.Move(window, 70, 80);
+  app.Sync();
+  // a round trip of the backend connection as well
+  EXPECT(core.GetWindowRect(id, rect) == ErrorCode::Success);
+  EXPECT(!waitFor(id, EventType::Moved));
+
+  app.Destroy(window);
+  app.Sync();
+  return true;
+}
+
+bool benchMoves(MonitorCore& core, App& app, size_t windows, size_t moves) {
+  std::vector<xcb_window_t> list;
+  for (size_t i = 0; i < windows; i++) {
+    list.push_back(app.CreateWindow((int16_t)(i % 32 * 20),
+                                    (int16_t)(i / 32 * 20), 200, 100));
+    EXPECT(core.Register((WNDID)list.back(), onEvent) == ErrorCode::Success);
+  }
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    _received.clear();
+  }
+
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t move = 1; move <= moves; move++) {
+    for (size_t i = 0; i < windows; i++) {
+      app.Move(list[i], (int32_t)(i % 32 * 20 + move), (int32_t)(i / 32 * 20));
+    }
+  }
+  app.Sync();
+  // the last move of every window is reported
+  for (size_t i = 0; i < windows; i++) {
+    Received received;
+    bool last = false;
+    while (!last) {
+      EXPECT(waitFor((WNDID)list[i], EventType::Moved, &received));
+      last = received.rect.left == (float)(i % 32 * 20 + moves);
+    }
+  }
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - begin)
+                             .count();
+
+  printf("%zu windows moved %zu times: %.0f configures/s, %.1f ms\r\n",
+         windows, moves, windows * moves / seconds, seconds * 1e3);
+
+  for (auto window : list) {
+    core.Unregister((WNDID)window);
+    app.Destroy(window);
+  }
+  app.Sync();
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+
+  if (!getenv("DISPLAY")) {
+    printf("xcb test skipped, DISPLAY is not set\r\n");
+    return kSkipped;
+  }
+
+  std::unique_ptr<XcbBackend> backend = XcbBackend::Connect();
+  if (!backend) {
+    printf("xcb test skipped, can not connect to %s\r\n", getenv("DISPLAY"));
+    return kSkipped;
+  }
+  MonitorCore core{std::unique_ptr<Backend>(backend.release())};
+  App app;
+
+  bool ok = testEvents(core, app) &&
+            benchMoves(core, app, quick ? 16 : 256, quick ? 50 : 200);
+
+  printf("xcb test %s\r\n", ok ? "passed" : "failed");
+  return ok ? 0 : 1;
+}